@@ -12,7 +12,7 @@ namespace ns3 {
     BlockchainMinerHelper::BlockchainMinerHelper(std::string protocol, Address address, std::vector<Ipv4Address> peers, int noMiners,
                                                 std::map<Ipv4Address, double> &peersDownloadSpeeds, std::map<Ipv4Address, double> &peersUploadSpeeds,
                                                 nodeInternetSpeed &internetSpeeds, nodeStatistics *stats, double hashRate, double averageBlockGenIntervalSeconds)
-                                                :BlockchainNodeHelper(), m_minerType(NORMAL_MINER), m_blockGenBinSize(-1), m_blockGenParameter(-1)
+                                                :BlockchainNodeHelper(), m_minerType(NORMAL_MINER)
     {
         m_factory.SetTypeId("ns3:BlockchainMiner");
         commonConstructor(protocol, address, peers, peersDownloadSpeeds, peersUploadSpeeds, internetSpeeds, stats);
@@ -40,6 +40,16 @@ namespace ns3 {
                 app->SetNodeInternetSpeeds(m_internetSpeeds);
                 app->SetNodeStats(m_nodeStats);
                 app->SetProtocolType(m_protocolType);
+                app->SetPeersNodeIds(m_peersNodeIds);
+                app->SetPeersShards(m_peersShards);
+                app->SetShardGateways(m_shardGateways);
+                app->SetFlowNetwork(m_flowNetwork);
+                app->SetTransactionLatencies(m_transactionLatencies);
+
+                if(m_miningScheduler != 0)
+                {
+                    app->SetMiningScheduler(m_miningScheduler);
+                }
                 
                 node->AddApplication(app);
                 
@@ -48,11 +58,40 @@ namespace ns3 {
             }
             case ENDORSER:
             {
-                break;
+                Ptr<BlockchainEndorser> app = m_factory.Create<BlockchainEndorser>();
+                app->SetPeersAddresses(m_peersAddresses);
+                app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
+                app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
+                app->SetNodeInternetSpeeds(m_internetSpeeds);
+                app->SetNodeStats(m_nodeStats);
+                app->SetProtocolType(m_protocolType);
+                app->SetPeersNodeIds(m_peersNodeIds);
+                app->SetEndorsers(m_endorsers);
+                app->SetOrderers(m_orderers);
+                app->SetFlowNetwork(m_flowNetwork);
+                app->SetTransactionLatencies(m_transactionLatencies);
+
+                node->AddApplication(app);
+
+                return app;
             }
             case ORDER:
             {
+                Ptr<BlockchainOrderer> app = m_factory.Create<BlockchainOrderer>();
+                app->SetPeersAddresses(m_peersAddresses);
+                app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
+                app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
+                app->SetNodeInternetSpeeds(m_internetSpeeds);
+                app->SetNodeStats(m_nodeStats);
+                app->SetProtocolType(m_protocolType);
+                app->SetPeersNodeIds(m_peersNodeIds);
+                app->SetOrderers(m_orderers);
+                app->SetFlowNetwork(m_flowNetwork);
+                app->SetTransactionLatencies(m_transactionLatencies);
+
+                node->AddApplication(app);
 
+                return app;
             }
         }
 
@@ -74,23 +113,54 @@ namespace ns3 {
         {
             case NORMAL_MINER:
             {
-                m_factory.SetTypeId("ns3::BlockchainMiner");
+                m_factory.SetTypeId("ns3:BlockchainMiner");
                 SetFactoryAttributes();
                 break;
             }
             case ENDORSER:
             {
-                m_factory.SetTypeId("ns3::BlockchainMiner");
-                SetFactoryAttributes();
+                /*
+                 * The endorsers and the orderers do not mine, they only take the attributes of BlockchainNode
+                 */
+                m_factory.SetTypeId("ns3::BlockchainEndorser");
+                m_factory.Set("Protocol", StringValue(m_protocol));
+                m_factory.Set("Local", AddressValue(m_address));
+                break;
             }
             case ORDER:
             {
-                m_factory.SetTypeId("ns3::BlockchainMiner");
-                SetFactoryAttributes();
+                m_factory.SetTypeId("ns3::BlockchainOrderer");
+                m_factory.Set("Protocol", StringValue(m_protocol));
+                m_factory.Set("Local", AddressValue(m_address));
+                break;
             }
         }
     }
 
+    void
+    BlockchainMinerHelper::SetMiningScheduler(Ptr<BlockchainMiningScheduler> miningScheduler)
+    {
+        m_miningScheduler = miningScheduler;
+    }
+
+    void
+    BlockchainMinerHelper::SetEndorsers(const std::vector<int> &endorsers)
+    {
+        m_endorsers = endorsers;
+    }
+
+    void
+    BlockchainMinerHelper::SetOrderers(const std::vector<int> &orderers)
+    {
+        m_orderers = orderers;
+    }
+
+    void
+    BlockchainMinerHelper::SetShardGateways(const std::vector<int> &gateways)
+    {
+        m_shardGateways = gateways;
+    }
+
     void
     BlockchainMinerHelper::SetFactoryAttributes(void)
     {
@@ -99,12 +169,6 @@ namespace ns3 {
         m_factory.Set("NumberOfMiners", UintegerValue(m_noMiners));
         m_factory.Set("HashRate", DoubleValue(m_hashRate));
         m_factory.Set("AverageBlockGenIntervalSeconds", DoubleValue(m_averageBlockGenIntervalSeconds));
-
-        if(m_blockGenBinSize > 0 && m_blockGenParameter)
-        {
-            m_factory.Set("BlockGenBinSize", DoubleValue(m_blockGenBinSize));
-            m_factory.Set("BlockGenParameter", DoubleValue(m_blockGenParameter));
-        }
     }
 
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 #define BLOCKCHAIN_MINER_HELPER_H
 
 #include "ns3/blockchain-node-helper.h"
+#include "ns3/blockchain-miner.h"
+#include "ns3/blockchain-endorser.h"
+#include "ns3/blockchain-orderer.h"
 
 namespace ns3{
 
@@ -16,6 +19,23 @@ namespace ns3{
             enum MinerType GetMinerType(void);
             void SetMinerType(enum MinerType m);
 
+            /*
+             * Installed miners share miningScheduler instead of scheduling their own
+             * mining events. All of them must run in the same process.
+             */
+            void SetMiningScheduler(Ptr<BlockchainMiningScheduler> miningScheduler);
+
+            /*
+             * The node ids of the endorsers and of the ordering service, for ENDORSER and ORDER nodes
+             */
+            void SetEndorsers(const std::vector<int> &endorsers);
+            void SetOrderers(const std::vector<int> &orderers);
+
+            /*
+             * The gateway miner of every shard, for the NORMAL_MINER nodes of a sharded network
+             */
+            void SetShardGateways(const std::vector<int> &gateways);
+
         protected:
 
             virtual Ptr<Application> InstallPriv(Ptr<Node> node);
@@ -25,9 +45,11 @@ namespace ns3{
             enum MinerType      m_minerType;
             int                 m_noMiners;
             double              m_hashRate;
-            double              m_blockGenBinSize;
-            double              m_blockGenParameter;
             double              m_averageBlockGenIntervalSeconds;
+            Ptr<BlockchainMiningScheduler>  m_miningScheduler;
+            std::vector<int>    m_endorsers;
+            std::vector<int>    m_orderers;
+            std::vector<int>    m_shardGateways;
         
 
     };
@@ -15,7 +15,7 @@ namespace ns3 {
         commonConstructor(protocol, address, peers, peersDownloadSpeeds, peersUploadSpeeds, internetSpeeds, stats);
     }
 
-    BlockchainNodeHelper::BlockchainNodeHelper(void)
+    BlockchainNodeHelper::BlockchainNodeHelper(void) : m_transactionLatencies(nullptr)
     {
 
     }
@@ -33,6 +33,7 @@ namespace ns3 {
         m_internetSpeeds = internetSpeeds;
         m_nodeStats = stats;
         m_protocolType = STANDARD_PROTOCOL;
+        m_transactionLatencies = nullptr;
 
         m_factory.Set("Protocol", StringValue(m_protocol));
         m_factory.Set("Local", AddressValue(m_address));
@@ -80,6 +81,10 @@ namespace ns3 {
         app->SetNodeInternetSpeeds(m_internetSpeeds);
         app->SetNodeStats(m_nodeStats);
         app->SetProtocolType(m_protocolType);
+        app->SetPeersNodeIds(m_peersNodeIds);
+        app->SetPeersShards(m_peersShards);
+        app->SetFlowNetwork(m_flowNetwork);
+        app->SetTransactionLatencies(m_transactionLatencies);
 
         node->AddApplication(app);
 
@@ -122,6 +127,47 @@ namespace ns3 {
         m_protocolType = protocolType;
     }
 
+    void
+    BlockchainNodeHelper::SetPeersNodeIds(const std::map<Ipv4Address, uint32_t> &peersNodeIds)
+    {
+        m_peersNodeIds = peersNodeIds;
+    }
+
+    void
+    BlockchainNodeHelper::SetPeersShards(const std::map<Ipv4Address, uint32_t> &peersShards)
+    {
+        m_peersShards = peersShards;
+    }
+
+    void
+    BlockchainNodeHelper::SetFlowNetwork(Ptr<BlockchainFlowNetwork> flowNetwork)
+    {
+        m_flowNetwork = flowNetwork;
+    }
+
+    void
+    BlockchainNodeHelper::SetTransactionLatencies(TransactionLatencies *transactionLatencies)
+    {
+        m_transactionLatencies = transactionLatencies;
+    }
+
+    int64_t
+    BlockchainNodeHelper::AssignStreams(ApplicationContainer c, int64_t stream)
+    {
+        int64_t streams = 0;
+
+        for(ApplicationContainer::Iterator i = c.Begin(); i != c.End(); ++i)
+        {
+            Ptr<BlockchainNode> app = DynamicCast<BlockchainNode>(*i);
+
+            if(app != 0)
+            {
+                streams += app->AssignStreams(stream + app->GetNode()->GetId() * BlockchainNode::STREAMS_PER_NODE);
+            }
+        }
+        return streams;
+    }
+
 
 
 
@@ -11,6 +11,8 @@
 namespace ns3
 {
 
+    class BlockchainFlowNetwork;
+
     class BlockchainNodeHelper{
         public:
 
@@ -37,6 +39,34 @@ namespace ns3
             void SetNodeStats(nodeStatistics *nodeStats);
             void SetProtocolType(enum ProtocolType protocolType);
 
+            /*
+             * The node id behind each peer address of the next installed node
+             */
+            void SetPeersNodeIds(const std::map<Ipv4Address, uint32_t> &peersNodeIds);
+
+            /*
+             * The shard of each peer of the next installed node
+             */
+            void SetPeersShards(const std::map<Ipv4Address, uint32_t> &peersShards);
+
+            /*
+             * The installed nodes send their messages through the shared flow-level model instead of TCP sockets
+             */
+            void SetFlowNetwork(Ptr<BlockchainFlowNetwork> flowNetwork);
+
+            /*
+             * The installed nodes add their transaction latencies to these when they stop
+             */
+            void SetTransactionLatencies(TransactionLatencies *transactionLatencies);
+
+            /*
+             * Assigns the random variable streams of the installed nodes. The node with id n takes
+             * stream + n * BlockchainNode::STREAMS_PER_NODE onwards, so the streams of a node do not depend
+             * on the MPI partitioning, and stream + (node count) * STREAMS_PER_NODE is the first free one.
+             * Returns the number of streams assigned.
+             */
+            int64_t AssignStreams(ApplicationContainer c, int64_t stream);
+
         protected:
 
             virtual Ptr<Application> InstallPriv (Ptr<Node> node);
@@ -49,7 +79,11 @@ namespace ns3
             std::map<Ipv4Address, double>   m_peersUploadSpeeds;
             nodeInternetSpeed               m_internetSpeeds;
             nodeStatistics                  *m_nodeStats;
-            enum ProtocolType               m_protocolType;          
+            enum ProtocolType               m_protocolType;
+            std::map<Ipv4Address, uint32_t> m_peersNodeIds;
+            std::map<Ipv4Address, uint32_t> m_peersShards;
+            Ptr<BlockchainFlowNetwork>      m_flowNetwork;
+            TransactionLatencies            *m_transactionLatencies;
 
     };
 
@@ -0,0 +1,350 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/blockchain-region-model.h"
+#include "ns3/log.h"
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BlockchainRegionModel");
+
+static bool
+IsKeyword (const std::string &token)
+{
+  return token == "region" || token == "nodes" || token == "latency" || token == "bins"
+         || token == "download" || token == "upload";
+}
+
+static double
+ReadNumber (const std::string &token, const std::string &fileName)
+{
+  char *end;
+  double value = strtod (token.c_str (), &end);
+
+  if (token.empty () || *end != '\0')
+  {
+    NS_FATAL_ERROR ("The region model " << fileName << " has " << token << " where a number is expected\n");
+  }
+  return value;
+}
+
+BlockchainRegionModel::BlockchainRegionModel ()
+{
+}
+
+void
+BlockchainRegionModel::Load (const std::string &fileName)
+{
+  std::ifstream file (fileName.c_str ());
+  std::string line;
+  std::vector<std::vector<std::string>> records;
+  std::map<std::string, std::vector<double>> nodesWeights;
+
+  if (!file.is_open ())
+  {
+    NS_FATAL_ERROR ("Cannot open the region model " << fileName << "\n");
+  }
+  m_fileName = fileName;
+
+  while (std::getline (file, line))
+  {
+    std::istringstream tokens (line.substr (0, line.find ('#')));
+    std::string token;
+
+    while (tokens >> token)
+    {
+      if (IsKeyword (token))
+      {
+        records.push_back (std::vector<std::string> ());
+      }
+      else if (records.empty ())
+      {
+        NS_FATAL_ERROR ("The region model " << fileName << " starts with " << token << " instead of a keyword\n");
+      }
+      records.back ().push_back (token);
+    }
+  }
+
+  /*
+   * The regions and the bins first, so that the other records can refer to the ones declared after them
+   */
+  for (auto const &record : records)
+  {
+    if (record[0] == "region")
+    {
+      for (uint32_t i = 1; i < record.size (); i++)
+      {
+        if (m_regionIndices.find (record[i]) == m_regionIndices.end ())
+        {
+          m_regionIndices[record[i]] = m_regionNames.size ();
+          m_regionNames.push_back (record[i]);
+        }
+      }
+    }
+    else if (record[0] == "bins")
+    {
+      std::vector<double> edges = ReadEdges (record, 2);
+
+      if (record.size () < 2 || edges.size () < 2)
+      {
+        NS_FATAL_ERROR ("The bins record of " << fileName << " needs a name and at least two edges\n");
+      }
+      m_bins[record[1]] = edges;
+    }
+  }
+
+  if (m_regionNames.empty ())
+  {
+    NS_FATAL_ERROR ("The region model " << fileName << " declares no region\n");
+  }
+
+  m_meanLatencies.assign (m_regionNames.size (), std::vector<double> (m_regionNames.size (), -1));
+  m_latencyShapes.assign (m_regionNames.size (), std::vector<double> (m_regionNames.size (), 0));
+
+  for (auto const &record : records)
+  {
+    if (record[0] == "nodes")
+    {
+      if (record.size () < 2)
+      {
+        NS_FATAL_ERROR ("The nodes record of " << fileName << " needs a network\n");
+      }
+      nodesWeights[record[1]] = ReadWeights (record, 2);
+
+      if (nodesWeights[record[1]].size () != m_regionNames.size ())
+      {
+        NS_FATAL_ERROR ("The nodes record of " << record[1] << " in " << fileName << " has "
+                        << nodesWeights[record[1]].size () << " weights for " << m_regionNames.size () << " regions\n");
+      }
+    }
+    else if (record[0] == "latency")
+    {
+      if (record.size () != 4 && record.size () != 5)
+      {
+        NS_FATAL_ERROR ("The latency records of " << fileName << " need two regions, a mean and an optional shape\n");
+      }
+
+      uint32_t from = GetRegionIndex (record[1], fileName);
+      uint32_t to = GetRegionIndex (record[2], fileName);
+
+      m_meanLatencies[from][to] = m_meanLatencies[to][from] = ReadNumber (record[3], fileName);
+      m_latencyShapes[from][to] = m_latencyShapes[to][from] = record.size () == 5 ? ReadNumber (record[4], fileName) : 0;
+    }
+    else if (record[0] == "download" || record[0] == "upload")
+    {
+      if (record.size () < 3 || m_bins.find (record[2]) == m_bins.end ())
+      {
+        NS_FATAL_ERROR ("The " << record[0] << " records of " << fileName << " need a region and declared bins\n");
+      }
+
+      uint32_t region = GetRegionIndex (record[1], fileName);
+      const std::vector<double> &edges = m_bins[record[2]];
+      std::vector<double> weights = ReadWeights (record, 3);
+
+      if (weights.size () + 1 != edges.size ())
+      {
+        NS_FATAL_ERROR ("The " << record[0] << " histogram of " << record[1] << " in " << fileName << " has "
+                        << weights.size () << " weights for " << edges.size () - 1 << " bins\n");
+      }
+
+      auto &distributions = record[0] == "download" ? m_downloadDistributions : m_uploadDistributions;
+      distributions[region] = std::piecewise_constant_distribution<double> (edges.begin (), edges.end (), weights.begin ());
+    }
+  }
+
+  for (uint32_t i = 0; i < m_regionNames.size (); i++)
+  {
+    for (uint32_t j = 0; j < m_regionNames.size (); j++)
+    {
+      if (m_meanLatencies[i][j] < 0)
+      {
+        NS_FATAL_ERROR ("The region model " << fileName << " has no latency between " << m_regionNames[i]
+                        << " and " << m_regionNames[j] << "\n");
+      }
+    }
+  }
+
+  /*
+   * The node shares are sampled as a region index: bin k of [k, k + 1) is region k
+   */
+  for (auto const &network : nodesWeights)
+  {
+    std::vector<double> intervals;
+
+    for (uint32_t i = 0; i <= m_regionNames.size (); i++)
+    {
+      intervals.push_back (i);
+    }
+
+    for (uint32_t i = 0; i < m_regionNames.size (); i++)
+    {
+      if (network.second[i] > 0 && (m_downloadDistributions.find (i) == m_downloadDistributions.end ()
+                                    || m_uploadDistributions.find (i) == m_uploadDistributions.end ()))
+      {
+        NS_FATAL_ERROR ("The region " << m_regionNames[i] << " of " << fileName << " has nodes but no bandwidth histograms\n");
+      }
+    }
+
+    m_nodesDistributions[network.first] = std::piecewise_constant_distribution<double> (intervals.begin (), intervals.end (),
+                                                                                        network.second.begin ());
+  }
+
+  NS_LOG_INFO ("Loaded the region model " << fileName << " with " << m_regionNames.size () << " regions and "
+               << m_nodesDistributions.size () << " networks");
+}
+
+uint32_t
+BlockchainRegionModel::GetNoRegions (void) const
+{
+  return m_regionNames.size ();
+}
+
+const std::string&
+BlockchainRegionModel::GetRegionName (uint32_t region) const
+{
+  return m_regionNames.at (region);
+}
+
+int
+BlockchainRegionModel::GetRegion (const std::string &name) const
+{
+  auto region = m_regionIndices.find (name);
+
+  return region != m_regionIndices.end () ? static_cast<int> (region->second) : -1;
+}
+
+uint32_t
+BlockchainRegionModel::SampleRegion (const std::string &network, std::default_random_engine &generator)
+{
+  auto distribution = m_nodesDistributions.find (network);
+
+  if (distribution == m_nodesDistributions.end ())
+  {
+    NS_FATAL_ERROR ("The region model " << m_fileName << " has no node shares for " << network << "\n");
+  }
+
+  return std::min (static_cast<uint32_t> (distribution->second (generator)), GetNoRegions () - 1);
+}
+
+double
+BlockchainRegionModel::GetMeanLatency (uint32_t from, uint32_t to) const
+{
+  return m_meanLatencies.at (from).at (to);
+}
+
+double
+BlockchainRegionModel::GetLatencyShape (uint32_t from, uint32_t to) const
+{
+  return m_latencyShapes.at (from).at (to);
+}
+
+double
+BlockchainRegionModel::SampleDownloadSpeed (uint32_t region, std::default_random_engine &generator)
+{
+  return m_downloadDistributions.at (region) (generator);
+}
+
+double
+BlockchainRegionModel::SampleUploadSpeed (uint32_t region, std::default_random_engine &generator)
+{
+  return m_uploadDistributions.at (region) (generator);
+}
+
+std::vector<double>
+BlockchainRegionModel::ReadWeights (const std::vector<std::string> &tokens, uint32_t first) const
+{
+  std::vector<double> weights;
+
+  for (uint32_t i = first; i < tokens.size (); i++)
+  {
+    size_t repeat = tokens[i].find ('*');
+
+    if (repeat == std::string::npos)
+    {
+      weights.push_back (ReadNumber (tokens[i], m_fileName));
+    }
+    else
+    {
+      weights.insert (weights.end (), static_cast<size_t> (ReadNumber (tokens[i].substr (repeat + 1), m_fileName)),
+                      ReadNumber (tokens[i].substr (0, repeat), m_fileName));
+    }
+  }
+  return weights;
+}
+
+std::vector<double>
+BlockchainRegionModel::ReadEdges (const std::vector<std::string> &tokens, uint32_t first) const
+{
+  std::vector<double> edges;
+
+  for (uint32_t i = first; i < tokens.size (); i++)
+  {
+    size_t step = tokens[i].find (':');
+    size_t last = tokens[i].rfind (':');
+
+    if (step == std::string::npos)
+    {
+      edges.push_back (ReadNumber (tokens[i], m_fileName));
+      continue;
+    }
+
+    double from = ReadNumber (tokens[i].substr (0, step), m_fileName);
+    double width = ReadNumber (tokens[i].substr (step + 1, last - step - 1), m_fileName);
+    double to = ReadNumber (tokens[i].substr (last + 1), m_fileName);
+
+    if (last == step || width <= 0 || to < from)
+    {
+      NS_FATAL_ERROR ("The bins of " << m_fileName << " have the malformed range " << tokens[i] << "\n");
+    }
+
+    /*
+     * The edges are computed from the first one, so the rounding errors do not add up
+     */
+    long noEdges = std::lround ((to - from) / width);
+
+    for (long k = 0; k <= noEdges; k++)
+    {
+      edges.push_back (from + k * width);
+    }
+  }
+
+  for (uint32_t i = 1; i < edges.size (); i++)
+  {
+    if (edges[i] <= edges[i - 1])
+    {
+      NS_FATAL_ERROR ("The bin edges of " << m_fileName << " must increase\n");
+    }
+  }
+  return edges;
+}
+
+uint32_t
+BlockchainRegionModel::GetRegionIndex (const std::string &name, const std::string &fileName) const
+{
+  int region = GetRegion (name);
+
+  if (region < 0)
+  {
+    NS_FATAL_ERROR ("The region model " << fileName << " uses the undeclared region " << name << "\n");
+  }
+  return region;
+}
+
+} // namespace ns3
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BLOCKCHAIN_REGION_MODEL_H
+#define BLOCKCHAIN_REGION_MODEL_H
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \brief The regions of the nodes of BlockchainTopologyHelper, with the share of the nodes
+ * in each region, the latency between every pair of regions and the bandwidth histograms
+ * of the nodes of each region. The model is read from a data file, see data/blockchain-regions.txt
+ * for the format, so any number of regions or cities can be modeled without recompiling.
+ * The sampling distributions are built once when the file is loaded.
+ */
+class BlockchainRegionModel
+{
+public:
+  BlockchainRegionModel ();
+
+  /**
+   * Reads the model. A malformed or incomplete file is a fatal error.
+   *
+   * \param fileName the path of the data file
+   */
+  void Load (const std::string &fileName);
+
+  uint32_t GetNoRegions (void) const;
+
+  const std::string& GetRegionName (uint32_t region) const;
+
+  /**
+   * \returns the index of the region, or -1 if the model has no region of that name
+   */
+  int GetRegion (const std::string &name) const;
+
+  /**
+   * \param network the name of the cryptocurrency whose node shares are used
+   * \returns the region of a new node, drawn from the node shares of the network
+   */
+  uint32_t SampleRegion (const std::string &network, std::default_random_engine &generator);
+
+  /**
+   * \returns the mean latency in ms of a link between two regions
+   */
+  double GetMeanLatency (uint32_t from, uint32_t to) const;
+
+  /**
+   * \returns the Pareto shape of the latency of a link between two regions, 0 if the file sets none
+   */
+  double GetLatencyShape (uint32_t from, uint32_t to) const;
+
+  /**
+   * \returns a download or upload speed in Mbps drawn from the histogram of the region
+   */
+  double SampleDownloadSpeed (uint32_t region, std::default_random_engine &generator);
+  double SampleUploadSpeed (uint32_t region, std::default_random_engine &generator);
+
+private:
+
+  /**
+   * Reads the weights of a record: plain numbers, and w*n for n times w
+   */
+  std::vector<double> ReadWeights (const std::vector<std::string> &tokens, uint32_t first) const;
+
+  /**
+   * Reads bin edges: plain numbers, and a:s:b for a, a+s, ..., b
+   */
+  std::vector<double> ReadEdges (const std::vector<std::string> &tokens, uint32_t first) const;
+
+  uint32_t GetRegionIndex (const std::string &name, const std::string &fileName) const;
+
+  std::string                                                   m_fileName;
+  std::vector<std::string>                                      m_regionNames;
+  std::map<std::string, uint32_t>                               m_regionIndices;
+  std::vector<std::vector<double>>                              m_meanLatencies;     //!< ms, -1 until set
+  std::vector<std::vector<double>>                              m_latencyShapes;     //!< 0 if unset
+  std::map<std::string, std::piecewise_constant_distribution<double>> m_nodesDistributions; //!< key = network
+  std::map<std::string, std::vector<double>>                    m_bins;              //!< key = bins name
+  std::map<uint32_t, std::piecewise_constant_distribution<double>> m_downloadDistributions; //!< key = region
+  std::map<uint32_t, std::piecewise_constant_distribution<double>> m_uploadDistributions;   //!< key = region
+};
+
+} // namespace ns3
+
+#endif /* BLOCKCHAIN_REGION_MODEL_H */
@@ -0,0 +1,44 @@
+#include "ns3/blockchain-staker-helper.h"
+#include "ns3/string.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/names.h"
+#include "ns3/blockchain-staker.h"
+
+namespace ns3 {
+
+    BlockchainStakerHelper::BlockchainStakerHelper(std::string protocol, Address address, std::vector<Ipv4Address> &peers, const std::vector<int> &validators,
+                                                    std::map<Ipv4Address, double> &peersDownloadSpeeds, std::map<Ipv4Address, double> &peersUploadSpeeds,
+                                                    nodeInternetSpeed &internetSpeeds, nodeStatistics *stats)
+                                                    :BlockchainNodeHelper(), m_validators(validators)
+    {
+        m_factory.SetTypeId("ns3::BlockchainStaker");
+        commonConstructor(protocol, address, peers, peersDownloadSpeeds, peersUploadSpeeds, internetSpeeds, stats);
+    }
+
+    Ptr<Application>
+    BlockchainStakerHelper::InstallPriv(Ptr<Node> node)
+    {
+        Ptr<BlockchainStaker> app = m_factory.Create<BlockchainStaker>();
+        app->SetPeersAddresses(m_peersAddresses);
+        app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
+        app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
+        app->SetNodeInternetSpeeds(m_internetSpeeds);
+        app->SetNodeStats(m_nodeStats);
+        app->SetProtocolType(m_protocolType);
+        app->SetValidators(m_validators);
+        app->SetPeersNodeIds(m_peersNodeIds);
+        app->SetFlowNetwork(m_flowNetwork);
+        app->SetTransactionLatencies(m_transactionLatencies);
+
+        node->AddApplication(app);
+
+        return app;
+    }
+
+    void
+    BlockchainStakerHelper::SetValidators(const std::vector<int> &validators)
+    {
+        m_validators = validators;
+    }
+
+}
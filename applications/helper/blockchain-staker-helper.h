@@ -0,0 +1,32 @@
+#ifndef BLOCKCHAIN_STAKER_HELPER_H
+#define BLOCKCHAIN_STAKER_HELPER_H
+
+#include "ns3/blockchain-node-helper.h"
+#include "ns3/blockchain-staker.h"
+
+namespace ns3{
+
+    class BlockchainStakerHelper : public BlockchainNodeHelper
+    {
+        public:
+
+            BlockchainStakerHelper(std::string protocol, Address address, std::vector<Ipv4Address> &peers, const std::vector<int> &validators,
+                                 std::map<Ipv4Address, double> &peersDownloadSpeeds, std::map<Ipv4Address, double> &peersUploadSpeeds,
+                                 nodeInternetSpeed &internetSpeeds, nodeStatistics *stats);
+
+            /*
+             * The node ids of the validators, the same for all the installed stakers
+             */
+            void SetValidators(const std::vector<int> &validators);
+
+        protected:
+
+            virtual Ptr<Application> InstallPriv(Ptr<Node> node);
+
+            std::vector<int>                    m_validators;
+
+    };
+
+}
+
+#endif
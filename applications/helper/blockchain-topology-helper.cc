@@ -26,6 +26,7 @@
 #include "ns3/ipv6-address-generator.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/double.h"
+#include "ns3/blockchain-node.h"
 #include <algorithm>
 #include <fstream>
 #include <time.h>
@@ -38,619 +39,24 @@ NS_LOG_COMPONENT_DEFINE ("BlockchainTopologyHelper");
 
 BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t totalNoNodes, uint32_t noMiners, enum BlockchainRegion *minersRegions,
                                               enum Cryptocurrency cryptocurrency, int minConnectionsPerNode, int maxConnectionsPerNode,  
-						                      double latencyParetoShapeDivider, uint32_t systemId)
+						                      double latencyParetoShapeDivider, uint32_t systemId, uint32_t noShards,
+                                              const std::string &regionModelFile)
   : m_noCpus(noCpus), m_totalNoNodes (totalNoNodes), m_noMiners (noMiners), 
     m_latencyParetoShapeDivider (latencyParetoShapeDivider), m_minConnectionsPerNode (minConnectionsPerNode), 
 	  m_maxConnectionsPerNode (maxConnectionsPerNode), m_minConnectionsPerMiner (700), m_maxConnectionsPerMiner (800), 
 	  m_minerDownloadSpeed (100), m_minerUploadSpeed (100), m_totalNoLinks (0), m_systemId (systemId), 
-	  m_cryptocurrency (cryptocurrency)
+	  m_noShards (noShards > 0 ? noShards : 1), m_cryptocurrency (cryptocurrency)
 {
   
   std::vector<uint32_t>     nodes;    //nodes contain the ids of the nodes
   double                    tStart = GetWallTime();
   double                    tFinish;
-  double regionLatencies[6][6] = { {35.5, 119.49, 254.79, 310.11, 154.36, 207.91},
-	                               {119.49, 11.61, 221.08, 241.9, 266.45, 350.07},
-	                               {254.79, 221.08, 137.09, 346.65, 255.95, 268.91},
-	                               {310.11, 241.9, 346.65, 99.46, 172.24, 277.8},
-	                               {154.36, 266.45, 255.95, 172.24, 8.76, 162.59},
-	                               {207.91, 350.07, 268.91, 277.8, 162.59, 21.72}};
-								   
-  std::array<double,1001> downloadBandwitdhIntervals {
-   0.1, 0.6, 1.1, 1.6, 2.1, 2.6, 3.1, 3.6, 4.1, 4.6, 5.1, 5.6, 6.1, 6.6,
-   7.1, 7.6, 8.1, 8.6, 9.1, 9.6, 10.1, 10.6, 11.1, 11.6, 12.1, 12.6, 13.1,
-   13.6, 14.1, 14.6, 15.1, 15.6, 16.1, 16.6, 17.1, 17.6, 18.1, 18.6, 19.1,
-   19.6, 20.1, 20.6, 21.1, 21.6, 22.1, 22.6, 23.1, 23.6, 24.1, 24.6, 25.1,
-   25.6, 26.1, 26.6, 27.1, 27.6, 28.1, 28.6, 29.1, 29.6, 30.1, 30.6, 31.1,
-   31.6, 32.1, 32.6, 33.1, 33.6, 34.1, 34.6, 35.1, 35.6, 36.1, 36.6, 37.1, 
-   37.6, 38.1, 38.6, 39.1, 39.6, 40.1, 40.6, 41.1, 41.6, 42.1, 42.6, 43.1,
-   43.6, 44.1, 44.6, 45.1, 45.6, 46.1, 46.6, 47.1, 47.6, 48.1, 48.6, 49.1,
-   49.6, 50.1, 50.6, 51.1, 51.6, 52.1, 52.6, 53.1, 53.6, 54.1, 54.6, 55.1,
-   55.6, 56.1, 56.6, 57.1, 57.6, 58.1, 58.6, 59.1, 59.6, 60.1, 60.6, 61.1,
-   61.6, 62.1, 62.6, 63.1, 63.6, 64.1, 64.6, 65.1, 65.6, 66.1, 66.6, 67.1,
-   67.6, 68.1, 68.6, 69.1, 69.6, 70.1, 70.6, 71.1, 71.6, 72.1, 72.6, 73.1,
-   73.6, 74.1, 74.6, 75.1, 75.6, 76.1, 76.6, 77.1, 77.6, 78.1, 78.6, 79.1,
-   79.6, 80.1, 80.6, 81.1, 81.6, 82.1, 82.6, 83.1, 83.6, 84.1, 84.6, 85.1,
-   85.6, 86.1, 86.6, 87.1, 87.6, 88.1, 88.6, 89.1, 89.6, 90.1, 90.6, 91.1,
-   91.6, 92.1, 92.6, 93.1, 93.6, 94.1, 94.6, 95.1, 95.6, 96.1, 96.6, 97.1,
-   97.6, 98.1, 98.6, 99.1, 99.6, 100.1, 100.6, 101.1, 101.6, 102.1, 102.6,
-   103.1, 103.6, 104.1, 104.6, 105.1, 105.6, 106.1, 106.6, 107.1, 107.6,
-   108.1, 108.6, 109.1, 109.6, 110.1, 110.6, 111.1, 111.6, 112.1, 112.6, 
-   113.1, 113.6, 114.1, 114.6, 115.1, 115.6, 116.1, 116.6, 117.1, 117.6,
-   118.1, 118.6, 119.1, 119.6, 120.1, 120.6, 121.1, 121.6, 122.1, 122.6,
-   123.1, 123.6, 124.1, 124.6, 125.1, 125.6, 126.1, 126.6, 127.1, 127.6,
-   128.1, 128.6, 129.1, 129.6, 130.1, 130.6, 131.1, 131.6, 132.1, 132.6, 
-   133.1, 133.6, 134.1, 134.6, 135.1, 135.6, 136.1, 136.6, 137.1, 137.6,
-   138.1, 138.6, 139.1, 139.6, 140.1, 140.6, 141.1, 141.6, 142.1, 142.6,
-   143.1, 143.6, 144.1, 144.6, 145.1, 145.6, 146.1, 146.6, 147.1, 147.6, 
-   148.1, 148.6, 149.1, 149.6, 150.1, 150.6, 151.1, 151.6, 152.1, 152.6,
-   153.1, 153.6, 154.1, 154.6, 155.1, 155.6, 156.1, 156.6, 157.1, 157.6,
-   158.1, 158.6, 159.1, 159.6, 160.1, 160.6, 161.1, 161.6, 162.1, 162.6,
-   163.1, 163.6, 164.1, 164.6, 165.1, 165.6, 166.1, 166.6, 167.1, 167.6, 
-   168.1, 168.6, 169.1, 169.6, 170.1, 170.6, 171.1, 171.6, 172.1, 172.6,
-   173.1, 173.6, 174.1, 174.6, 175.1, 175.6, 176.1, 176.6, 177.1, 177.6,
-   178.1, 178.6, 179.1, 179.6, 180.1, 180.6, 181.1, 181.6, 182.1, 182.6,
-   183.1, 183.6, 184.1, 184.6, 185.1, 185.6, 186.1, 186.6, 187.1, 187.6, 
-   188.1, 188.6, 189.1, 189.6, 190.1, 190.6, 191.1, 191.6, 192.1, 192.6,
-   193.1, 193.6, 194.1, 194.6, 195.1, 195.6, 196.1, 196.6, 197.1, 197.6, 
-   198.1, 198.6, 199.1, 199.6, 200.1, 200.6, 201.1, 201.6, 202.1, 202.6, 
-   203.1, 203.6, 204.1, 204.6, 205.1, 205.6, 206.1, 206.6, 207.1, 207.6,
-   208.1, 208.6, 209.1, 209.6, 210.1, 210.6, 211.1, 211.6, 212.1, 212.6, 
-   213.1, 213.6, 214.1, 214.6, 215.1, 215.6, 216.1, 216.6, 217.1, 217.6, 
-   218.1, 218.6, 219.1, 219.6, 220.1, 220.6, 221.1, 221.6, 222.1, 222.6,
-   223.1, 223.6, 224.1, 224.6, 225.1, 225.6, 226.1, 226.6, 227.1, 227.6,
-   228.1, 228.6, 229.1, 229.6, 230.1, 230.6, 231.1, 231.6, 232.1, 232.6, 
-   233.1, 233.6, 234.1, 234.6, 235.1, 235.6, 236.1, 236.6, 237.1, 237.6, 
-   238.1, 238.6, 239.1, 239.6, 240.1, 240.6, 241.1, 241.6, 242.1, 242.6,
-   243.1, 243.6, 244.1, 244.6, 245.1, 245.6, 246.1, 246.6, 247.1, 247.6,
-   248.1, 248.6, 249.1, 249.6, 250.1, 250.6, 251.1, 251.6, 252.1, 252.6,
-   253.1, 253.6, 254.1, 254.6, 255.1, 255.6, 256.1, 256.6, 257.1, 257.6,
-   258.1, 258.6, 259.1, 259.6, 260.1, 260.6, 261.1, 261.6, 262.1, 262.6, 
-   263.1, 263.6, 264.1, 264.6, 265.1, 265.6, 266.1, 266.6, 267.1, 267.6, 
-   268.1, 268.6, 269.1, 269.6, 270.1, 270.6, 271.1, 271.6, 272.1, 272.6,
-   273.1, 273.6, 274.1, 274.6, 275.1, 275.6, 276.1, 276.6, 277.1, 277.6,
-   278.1, 278.6, 279.1, 279.6, 280.1, 280.6, 281.1, 281.6, 282.1, 282.6,
-   283.1, 283.6, 284.1, 284.6, 285.1, 285.6, 286.1, 286.6, 287.1, 287.6,
-   288.1, 288.6, 289.1, 289.6, 290.1, 290.6, 291.1, 291.6, 292.1, 292.6,
-   293.1, 293.6, 294.1, 294.6, 295.1, 295.6, 296.1, 296.6, 297.1, 297.6,
-   298.1, 298.6, 299.1, 299.6, 300.1, 300.6, 301.1, 301.6, 302.1, 302.6,
-   303.1, 303.6, 304.1, 304.6, 305.1, 305.6, 306.1, 306.6, 307.1, 307.6,
-   308.1, 308.6, 309.1, 309.6, 310.1, 310.6, 311.1, 311.6, 312.1, 312.6,
-   313.1, 313.6, 314.1, 314.6, 315.1, 315.6, 316.1, 316.6, 317.1, 317.6,
-   318.1, 318.6, 319.1, 319.6, 320.1, 320.6, 321.1, 321.6, 322.1, 322.6,
-   323.1, 323.6, 324.1, 324.6, 325.1, 325.6, 326.1, 326.6, 327.1, 327.6,
-   328.1, 328.6, 329.1, 329.6, 330.1, 330.6, 331.1, 331.6, 332.1, 332.6,
-   333.1, 333.6, 334.1, 334.6, 335.1, 335.6, 336.1, 336.6, 337.1, 337.6,
-   338.1, 338.6, 339.1, 339.6, 340.1, 340.6, 341.1, 341.6, 342.1, 342.6, 
-   343.1, 343.6, 344.1, 344.6, 345.1, 345.6, 346.1, 346.6, 347.1, 347.6,
-   348.1, 348.6, 349.1, 349.6, 350.1, 350.6, 351.1, 351.6, 352.1, 352.6,
-   353.1, 353.6, 354.1, 354.6, 355.1, 355.6, 356.1, 356.6, 357.1, 357.6,
-   358.1, 358.6, 359.1, 359.6, 360.1, 360.6, 361.1, 361.6, 362.1, 362.6,
-   363.1, 363.6, 364.1, 364.6, 365.1, 365.6, 366.1, 366.6, 367.1, 367.6, 
-   368.1, 368.6, 369.1, 369.6, 370.1, 370.6, 371.1, 371.6, 372.1, 372.6, 
-   373.1, 373.6, 374.1, 374.6, 375.1, 375.6, 376.1, 376.6, 377.1, 377.6,
-   378.1, 378.6, 379.1, 379.6, 380.1, 380.6, 381.1, 381.6, 382.1, 382.6,
-   383.1, 383.6, 384.1, 384.6, 385.1, 385.6, 386.1, 386.6, 387.1, 387.6,
-   388.1, 388.6, 389.1, 389.6, 390.1, 390.6, 391.1, 391.6, 392.1, 392.6,
-   393.1, 393.6, 394.1, 394.6, 395.1, 395.6, 396.1, 396.6, 397.1, 397.6,
-   398.1, 398.6, 399.1, 399.6, 400.1, 400.6, 401.1, 401.6, 402.1, 402.6, 
-   403.1, 403.6, 404.1, 404.6, 405.1, 405.6, 406.1, 406.6, 407.1, 407.6,
-   408.1, 408.6, 409.1, 409.6, 410.1, 410.6, 411.1, 411.6, 412.1, 412.6,
-   413.1, 413.6, 414.1, 414.6, 415.1, 415.6, 416.1, 416.6, 417.1, 417.6,
-   418.1, 418.6, 419.1, 419.6, 420.1, 420.6, 421.1, 421.6, 422.1, 422.6,
-   423.1, 423.6, 424.1, 424.6, 425.1, 425.6, 426.1, 426.6, 427.1, 427.6,
-   428.1, 428.6, 429.1, 429.6, 430.1, 430.6, 431.1, 431.6, 432.1, 432.6,
-   433.1, 433.6, 434.1, 434.6, 435.1, 435.6, 436.1, 436.6, 437.1, 437.6,
-   438.1, 438.6, 439.1, 439.6, 440.1, 440.6, 441.1, 441.6, 442.1, 442.6, 
-   443.1, 443.6, 444.1, 444.6, 445.1, 445.6, 446.1, 446.6, 447.1, 447.6,
-   448.1, 448.6, 449.1, 449.6, 450.1, 450.6, 451.1, 451.6, 452.1, 452.6,
-   453.1, 453.6, 454.1, 454.6, 455.1, 455.6, 456.1, 456.6, 457.1, 457.6,
-   458.1, 458.6, 459.1, 459.6, 460.1, 460.6, 461.1, 461.6, 462.1, 462.6,
-   463.1, 463.6, 464.1, 464.6, 465.1, 465.6, 466.1, 466.6, 467.1, 467.6, 
-   468.1, 468.6, 469.1, 469.6, 470.1, 470.6, 471.1, 471.6, 472.1, 472.6,
-   473.1, 473.6, 474.1, 474.6, 475.1, 475.6, 476.1, 476.6, 477.1, 477.6,
-   478.1, 478.6, 479.1, 479.6, 480.1, 480.6, 481.1, 481.6, 482.1, 482.6, 
-   483.1, 483.6, 484.1, 484.6, 485.1, 485.6, 486.1, 486.6, 487.1, 487.6, 
-   488.1, 488.6, 489.1, 489.6, 490.1, 490.6, 491.1, 491.6, 492.1, 492.6, 
-   493.1, 493.6, 494.1, 494.6, 495.1, 495.6, 496.1, 496.6, 497.1, 497.6,
-   498.1, 498.6, 499.1, 499.6, 500};
-   
-  std::array<double,1000> uploadBandwitdhIntervals {
-   0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.1, 1.2, 1.3, 1.4,
-   1.5, 1.6, 1.7, 1.8, 1.9, 2.0, 2.1, 2.2, 2.3, 2.4, 2.5, 2.6, 2.7, 2.8,
-   2.9, 3.0, 3.1, 3.2, 3.3, 3.4, 3.5, 3.6, 3.7, 3.8, 3.9, 4.0, 4.1, 4.2,
-   4.3, 4.4, 4.5, 4.6, 4.7, 4.8, 4.9, 5.0, 5.1, 5.2, 5.3, 5.4, 5.5, 5.6,
-   5.7, 5.8, 5.9, 6.0, 6.1, 6.2, 6.3, 6.4, 6.5, 6.6, 6.7, 6.8, 6.9, 7.0,
-   7.1, 7.2, 7.3, 7.4, 7.5, 7.6, 7.7, 7.8, 7.9, 8.0, 8.1, 8.2, 8.3, 8.4,
-   8.5, 8.6, 8.7, 8.8, 8.9, 9.0, 9.1, 9.2, 9.3, 9.4, 9.5, 9.6, 9.7, 9.8,
-   9.9, 10.0, 10.1, 10.2, 10.3, 10.4, 10.5, 10.6, 10.7, 10.8, 10.9, 11.0,
-   11.1, 11.2, 11.3, 11.4, 11.5, 11.6, 11.7, 11.8, 11.9, 12.0, 12.1, 12.2,
-   12.3, 12.4, 12.5, 12.6, 12.7, 12.8, 12.9, 13.0, 13.1, 13.2, 13.3, 13.4,
-   13.5, 13.6, 13.7, 13.8, 13.9, 14.0, 14.1, 14.2, 14.3, 14.4, 14.5, 14.6,
-   14.7, 14.8, 14.9, 15.0, 15.1, 15.2, 15.3, 15.4, 15.5, 15.6, 15.7, 15.8,
-   15.9, 16.0, 16.1, 16.2, 16.3, 16.4, 16.5, 16.6, 16.7, 16.8, 16.9, 17.0,
-   17.1, 17.2, 17.3, 17.4, 17.5, 17.6, 17.7, 17.8, 17.9, 18.0, 18.1, 18.2,
-   18.3, 18.4, 18.5, 18.6, 18.7, 18.8, 18.9, 19.0, 19.1, 19.2, 19.3, 19.4,
-   19.5, 19.6, 19.7, 19.8, 19.9, 20.0, 20.1, 20.2, 20.3, 20.4, 20.5, 20.6,
-   20.7, 20.8, 20.9, 21.0, 21.1, 21.2, 21.3, 21.4, 21.5, 21.6, 21.7, 21.8,
-   21.9, 22.0, 22.1, 22.2, 22.3, 22.4, 22.5, 22.6, 22.7, 22.8, 22.9, 23.0,
-   23.1, 23.2, 23.3, 23.4, 23.5, 23.6, 23.7, 23.8, 23.9, 24.0, 24.1, 24.2,
-   24.3, 24.4, 24.5, 24.6, 24.7, 24.8, 24.9, 25.0, 25.1, 25.2, 25.3, 25.4,
-   25.5, 25.6, 25.7, 25.8, 25.9, 26.0, 26.1, 26.2, 26.3, 26.4, 26.5, 26.6,
-   26.7, 26.8, 26.9, 27.0, 27.1, 27.2, 27.3, 27.4, 27.5, 27.6, 27.7, 27.8,
-   27.9, 28.0, 28.1, 28.2, 28.3, 28.4, 28.5, 28.6, 28.7, 28.8, 28.9, 29.0,
-   29.1, 29.2, 29.3, 29.4, 29.5, 29.6, 29.7, 29.8, 29.9, 30.0, 30.1, 30.2,
-   30.3, 30.4, 30.5, 30.6, 30.7, 30.8, 30.9, 31.0, 31.1, 31.2, 31.3, 31.4,
-   31.5, 31.6, 31.7, 31.8, 31.9, 32.0, 32.1, 32.2, 32.3, 32.4, 32.5, 32.6,
-   32.7, 32.8, 32.9, 33.0, 33.1, 33.2, 33.3, 33.4, 33.5, 33.6, 33.7, 33.8,
-   33.9, 34.0, 34.1, 34.2, 34.3, 34.4, 34.5, 34.6, 34.7, 34.8, 34.9, 35.0,
-   35.1, 35.2, 35.3, 35.4, 35.5, 35.6, 35.7, 35.8, 35.9, 36.0, 36.1, 36.2,
-   36.3, 36.4, 36.5, 36.6, 36.7, 36.8, 36.9, 37.0, 37.1, 37.2, 37.3, 37.4,
-   37.5, 37.6, 37.7, 37.8, 37.9, 38.0, 38.1, 38.2, 38.3, 38.4, 38.5, 38.6,
-   38.7, 38.8, 38.9, 39.0, 39.1, 39.2, 39.3, 39.4, 39.5, 39.6, 39.7, 39.8,
-   39.9, 40.0, 40.1, 40.2, 40.3, 40.4, 40.5, 40.6, 40.7, 40.8, 40.9, 41.0,
-   41.1, 41.2, 41.3, 41.4, 41.5, 41.6, 41.7, 41.8, 41.9, 42.0, 42.1, 42.2,
-   42.3, 42.4, 42.5, 42.6, 42.7, 42.8, 42.9, 43.0, 43.1, 43.2, 43.3, 43.4,
-   43.5, 43.6, 43.7, 43.8, 43.9, 44.0, 44.1, 44.2, 44.3, 44.4, 44.5, 44.6,
-   44.7, 44.8, 44.9, 45.0, 45.1, 45.2, 45.3, 45.4, 45.5, 45.6, 45.7, 45.8,
-   45.9, 46.0, 46.1, 46.2, 46.3, 46.4, 46.5, 46.6, 46.7, 46.8, 46.9, 47.0,
-   47.1, 47.2, 47.3, 47.4, 47.5, 47.6, 47.7, 47.8, 47.9, 48.0, 48.1, 48.2,
-   48.3, 48.4, 48.5, 48.6, 48.7, 48.8, 48.9, 49.0, 49.1, 49.2, 49.3, 49.4,
-   49.5, 49.6, 49.7, 49.8, 49.9, 50.0, 50.1, 50.2, 50.3, 50.4, 50.5, 50.6,
-   50.7, 50.8, 50.9, 51.0, 51.1, 51.2, 51.3, 51.4, 51.5, 51.6, 51.7, 51.8,
-   51.9, 52.0, 52.1, 52.2, 52.3, 52.4, 52.5, 52.6, 52.7, 52.8, 52.9, 53.0,
-   53.1, 53.2, 53.3, 53.4, 53.5, 53.6, 53.7, 53.8, 53.9, 54.0, 54.1, 54.2,
-   54.3, 54.4, 54.5, 54.6, 54.7, 54.8, 54.9, 55.0, 55.1, 55.2, 55.3, 55.4,
-   55.5, 55.6, 55.7, 55.8, 55.9, 56.0, 56.1, 56.2, 56.3, 56.4, 56.5, 56.6,
-   56.7, 56.8, 56.9, 57.0, 57.1, 57.2, 57.3, 57.4, 57.5, 57.6, 57.7, 57.8,
-   57.9, 58.0, 58.1, 58.2, 58.3, 58.4, 58.5, 58.6, 58.7, 58.8, 58.9, 59.0,
-   59.1, 59.2, 59.3, 59.4, 59.5, 59.6, 59.7, 59.8, 59.9, 60.0, 60.1, 60.2,
-   60.3, 60.4, 60.5, 60.6, 60.7, 60.8, 60.9, 61.0, 61.1, 61.2, 61.3, 61.4,
-   61.5, 61.6, 61.7, 61.8, 61.9, 62.0, 62.1, 62.2, 62.3, 62.4, 62.5, 62.6,
-   62.7, 62.8, 62.9, 63.0, 63.1, 63.2, 63.3, 63.4, 63.5, 63.6, 63.7, 63.8,
-   63.9, 64.0, 64.1, 64.2, 64.3, 64.4, 64.5, 64.6, 64.7, 64.8, 64.9, 65.0,
-   65.1, 65.2, 65.3, 65.4, 65.5, 65.6, 65.7, 65.8, 65.9, 66.0, 66.1, 66.2,
-   66.3, 66.4, 66.5, 66.6, 66.7, 66.8, 66.9, 67.0, 67.1, 67.2, 67.3, 67.4,
-   67.5, 67.6, 67.7, 67.8, 67.9, 68.0, 68.1, 68.2, 68.3, 68.4, 68.5, 68.6,
-   68.7, 68.8, 68.9, 69.0, 69.1, 69.2, 69.3, 69.4, 69.5, 69.6, 69.7, 69.8,
-   69.9, 70.0, 70.1, 70.2, 70.3, 70.4, 70.5, 70.6, 70.7, 70.8, 70.9, 71.0,
-   71.1, 71.2, 71.3, 71.4, 71.5, 71.6, 71.7, 71.8, 71.9, 72.0, 72.1, 72.2,
-   72.3, 72.4, 72.5, 72.6, 72.7, 72.8, 72.9, 73.0, 73.1, 73.2, 73.3, 73.4,
-   73.5, 73.6, 73.7, 73.8, 73.9, 74.0, 74.1, 74.2, 74.3, 74.4, 74.5, 74.6,
-   74.7, 74.8, 74.9, 75.0, 75.1, 75.2, 75.3, 75.4, 75.5, 75.6, 75.7, 75.8,
-   75.9, 76.0, 76.1, 76.2, 76.3, 76.4, 76.5, 76.6, 76.7, 76.8, 76.9, 77.0,
-   77.1, 77.2, 77.3, 77.4, 77.5, 77.6, 77.7, 77.8, 77.9, 78.0, 78.1, 78.2,
-   78.3, 78.4, 78.5, 78.6, 78.7, 78.8, 78.9, 79.0, 79.1, 79.2, 79.3, 79.4,
-   79.5, 79.6, 79.7, 79.8, 79.9, 80.0, 80.1, 80.2, 80.3, 80.4, 80.5, 80.6,
-   80.7, 80.8, 80.9, 81.0, 81.1, 81.2, 81.3, 81.4, 81.5, 81.6, 81.7, 81.8,
-   81.9, 82.0, 82.1, 82.2, 82.3, 82.4, 82.5, 82.6, 82.7, 82.8, 82.9, 83.0,
-   83.1, 83.2, 83.3, 83.4, 83.5, 83.6, 83.7, 83.8, 83.9, 84.0, 84.1, 84.2,
-   84.3, 84.4, 84.5, 84.6, 84.7, 84.8, 84.9, 85.0, 85.1, 85.2, 85.3, 85.4,
-   85.5, 85.6, 85.7, 85.8, 85.9, 86.0, 86.1, 86.2, 86.3, 86.4, 86.5, 86.6,
-   86.7, 86.8, 86.9, 87.0, 87.1, 87.2, 87.3, 87.4, 87.5, 87.6, 87.7, 87.8,
-   87.9, 88.0, 88.1, 88.2, 88.3, 88.4, 88.5, 88.6, 88.7, 88.8, 88.9, 89.0,
-   89.1, 89.2, 89.3, 89.4, 89.5, 89.6, 89.7, 89.8, 89.9, 90.0, 90.1, 90.2,
-   90.3, 90.4, 90.5, 90.6, 90.7, 90.8, 90.9, 91.0, 91.1, 91.2, 91.3, 91.4,
-   91.5, 91.6, 91.7, 91.8, 91.9, 92.0, 92.1, 92.2, 92.3, 92.4, 92.5, 92.6,
-   92.7, 92.8, 92.9, 93.0, 93.1, 93.2, 93.3, 93.4, 93.5, 93.6, 93.7, 93.8,
-   93.9, 94.0, 94.1, 94.2, 94.3, 94.4, 94.5, 94.6, 94.7, 94.8, 94.9, 95.0,
-   95.1, 95.2, 95.3, 95.4, 95.5, 95.6, 95.7, 95.8, 95.9, 96.0, 96.1, 96.2,
-   96.3, 96.4, 96.5, 96.6, 96.7, 96.8, 96.9, 97.0, 97.1, 97.2, 97.3, 97.4,
-   97.5, 97.6, 97.7, 97.8, 97.9, 98.0, 98.1, 98.2, 98.3, 98.4, 98.5, 98.6,
-   98.7, 98.8, 98.9, 99.0, 99.1, 99.2, 99.3, 99.4, 99.5, 99.6, 99.7, 99.8, 99.9, 100};
-
-
-  std::array<double,1000> EuropeDownloadWeights {
-    134, 77, 65, 58, 43, 44, 48, 42, 34, 41, 42, 41, 33, 35, 35, 38, 37, 30, 36, 37, 34, 24, 21, 23,
-	22, 21, 20, 19, 17, 16, 13, 18, 20, 15, 18, 17, 15, 11, 15, 10, 13, 12, 11, 11, 11, 13, 11, 12,
-	9, 12, 13, 10, 10, 9, 10, 10, 9, 7, 8, 7, 7, 7, 6, 10, 6, 5, 6, 9, 6, 5, 7, 4, 6, 6, 4, 5, 4, 6,
-	7, 5, 6, 6, 7, 5, 5, 5, 4, 4, 4, 4, 5, 6, 6, 5, 6, 4, 5, 5, 3, 3, 3, 4, 3, 3, 3, 2, 4, 3, 2, 3,
-	4, 3, 2, 3, 4, 2, 3, 3, 4, 3, 1, 3, 4, 2, 1, 3, 2, 5, 3, 3, 2, 1, 3, 2, 2, 1, 3, 2, 2, 3, 2, 2,
-	1, 2, 2, 2, 0, 1, 1, 0, 1, 1, 2, 1, 0, 1, 2, 2, 1, 1, 1, 2, 0, 1, 1, 1, 0, 0, 0, 1, 0, 1, 0, 0,
-	1, 0, 0, 1, 1, 1, 1, 2, 2, 1, 0, 1, 1, 1, 2, 1, 1, 1, 0, 2, 2, 1, 1, 1, 2, 0, 1, 0, 2, 0, 1, 0,
-	1, 0, 0, 0, 1, 1, 1, 2, 0, 0, 1, 1, 0, 1, 0, 0, 2, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 1,
-	2, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 1, 1, 1, 0, 1, 1, 0, 0, 1, 1, 1, 1,
-	0, 1, 1, 0, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
-	1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
-	0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
-	0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2};
-
-  std::array<double,999> EuropeUploadWeights {
-    99, 51, 48, 70, 58, 44, 43, 31, 27, 27, 24, 24, 25, 24, 21, 18, 20, 21, 19, 18, 16, 15, 19, 18,
-	15, 18, 21, 26, 23, 17, 17, 14, 15, 15, 14, 16, 19, 20, 17, 13, 17, 11, 11, 11, 11, 10, 13, 11,
-	10, 12, 12, 12, 13, 9, 11, 10, 10, 9, 9, 7, 7, 7, 8, 8, 9, 5, 7, 5, 6, 8, 7, 6, 6, 8, 8, 8, 8,
-	10, 9, 9, 8, 7, 8, 5, 4, 5, 3, 5, 5, 5, 4, 4, 5, 5, 5, 6, 7, 7, 5, 7, 7, 5, 4, 5, 3, 5, 5, 4, 6,
-	4, 4, 3, 4, 5, 4, 5, 4, 4, 3, 2, 3, 3, 4, 3, 2, 2, 3, 2, 2, 3, 2, 2, 2, 2, 3, 1, 3, 2, 2, 3, 2,
-	2, 1, 4, 3, 3, 3, 2, 3, 2, 2, 2, 3, 1, 2, 2, 2, 0, 0, 3, 2, 2, 1, 2, 2, 3, 1, 0, 2, 2, 1, 2, 1,
-	1, 2, 1, 1, 1, 2, 1, 3, 1, 2, 1, 1, 3, 2, 1, 2, 2, 2, 1, 2, 1, 2, 2, 0, 1, 2, 1, 2, 2, 1, 2, 1,
-	1, 1, 2, 1, 2, 2, 1, 1, 1, 2, 1, 1, 2, 1, 1, 0, 1, 1, 1, 1, 2, 2, 1, 1, 1, 2, 1, 2, 0, 1, 1, 1,
-	2, 1, 1, 0, 2, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 2, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1,
-	2, 1, 0, 2, 1, 1, 0, 2, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1,
-	1, 1, 1, 2, 0, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 0, 0, 1, 1, 0, 1, 0, 1, 1, 0, 0,
-	1, 1, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 0, 0, 1, 1, 0, 1, 1, 0, 1,
-	1, 0, 0, 1, 1, 0, 1, 0, 0, 0, 0, 1, 1, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0,
-	0, 1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 0, 1,
-	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0,
-	0, 1, 0, 0, 1, 0, 1, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1,
-	0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0,
-	0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8};
-
-  std::array<double,1000> AustraliaDownloadWeights {
-    234, 143, 130, 80, 69, 73, 48, 56, 52, 45, 62, 52, 48, 37, 43, 25, 24, 29, 23, 28, 25, 28, 17, 27,
-	23, 24, 12, 18, 17, 13, 12, 8, 9, 12, 15, 11, 7, 9, 13, 8, 3, 6, 3, 3, 6, 12, 5, 5, 2, 4, 1, 14, 12,
-	12, 9, 10, 17, 12, 16, 4, 7, 3, 1, 4, 2, 5, 3, 6, 6, 5, 7, 1, 1, 0, 1, 1, 0, 0, 2, 0, 3, 2, 1, 0, 2,
-	0, 3, 5, 2, 3, 5, 3, 1, 1, 4, 3, 2, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 2, 0, 1, 1, 1, 0, 0, 1, 1, 2,
-	0, 1, 0, 0, 1, 0, 0, 2, 0, 1, 2, 1, 0, 1, 2, 0, 0, 0, 2, 2, 1, 2, 0, 0, 1, 1, 1, 0, 1, 2, 1, 0, 1, 1,
-	1, 1, 0, 1, 0, 2, 1, 0, 2, 1, 2, 1, 3, 2, 4, 1, 4, 5, 3, 4, 5, 4, 2, 1, 1, 3, 0, 4, 3, 3, 1, 3, 1, 1,
-	1, 1, 2, 0, 0, 2, 0, 1, 1, 1, 1, 1, 1, 4, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0,
-	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
-	0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-  std::array<double,999> AustraliaUploadWeights {
-    105, 88, 81, 58, 71, 155, 233, 161, 45, 20, 18, 61, 8, 12, 9, 18, 14, 13, 16, 19, 15, 16, 22, 19, 18,
-	22, 20, 10, 9, 16, 10, 13, 12, 11, 11, 8, 13, 14, 12, 19, 14, 9, 11, 9, 5, 9, 7, 11, 6, 6, 10, 14, 8,
-	6, 2, 2, 3, 4, 4, 2, 2, 1, 6, 2, 3, 1, 1, 1, 2, 2, 1, 2, 2, 1, 1, 0, 2, 0, 1, 0, 1, 0, 2, 0, 1, 0, 0,
-	1, 1, 0, 1, 2, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 2, 2, 1, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 2, 1, 2,
-	2, 3, 1, 0, 2, 0, 1, 0, 0, 2, 0, 0, 1, 0, 0, 1, 0, 2, 2, 0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 1,
-	1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 2, 0, 0, 2, 0, 2, 0, 2, 0, 1, 0, 1, 1, 0, 0, 0, 2, 1, 2, 0, 1, 0, 0,
-	1, 0, 0, 0, 1, 0, 1, 1, 0, 0, 2, 1, 2, 1, 0, 0, 1, 3, 0, 1, 3, 1, 3, 2, 3, 1, 2, 1, 2, 2, 3, 3, 3, 4,
-	1, 5, 5, 5, 6, 2, 2, 1, 0, 4, 0, 5, 0, 7, 6, 9, 7, 3, 6, 9, 4, 6, 3, 1, 5, 2, 0, 0, 2, 3, 1, 2, 1, 2,
-	1, 3, 3, 3, 4, 4, 4, 3, 1, 2, 1, 5, 3, 2, 1, 1, 0, 2, 1, 2, 2, 2, 1, 2, 0, 0, 2, 1, 2, 2, 1, 0, 1, 0,
-	0, 1, 1, 0, 1, 1, 2, 1, 0, 1, 1, 1, 1, 2, 0, 1, 1, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 1, 0, 0,
-	1, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4};
-
-  std::array<double,1000> NorthAmericaDownloadWeights {
-    170, 107, 73, 46, 77, 49, 26, 35, 34, 38, 31, 35, 26, 32, 29, 18, 20, 22, 25, 21, 20, 17, 20, 23, 15,
-	12, 14, 13, 16, 15, 19, 11, 19, 27, 21, 20, 17, 12, 21, 23, 32, 26, 18, 13, 19, 16, 9, 16, 6, 10, 6,
-	9, 8, 5, 11, 8, 7, 5, 6, 5, 8, 6, 2, 6, 8, 4, 4, 4, 4, 7, 5, 7, 3, 2, 3, 4, 7, 7, 8, 12, 7, 2, 4, 2,
-	5, 4, 3, 3, 3, 4, 0, 3, 3, 4, 8, 2, 5, 7, 9, 5, 4, 10, 7, 6, 3, 9, 6, 5, 8, 8, 3, 14, 13, 8, 2, 3, 3,
-	2, 2, 3, 0, 4, 2, 1, 1, 4, 0, 4, 4, 4, 1, 1, 3, 1, 0, 1, 3, 1, 2, 3, 1, 3, 2, 3, 1, 2, 0, 0, 1, 2, 1,
-	1, 0, 0, 1, 2, 1, 2, 1, 1, 2, 0, 1, 1, 3, 2, 2, 2, 3, 3, 3, 4, 4, 4, 1, 4, 3, 1, 3, 0, 2, 2, 3, 0, 2,
-	1, 0, 1, 0, 0, 0, 0, 1, 2, 1, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1, 1, 1, 0, 0, 1, 0, 1, 0, 0, 1,
-	0, 1, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 0,
-	1, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 2, 0, 0, 1, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0,
-	1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2};
-
-  std::array<double,999> NorthAmericaUploadWeights {
-    120, 75, 83, 64, 62, 59, 50, 60, 48, 82, 45, 22, 30, 34, 34, 20, 18, 13, 21, 16, 10, 15, 24, 22, 14, 21,
-	10, 9, 9, 10, 15, 17, 16, 21, 27, 37, 12, 13, 7, 10, 16, 16, 16, 14, 13, 9, 11, 12, 9, 15, 16, 20, 16,
-	20, 18, 18, 40, 32, 4, 6, 3, 4, 4, 5, 6, 4, 6, 5, 4, 4, 3, 4, 3, 3, 5, 3, 10, 7, 6, 9, 5, 6, 10, 7, 5,
-	9, 8, 5, 7, 5, 9, 5, 5, 5, 6, 7, 3, 6, 6, 7, 4, 4, 7, 3, 6, 2, 3, 4, 1, 2, 3, 3, 4, 5, 0, 0, 2, 2, 1,
-	1, 4, 2, 2, 1, 0, 0, 1, 1, 3, 0, 1, 1, 2, 0, 0, 1, 2, 0, 1, 0, 1, 2, 1, 0, 0, 3, 0, 1, 1, 1, 0, 0, 2,
-	1, 0, 0, 2, 1, 1, 1, 1, 0, 1, 0, 0, 0, 2, 0, 1, 1, 1, 2, 1, 0, 0, 0, 2, 1, 2, 0, 0, 1, 1, 1, 1, 0, 0,
-	2, 0, 2, 1, 0, 0, 0, 0, 0, 1, 0, 0, 2, 0, 1, 2, 2, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 1, 1, 1, 1, 0, 1,
-	0, 1, 1, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
-	1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6};
-
-  std::array<double,1000> SouthAmericaDownloadWeights {
-    383, 210, 163, 105, 85, 90, 71, 61, 63, 60, 54, 41, 48, 40, 35, 33, 33, 26, 21, 28, 20, 20, 17, 16, 14,
-	12, 11, 12, 12, 6, 15, 11, 11, 7, 7, 3, 2, 6, 5, 4, 7, 5, 4, 5, 2, 5, 6, 3, 0, 4, 1, 5, 2, 2, 2, 3, 1,
-	2, 3, 1, 3, 1, 2, 2, 1, 1, 1, 0, 0, 0, 3, 1, 3, 1, 1, 1, 2, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1,
-	1, 1, 0, 1, 2, 0, 0, 1, 0, 0, 0, 0, 2, 0, 0, 1, 1, 0, 2, 0, 1, 1, 1, 1, 0, 1, 0, 2, 0, 1, 0, 1, 1, 1,
-	0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 0, 1, 1, 0, 2, 0, 1, 1, 2, 1, 0, 0, 1, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-	
-  std::array<double,999> SouthAmericaUploadWeights {
-    260, 178, 201, 146, 93, 72, 84, 74, 61, 28, 20, 23, 21, 23, 22, 11, 14, 30, 47, 30, 14, 24, 19, 26, 23,
-	20, 21, 19, 25, 18, 24, 21, 16, 19, 16, 13, 16, 12, 14, 12, 8, 7, 7, 5, 9, 4, 8, 3, 7, 5, 11, 5, 6, 7,
-	6, 3, 4, 3, 4, 4, 1, 3, 2, 0, 1, 1, 1, 1, 1, 2, 2, 1, 3, 0, 1, 2, 1, 0, 0, 1, 2, 0, 2, 0, 2, 2, 1, 1,
-	1, 0, 0, 1, 2, 2, 1, 1, 0, 0, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 2, 0,
-	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0,
-	0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-  std::array<double,1000> KoreaDownloadWeights {
-    251, 140, 133, 122, 103, 95, 91, 69, 73, 58, 47, 39, 34, 36, 34, 39, 27, 27, 32, 23, 23, 23, 23, 22,
-	20, 15, 16, 14, 12, 13, 9, 15, 10, 12, 8, 12, 9, 7, 6, 9, 7, 8, 4, 3, 5, 5, 7, 4, 6, 4, 3, 6, 6, 4, 4,
-	3, 3, 4, 5, 2, 3, 4, 3, 2, 2, 4, 2, 2, 4, 3, 5, 4, 3, 1, 5, 2, 1, 3, 2, 1, 1, 2, 2, 2, 3, 1, 2, 2, 2,
-	0, 3, 2, 1, 2, 0, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 1, 2, 1, 1, 1, 0, 2, 1, 1, 1, 2, 0, 1, 0, 1, 1, 0, 1,
-	1, 1, 1, 0, 1, 1, 0, 1, 1, 1, 1, 1, 2, 1, 1, 0, 2, 1, 1, 2, 1, 2, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0,
-	1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
-
-  std::array<double,999> KoreaUploadWeights {
-    210, 77, 77, 60, 71, 54, 53, 45, 39, 38, 29, 32, 26, 27, 21, 24, 23, 27, 21, 24, 21, 18, 24, 17, 26,
-	29, 26, 19, 19, 17, 17, 13, 9, 7, 14, 8, 9, 8, 9, 10, 12, 7, 7, 10, 8, 10, 5, 6, 10, 7, 5, 10, 7, 7,
-	6, 6, 6, 9, 9, 6, 5, 5, 7, 6, 6, 5, 11, 11, 11, 12, 10, 8, 11, 6, 8, 7, 10, 8, 7, 5, 5, 5, 4, 3, 3,
-	3, 3, 4, 5, 5, 5, 5, 4, 5, 2, 3, 2, 2, 2, 2, 3, 3, 2, 2, 2, 2, 2, 3, 1, 4, 1, 3, 3, 3, 3, 4, 5, 3,
-	3, 3, 4, 2, 4, 0, 2, 1, 4, 4, 3, 4, 2, 3, 4, 2, 3, 4, 2, 3, 2, 1, 3, 3, 1, 5, 4, 2, 3, 2, 2, 1, 3,
-	3, 2, 2, 2, 3, 3, 3, 2, 2, 1, 2, 1, 2, 1, 1, 2, 2, 2, 0, 1, 2, 1, 0, 1, 1, 2, 0, 1, 2, 1, 2, 1, 1,
-	1, 1, 2, 0, 0, 0, 2, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 1, 1,
-	0, 0, 1, 1, 0, 2, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 0, 2, 0, 2, 1, 1, 0, 2, 0, 2, 0, 1, 2, 1, 0, 1, 1,
-	1, 1, 1, 0, 1, 0, 2, 1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 2, 0, 1, 1, 1, 0, 1, 1, 0, 1, 0, 1, 1, 1, 1, 0,
-	1, 1, 1, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 1, 0, 1, 1, 0, 2, 0, 1, 0, 1, 0, 0, 1, 1, 0,
-	1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0,
-	0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-	
-  std::array<double,1000> JapanDownloadWeights {
-    344, 157, 125, 92, 68, 62, 105, 52, 32, 47, 27, 30, 27, 29, 18, 24, 19, 20, 15, 20, 11, 14, 15,
-	9, 9, 5, 8, 11, 9, 9, 7, 7, 5, 8, 4, 7, 8, 4, 5, 6, 10, 6, 7, 8, 7, 9, 15, 4, 7, 10, 14, 7, 5,
-	10, 9, 14, 9, 7, 5, 3, 3, 7, 2, 2, 7, 3, 0, 2, 2, 3, 3, 3, 1, 1, 3, 6, 3, 2, 6, 2, 1, 4, 3, 2,
-	5, 4, 8, 2, 8, 0, 3, 6, 3, 2, 2, 4, 0, 0, 0, 3, 0, 2, 0, 2, 2, 1, 1, 1, 2, 3, 1, 3, 0, 0, 0, 0,
-	0, 1, 1, 0, 1, 0, 1, 0, 3, 3, 1, 2, 2, 2, 3, 2, 1, 5, 6, 2, 4, 2, 11, 5, 7, 7, 5, 8, 2, 7, 3, 0,
-	5, 2, 6, 2, 0, 1, 2, 0, 1, 1, 1, 0, 1, 1, 3, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1, 3, 0, 2, 1, 1,
-	2, 0, 1, 2, 0, 1, 2, 1, 0, 2, 2, 0, 1, 2, 1, 2, 0, 1, 3, 1, 0, 1, 1, 0, 0, 2, 1, 0, 1, 0, 1, 3,
-	2, 3, 3, 2, 1, 3, 0, 2, 0, 4, 2, 0, 2, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 1, 0, 1, 0, 0, 1, 0, 0, 0,
-	1, 0, 0, 2, 0, 0, 1, 2, 0, 2, 1, 0, 2, 0, 0, 0, 2, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-
-  std::array<double,999> JapanUploadWeights {
-    135, 89, 82, 67, 45, 40, 37, 47, 46, 40, 37, 39, 42, 33, 26, 35, 40, 36, 38, 30, 29, 39, 31, 31,
-	25, 17, 25, 18, 20, 14, 19, 20, 9, 11, 9, 9, 16, 5, 17, 15, 14, 22, 17, 24, 14, 10, 14, 14, 9,
-	13, 10, 17, 16, 18, 17, 20, 16, 17, 15, 18, 18, 15, 14, 9, 12, 7, 14, 13, 10, 7, 4, 2, 5, 6, 5,
-	7, 3, 4, 2, 5, 2, 5, 1, 1, 3, 1, 1, 0, 4, 3, 3, 3, 1, 6, 6, 3, 2, 1, 1, 4, 2, 4, 1, 3, 3, 4, 2,
-	2, 3, 1, 0, 1, 1, 0, 3, 2, 2, 1, 1, 0, 0, 2, 1, 0, 3, 2, 3, 1, 1, 1, 2, 2, 2, 1, 1, 0, 3, 0, 1,
-	2, 3, 1, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 2, 1, 1, 0,
-	2, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 2, 1, 0, 1,
-	0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
-	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
-	0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-	
-	
-  for (int k = 0; k < 6; k++)
-    for (int j = 0; j < 6; j++)
-	  m_regionLatencies[k][j] = regionLatencies[k][j];
-  
-  m_regionDownloadSpeeds[NORTH_AMERICA] = 41.68;
-  m_regionDownloadSpeeds[EUROPE] = 21.29;
-  m_regionDownloadSpeeds[SOUTH_AMERICA] = 9.89;
-  m_regionDownloadSpeeds[KOREA] = 14.56;
-  m_regionDownloadSpeeds[JAPAN] = 6.9;
-  m_regionDownloadSpeeds[AUSTRALIA] = 16;
-
-  m_regionUploadSpeeds[NORTH_AMERICA] = 6.74;
-  m_regionUploadSpeeds[EUROPE] = 6.72;
-  m_regionUploadSpeeds[SOUTH_AMERICA] = 2.2;
-  m_regionUploadSpeeds[KOREA] = 6.53;
-  m_regionUploadSpeeds[JAPAN] = 1.7;
-  m_regionUploadSpeeds[AUSTRALIA] = 6.1;
+
+  /*
+   * The regions, their latencies and their bandwidth histograms come from the data file
+   */
+  m_regionModel.Load (regionModelFile);
+
   srand (1000);
 
   // Bounds check
@@ -666,31 +72,8 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
 
   m_blockchainNodesRegion = new uint32_t[m_totalNoNodes];
   
-  
-  std::array<double,7> nodesDistributionIntervals {NORTH_AMERICA, EUROPE, SOUTH_AMERICA, KOREA, JAPAN, AUSTRALIA, OTHER};
-
-  switch (m_cryptocurrency) 
-  {
-    case ETHEREUM: 
-    {
-      if (m_systemId == 0)
-        std::cout << "ETHEREUM Mode selected\n";
-      std::array<double,6> nodesDistributionWeights {38.69, 51.59, 1.13, 5.74, 1.19, 1.66};
-      m_nodesDistribution = std::piecewise_constant_distribution<double> (nodesDistributionIntervals.begin(), nodesDistributionIntervals.end(), nodesDistributionWeights.begin());
-
-      break;		
-    }
-    case LEDGER: 
-    {
-      if (m_systemId == 0)
-        std::cout << "LEDGER Mode selected\n";
-      std::array<double,6> nodesDistributionWeights {36.61, 47.91, 1.49, 10.22, 2.38, 1.39};
-      m_nodesDistribution = std::piecewise_constant_distribution<double> (nodesDistributionIntervals.begin(), nodesDistributionIntervals.end(), nodesDistributionWeights.begin());
-
-      break;		
-    }
-   
-  }
+  if (m_systemId == 0)
+    std::cout << getCryptocurrency (m_cryptocurrency) << " Mode selected\n";
   
   NS_LOG_INFO("Setting bandwidth distribution");
   std::array<double,7> connectionsDistributionIntervals {1, 5, 10, 15, 20, 30, 125};
@@ -701,23 +84,15 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
                                 
   m_connectionsDistribution = std::piecewise_constant_distribution<double> (connectionsDistributionIntervals.begin(), connectionsDistributionIntervals.end(), connectionsDistributionWeights.begin());
 
-  m_europeDownloadBandwidthDistribution = std::piecewise_constant_distribution<double> (downloadBandwitdhIntervals.begin(), downloadBandwitdhIntervals.end(), EuropeDownloadWeights.begin());
-  m_europeUploadBandwidthDistribution = std::piecewise_constant_distribution<double> (uploadBandwitdhIntervals.begin(), uploadBandwitdhIntervals.end(), EuropeUploadWeights.begin());
-  m_northAmericaDownloadBandwidthDistribution = std::piecewise_constant_distribution<double> (downloadBandwitdhIntervals.begin(), downloadBandwitdhIntervals.end(), NorthAmericaDownloadWeights.begin());
-  m_northAmericaUploadBandwidthDistribution = std::piecewise_constant_distribution<double> (uploadBandwitdhIntervals.begin(), uploadBandwitdhIntervals.end(), NorthAmericaUploadWeights.begin());
-  m_koreaDownloadBandwidthDistribution = std::piecewise_constant_distribution<double> (downloadBandwitdhIntervals.begin(), downloadBandwitdhIntervals.end(), KoreaDownloadWeights.begin());
-  m_koreaUploadBandwidthDistribution = std::piecewise_constant_distribution<double> (uploadBandwitdhIntervals.begin(), uploadBandwitdhIntervals.end(), KoreaUploadWeights.begin());
-  m_japanDownloadBandwidthDistribution = std::piecewise_constant_distribution<double> (downloadBandwitdhIntervals.begin(), downloadBandwitdhIntervals.end(), JapanDownloadWeights.begin());
-  m_japanUploadBandwidthDistribution = std::piecewise_constant_distribution<double> (uploadBandwitdhIntervals.begin(), uploadBandwitdhIntervals.end(), JapanUploadWeights.begin());
-  m_southAmericaDownloadBandwidthDistribution = std::piecewise_constant_distribution<double> (downloadBandwitdhIntervals.begin(), downloadBandwitdhIntervals.end(), SouthAmericaDownloadWeights.begin());
-  m_southAmericaUploadBandwidthDistribution = std::piecewise_constant_distribution<double> (uploadBandwitdhIntervals.begin(), uploadBandwitdhIntervals.end(), SouthAmericaUploadWeights.begin());
-  m_australiaDownloadBandwidthDistribution = std::piecewise_constant_distribution<double> (downloadBandwitdhIntervals.begin(), downloadBandwitdhIntervals.end(), AustraliaDownloadWeights.begin());
-  m_australiaUploadBandwidthDistribution = std::piecewise_constant_distribution<double> (uploadBandwitdhIntervals.begin(), uploadBandwitdhIntervals.end(), AustraliaUploadWeights.begin());
-  
   m_minersRegions = new enum BlockchainRegion[m_noMiners];
   for (uint32_t i = 0; i < m_noMiners; i++)
   {
     m_minersRegions[i] = minersRegions[i];
+
+    if (m_regionModel.GetRegion (getBlockchainRegion (m_minersRegions[i])) < 0)
+    {
+      NS_FATAL_ERROR ("The region model has no region " << getBlockchainRegion (m_minersRegions[i]) << " for the miners\n");
+    }
   }
   
   /**
@@ -759,6 +134,18 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
   }
 
   sort(m_miners.begin(), m_miners.end());
+
+  //Deal the miners and then the rest of nodes to the shards
+  for (uint32_t i = 0; i < m_miners.size(); i++)
+  {
+    m_nodesShards[m_miners[i]] = i % m_noShards;
+  }
+
+  for (uint32_t i = 0, count = 0; i < m_totalNoNodes; i++)
+  {
+    if (m_nodesShards.find(i) == m_nodesShards.end())
+      m_nodesShards[i] = count++ % m_noShards;
+  }
   
 /*   //Print the miners
   if (m_systemId == 0)
@@ -853,7 +240,7 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
   {
 	int count = 0;
 
-    while ((int)m_nodesConnections[i].size() < m_minConnections[i] && count < 10*m_minConnections[i])
+    while ((int)m_nodesConnections[i].size() < m_minConnections[i] && count < 10*(int)m_noShards*m_minConnections[i])
     {
       uint32_t index = rand() % nodes.size();
 	  uint32_t candidatePeer = nodes[index];
@@ -873,6 +260,10 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
 /* 		if (m_systemId == 0)
           std::cout << "Node " << nodes[index] << " has already " << m_maxConnections[candidatePeer] << " connections" << "\n"; */
       }
+      else if (m_nodesShards[candidatePeer] != m_nodesShards[i])
+      {
+        //the nodes of different shards do not relay each other's blocks
+      }
       else
       {
         m_nodesConnections[i].push_back(candidatePeer);
@@ -894,7 +285,7 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
   {
 	int count = 0;
 	
-    while ((int)m_nodesConnections[i].size() < m_minConnections[i] && count < 10*m_minConnections[i])
+    while ((int)m_nodesConnections[i].size() < m_minConnections[i] && count < 10*(int)m_noShards*m_minConnections[i])
     {
       uint32_t index = rand() % nodes.size();
 	  uint32_t candidatePeer = nodes[index];
@@ -914,6 +305,10 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
 /* 		if (m_systemId == 0)
           std::cout << "Node " << nodes[index] << " has already " << m_maxConnections[candidatePeer] << " connections" << "\n"; */
       }
+      else if (m_nodesShards[candidatePeer] != m_nodesShards[i])
+      {
+        //the nodes of different shards do not relay each other's blocks
+      }
       else
       {
         m_nodesConnections[i].push_back(candidatePeer);
@@ -1017,14 +412,6 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
               << " and whereas the maximum is " << m_maxConnectionsPerNode << ".\n";
   }
   
-  NS_LOG_INFO("Setting InetnetStack and pointTopoint");
-  InternetStackHelper stack;
-  
-  std::ostringstream latencyStringStream; 
-  std::ostringstream bandwidthStream;
-  
-  PointToPointHelper pointToPoint;
-  
   tStart = GetWallTime();
   //Create the Blockchain nodes
   for (uint32_t i = 0; i < m_totalNoNodes; i++)
@@ -1062,7 +449,7 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
          average += speed;
 	   }
        
-      std::cout << "The download speed for region " << getBlockchainRegion(getBlockchainEnum(region.first)) << " = " << average / region.second.size() << " Mbps\n";
+      std::cout << "The download speed for region " << m_regionModel.GetRegionName (region.first) << " = " << average / region.second.size() << " Mbps\n";
     }
 	
     for (auto region : uploadRegionBandwidths)
@@ -1073,7 +460,7 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
          average += speed;
 	   }
        
-      std::cout << "The upload speed for region " << getBlockchainRegion(getBlockchainEnum(region.first)) << " = " << average / region.second.size() << " Mbps\n";
+      std::cout << "The upload speed for region " << m_regionModel.GetRegionName (region.first) << " = " << average / region.second.size() << " Mbps\n";
     }
   }
   
@@ -1092,43 +479,33 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
     {
       if ( *it > *miner)	//Do not recreate links
       {
-        NetDeviceContainer newDevices;
-		
         m_totalNoLinks++;
 		
 		double bandwidth = std::min(std::min(m_nodesInternetSpeeds[m_nodes.at (*miner).Get (0)->GetId()].uploadSpeed, 
                                     m_nodesInternetSpeeds[m_nodes.at (*miner).Get (0)->GetId()].downloadSpeed),
                                     std::min(m_nodesInternetSpeeds[m_nodes.at (*it).Get (0)->GetId()].uploadSpeed, 
                                     m_nodesInternetSpeeds[m_nodes.at (*it).Get (0)->GetId()].downloadSpeed));					
-		bandwidthStream.str("");
-        bandwidthStream.clear();
-		bandwidthStream << bandwidth << "Mbps";
-		
-        latencyStringStream.str("");
-        latencyStringStream.clear();
+        double latency;
 		
 		if (m_latencyParetoShapeDivider > 0)
         {
           Ptr<ParetoRandomVariable> paretoDistribution = CreateObject<ParetoRandomVariable> ();
-          paretoDistribution->SetAttribute ("Mean", DoubleValue (m_regionLatencies[m_blockchainNodesRegion[(m_nodes.at (*miner).Get (0))->GetId()]]
-                                                                                  [m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]]));
+          paretoDistribution->SetAttribute ("Mean", DoubleValue (m_regionModel.GetMeanLatency (m_blockchainNodesRegion[(m_nodes.at (*miner).Get (0))->GetId()],
+                                                                                  m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()])));
           
-          paretoDistribution->SetAttribute ("Shape", DoubleValue (m_regionLatencies[m_blockchainNodesRegion[(m_nodes.at (*miner).Get (0))->GetId()]]
-                                                                                   [m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]] / m_latencyParetoShapeDivider));
-          latencyStringStream << paretoDistribution->GetValue() << "ms";
+          paretoDistribution->SetAttribute ("Shape", DoubleValue (GetLatencyShape (m_blockchainNodesRegion[(m_nodes.at (*miner).Get (0))->GetId()],
+                                                                  m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()])));
+          latency = paretoDistribution->GetValue();
         }
         else
         {
-          latencyStringStream << m_regionLatencies[m_blockchainNodesRegion[(m_nodes.at (*miner).Get (0))->GetId()]]
-                                                  [m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]] << "ms";
+          latency = m_regionModel.GetMeanLatency (m_blockchainNodesRegion[(m_nodes.at (*miner).Get (0))->GetId()],
+                                                  m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]);
         }
 
-        
-		pointToPoint.SetDeviceAttribute ("DataRate", StringValue (bandwidthStream.str()));
-		pointToPoint.SetChannelAttribute ("Delay", StringValue (latencyStringStream.str()));
-		
-        newDevices.Add (pointToPoint.Install (m_nodes.at (*miner).Get (0), m_nodes.at (*it).Get (0)));
-		    m_devices.push_back (newDevices);
+        m_linksNodes.push_back (std::make_pair (*miner, *it));
+		    m_linksLatencies.push_back (latency);
+		    m_linksDataRates.push_back (bandwidth);
 
       }
     }
@@ -1143,42 +520,33 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
       if ( *it > node.first && (std::find(m_miners.begin(), m_miners.end(), *it) == m_miners.end() || 
 	       std::find(m_miners.begin(), m_miners.end(), node.first) == m_miners.end()))	//Do not recreate links
       {
-        NetDeviceContainer newDevices;
-		
         m_totalNoLinks++;
 		
 		double bandwidth = std::min(std::min(m_nodesInternetSpeeds[m_nodes.at (node.first).Get (0)->GetId()].uploadSpeed, 
                                     m_nodesInternetSpeeds[m_nodes.at (node.first).Get (0)->GetId()].downloadSpeed),
                                     std::min(m_nodesInternetSpeeds[m_nodes.at (*it).Get (0)->GetId()].uploadSpeed, 
                                     m_nodesInternetSpeeds[m_nodes.at (*it).Get (0)->GetId()].downloadSpeed));					
-		bandwidthStream.str("");
-        bandwidthStream.clear();
-		bandwidthStream << bandwidth << "Mbps";
-		
-        latencyStringStream.str("");
-        latencyStringStream.clear();
+        double latency;
 		
 		if (m_latencyParetoShapeDivider > 0)
         {
           Ptr<ParetoRandomVariable> paretoDistribution = CreateObject<ParetoRandomVariable> ();
-          paretoDistribution->SetAttribute ("Mean", DoubleValue (m_regionLatencies[m_blockchainNodesRegion[(m_nodes.at (node.first).Get (0))->GetId()]]
-                                                                                  [m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]]));
+          paretoDistribution->SetAttribute ("Mean", DoubleValue (m_regionModel.GetMeanLatency (m_blockchainNodesRegion[(m_nodes.at (node.first).Get (0))->GetId()],
+                                                                                  m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()])));
           
-          paretoDistribution->SetAttribute ("Shape", DoubleValue (m_regionLatencies[m_blockchainNodesRegion[(m_nodes.at (node.first).Get (0))->GetId()]]
-                                                                                   [m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]] / m_latencyParetoShapeDivider));
-          latencyStringStream << paretoDistribution->GetValue() << "ms";
+          paretoDistribution->SetAttribute ("Shape", DoubleValue (GetLatencyShape (m_blockchainNodesRegion[(m_nodes.at (node.first).Get (0))->GetId()],
+                                                                  m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()])));
+          latency = paretoDistribution->GetValue();
         }
         else
         {
-        latencyStringStream << m_regionLatencies[m_blockchainNodesRegion[(m_nodes.at (node.first).Get (0))->GetId()]]
-                                                [m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]] << "ms";
+        latency = m_regionModel.GetMeanLatency (m_blockchainNodesRegion[(m_nodes.at (node.first).Get (0))->GetId()],
+                                                m_blockchainNodesRegion[(m_nodes.at (*it).Get (0))->GetId()]);
         }
-		
-		pointToPoint.SetDeviceAttribute ("DataRate", StringValue (bandwidthStream.str()));
-		pointToPoint.SetChannelAttribute ("Delay", StringValue (latencyStringStream.str()));
-		
-        newDevices.Add (pointToPoint.Install (m_nodes.at (node.first).Get (0), m_nodes.at (*it).Get (0)));
-		    m_devices.push_back (newDevices);
+
+        m_linksNodes.push_back (std::make_pair (node.first, *it));
+		    m_linksLatencies.push_back (latency);
+		    m_linksDataRates.push_back (bandwidth);
 
       }
     }
@@ -1190,6 +558,34 @@ BlockchainTopologyHelper::BlockchainTopologyHelper (uint32_t noCpus, uint32_t to
     std::cout << "The total number of links is " << m_totalNoLinks << " (" << tFinish - tStart << "s).\n";
 }
 
+void
+BlockchainTopologyHelper::InstallPointToPointLinks (void)
+{
+  NS_LOG_FUNCTION(this);
+
+  double tStart = GetWallTime();
+  double tFinish;
+  PointToPointHelper pointToPoint;
+
+  for (uint32_t i = 0; i < m_linksNodes.size (); ++i)
+  {
+    std::ostringstream bandwidthStream;
+    std::ostringstream latencyStringStream;
+
+    bandwidthStream << m_linksDataRates[i] << "Mbps";
+    latencyStringStream << m_linksLatencies[i] << "ms";
+
+    pointToPoint.SetDeviceAttribute ("DataRate", StringValue (bandwidthStream.str()));
+    pointToPoint.SetChannelAttribute ("Delay", StringValue (latencyStringStream.str()));
+
+    m_devices.push_back (pointToPoint.Install (m_nodes.at (m_linksNodes[i].first).Get (0), m_nodes.at (m_linksNodes[i].second).Get (0)));
+  }
+
+  tFinish = GetWallTime();
+  if (m_systemId == 0)
+    std::cout << "The point-to-point links were installed in " << tFinish - tStart << "s.\n";
+}
+
 BlockchainTopologyHelper::~BlockchainTopologyHelper ()
 {
   NS_LOG_FUNCTION(this);
@@ -1226,20 +622,31 @@ BlockchainTopologyHelper::AssignIpv4Addresses (Ipv4AddressHelperCustom ip)
   double tStart = GetWallTime();
   double tFinish;
   
-  // Assign addresses to all devices in the network.
-  // These devices are stored in a vector. 
-  for (uint32_t i = 0; i < m_devices.size (); ++i)
+  // Assign addresses to both ends of every link, to their devices unless the links
+  // are only modeled by the flow-level network
+  for (uint32_t i = 0; i < m_linksNodes.size (); ++i)
   {
-    Ipv4InterfaceContainer newInterfaces; 
-    NetDeviceContainer currentContainer = m_devices[i];
-	  
-    newInterfaces.Add (ip.Assign (currentContainer.Get (0))); 
-    newInterfaces.Add (ip.Assign (currentContainer.Get (1)));
-	  
-    auto interfaceAddress1 = newInterfaces.GetAddress (0);
-    auto interfaceAddress2 = newInterfaces.GetAddress (1);
-    uint32_t node1 = (currentContainer.Get (0))->GetNode()->GetId();
-    uint32_t node2 = (currentContainer.Get (1))->GetNode()->GetId();
+    Ipv4Address interfaceAddress1;
+    Ipv4Address interfaceAddress2;
+    uint32_t node1 = m_nodes.at (m_linksNodes[i].first).Get (0)->GetId();
+    uint32_t node2 = m_nodes.at (m_linksNodes[i].second).Get (0)->GetId();
+
+    if (i < m_devices.size ())
+    {
+      Ipv4InterfaceContainer newInterfaces;
+
+      newInterfaces.Add (ip.Assign (m_devices[i].Get (0)));
+      newInterfaces.Add (ip.Assign (m_devices[i].Get (1)));
+      interfaceAddress1 = newInterfaces.GetAddress (0);
+      interfaceAddress2 = newInterfaces.GetAddress (1);
+      m_interfaces.push_back (newInterfaces);
+    }
+    else
+    {
+      interfaceAddress1 = ip.NewAddress ();
+      interfaceAddress2 = ip.NewAddress ();
+    }
+    m_linksAddresses.push_back (std::make_pair (interfaceAddress1, interfaceAddress2));
 
 /*     if (m_systemId == 0)
       std::cout << i << "/" << m_devices.size () << "\n"; */
@@ -1249,10 +656,10 @@ BlockchainTopologyHelper::AssignIpv4Addresses (Ipv4AddressHelperCustom ip)
 				
 	m_nodesConnectionsIps[node1].push_back(interfaceAddress2);
 	m_nodesConnectionsIps[node2].push_back(interfaceAddress1);
+	m_peersNodeIds[node1][interfaceAddress2] = node2;
+	m_peersNodeIds[node2][interfaceAddress1] = node1;
 
     ip.NewNetwork ();
-        
-    m_interfaces.push_back (newInterfaces);
 	
 	m_peersDownloadSpeeds[node1][interfaceAddress2] = m_nodesInternetSpeeds[node2].downloadSpeed;
 	m_peersDownloadSpeeds[node2][interfaceAddress1] = m_nodesInternetSpeeds[node1].downloadSpeed;
@@ -1326,11 +733,10 @@ BlockchainTopologyHelper::AssignRegion (uint32_t id)
   auto index = std::find(m_miners.begin(), m_miners.end(), id);
   if ( index != m_miners.end() )
   {
-    m_blockchainNodesRegion[id] = m_minersRegions[index - m_miners.begin()];
+    m_blockchainNodesRegion[id] = m_regionModel.GetRegion (getBlockchainRegion (m_minersRegions[index - m_miners.begin()]));
   }
   else{
-    int number = m_nodesDistribution(m_generator); 
-    m_blockchainNodesRegion[id] = number;
+    m_blockchainNodesRegion[id] = m_regionModel.SampleRegion (getCryptocurrency (m_cryptocurrency), m_generator);
   }
   
 }
@@ -1346,50 +752,22 @@ BlockchainTopologyHelper::AssignInternetSpeeds(uint32_t id)
     m_nodesInternetSpeeds[id].uploadSpeed = m_minerUploadSpeed;
   }
   else{
-    switch(m_blockchainNodesRegion[id])
-    {
-      case KOREA: 
-      {
-        m_nodesInternetSpeeds[id].downloadSpeed = m_koreaDownloadBandwidthDistribution(m_generator);
-        m_nodesInternetSpeeds[id].uploadSpeed = m_koreaUploadBandwidthDistribution(m_generator);
-        break;
-      }
-      case AUSTRALIA: 
-      {
-        m_nodesInternetSpeeds[id].downloadSpeed = m_australiaDownloadBandwidthDistribution(m_generator);
-        m_nodesInternetSpeeds[id].uploadSpeed = m_australiaUploadBandwidthDistribution(m_generator);
-        break;
-      }
-      case EUROPE:  
-      {
-        m_nodesInternetSpeeds[id].downloadSpeed = m_europeDownloadBandwidthDistribution(m_generator);
-        m_nodesInternetSpeeds[id].uploadSpeed = m_europeUploadBandwidthDistribution(m_generator);
-        break;
-      }
-      case JAPAN:  
-      {
-        m_nodesInternetSpeeds[id].downloadSpeed = m_japanDownloadBandwidthDistribution(m_generator);
-        m_nodesInternetSpeeds[id].uploadSpeed = m_japanUploadBandwidthDistribution(m_generator);
-        break;
-      }
-      case NORTH_AMERICA:  
-      {
-        m_nodesInternetSpeeds[id].downloadSpeed = m_northAmericaDownloadBandwidthDistribution(m_generator);
-        m_nodesInternetSpeeds[id].uploadSpeed = m_northAmericaUploadBandwidthDistribution(m_generator);
-        break;
-      }
-      case SOUTH_AMERICA: 
-      {
-        m_nodesInternetSpeeds[id].downloadSpeed = m_southAmericaDownloadBandwidthDistribution(m_generator);
-        m_nodesInternetSpeeds[id].uploadSpeed = m_southAmericaUploadBandwidthDistribution(m_generator);
-        break;
-      }
-    }
+    m_nodesInternetSpeeds[id].downloadSpeed = m_regionModel.SampleDownloadSpeed (m_blockchainNodesRegion[id], m_generator);
+    m_nodesInternetSpeeds[id].uploadSpeed = m_regionModel.SampleUploadSpeed (m_blockchainNodesRegion[id], m_generator);
   }
   
 }
 
 
+double
+BlockchainTopologyHelper::GetLatencyShape (uint32_t from, uint32_t to) const
+{
+  double shape = m_regionModel.GetLatencyShape (from, to);
+
+  return shape > 0 ? shape : m_regionModel.GetMeanLatency (from, to) / m_latencyParetoShapeDivider;
+}
+
+
 uint32_t* 
 BlockchainTopologyHelper::GetBlockchainNodesRegions (void)
 {
@@ -1397,6 +775,17 @@ BlockchainTopologyHelper::GetBlockchainNodesRegions (void)
 }
 
 
+std::vector<std::string>
+BlockchainTopologyHelper::GetRegionNames (void) const
+{
+  std::vector<std::string> names;
+
+  for (uint32_t i = 0; i < m_regionModel.GetNoRegions (); i++)
+    names.push_back (m_regionModel.GetRegionName (i));
+  return names;
+}
+
+
 std::map<uint32_t, std::map<Ipv4Address, double>> 
 BlockchainTopologyHelper::GetPeersDownloadSpeeds (void) const
 {
@@ -1410,6 +799,50 @@ BlockchainTopologyHelper::GetPeersUploadSpeeds (void) const
   return m_peersUploadSpeeds;
 }
 
+std::map<uint32_t, std::map<Ipv4Address, uint32_t>>
+BlockchainTopologyHelper::GetPeersNodeIds (void) const
+{
+  return m_peersNodeIds;
+}
+
+std::map<uint32_t, uint32_t>
+BlockchainTopologyHelper::GetNodesShards (void) const
+{
+  return m_nodesShards;
+}
+
+std::map<uint32_t, std::map<Ipv4Address, uint32_t>>
+BlockchainTopologyHelper::GetPeersShards (void) const
+{
+  std::map<uint32_t, std::map<Ipv4Address, uint32_t>> peersShards;
+
+  for (auto &node : m_peersNodeIds)
+  {
+    for (auto &peer : node.second)
+      peersShards[node.first][peer.first] = m_nodesShards.at(peer.second);
+  }
+  return peersShards;
+}
+
+
+void
+BlockchainTopologyHelper::InstallFlowNetwork (Ptr<BlockchainFlowNetwork> flowNetwork) const
+{
+  NS_LOG_FUNCTION(this);
+
+  for (uint32_t i = 0; i < m_linksAddresses.size (); ++i)
+  {
+    uint32_t node1 = m_nodes.at (m_linksNodes[i].first).Get (0)->GetId();
+    uint32_t node2 = m_nodes.at (m_linksNodes[i].second).Get (0)->GetId();
+    Ipv4Address interfaceAddress1 = m_linksAddresses[i].first;
+    Ipv4Address interfaceAddress2 = m_linksAddresses[i].second;
+    double latency = m_linksLatencies[i] / 1000;
+    double dataRate = m_linksDataRates[i] * 1000000;
+
+    flowNetwork->AddLink (node1, interfaceAddress2, node2, interfaceAddress1, latency, dataRate);
+    flowNetwork->AddLink (node2, interfaceAddress1, node1, interfaceAddress2, latency, dataRate);
+  }
+}
 
 std::map<uint32_t, nodeInternetSpeed> 
 BlockchainTopologyHelper::GetNodesInternetSpeeds (void) const
@@ -28,11 +28,14 @@
 #include "net-device-container.h"
 #include "ipv4-address-helper-custom.h"
 #include "ns3/blockchain.h"
+#include "ns3/blockchain-region-model.h"
 #include <random>
 #include <vector>
 
 namespace ns3 {
 
+class BlockchainFlowNetwork;
+
 /**
  * \ingroup point-to-point-layout
  *
@@ -53,10 +56,19 @@ public:
    * \param pointToPoint the PointToPointHelper which is used 
    *                     to connect all of the nodes together 
    *                     in the grid
+   *
+   * \param noShards the number of shards. The miners and the other nodes are dealt round-robin
+   *                 to the shards, the nodes only connect to nodes of their shard and the miners
+   *                 stay fully connected across the shards
+   *
+   * \param regionModelFile the data file of the regions, their latencies and their bandwidth
+   *                        histograms, see BlockchainRegionModel. The regions of the miners
+   *                        must be in it.
    */
   BlockchainTopologyHelper (uint32_t noCpus, uint32_t totalNoNodes, uint32_t noMiners, enum BlockchainRegion *minersRegions,
                          enum Cryptocurrency cryptocurrency, int minConnectionsPerNode, int maxConnectionsPerNode, 
-                         double latencyParetoShapeDivider, uint32_t systemId);
+                         double latencyParetoShapeDivider, uint32_t systemId, uint32_t noShards = 1,
+                         const std::string &regionModelFile = "blockchain-regions.txt");
 
   ~BlockchainTopologyHelper ();
 
@@ -89,6 +101,12 @@ public:
   Ipv4Address GetIpv4Address (uint32_t row, uint32_t col);
 
 
+  /**
+   * Installs a point-to-point link with the latency and the data rate drawn by the constructor
+   * for every connection. The flow-level model needs neither the links nor the stacks.
+   */
+  void InstallPointToPointLinks (void);
+
   /**
    * \param stack an InternetStackHelper which is used to install 
    *              on every node in the grid
@@ -96,7 +114,8 @@ public:
   void InstallStack (InternetStackHelper stack);
 
   /**
-   * Assigns Ipv4 addresses to all the row and column interfaces
+   * Assigns Ipv4 addresses to all the row and column interfaces. Without the point-to-point
+   * links the addresses are only drawn for the flow-level model.
    *
    * \param ip the Ipv4AddressHelper used to assign Ipv4 addresses 
    *              to all of the row interfaces in the grid
@@ -127,17 +146,44 @@ public:
    
    std::vector<uint32_t> GetMiners (void) const;
    
+   /**
+    * Get the region of every node, an index of GetRegionNames
+    */
    uint32_t* GetBlockchainNodesRegions (void);
+
+   std::vector<std::string> GetRegionNames (void) const;
    
    std::map<uint32_t, std::map<Ipv4Address, double>> GetPeersDownloadSpeeds(void) const;
    std::map<uint32_t, std::map<Ipv4Address, double>> GetPeersUploadSpeeds(void) const;
 
+   /**
+    * Get the node id behind each peer address of every node
+    */
+   std::map<uint32_t, std::map<Ipv4Address, uint32_t>> GetPeersNodeIds(void) const;
+
    std::map<uint32_t, nodeInternetSpeed> GetNodesInternetSpeeds (void) const;
 
+   /**
+    * Get the shard of every node, and the shard behind each peer address of every node
+    */
+   std::map<uint32_t, uint32_t> GetNodesShards (void) const;
+   std::map<uint32_t, std::map<Ipv4Address, uint32_t>> GetPeersShards (void) const;
+
+   /**
+    * Adds both directions of every link, with its latency and data rate, to the flow-level
+    * model of the network. Call it after AssignIpv4Addresses.
+    */
+   void InstallFlowNetwork (Ptr<BlockchainFlowNetwork> flowNetwork) const;
+
 private:
 
   void AssignRegion (uint32_t id);
   void AssignInternetSpeeds(uint32_t id);
+
+  /**
+   * The Pareto shape of the latency between two regions, from the region model or else mean / m_latencyParetoShapeDivider
+   */
+  double GetLatencyShape (uint32_t from, uint32_t to) const;
   
   uint32_t     m_noCpus;                        //!< The number of the available cpus in the simulation
   uint32_t     m_totalNoNodes;                  //!< The total number of nodes
@@ -151,6 +197,7 @@ private:
   double       m_minerUploadSpeed;              //!<  The upload speed of miners
   uint32_t     m_totalNoLinks;                  //!<  Total number of links
   uint32_t     m_systemId;
+  uint32_t     m_noShards;                      //!<  The number of shards
   
   enum BlockchainRegion                             *m_minersRegions;
   enum Cryptocurrency                             m_cryptocurrency;
@@ -160,33 +207,24 @@ private:
   std::vector<NodeContainer>                      m_nodes;                   //!< all the nodes in the network
   std::vector<NetDeviceContainer>                 m_devices;                 //!< NetDevices in the network
   std::vector<Ipv4InterfaceContainer>             m_interfaces;              //!< IPv4 interfaces in the network
+  std::vector<std::pair<uint32_t, uint32_t>>      m_linksNodes;              //!< The two nodes of every link
+  std::vector<std::pair<Ipv4Address, Ipv4Address>> m_linksAddresses;         //!< The addresses of both ends of every link, parallel to m_linksNodes
+  std::vector<double>                             m_linksLatencies;          //!< The latency of every link in ms, parallel to m_linksNodes
+  std::vector<double>                             m_linksDataRates;          //!< The data rate of every link in Mbps, parallel to m_linksNodes
   uint32_t                                       *m_blockchainNodesRegion;      //!< The region in which the blockchain nodes are located
-  double                                          m_regionLatencies[6][6];   //!< The inter- and intra-region latencies
-  double                                          m_regionDownloadSpeeds[6];     
-  double                                          m_regionUploadSpeeds[6];     
+  BlockchainRegionModel                           m_regionModel;             //!< The regions, their latencies and bandwidths
   
 
   std::map<uint32_t, std::map<Ipv4Address, double>>    m_peersDownloadSpeeds;     //!< key1 = nodeId, key2 = Ipv4Address of peer
   std::map<uint32_t, std::map<Ipv4Address, double>>    m_peersUploadSpeeds;       //!< key1 = nodeId, key2 = Ipv4Address of peer
+  std::map<uint32_t, std::map<Ipv4Address, uint32_t>>  m_peersNodeIds;            //!< key1 = nodeId, key2 = Ipv4Address of peer
   std::map<uint32_t, nodeInternetSpeed>               m_nodesInternetSpeeds;     //!< key = nodeId
   std::map<uint32_t, int>                              m_minConnections;          //!< key = nodeId
   std::map<uint32_t, int>                              m_maxConnections;          //!< key = nodeId
+  std::map<uint32_t, uint32_t>                         m_nodesShards;             //!< key = nodeId
 
   std::default_random_engine                     m_generator;
-  std::piecewise_constant_distribution<double>   m_nodesDistribution;
   std::piecewise_constant_distribution<double>   m_connectionsDistribution;
-  std::piecewise_constant_distribution<double>   m_europeDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_europeUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_northAmericaDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_northAmericaUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_koreaDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_koreaUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_japanDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_japanUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_southAmericaDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_southAmericaUploadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_australiaDownloadBandwidthDistribution;
-  std::piecewise_constant_distribution<double>   m_australiaUploadBandwidthDistribution;
 };
 
 
@@ -0,0 +1,44 @@
+#include "ns3/blockchain-validator-helper.h"
+#include "ns3/string.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/names.h"
+#include "ns3/blockchain-validator.h"
+
+namespace ns3 {
+
+    BlockchainValidatorHelper::BlockchainValidatorHelper(std::string protocol, Address address, std::vector<Ipv4Address> &peers, const std::vector<int> &committee,
+                                                        std::map<Ipv4Address, double> &peersDownloadSpeeds, std::map<Ipv4Address, double> &peersUploadSpeeds,
+                                                        nodeInternetSpeed &internetSpeeds, nodeStatistics *stats)
+                                                        :BlockchainNodeHelper(), m_committee(committee)
+    {
+        m_factory.SetTypeId("ns3::BlockchainValidator");
+        commonConstructor(protocol, address, peers, peersDownloadSpeeds, peersUploadSpeeds, internetSpeeds, stats);
+    }
+
+    Ptr<Application>
+    BlockchainValidatorHelper::InstallPriv(Ptr<Node> node)
+    {
+        Ptr<BlockchainValidator> app = m_factory.Create<BlockchainValidator>();
+        app->SetPeersAddresses(m_peersAddresses);
+        app->SetPeersDownloadSpeeds(m_peersDownloadSpeeds);
+        app->SetPeersUploadSpeeds(m_peersUploadSpeeds);
+        app->SetNodeInternetSpeeds(m_internetSpeeds);
+        app->SetNodeStats(m_nodeStats);
+        app->SetProtocolType(m_protocolType);
+        app->SetCommittee(m_committee);
+        app->SetPeersNodeIds(m_peersNodeIds);
+        app->SetFlowNetwork(m_flowNetwork);
+        app->SetTransactionLatencies(m_transactionLatencies);
+
+        node->AddApplication(app);
+
+        return app;
+    }
+
+    void
+    BlockchainValidatorHelper::SetCommittee(const std::vector<int> &committee)
+    {
+        m_committee = committee;
+    }
+
+}
@@ -0,0 +1,32 @@
+#ifndef BLOCKCHAIN_VALIDATOR_HELPER_H
+#define BLOCKCHAIN_VALIDATOR_HELPER_H
+
+#include "ns3/blockchain-node-helper.h"
+#include "ns3/blockchain-validator.h"
+
+namespace ns3{
+
+    class BlockchainValidatorHelper : public BlockchainNodeHelper
+    {
+        public:
+
+            BlockchainValidatorHelper(std::string protocol, Address address, std::vector<Ipv4Address> &peers, const std::vector<int> &committee,
+                                    std::map<Ipv4Address, double> &peersDownloadSpeeds, std::map<Ipv4Address, double> &peersUploadSpeeds,
+                                    nodeInternetSpeed &internetSpeeds, nodeStatistics *stats);
+
+            /*
+             * The node ids of the committee in leader rotation order, the same for all the installed validators
+             */
+            void SetCommittee(const std::vector<int> &committee);
+
+        protected:
+
+            virtual Ptr<Application> InstallPriv(Ptr<Node> node);
+
+            std::vector<int>                    m_committee;
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,350 @@
+#include "ns3/address.h"
+#include "ns3/log.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/node.h"
+#include "ns3/socket.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/blockchain-endorser.h"
+
+namespace ns3 {
+
+    NS_LOG_COMPONENT_DEFINE("BlockchainEndorser");
+    NS_OBJECT_ENSURE_REGISTERED(BlockchainEndorser);
+
+    TypeId
+    BlockchainEndorser::GetTypeId(void)
+    {
+        static TypeId tid = TypeId("ns3::BlockchainEndorser")
+            .SetParent<BlockchainNode>()
+            .SetGroupName("Application")
+            .AddConstructor<BlockchainEndorser>()
+            .AddAttribute("ProposalRate",
+                            "The client proposals per second received by the endorser as a gateway (0 only endorses for the other gateways)",
+                            DoubleValue(10),
+                            MakeDoubleAccessor(&BlockchainEndorser::m_proposalRate),
+                            MakeDoubleChecker<double>(0))
+            .AddAttribute("ExecutionTime",
+                            "The time to simulate a transaction proposal in seconds",
+                            DoubleValue(0.002),
+                            MakeDoubleAccessor(&BlockchainEndorser::m_executionTime),
+                            MakeDoubleChecker<double>(0))
+            .AddAttribute("EndorsementPolicy",
+                            "The endorsements needed by a transaction, one of them from the gateway",
+                            UintegerValue(2),
+                            MakeUintegerAccessor(&BlockchainEndorser::m_endorsementPolicy),
+                            MakeUintegerChecker<uint32_t>(1))
+            ;
+            return tid;
+    }
+
+    BlockchainEndorser::BlockchainEndorser() : BlockchainNode(), m_endorserIndex(-1), m_nextEndorser(0), m_nextOrderer(0),
+                                                m_endorsementSizeBytes(800), m_busyTime(0)
+    {
+        NS_LOG_FUNCTION(this);
+
+        m_proposalInterval = CreateObject<ExponentialRandomVariable>();
+        m_executedProposals = 0;
+        m_submittedTransactions = 0;
+
+        m_isMiner = true;
+    }
+
+    BlockchainEndorser::~BlockchainEndorser(void)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    void
+    BlockchainEndorser::DoDispose(void)
+    {
+        NS_LOG_FUNCTION(this);
+        m_proposalInterval = 0;
+        BlockchainNode::DoDispose();
+    }
+
+    void
+    BlockchainEndorser::SetEndorsers(const std::vector<int> &endorsers)
+    {
+        NS_LOG_FUNCTION(this);
+        m_endorsers = endorsers;
+    }
+
+    void
+    BlockchainEndorser::SetOrderers(const std::vector<int> &orderers)
+    {
+        NS_LOG_FUNCTION(this);
+        m_orderers = orderers;
+    }
+
+    int64_t
+    BlockchainEndorser::AssignStreams(int64_t stream)
+    {
+        NS_LOG_FUNCTION(this << stream);
+        int64_t streams = BlockchainNode::AssignStreams(stream);
+
+        m_proposalInterval->SetStream(stream + streams);
+        return streams + 1;
+    }
+
+    void
+    BlockchainEndorser::StartApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StartApplication();
+
+        m_nodeStats->miner = 1;
+
+        auto member = std::find(m_endorsers.begin(), m_endorsers.end(), static_cast<int>(GetNode()->GetId()));
+
+        if(member == m_endorsers.end() || m_orderers.empty())
+        {
+            NS_LOG_WARN("Endorser " << GetNode()->GetId() << " is not in the endorsers or has no ordering service");
+            return;
+        }
+        m_endorserIndex = member - m_endorsers.begin();
+
+        if(m_endorsementPolicy > m_endorsers.size())
+        {
+            NS_LOG_WARN("The endorsement policy needs " << m_endorsementPolicy << " endorsements but there are only "
+                        << m_endorsers.size() << " endorsers");
+            m_endorsementPolicy = m_endorsers.size();
+        }
+
+        if(m_proposalRate > 0)
+        {
+            ScheduleNextProposal();
+        }
+    }
+
+    void
+    BlockchainEndorser::StopApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StopApplication();
+        Simulator::Cancel(m_nextProposal);
+
+        double duration = Simulator::Now().GetSeconds() - m_startTime;
+
+        NS_LOG_WARN("The endorser " << GetNode()->GetId() << " simulated " << m_executedProposals << " proposals and submitted "
+                    << m_submittedTransactions << " transactions, " << m_pendingEndorsements.size() << " are still waiting for endorsements."
+                    << " Endorsement time mean/p50/p90 = " << m_endorsementTimes.GetMean() << "/" << m_endorsementTimes.GetPercentile(50)
+                    << "/" << m_endorsementTimes.GetPercentile(90) << "s");
+
+        m_nodeStats->executedProposals = m_executedProposals;
+        m_nodeStats->endorserUtilization = duration > 0 ? std::min(m_busyTime / (std::max(m_cpuCores, 1u) * duration), 1.0) : 0;
+        m_nodeStats->submittedTransactions = m_submittedTransactions;
+        m_nodeStats->meanEndorsementTime = m_endorsementTimes.GetMean();
+    }
+
+    void
+    BlockchainEndorser::ScheduleNextProposal(void)
+    {
+        NS_LOG_FUNCTION(this);
+        m_nextProposal = Simulator::Schedule(Seconds(m_proposalInterval->GetValue(1 / m_proposalRate, 0)),
+                                             &BlockchainEndorser::GenerateProposal, this);
+    }
+
+    double
+    BlockchainEndorser::ExecuteProposal(void)
+    {
+        m_busyTime += m_executionTime;
+        m_executedProposals++;
+
+        return ScheduleCpuTask(m_executionTime);
+    }
+
+    void
+    BlockchainEndorser::GenerateProposal(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        int nodeId = GetNode()->GetId();
+        int transId = m_transactionId++;
+        Transaction newTrans(nodeId, transId, Simulator::Now().GetSeconds());
+
+        m_pendingEndorsements[getTransactionKey(nodeId, transId)] = std::make_pair(newTrans, 0);
+        Simulator::Schedule(Seconds(ExecuteProposal()), &BlockchainEndorser::ReceivedEndorsement, this, nodeId, transId);
+
+        /*
+         * The other endorsements are requested from the next endorsers in turn
+         */
+        for(uint32_t i = 1; i < m_endorsementPolicy; i++)
+        {
+            rapidjson::Document d;
+            rapidjson::Value value;
+            std::ostringstream stringStream;
+            int endorser = m_endorsers[(m_endorserIndex + 1 + (m_nextEndorser++ % (m_endorsers.size() - 1))) % m_endorsers.size()];
+
+            d.SetObject();
+            stringStream << "endorse/" << nodeId << "/" << transId << "/" << endorser;
+
+            value = ENDORSE;
+            d.AddMember("message", value, d.GetAllocator());
+
+            value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+            d.AddMember("id", value, d.GetAllocator());
+
+            value = endorser;
+            d.AddMember("to", value, d.GetAllocator());
+
+            value = nodeId;
+            d.AddMember("nodeId", value, d.GetAllocator());
+
+            value = transId;
+            d.AddMember("transId", value, d.GetAllocator());
+
+            value = newTrans.GetTransSizeByte();
+            d.AddMember("size", value, d.GetAllocator());
+
+            SendConsensusMessage(d, endorser);
+        }
+
+        ScheduleNextProposal();
+    }
+
+    void
+    BlockchainEndorser::SendEndorsement(int gateway, int nodeId, int transId, int proposalSize)
+    {
+        NS_LOG_FUNCTION(this);
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        std::ostringstream stringStream;
+
+        d.SetObject();
+        stringStream << "endorsement/" << nodeId << "/" << transId << "/" << GetNode()->GetId();
+
+        value = ENDORSEMENT;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+        d.AddMember("id", value, d.GetAllocator());
+
+        value = gateway;
+        d.AddMember("to", value, d.GetAllocator());
+
+        value = nodeId;
+        d.AddMember("nodeId", value, d.GetAllocator());
+
+        value = transId;
+        d.AddMember("transId", value, d.GetAllocator());
+
+        /*
+         * The read-write set of the simulation and the endorsement
+         */
+        value = proposalSize + m_endorsementSizeBytes;
+        d.AddMember("size", value, d.GetAllocator());
+
+        SendConsensusMessage(d, gateway);
+    }
+
+    void
+    BlockchainEndorser::ReceivedEndorsement(int nodeId, int transId)
+    {
+        NS_LOG_FUNCTION(this << nodeId << transId);
+
+        auto it = m_pendingEndorsements.find(getTransactionKey(nodeId, transId));
+
+        if(it == m_pendingEndorsements.end())
+        {
+            return;
+        }
+
+        if(++it->second.second == static_cast<int>(m_endorsementPolicy))
+        {
+            Transaction newTrans = it->second.first;
+
+            m_pendingEndorsements.erase(it);
+            SubmitTransaction(newTrans);
+        }
+    }
+
+    void
+    BlockchainEndorser::SubmitTransaction(const Transaction &newTrans)
+    {
+        NS_LOG_FUNCTION(this);
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        std::ostringstream stringStream;
+        Transaction endorsedTrans = newTrans;
+        int orderer = m_orderers[m_nextOrderer++ % m_orderers.size()];
+
+        endorsedTrans.SetExecution();
+        endorsedTrans.SetEndorsements(m_endorsementPolicy);
+        endorsedTrans.SetTransSizeByte(newTrans.GetTransSizeByte() + m_endorsementPolicy * m_endorsementSizeBytes);
+
+        d.SetObject();
+        stringStream << "submit/" << newTrans.GetTransNodeId() << "/" << newTrans.GetTransId() << "/" << orderer;
+
+        value = SUBMIT;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+        d.AddMember("id", value, d.GetAllocator());
+
+        value = orderer;
+        d.AddMember("to", value, d.GetAllocator());
+
+        value = endorsedTrans.GetTransNodeId();
+        d.AddMember("nodeId", value, d.GetAllocator());
+
+        value = endorsedTrans.GetTransId();
+        d.AddMember("transId", value, d.GetAllocator());
+
+        value = endorsedTrans.GetTransTimeStamp();
+        d.AddMember("timestamp", value, d.GetAllocator());
+
+        value = endorsedTrans.GetEndorsements();
+        d.AddMember("endorsements", value, d.GetAllocator());
+
+        value = endorsedTrans.GetTransSizeByte();
+        d.AddMember("size", value, d.GetAllocator());
+
+        m_endorsementTimes.AddSample(Simulator::Now().GetSeconds() - newTrans.GetTransTimeStamp());
+        m_submittedTransactions++;
+
+        NS_LOG_INFO("SubmitTransaction: At time " << Simulator::Now().GetSeconds() << "s endorser " << GetNode()->GetId()
+                    << " submitted transaction " << newTrans.GetTransNodeId() << "/" << newTrans.GetTransId() << " to orderer " << orderer);
+
+        SendConsensusMessage(d, orderer);
+    }
+
+    void
+    BlockchainEndorser::ReceivedConsensusMessage(rapidjson::Document &d)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(m_endorserIndex < 0)
+        {
+            return;
+        }
+
+        switch(d["message"].GetInt())
+        {
+            case ENDORSE:
+            {
+                int gateway = d["nodeId"].GetInt();
+
+                Simulator::Schedule(Seconds(ExecuteProposal()), &BlockchainEndorser::SendEndorsement, this,
+                                    gateway, d["nodeId"].GetInt(), d["transId"].GetInt(), d["size"].GetInt());
+                break;
+            }
+            case ENDORSEMENT:
+            {
+                ReceivedEndorsement(d["nodeId"].GetInt(), d["transId"].GetInt());
+                break;
+            }
+            default:
+            {
+                NS_LOG_INFO("ReceivedConsensusMessage: endorser " << GetNode()->GetId() << " ignores " << d["id"].GetString());
+                break;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,109 @@
+#ifndef BLOCKCHAIN_ENDORSER_H
+#define BLOCKCHAIN_ENDORSER_H
+
+#include "blockchain-node.h"
+#include "ns3/random-variable-stream.h"
+#include "../../rapidjson/document.h"
+#include "../../rapidjson/writer.h"
+#include "../../rapidjson/stringbuffer.h"
+
+
+namespace ns3{
+
+    class Address;
+    class Socket;
+    class Packet;
+
+    /*
+     * ENDORSER of the execute-order-validate pipeline (Hyperledger Fabric).
+     * Every endorser is also the gateway of its clients: it receives their transaction proposals,
+     * simulates them and asks other endorsers for the endorsements the policy requires. Once the policy
+     * is satisfied the endorsed transaction is submitted to the ordering service (SUBMIT).
+     * Proposals are simulated on the cores of the node, next to the message processing and the block validations,
+     * so the endorser saturates below CpuCores/ExecutionTime proposals per second.
+     */
+    class BlockchainEndorser : public BlockchainNode
+    {
+
+        public:
+
+            static TypeId GetTypeId(void);
+            BlockchainEndorser();
+
+            virtual ~BlockchainEndorser(void);
+
+            /*
+             * The node ids of the endorsers, the same for all the nodes of the pipeline
+             */
+            void SetEndorsers(const std::vector<int> &endorsers);
+
+            /*
+             * The node ids of the ordering service, the first one leads it
+             */
+            void SetOrderers(const std::vector<int> &orderers);
+
+            /*
+             * Assign fixed random variable stream numbers to the node and to the proposal
+             * interval distribution. Returns the number of streams used.
+             */
+            virtual int64_t AssignStreams(int64_t stream);
+
+        protected:
+
+            virtual void StartApplication(void);
+            virtual void StopApplication(void);
+
+            virtual void DoDispose(void);
+
+            virtual void ReceivedConsensusMessage(rapidjson::Document &d);
+
+            /*
+             * A client proposal reaches this gateway
+             */
+            void GenerateProposal(void);
+
+            void ScheduleNextProposal(void);
+
+            /*
+             * Queues the simulation of a proposal on the cpu of the node
+             * return : the time until the simulation finishes
+             */
+            double ExecuteProposal(void);
+
+            /*
+             * Answers the ENDORSE request of a gateway once the proposal is simulated
+             */
+            void SendEndorsement(int gateway, int nodeId, int transId, int proposalSize);
+
+            void ReceivedEndorsement(int nodeId, int transId);
+
+            /*
+             * Submits the transaction to the ordering service, once it collected enough endorsements
+             */
+            void SubmitTransaction(const Transaction &newTrans);
+
+            std::vector<int>                    m_endorsers;
+            std::vector<int>                    m_orderers;
+            int                                 m_endorserIndex;            // -1 if the node is not in m_endorsers
+            int                                 m_nextEndorser;             // spreads the endorse requests over the endorsers
+            int                                 m_nextOrderer;              // spreads the submissions over the ordering service
+
+            double                              m_proposalRate;             // client proposals per second
+            double                              m_executionTime;            // seconds to simulate a proposal
+            uint32_t                            m_endorsementPolicy;        // endorsements needed per transaction
+            const int                           m_endorsementSizeBytes;     // signature and certificate of the endorser, 800 Bytes
+            double                              m_busyTime;                 // cpu time spent simulating proposals
+
+            EventId                             m_nextProposal;
+            Ptr<ExponentialRandomVariable>      m_proposalInterval;
+
+            std::unordered_map<uint64_t, std::pair<Transaction, int>>   m_pendingEndorsements;  // key = transaction key, value = (transaction, endorsements)
+
+            long                                m_executedProposals;
+            long                                m_submittedTransactions;
+            LatencyHistogram                    m_endorsementTimes;         // proposal -> policy satisfied
+    };
+
+}
+
+#endif
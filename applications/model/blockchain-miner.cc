@@ -26,6 +26,7 @@ namespace ns3 {
 
     NS_LOG_COMPONENT_DEFINE("BlockchainMiner");
     NS_OBJECT_ENSURE_REGISTERED(BlockchainMiner);
+    NS_OBJECT_ENSURE_REGISTERED(BlockchainMiningScheduler);
 
     TypeId
     BlockchainMiner::GetTypeId(void)
@@ -64,21 +65,231 @@ namespace ns3 {
                             TimeValue(Minutes(2)),
                             MakeTimeAccessor(&BlockchainMiner::m_invTimeoutMinutes),
                             MakeTimeChecker())
+            .AddAttribute("TransactionSampleRate",
+                            "Track the lifecycle of one out of every n transactions",
+                            UintegerValue(1),
+                            MakeUintegerAccessor(&BlockchainMiner::m_transactionSampleRate),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ConfirmationDepth",
+                            "The number of blocks on top of which a transaction is considered confirmed",
+                            UintegerValue(12),
+                            MakeUintegerAccessor(&BlockchainMiner::m_confirmationDepth),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("TransactionRetentionTime",
+                            "The time after its creation for which the lifecycle of a transaction is tracked",
+                            TimeValue(Hours(24)),
+                            MakeTimeAccessor(&BlockchainMiner::m_transactionRetentionTime),
+                            MakeTimeChecker())
+            .AddAttribute("MempoolMaxSizeBytes",
+                            "The memory budget of the mempool in bytes",
+                            UintegerValue(300000000),
+                            MakeUintegerAccessor(&BlockchainMiner::m_mempoolMaxSizeBytes),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("MempoolExpiry",
+                            "The time after which a transaction is dropped from the mempool (0 disables the expiry)",
+                            TimeValue(Hours(336)),
+                            MakeTimeAccessor(&BlockchainMiner::m_mempoolExpiry),
+                            MakeTimeChecker())
+            .AddAttribute("KnownInventoryFilterItems",
+                            "The items per generation of the per-peer known inventory filters (0 disables the filters)",
+                            UintegerValue(5000),
+                            MakeUintegerAccessor(&BlockchainMiner::m_knownInventoryFilterItems),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("KnownInventoryFilterFpRate",
+                            "The target false positive rate of the per-peer known inventory filters, in [1e-9, 0.5]",
+                            DoubleValue(0.001),
+                            MakeDoubleAccessor(&BlockchainMiner::m_knownInventoryFilterFpRate),
+                            MakeDoubleChecker<double>(1e-9, 0.5))
+            .AddAttribute("KnownInventoryAudit",
+                            "Keep an exact copy of the known inventory to measure the false positives of the filters",
+                            BooleanValue(false),
+                            MakeBooleanAccessor(&BlockchainMiner::m_knownInventoryAudit),
+                            MakeBooleanChecker())
+            .AddAttribute("TransactionRelayType",
+                            "PUSH_TRANSACTIONS, ANNOUNCE_TRANSACTIONS",
+                            UintegerValue(0),
+                            MakeUintegerAccessor(&BlockchainMiner::m_transactionRelayType),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("TransactionInvInterval",
+                            "The interval at which the queued transaction announcements are sent",
+                            TimeValue(Seconds(1)),
+                            MakeTimeAccessor(&BlockchainMiner::m_transactionInvInterval),
+                            MakeTimeChecker())
+            .AddAttribute("MaxTransactionsInFlight",
+                            "The maximum number of transactions requested from a peer at the same time",
+                            UintegerValue(100),
+                            MakeUintegerAccessor(&BlockchainMiner::m_maxTransactionsInFlight),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("TransactionRequestTimeout",
+                            "The time to wait for a requested transaction before asking another announcer",
+                            TimeValue(Seconds(60)),
+                            MakeTimeAccessor(&BlockchainMiner::m_transactionRequestTimeout),
+                            MakeTimeChecker())
+            .AddAttribute("TransactionValidationTime",
+                            "The time to validate a transaction that is not in the signature cache (in seconds)",
+                            DoubleValue(0.00038),
+                            MakeDoubleAccessor(&BlockchainMiner::m_transactionValidationTime),
+                            MakeDoubleChecker<double>())
+            .AddAttribute("CachedTransactionValidationTime",
+                            "The time to validate a transaction already verified on mempool entry (in seconds)",
+                            DoubleValue(0.00001),
+                            MakeDoubleAccessor(&BlockchainMiner::m_cachedTransactionValidationTime),
+                            MakeDoubleChecker<double>())
+            .AddAttribute("SignatureCacheSize",
+                            "The maximum number of entries of the signature cache",
+                            UintegerValue(100000),
+                            MakeUintegerAccessor(&BlockchainMiner::m_signatureCacheSize),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ForkChoiceRule",
+                            "LONGEST_CHAIN, GHOST, KEY_BLOCKS",
+                            UintegerValue(0),
+                            MakeUintegerAccessor(&BlockchainMiner::m_forkChoiceRule),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("CpuCores",
+                            "The cores processing the received messages and validating blocks (0 processes them in parallel without limit)",
+                            UintegerValue(0),
+                            MakeUintegerAccessor(&BlockchainMiner::m_cpuCores),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("MessageProcessingTime",
+                            "The cpu time to parse and dispatch a received message (in seconds)",
+                            DoubleValue(0.0001),
+                            MakeDoubleAccessor(&BlockchainMiner::m_messageProcessingTime),
+                            MakeDoubleChecker<double>(0))
+            .AddAttribute("Shard",
+                            "The shard of the miner, blocks and transactions are only relayed to the peers of the same shard",
+                            UintegerValue(0),
+                            MakeUintegerAccessor(&BlockchainMiner::m_shard),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("Shards",
+                            "The number of shards, each one running its own chain on the network",
+                            UintegerValue(1),
+                            MakeUintegerAccessor(&BlockchainMiner::m_noShards),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("CrossShardRatio",
+                            "The fraction of the created transactions that pay to another shard",
+                            DoubleValue(0),
+                            MakeDoubleAccessor(&BlockchainMiner::m_crossShardRatio),
+                            MakeDoubleChecker<double>(0, 1))
+            .AddAttribute("UploadDiscipline",
+                            "FIFO_UPLOADS, FAIR_SHARE_UPLOADS, PEER_PRIORITY_UPLOADS",
+                            UintegerValue(0),
+                            MakeUintegerAccessor(&BlockchainMiner::m_uploadDiscipline),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ChunkSize",
+                            "The size of the chunks of a block relayed with BLOCK_TORRENT in Bytes",
+                            UintegerValue(65536),
+                            MakeUintegerAccessor(&BlockchainMiner::m_chunkSizeBytes),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("MaxChunksInFlight",
+                            "The maximum number of chunks of a block requested from a peer at the same time",
+                            UintegerValue(4),
+                            MakeUintegerAccessor(&BlockchainMiner::m_maxChunksInFlight),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("MeanSessionLength",
+                            "The mean time the node stays online before leaving the network, 0 disables the churn",
+                            TimeValue(Seconds(0)),
+                            MakeTimeAccessor(&BlockchainMiner::m_meanSessionLength),
+                            MakeTimeChecker())
+            .AddAttribute("MeanDowntime",
+                            "The mean time the node stays offline before rejoining the network",
+                            TimeValue(Minutes(10)),
+                            MakeTimeAccessor(&BlockchainMiner::m_meanDowntime),
+                            MakeTimeChecker())
+            .AddAttribute("SessionDistribution",
+                            "EXPONENTIAL_SESSIONS, WEIBULL_SESSIONS, PARETO_SESSIONS",
+                            UintegerValue(0),
+                            MakeUintegerAccessor(&BlockchainMiner::m_sessionDistribution),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("SessionShape",
+                            "The shape of the Weibull and Pareto session and downtime lengths",
+                            DoubleValue(0.6),
+                            MakeDoubleAccessor(&BlockchainMiner::m_sessionShape),
+                            MakeDoubleChecker<double>(0.01))
+            .AddAttribute("MaxHeadersPerMessage",
+                            "The headers sent in answer to a GET_HEADERS with a locator",
+                            UintegerValue(2000),
+                            MakeUintegerAccessor(&BlockchainMiner::m_maxHeadersPerMessage),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("MaxBlocksInFlight",
+                            "The blocks requested from one peer at the same time while syncing",
+                            UintegerValue(16),
+                            MakeUintegerAccessor(&BlockchainMiner::m_maxBlocksInFlight),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("BlockDownloadWindow",
+                            "The blocks above the lowest missing one that may be requested while syncing",
+                            UintegerValue(1024),
+                            MakeUintegerAccessor(&BlockchainMiner::m_blockDownloadWindow),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("BlockStallTimeout",
+                            "The time a peer has to deliver a block requested while syncing before it is requested from another peer",
+                            TimeValue(Seconds(10)),
+                            MakeTimeAccessor(&BlockchainMiner::m_blockStallTimeout),
+                            MakeTimeChecker())
+            .AddAttribute("InitialBlockDownload",
+                            "Whether the node syncs the chain of its peers when it starts, for the nodes started late",
+                            BooleanValue(false),
+                            MakeBooleanAccessor(&BlockchainMiner::m_initialBlockDownload),
+                            MakeBooleanChecker())
+            .AddAttribute("ConsensusWeight",
+                            "The share of the send queue of a peer for blocks, headers, requests and votes",
+                            UintegerValue(16),
+                            MakeUintegerAccessor(&BlockchainMiner::m_consensusWeight),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("InventoryWeight",
+                            "The share of the send queue of a peer for INV and CHUNK_INV announcements",
+                            UintegerValue(4),
+                            MakeUintegerAccessor(&BlockchainMiner::m_inventoryWeight),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("BulkWeight",
+                            "The share of the send queue of a peer for transactions",
+                            UintegerValue(1),
+                            MakeUintegerAccessor(&BlockchainMiner::m_bulkWeight),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("MaxUnconnectedQueueBytes",
+                            "The bytes queued for a peer that has not connected to the node yet, the messages beyond are dropped",
+                            UintegerValue(1000000),
+                            MakeUintegerAccessor(&BlockchainMiner::m_maxUnconnectedQueueBytes),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("ReceiptConfirmations",
+                            "The blocks on top of a block of the miner before the receipts of its cross-shard transactions are sent",
+                            UintegerValue(6),
+                            MakeUintegerAccessor(&BlockchainMiner::m_receiptConfirmations),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("MaxUncles",
+                            "The maximum number of uncles referenced by a block (ETHEREUM only)",
+                            UintegerValue(2),
+                            MakeUintegerAccessor(&BlockchainMiner::m_maxUncles),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("MaxUncleDepth",
+                            "The maximum number of generations between a block and its uncles",
+                            UintegerValue(6),
+                            MakeUintegerAccessor(&BlockchainMiner::m_maxUncleDepth),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("HeaderFirstMining",
+                            "Mine on a new tip as soon as its header is checked, before the block is downloaded and validated",
+                            BooleanValue(false),
+                            MakeBooleanAccessor(&BlockchainMiner::m_headerFirstMining),
+                            MakeBooleanChecker())
+            .AddAttribute("InvalidBlockRate",
+                            "The probability that a block of the miner fails the full validation",
+                            DoubleValue(0),
+                            MakeDoubleAccessor(&BlockchainMiner::m_invalidBlockRate),
+                            MakeDoubleChecker<double>(0, 1))
+            .AddAttribute("MicroblockInterval",
+                            "Bitcoin-NG: the interval between the microblocks of the leader of the last key block (0 mines plain blocks)",
+                            TimeValue(Seconds(0)),
+                            MakeTimeAccessor(&BlockchainMiner::m_microblockInterval),
+                            MakeTimeChecker())
+            .AddAttribute("MicroblockSize",
+                            "The maximum size of a microblock in Bytes (0 uses the size of the mined blocks)",
+                            UintegerValue(0),
+                            MakeUintegerAccessor(&BlockchainMiner::m_microblockSize),
+                            MakeUintegerChecker<uint32_t>())
             .AddAttribute("HashRate",
                             "The hash rate of the miner",
                             DoubleValue(0.2),
                             MakeDoubleAccessor(&BlockchainMiner::m_hashRate),
                             MakeDoubleChecker<double>())
-            .AddAttribute("BlockGenBinSize",
-                            "The block generation bin size",
-                            DoubleValue(-1),
-                            MakeDoubleAccessor(&BlockchainMiner::m_blockGenBinSize),
-                            MakeDoubleChecker<double>())
-            .AddAttribute("BlockGenParameter",
-                            "The block generation distribution parameter",
-                            DoubleValue(-1),
-                            MakeDoubleAccessor(&BlockchainMiner::m_blockGenParameter),
-                            MakeDoubleChecker<double>())
             .AddAttribute("AverageBlockGenIntervalSeconds",
                             "The average block generation interval we ami at (in seconds) ", 
                             DoubleValue(15),
@@ -97,17 +308,31 @@ namespace ns3 {
             return tid;
     }
 
-    BlockchainMiner::BlockchainMiner() : BlockchainNode(), m_realAverageBlockGenIntervalSeconds(15),
-                                        m_timeStart(0), m_timeFinish(0), m_fistToMine(false)
+    BlockchainMiner::BlockchainMiner() : BlockchainNode(), m_miningSchedulerIndex(-1),
+                                        m_realAverageBlockGenIntervalSeconds(15), m_timeStart(0), m_timeFinish(0), m_fistToMine(false),
+                                        m_miningOnHeader(false), m_headerTipSwitchTime(0), m_receiptProofSizeBytes(384),
+                                        m_microblockSignatureSizeBytes(72), m_leaderKeyHeight(-1)
     {
         NS_LOG_FUNCTION(this);
         m_minerAverageBlockGenInterval = 0;
         m_minerGeneratedBlocks = 0;
         m_previousBlockGenerationTime = 0;
+        m_headerTipSwitches = 0;
+        m_headerMinedBlocks = 0;
+        m_headerMiningRollbacks = 0;
+        m_headerMiningDiscardedBlocks = 0;
+        m_headerMiningInvalidTime = 0;
+        m_sentReceipts = 0;
+        m_receivedReceipts = 0;
+        m_crossShardTransactions = 0;
+        m_generatedMicroblocks = 0;
 
         std::random_device rd;
         m_generator.seed(rd());
 
+        m_blockGenTimeDistribution = CreateObject<ExponentialRandomVariable>();
+        m_invalidBlockDistribution = CreateObject<UniformRandomVariable>();
+
         if(m_fixedBlockTimeGeneration > 0)
         {
             m_nextBlockTime = m_fixedBlockTimeGeneration;
@@ -150,22 +375,20 @@ namespace ns3 {
         NS_LOG_WARN("Miner " << GetNode()->GetId() << " m_hashRate = " << m_hashRate);
         NS_LOG_WARN("Miner " << GetNode()->GetId() << " m_cryptocurrency = " << m_cryptocurrency);
         
-        if(m_blockGenBinSize < 0 && m_blockGenParameter <0)
-        {
-            m_blockGenBinSize = 1.0/60/1000;
-            m_blockGenParameter = 0.19 * m_blockGenBinSize / 2;
-            //std::cout<< "m_blockGenBinSize : "<< m_blockGenBinSize << "\n";
-            //std::cout<< "m_blockGenParameter : "<< m_blockGenParameter << "\n";
-        }
-        else
+        /*
+         * Mining is a memoryless race: a miner holding m_hashRate of the total hash power
+         * finds blocks at rate m_hashRate / m_averageBlockGenIntervalSeconds, so the network
+         * as a whole produces one block every m_averageBlockGenIntervalSeconds on average.
+         */
+        if(m_fixedBlockTimeGeneration <= 0)
         {
-            m_blockGenParameter *= m_hashRate;
-            //std::cout<< "m_blockGenParameter : "<< m_blockGenParameter << "\n";
-        }
+            NS_ASSERT_MSG(m_hashRate > 0, "The hash rate of miner " << GetNode()->GetId() << " must be positive");
+            m_blockGenTimeDistribution->SetAttribute("Mean", DoubleValue(m_averageBlockGenIntervalSeconds / m_hashRate));
 
-        if(m_fixedBlockTimeGeneration == 0)
-        {
-            m_blockGenTimeDistribution.param(std::geometric_distribution<int>::param_type(m_blockGenParameter));
+            if(m_miningScheduler != 0)
+            {
+                m_miningSchedulerIndex = m_miningScheduler->AddMiner(this, m_hashRate / m_averageBlockGenIntervalSeconds);
+            }
         }
 
         if(m_fixedBlockSize > 0)
@@ -187,6 +410,12 @@ namespace ns3 {
         
         BlockchainNode::StopApplication();
         Simulator::Cancel(m_nextMiningEvent);
+        StopLeading();
+
+        if(m_miningSchedulerIndex >= 0)
+        {
+            m_miningScheduler->SetMinerRate(m_miningSchedulerIndex, 0);
+        }
 
         NS_LOG_WARN("The miner " << GetNode()->GetId() << " with hash rate = " << m_hashRate
                     << " generated " << m_minerGeneratedBlocks << " blocks " << " ( " << 100.0*m_minerGeneratedBlocks/(m_blockchain.GetTotalBlocks()-1)
@@ -199,6 +428,59 @@ namespace ns3 {
         m_nodeStats->minerAverageBlockGenInterval = m_minerAverageBlockGenInterval;
         m_nodeStats->minerAverageBlockSize = m_minerAverageBlockSize;
 
+        if(m_headerFirstMining)
+        {
+            if(m_miningOnHeader)
+            {
+                LeaveHeaderTip();
+            }
+
+            NS_LOG_WARN("The miner " << GetNode()->GetId() << " switched " << m_headerTipSwitches << " times to unvalidated tips, mined "
+                        << m_headerMinedBlocks << " empty blocks on them and rolled back " << m_headerMiningRollbacks << " invalid tips ("
+                        << m_headerMiningDiscardedBlocks << " blocks discarded). Risk window mean/p90 = " << m_headerRiskWindows.GetMean()
+                        << "/" << m_headerRiskWindows.GetPercentile(90) << "s");
+
+            m_nodeStats->headerTipSwitches = m_headerTipSwitches;
+            m_nodeStats->headerMinedBlocks = m_headerMinedBlocks;
+            m_nodeStats->headerMiningRollbacks = m_headerMiningRollbacks;
+            m_nodeStats->headerMiningDiscardedBlocks = m_headerMiningDiscardedBlocks;
+            m_nodeStats->meanHeaderRiskWindow = m_headerRiskWindows.GetMean();
+            m_nodeStats->headerMiningInvalidTime = m_headerMiningInvalidTime;
+        }
+
+        if(m_noShards > 1)
+        {
+            NS_LOG_WARN("The miner " << GetNode()->GetId() << " of shard " << m_shard << " sent " << m_sentReceipts << " receipts, received "
+                        << m_receivedReceipts << " as a gateway and confirmed " << m_crossShardTransactions
+                        << " cross-shard transactions, " << m_unconfirmedBlocks.size() << " blocks are still waiting for confirmations."
+                        << " Cross-shard latency mean/p90 = " << m_crossShardLatencies.GetMean() << "/"
+                        << m_crossShardLatencies.GetPercentile(90) << "s");
+
+            m_nodeStats->sentReceipts = m_sentReceipts;
+            m_nodeStats->crossShardTransactions = m_crossShardTransactions;
+            m_nodeStats->meanCrossShardLatency = m_crossShardLatencies.GetMean();
+            m_nodeStats->crossShardLatencyP90 = m_crossShardLatencies.GetPercentile(90);
+        }
+
+        if(m_microblockInterval.IsStrictlyPositive())
+        {
+            int staleMicroblocks = 0;
+
+            for(auto const &height: m_microblockHeights)
+            {
+                if(!m_blockchain.IsInMainChain(height, GetNode()->GetId()))
+                {
+                    staleMicroblocks++;
+                }
+            }
+
+            NS_LOG_WARN("The miner " << GetNode()->GetId() << " streamed " << m_generatedMicroblocks << " microblocks as leader, "
+                        << staleMicroblocks << " of them were pruned by a key block mined on an earlier microblock");
+
+            m_nodeStats->generatedMicroblocks = m_generatedMicroblocks;
+            m_nodeStats->staleMicroblocks = staleMicroblocks;
+        }
+
         if(m_fistToMine)
         {
             m_timeFinish = GetWallTime();
@@ -210,6 +492,8 @@ namespace ns3 {
     BlockchainMiner::DoDispose(void)
     {
         NS_LOG_FUNCTION(this);
+        m_miningScheduler = 0;
+        m_invalidBlockDistribution = 0;
         BlockchainNode::DoDispose();
     }
 
@@ -242,47 +526,71 @@ namespace ns3 {
     }
 
     double
-    BlockchainMiner::GetBlockGenBinSize(void) const
+    BlockchainMiner::GetHashRate(void) const
     {
         NS_LOG_FUNCTION(this);
-        return m_blockGenBinSize;
+        return m_hashRate;
     }
 
     void
-    BlockchainMiner::SetBlockGenBinSize(double blockGenBinSize)
+    BlockchainMiner::SetHashRate(double hashRate)
     {
         NS_LOG_FUNCTION(this);
-        m_blockGenBinSize = blockGenBinSize;
+        m_hashRate = hashRate;
     }
 
-    double
-    BlockchainMiner::GetBlockGenParameter(void) const
+    int64_t
+    BlockchainMiner::AssignStreams(int64_t stream)
     {
-        NS_LOG_FUNCTION(this);
-        return m_blockGenParameter;
+        NS_LOG_FUNCTION(this << stream);
+        int64_t streams = BlockchainNode::AssignStreams(stream);
+
+        m_blockGenTimeDistribution->SetStream(stream + streams);
+        m_invalidBlockDistribution->SetStream(stream + streams + 1);
+        return streams + 2;
     }
 
     void
-    BlockchainMiner::SetBlockGenParameter(double blockGenParameter)
+    BlockchainMiner::SetMiningScheduler(Ptr<BlockchainMiningScheduler> miningScheduler)
     {
         NS_LOG_FUNCTION(this);
-        m_blockGenParameter = blockGenParameter;
-        m_blockGenTimeDistribution.param(std::geometric_distribution<int>::param_type(m_blockGenParameter));
+        m_miningScheduler = miningScheduler;
+    }
 
+    void
+    BlockchainMiner::SetShardGateways(const std::vector<int> &gateways)
+    {
+        NS_LOG_FUNCTION(this);
+        m_shardGateways = gateways;
     }
 
-    double
-    BlockchainMiner::GetHashRate(void) const
+    void
+    BlockchainMiner::LeaveNetwork(void)
     {
         NS_LOG_FUNCTION(this);
-        return m_hashRate;
+
+        BlockchainNode::LeaveNetwork();
+        Simulator::Cancel(m_nextMiningEvent);
+        StopLeading();
+
+        if(m_miningSchedulerIndex >= 0)
+        {
+            m_miningScheduler->SetMinerRate(m_miningSchedulerIndex, 0);
+        }
     }
 
     void
-    BlockchainMiner::SetHashRate(double hashRate)
+    BlockchainMiner::JoinNetwork(void)
     {
         NS_LOG_FUNCTION(this);
-        m_hashRate = hashRate;
+
+        BlockchainNode::JoinNetwork();
+
+        if(m_miningSchedulerIndex >= 0)
+        {
+            m_miningScheduler->SetMinerRate(m_miningSchedulerIndex, m_hashRate / m_averageBlockGenIntervalSeconds);
+        }
+        ScheduleNextMiningEvent();
     }
 
     void
@@ -291,6 +599,16 @@ namespace ns3 {
         NS_LOG_FUNCTION(this);
         //std::cout<< "Schedule Mine application\n";
 
+        if(!m_online)
+        {
+            return;     // the race restarts when the miner rejoins
+        }
+
+        if(m_miningSchedulerIndex >= 0)
+        {
+            return;     // the shared scheduler decides when this miner finds a block
+        }
+
         if(m_fixedBlockTimeGeneration > 0)
         {
             m_nextBlockTime = m_fixedBlockTimeGeneration;
@@ -299,14 +617,7 @@ namespace ns3 {
         }
         else
         {
-            /*
-            m_nextBlockTime = m_blockGenTimeDistribution(m_generator)*m_blockGenBinSize*60
-                                *(m_averageBlockGenIntervalSeconds/m_realAverageBlockGenIntervalSeconds)/m_hashRate;
-            //std::cout<< "m_blockGenTimeDistribution(m_generator) : "<<m_blockGenTimeDistribution(m_generator)<<"\n";
-            //std::cout<<"m_nextBlockTime(2) : " << m_nextBlockTime <<"\n";
-            m_nextMiningEvent = Simulator::Schedule(Seconds(m_nextBlockTime), &BlockchainMiner::MineBlock, this);
-            */
-            m_nextBlockTime = 13;
+            m_nextBlockTime = m_blockGenTimeDistribution->GetValue();
             m_nextMiningEvent = Simulator::Schedule(Seconds(m_nextBlockTime), &BlockchainMiner::MineBlock, this);
         }
     }
@@ -315,6 +626,13 @@ namespace ns3 {
     BlockchainMiner::MineBlock(void)
     {   
         NS_LOG_FUNCTION(this);
+
+        if(m_miningOnHeader)
+        {
+            MineBlockOnHeader();
+            return;
+        }
+
         //std::cout<< "Start MineBlock function\n";
         rapidjson::Document inv;
         rapidjson::Document block;
@@ -358,21 +676,67 @@ namespace ns3 {
             m_nextBlockSize = m_averageTransacionSize + m_headersSizeBytes;
         }
 
-        Block newBlock(height, minerId, nonce, parentBlockMinerId, m_nextBlockSize,
+        /*
+         * Bitcoin-NG: the key block only elects the miner as leader, the transactions go in its microblocks
+         */
+        bool keyBlock = m_microblockInterval.IsStrictlyPositive();
+        int blockSize = keyBlock ? m_blockHeadersSizeBytes : m_nextBlockSize;
+
+        Block newBlock(height, minerId, nonce, parentBlockMinerId, blockSize,
                         currentTime, currentTime, Ipv4Address("127.0.0.1"));
+        newBlock.SetValid(!IsNextBlockInvalid());
         
         /*
-         * Push transactions to new Blocks
+         * Push the transactions with the highest fees that fit in the new Block
          */
-        
-        for(trans_it = m_notValidatedTransaction.begin(); trans_it < m_notValidatedTransaction.end(); trans_it++)
+
+        /*
+         * Ethereum blocks reference recent stale blocks as uncles; their headers take
+         * the place of transactions in the block
+         */
+        std::vector<std::pair<int, int>> uncles;
+
+        if(m_cryptocurrency == ETHEREUM && m_maxUncles > 0 && !keyBlock)
+        {
+            uncles = m_blockchain.GetUncleCandidates(m_maxUncles, m_maxUncleDepth);
+            newBlock.SetUncles(uncles);
+        }
+
+        m_mempool.ExpireTransactions(currentTime);
+        ForgetDroppedTransactions();
+        std::vector<Transaction> blockTransactions;
+
+        if(!keyBlock)
+        {
+            blockTransactions = m_mempool.GetTransactionsByFee(m_nextBlockSize - m_blockHeadersSizeBytes*(1 + uncles.size()));
+        }
+
+        for(trans_it = blockTransactions.begin(); trans_it < blockTransactions.end(); trans_it++)
         {
             trans_it->SetValidation();
+            m_mempool.RemoveTransaction(trans_it->GetTransNodeId(), trans_it->GetTransId());
             m_totalMining++;
             m_meanMiningTime = (m_meanMiningTime*static_cast<double>(m_totalMining-1) + (Simulator::Now().GetSeconds() - trans_it->GetTransTimeStamp()))/static_cast<double>(m_totalMining);
         }
-        newBlock.SetTransactions(m_notValidatedTransaction);
-        m_notValidatedTransaction.clear();
+        newBlock.SetTransactions(blockTransactions);
+
+        if(m_noShards > 1)
+        {
+            std::vector<Transaction> crossShardTransactions;
+
+            for(auto const &tran: blockTransactions)
+            {
+                if(tran.GetDestinationShard() >= 0)
+                {
+                    crossShardTransactions.push_back(tran);
+                }
+            }
+
+            if(!crossShardTransactions.empty())
+            {
+                m_unconfirmedBlocks[height] = crossShardTransactions;
+            }
+        }
 
         //newBlock.PrintAllTransaction();
         
@@ -400,9 +764,11 @@ namespace ns3 {
         m_meanBlockPropagationTime = (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks())*m_meanBlockPropagationTime;
 
         m_meanBlockSize = (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks())*m_meanBlockSize     
-                            + (m_nextBlockSize)/static_cast<double>(m_blockchain.GetTotalBlocks());
+                            + (blockSize)/static_cast<double>(m_blockchain.GetTotalBlocks());
         
         m_blockchain.AddBlock(newBlock);
+        m_txTracker.BlockAdded(newBlock, currentTime);
+        m_txTracker.UpdateConfirmations(m_blockchain, currentTime);
 
         rapidjson::StringBuffer invInfo;
         rapidjson::Writer<rapidjson::StringBuffer> invWriter(invInfo);
@@ -414,35 +780,258 @@ namespace ns3 {
 
         //std::cout<< "MineBlock function : Add a new block in packet\n";
 
-        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+        if(m_protocolType == BLOCK_TORRENT)
         {
+            AdvertiseFullBlock(newBlock);
+        }
+        else
+        {
+            for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+            {
             
-            const uint8_t delimiter[] = "#";
-
-            m_peersSockets[*i]->Send(reinterpret_cast<const uint8_t*>(invInfo.GetString()), invInfo.GetSize(), 0);
-            m_peersSockets[*i]->Send(delimiter, 1, 0);
+                MarkBlockKnown(*i, blockHash);
+                SendToPeer(*i, invInfo.GetString(), invInfo.GetSize(), INV);
             
-            m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
-            //std::cout<< "Node : " << GetNode()->GetId() <<" complete minning and send packet to " << *i << " \n" ;
-            NS_LOG_INFO("At time " << Simulator::Now().GetSeconds()
-                        << " s blockchain miner " << GetNode()->GetId()
-                        << " sent a packet " << invInfo.GetString()
-                        << " to " << *i);
+                m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_countBytes + inv["inv"].Size()*m_inventorySizeBytes;
+                //std::cout<< "Node : " << GetNode()->GetId() <<" complete minning and send packet to " << *i << " \n" ;
+                NS_LOG_INFO("At time " << Simulator::Now().GetSeconds()
+                            << " s blockchain miner " << GetNode()->GetId()
+                            << " sent a packet " << invInfo.GetString()
+                            << " to " << *i);
             
 
+            }
         }
         
+        UpdateGeneratedBlockStats(blockSize);
+        ProcessConfirmedBlocks();
+
+        if(keyBlock)
+        {
+            StartLeading(height);
+        }
+
+        ScheduleNextMiningEvent();
+        //std::cout<< "MineBlock function : finish MinBLock\n";
+
+    }
+
+    void
+    BlockchainMiner::UpdateGeneratedBlockStats(int blockSize)
+    {
         m_minerAverageBlockGenInterval = m_minerGeneratedBlocks/static_cast<double>(m_minerGeneratedBlocks+1)*m_minerAverageBlockGenInterval
                                         + (Simulator::Now().GetSeconds() - m_previousBlockGenerationTime)/(m_minerGeneratedBlocks+1);
 
         m_minerAverageBlockSize = m_minerGeneratedBlocks/static_cast<double>(m_minerGeneratedBlocks+1)*m_minerAverageBlockSize
-                                + static_cast<double>(m_nextBlockSize)/(m_minerGeneratedBlocks+1);
+                                + static_cast<double>(blockSize)/(m_minerGeneratedBlocks+1);
         m_previousBlockGenerationTime = Simulator::Now().GetSeconds();
         m_minerGeneratedBlocks++;
+    }
+
+    bool
+    BlockchainMiner::IsNextBlockInvalid(void)
+    {
+        if(m_invalidBlockRate <= 0)
+        {
+            return false;
+        }
+
+        return m_invalidBlockDistribution->GetValue() < m_invalidBlockRate;
+    }
+
+    void
+    BlockchainMiner::MineBlockOnHeader(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        int height = m_headerTip.GetBlockHeight() + 1;
+        int minerId = GetNode()->GetId();
+        double currentTime = Simulator::Now().GetSeconds();
+        std::ostringstream stringStream;
 
+        /*
+         * Without the body of the parent the miner cannot tell which transactions are already spent,
+         * so the block only carries the header. It is announced once its ancestors are validated.
+         */
+        Block newBlock(height, minerId, 0, m_headerTip.GetMinerId(), m_blockHeadersSizeBytes,
+                        currentTime, currentTime, Ipv4Address("127.0.0.1"));
+        newBlock.SetValid(!IsNextBlockInvalid());
+
+        stringStream << height << "/" << minerId;
+        NS_LOG_INFO("MineBlockOnHeader: At time " << currentTime << "s miner " << minerId << " mined the empty block "
+                    << stringStream.str() << " on an unvalidated tip");
+
+        m_heldBlocks.push_back(newBlock);
+        m_headerTip = newBlock;
+        m_unvalidatedTips.insert(stringStream.str());
+        m_headerMinedBlocks++;
+
+        UpdateGeneratedBlockStats(m_blockHeadersSizeBytes);
         ScheduleNextMiningEvent();
-        //std::cout<< "MineBlock function : finish MinBLock\n";
+    }
+
+    void
+    BlockchainMiner::ReceivedHeader(const Block &header)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(!m_headerFirstMining)
+        {
+            return;
+        }
+
+        int tipHeight = m_miningOnHeader ? m_headerTip.GetBlockHeight() : m_blockchain.GetCurrentTopBlock()->GetBlockHeight();
+        std::ostringstream stringStream;
+        std::ostringstream parentStream;
+
+        stringStream << header.GetBlockHeight() << "/" << header.GetMinerId();
+        parentStream << header.GetBlockHeight() - 1 << "/" << header.GetParentBlockMinerId();
+
+        if(header.GetBlockHeight() <= tipHeight || m_blockchain.HasBlock(header.GetBlockHeight(), header.GetMinerId()))
+        {
+            return;
+        }
+
+        /*
+         * The header either extends a validated block, which starts a new unvalidated branch,
+         * or the unvalidated branch the miner is already on
+         */
+        if(m_blockchain.HasBlock(header.GetBlockHeight() - 1, header.GetParentBlockMinerId()))
+        {
+            if(m_miningOnHeader)
+            {
+                LeaveHeaderTip();
+            }
+            m_miningOnHeader = true;
+            m_headerTipSwitchTime = Simulator::Now().GetSeconds();
+        }
+        else if(!m_miningOnHeader || m_unvalidatedTips.find(parentStream.str()) == m_unvalidatedTips.end())
+        {
+            return;
+        }
+
+        NS_LOG_INFO("ReceivedHeader: At time " << Simulator::Now().GetSeconds() << "s miner " << GetNode()->GetId()
+                    << " mines on the unvalidated tip " << stringStream.str());
+
+        m_headerTip = header;
+        m_unvalidatedTips.insert(stringStream.str());
+        m_headerTipSwitches++;
+
+        Simulator::Cancel(m_nextMiningEvent);
+        ScheduleNextMiningEvent();
+    }
+
+    void
+    BlockchainMiner::AfterBlockValidation(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::AfterBlockValidation(newBlock);
+
+        if(!newBlock.IsValid())
+        {
+            return;
+        }
+
+        ReleaseHeldBlocks(newBlock);
+        ProcessConfirmedBlocks();
+
+        /*
+         * The unvalidated tip is left once it is validated or the validated chain reaches its height through another branch
+         */
+        if(m_miningOnHeader && (m_blockchain.HasBlock(m_headerTip)
+                                || m_blockchain.GetCurrentTopBlock()->GetBlockHeight() >= m_headerTip.GetBlockHeight()))
+        {
+            LeaveHeaderTip();
+        }
+    }
+
+    void
+    BlockchainMiner::ReceivedInvalidBlock(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::ostringstream stringStream;
+
+        stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
+        DiscardHeldBlocks(newBlock);
+
+        if(m_miningOnHeader && m_unvalidatedTips.find(stringStream.str()) != m_unvalidatedTips.end())
+        {
+            NS_LOG_WARN("ReceivedInvalidBlock: At time " << Simulator::Now().GetSeconds() << "s miner " << GetNode()->GetId()
+                        << " rolls back to its validated top block, the tip " << stringStream.str() << " is invalid");
+
+            m_headerMiningRollbacks++;
+            m_headerMiningInvalidTime += Simulator::Now().GetSeconds() - m_headerTipSwitchTime;
+            LeaveHeaderTip();
+
+            Simulator::Cancel(m_nextMiningEvent);
+            ScheduleNextMiningEvent();
+        }
+    }
+
+    void
+    BlockchainMiner::LeaveHeaderTip(void)
+    {
+        m_headerRiskWindows.AddSample(Simulator::Now().GetSeconds() - m_headerTipSwitchTime);
+        m_miningOnHeader = false;
+        m_unvalidatedTips.clear();
+    }
+
+    void
+    BlockchainMiner::ReleaseHeldBlocks(const Block &parent)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::vector<Block> children;
+
+        for(auto it = m_heldBlocks.begin(); it != m_heldBlocks.end();)
+        {
+            if(it->IsChild(parent))
+            {
+                children.push_back(*it);
+                it = m_heldBlocks.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+
+        for(auto const &child: children)
+        {
+            m_blockchain.AddBlock(child);
+            m_txTracker.BlockAdded(child, Simulator::Now().GetSeconds());
+            AdvertiseNewBlock(child);
+            ReleaseHeldBlocks(child);
+        }
+    }
+
+    void
+    BlockchainMiner::DiscardHeldBlocks(const Block &parent)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::vector<Block> children;
+
+        for(auto it = m_heldBlocks.begin(); it != m_heldBlocks.end();)
+        {
+            if(it->IsChild(parent))
+            {
+                children.push_back(*it);
+                it = m_heldBlocks.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
 
+        for(auto const &child: children)
+        {
+            m_headerMiningDiscardedBlocks++;
+            DiscardHeldBlocks(child);
+        }
     }
 
     void
@@ -450,10 +1039,115 @@ namespace ns3 {
     {
         NS_LOG_FUNCTION(this);
         NS_LOG_WARN("Blockchain miner " << GetNode()->GetId() << " added a new block in the blockchain with higher height");
+
+        if(m_leaderKeyHeight >= 0 && !IsLeader())
+        {
+            StopLeading();
+        }
+
+        /*
+         * A microblock extends the top without changing the key block race: the pending key block is
+         * built on the top of the time it is found. Restarting the race would also starve a fixed interval.
+         */
+        if(newBlock.IsMicroblock())
+        {
+            return;
+        }
+
         Simulator::Cancel(m_nextMiningEvent);
         ScheduleNextMiningEvent();
     }
 
+    void
+    BlockchainMiner::StartLeading(int keyHeight)
+    {
+        NS_LOG_FUNCTION(this << keyHeight);
+
+        Simulator::Cancel(m_nextMicroblockEvent);
+        m_leaderKeyHeight = keyHeight;
+        m_nextMicroblockEvent = Simulator::Schedule(m_microblockInterval, &BlockchainMiner::MineMicroblock, this);
+    }
+
+    void
+    BlockchainMiner::StopLeading(void)
+    {
+        Simulator::Cancel(m_nextMicroblockEvent);
+        m_leaderKeyHeight = -1;
+    }
+
+    bool
+    BlockchainMiner::IsLeader(void)
+    {
+        const Block *block = m_blockchain.GetCurrentTopBlock();
+
+        while(block != nullptr && block->IsMicroblock())
+        {
+            block = m_blockchain.GetParent(*block);
+        }
+
+        return block != nullptr && block->GetBlockHeight() == m_leaderKeyHeight
+                && block->GetMinerId() == static_cast<int>(GetNode()->GetId());
+    }
+
+    void
+    BlockchainMiner::MineMicroblock(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(!IsLeader())
+        {
+            NS_LOG_INFO("MineMicroblock: miner " << GetNode()->GetId() << " is no longer the leader of key block " << m_leaderKeyHeight);
+            StopLeading();
+            return;
+        }
+
+        int height = m_blockchain.GetCurrentTopBlock()->GetBlockHeight() + 1;
+        int minerId = GetNode()->GetId();
+        double currentTime = Simulator::Now().GetSeconds();
+        int maxSize = m_microblockSize > 0 ? m_microblockSize : m_nextBlockSize;
+        int blockSize = m_blockHeadersSizeBytes + m_microblockSignatureSizeBytes;
+
+        m_nextMicroblockEvent = Simulator::Schedule(m_microblockInterval, &BlockchainMiner::MineMicroblock, this);
+
+        if(m_blockchain.HasBlock(height, minerId))
+        {
+            NS_LOG_WARN("MineMicroblock: miner " << minerId << " already has a block at height " << height << ", skips a microblock");
+            return;
+        }
+
+        /*
+         * The microblock is signed by the leader instead of mined, it carries the transactions with the
+         * highest fees and is sized by its content, so the leader streams small blocks at a steady pace
+         */
+        m_mempool.ExpireTransactions(currentTime);
+        ForgetDroppedTransactions();
+        std::vector<Transaction> blockTransactions = m_mempool.GetTransactionsByFee(maxSize - blockSize);
+
+        for(auto &tran: blockTransactions)
+        {
+            tran.SetValidation();
+            m_mempool.RemoveTransaction(tran.GetTransNodeId(), tran.GetTransId());
+            m_totalMining++;
+            m_meanMiningTime = (m_meanMiningTime*static_cast<double>(m_totalMining-1) + (currentTime - tran.GetTransTimeStamp()))/static_cast<double>(m_totalMining);
+            blockSize += tran.GetTransSizeByte();
+        }
+
+        Block newBlock(height, minerId, 0, minerId, blockSize, currentTime, currentTime, Ipv4Address("127.0.0.1"));
+        newBlock.SetMicroblock(true);
+        newBlock.SetTransactions(blockTransactions);
+
+        NS_LOG_INFO("MineMicroblock: At time " << currentTime << "s leader " << minerId << " streamed the microblock "
+                    << height << "/" << minerId << " with " << blockTransactions.size() << " transactions");
+
+        m_blockchain.AddBlock(newBlock);
+        m_txTracker.BlockAdded(newBlock, currentTime);
+        m_txTracker.UpdateConfirmations(m_blockchain, currentTime);
+        AdvertiseNewBlock(newBlock);
+
+        m_microblockHeights.push_back(height);
+        m_generatedMicroblocks++;
+    }
+
     void
     BlockchainMiner::SendBlock(std::string packetInfo, Ptr<Socket> socket)
     {
@@ -475,6 +1169,369 @@ namespace ns3 {
 
     }
 
+    void
+    BlockchainMiner::ProcessConfirmedBlocks(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        int topHeight = m_blockchain.GetCurrentTopBlock()->GetBlockHeight();
+        int minerId = GetNode()->GetId();
+
+        for(auto it = m_unconfirmedBlocks.begin();
+            it != m_unconfirmedBlocks.end() && topHeight - it->first >= static_cast<int>(m_receiptConfirmations);)
+        {
+            /*
+             * Like the other transactions of a stale block, the payments of a stale block are lost
+             */
+            if(!m_blockchain.IsInMainChain(it->first, minerId))
+            {
+                NS_LOG_INFO("ProcessConfirmedBlocks: miner " << minerId << " dropped the " << it->second.size()
+                            << " cross-shard transactions of its stale block " << it->first << "/" << minerId);
+                it = m_unconfirmedBlocks.erase(it);
+                continue;
+            }
+
+            std::map<int, std::vector<Transaction>> receipts;   // key = destination shard
+
+            for(auto const &tran: it->second)
+            {
+                if(tran.GetDestinationShard() == static_cast<int>(m_shard))
+                {
+                    m_crossShardLatencies.AddSample(Simulator::Now().GetSeconds() - tran.GetTransTimeStamp());
+                    m_crossShardTransactions++;
+                }
+                else
+                {
+                    receipts[tran.GetDestinationShard()].push_back(tran);
+                }
+            }
+
+            for(auto const &shard: receipts)
+            {
+                SendReceipts(it->first, shard.first, shard.second);
+            }
+
+            it = m_unconfirmedBlocks.erase(it);
+        }
+    }
+
+    void
+    BlockchainMiner::SendReceipts(int height, int shard, const std::vector<Transaction> &transactions)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(shard >= static_cast<int>(m_shardGateways.size()))
+        {
+            NS_LOG_WARN("SendReceipts: miner " << GetNode()->GetId() << " knows no gateway of shard " << shard);
+            return;
+        }
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+        std::ostringstream stringStream;
+        int gateway = m_shardGateways[shard];
+        int size = m_blockHeadersSizeBytes;
+
+        d.SetObject();
+        stringStream << "receipt/" << height << "/" << GetNode()->GetId() << "/" << shard;
+
+        value = RECEIPT;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+        d.AddMember("id", value, d.GetAllocator());
+
+        value = gateway;
+        d.AddMember("to", value, d.GetAllocator());
+
+        for(auto const &tran: transactions)
+        {
+            rapidjson::Value transInfo(rapidjson::kObjectType);
+
+            value = tran.GetTransNodeId();
+            transInfo.AddMember("nodeId", value, d.GetAllocator());
+
+            value = tran.GetTransId();
+            transInfo.AddMember("transId", value, d.GetAllocator());
+
+            value = tran.GetTransTimeStamp();
+            transInfo.AddMember("timestamp", value, d.GetAllocator());
+
+            value = tran.GetTransFee();
+            transInfo.AddMember("fee", value, d.GetAllocator());
+
+            array.PushBack(transInfo, d.GetAllocator());
+            size += tran.GetTransSizeByte() + m_receiptProofSizeBytes;
+        }
+        d.AddMember("transactions", array, d.GetAllocator());
+
+        /*
+         * The header of the source block and a merkle proof of every payment
+         */
+        value = size;
+        d.AddMember("size", value, d.GetAllocator());
+
+        m_sentReceipts += transactions.size();
+
+        NS_LOG_INFO("SendReceipts: At time " << Simulator::Now().GetSeconds() << "s miner " << GetNode()->GetId()
+                    << " sent " << transactions.size() << " receipts of block " << height << "/" << GetNode()->GetId()
+                    << " to the gateway " << gateway << " of shard " << shard);
+
+        SendConsensusMessage(d, gateway);
+    }
+
+    void
+    BlockchainMiner::ReceivedConsensusMessage(rapidjson::Document &d)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(d["message"].GetInt() != RECEIPT)
+        {
+            BlockchainNode::ReceivedConsensusMessage(d);
+            return;
+        }
+
+        /*
+         * The gateway turns the receipts into transactions of its shard, they are relayed and mined like the others
+         */
+        for(unsigned int j = 0; j < d["transactions"].Size(); j++)
+        {
+            int nodeId = d["transactions"][j]["nodeId"].GetInt();
+            int transId = d["transactions"][j]["transId"].GetInt();
+            Transaction receipt(nodeId, transId, d["transactions"][j]["timestamp"].GetDouble());
+
+            receipt.SetTransFee(d["transactions"][j]["fee"].GetDouble());
+            receipt.SetDestinationShard(m_shard);
+            m_receivedReceipts++;
+
+            if(HasTransaction(nodeId, transId))
+            {
+                continue;
+            }
+
+            m_transaction.insert(getTransactionKey(nodeId, transId));
+
+            bool accepted = m_mempool.AddTransaction(receipt, Simulator::Now().GetSeconds());
+
+            ForgetDroppedTransactions();
+
+            if(accepted)
+            {
+                m_signatureCache.Insert(getTransactionKey(nodeId, transId));
+                AdvertiseNewTransaction(receipt, Ipv4Address::GetAny());
+            }
+        }
+    }
+
+    TypeId
+    BlockchainMiningScheduler::GetTypeId(void)
+    {
+        static TypeId tid = TypeId("ns3::BlockchainMiningScheduler")
+            .SetParent<Object>()
+            .SetGroupName("Application")
+            .AddConstructor<BlockchainMiningScheduler>()
+            ;
+            return tid;
+    }
+
+    BlockchainMiningScheduler::BlockchainMiningScheduler() : m_totalRate(0), m_activeMiners(0)
+    {
+        NS_LOG_FUNCTION(this);
+        m_blockIntervalDistribution = CreateObject<ExponentialRandomVariable>();
+        m_minerDistribution = CreateObject<UniformRandomVariable>();
+    }
+
+    BlockchainMiningScheduler::~BlockchainMiningScheduler(void)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    void
+    BlockchainMiningScheduler::DoDispose(void)
+    {
+        NS_LOG_FUNCTION(this);
+        Simulator::Cancel(m_nextBlockEvent);
+        m_miners.clear();
+        Object::DoDispose();
+    }
+
+    int
+    BlockchainMiningScheduler::AddMiner(BlockchainMiner *miner, double blockRate)
+    {
+        NS_LOG_FUNCTION(this << miner << blockRate);
+
+        int index = m_miners.size();
+        int position = index + 1;
+
+        /*
+         * Appending to a Fenwick tree: the new node covers the range (position - lowbit, position],
+         * whose sum up to the new element is already known from the existing prefixes.
+         */
+        m_miners.push_back(miner);
+        m_rates.push_back(blockRate);
+        m_tree.push_back(blockRate + GetPrefixRate(position - 1) - GetPrefixRate(position - (position & -position)));
+        m_totalRate += blockRate;
+
+        if(blockRate > 0)
+        {
+            m_activeMiners++;
+        }
+
+        ScheduleNextBlock();
+        return index;
+    }
+
+    void
+    BlockchainMiningScheduler::SetMinerRate(int index, double blockRate)
+    {
+        NS_LOG_FUNCTION(this << index << blockRate);
+
+        if(m_rates[index] > 0)
+        {
+            m_activeMiners--;
+        }
+        if(blockRate > 0)
+        {
+            m_activeMiners++;
+        }
+
+        UpdateRate(index, blockRate - m_rates[index]);
+
+        /*
+         * Set the rate exactly, so that a miner toggled off is never drawn again whatever the rounding of the tree
+         */
+        m_rates[index] = blockRate;
+
+        if(m_activeMiners == 0)
+        {
+            m_totalRate = 0;
+        }
+
+        ScheduleNextBlock();
+    }
+
+    double
+    BlockchainMiningScheduler::GetTotalBlockRate(void) const
+    {
+        return m_totalRate;
+    }
+
+    int64_t
+    BlockchainMiningScheduler::AssignStreams(int64_t stream)
+    {
+        NS_LOG_FUNCTION(this << stream);
+        m_blockIntervalDistribution->SetStream(stream);
+        m_minerDistribution->SetStream(stream + 1);
+        return 2;
+    }
+
+    void
+    BlockchainMiningScheduler::ScheduleNextBlock(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        /*
+         * Only called when the set of rates changes (or after a block), so redrawing is both
+         * cheap and, by memorylessness, statistically the same as keeping the pending draw.
+         */
+        Simulator::Cancel(m_nextBlockEvent);
+
+        if(m_totalRate <= 0)
+        {
+            m_totalRate = 0;
+            return;
+        }
+
+        double interval = m_blockIntervalDistribution->GetValue(1 / m_totalRate, 0);
+        m_nextBlockEvent = Simulator::Schedule(Seconds(interval), &BlockchainMiningScheduler::MineNextBlock, this);
+    }
+
+    void
+    BlockchainMiningScheduler::MineNextBlock(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(m_totalRate <= 0)
+        {
+            return;
+        }
+
+        int index = FindMiner(m_minerDistribution->GetValue(0, m_totalRate));
+
+        NS_ASSERT_MSG(m_miners[index] != 0 && m_rates[index] > 0, "The mining scheduler drew the inactive miner " << index);
+        NS_LOG_INFO("At time " << Simulator::Now().GetSeconds() << " s miner " << index << " found the next block");
+        m_miners[index]->MineBlock();
+
+        ScheduleNextBlock();
+    }
+
+    void
+    BlockchainMiningScheduler::UpdateRate(int index, double delta)
+    {
+        m_rates[index] += delta;
+        m_totalRate += delta;
+
+        for(int position = index + 1; position <= static_cast<int>(m_tree.size()); position += position & -position)
+        {
+            m_tree[position - 1] += delta;
+        }
+    }
+
+    double
+    BlockchainMiningScheduler::GetPrefixRate(int count) const
+    {
+        double sum = 0;
+
+        for(int position = count; position > 0; position -= position & -position)
+        {
+            sum += m_tree[position - 1];
+        }
+        return sum;
+    }
+
+    int
+    BlockchainMiningScheduler::FindMiner(double target) const
+    {
+        int position = 0;
+        int step = 1;
+
+        while(step * 2 <= static_cast<int>(m_tree.size()))
+        {
+            step *= 2;
+        }
+
+        for(; step > 0; step /= 2)
+        {
+            if(position + step <= static_cast<int>(m_tree.size()) && m_tree[position + step - 1] <= target)
+            {
+                position += step;
+                target -= m_tree[position - 1];
+            }
+        }
+
+        /*
+         * position is now the number of miners whose cumulative rate is <= target; skip any
+         * inactive miners that floating point rounding could still land on, down first and then up.
+         */
+        int index = std::min(position, static_cast<int>(m_miners.size()) - 1);
+        int active = index;
+
+        while(active >= 0 && m_rates[active] <= 0)
+        {
+            active--;
+        }
+        if(active < 0)
+        {
+            active = index;
+            while(active < static_cast<int>(m_miners.size()) - 1 && m_rates[active] <= 0)
+            {
+                active++;
+            }
+        }
+        return active;
+    }
+
 }
 
 
@@ -487,5 +1544,3 @@ static double GetWallTime()
     }
     return (double)time.tv_sec + (double)time.tv_usec * .000001;
 }
-
-
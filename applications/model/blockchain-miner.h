@@ -2,6 +2,7 @@
 #define BLOCKCHAIN_MINER_H
 
 #include "blockchain-node.h"
+#include "ns3/random-variable-stream.h"
 #include <random>
 #include "../../rapidjson/document.h"
 #include "../../rapidjson/writer.h"
@@ -13,6 +14,7 @@ namespace ns3{
     class Address;
     class Socket;
     class Packet;
+    class BlockchainMiningScheduler;
 
     class BlockchainMiner : public BlockchainNode
     {
@@ -32,17 +34,26 @@ namespace ns3{
 
             void SetFixedBlockSize(uint32_t fixedBlockSize);
 
-            double GetBlockGenBinSize(void) const;
-
-            void SetBlockGenBinSize(double m_blockGenBinSize);
+            double GetHashRate(void) const;
 
-            double GetBlockGenParameter(void) const;
+            void SetHashRate(double hashRate);
 
-            void SetBlockGenParameter(double blockGenParameter);
+            /*
+             * Assign fixed random variable stream numbers to the node and to the block
+             * generation time distribution. Returns the number of streams used.
+             */
+            virtual int64_t AssignStreams(int64_t stream);
 
-            double GetHashRate(void) const;
+            /*
+             * Let a network-wide scheduler decide when this miner finds a block instead
+             * of keeping a per-miner mining event. Ignored with FixedBlockIntervalGeneration.
+             */
+            void SetMiningScheduler(Ptr<BlockchainMiningScheduler> miningScheduler);
 
-            void SetHashRate(double blockGenParameter);
+            /*
+             * The gateway miner of every shard, which receives the receipts paying to its shard
+             */
+            void SetShardGateways(const std::vector<int> &gateways);
 
 
         protected:
@@ -52,6 +63,12 @@ namespace ns3{
 
             virtual void DoDispose(void);
 
+            /*
+             * An offline miner does not mine, it restarts its race when it rejoins
+             */
+            virtual void LeaveNetwork(void);
+            virtual void JoinNetwork(void);
+
             void ScheduleNextMiningEvent (void);
 
             virtual void MineBlock(void);
@@ -60,21 +77,82 @@ namespace ns3{
 
             void SendBlock(std::string packetInfo, Ptr<Socket> socket);
 
+            void UpdateGeneratedBlockStats(int blockSize);
+
+            /*
+             * Draws whether the next block of the miner fails the full validation
+             */
+            bool IsNextBlockInvalid(void);
+
+            /*
+             * Header-first mining: the miner switches to a higher tip once its header is checked,
+             * instead of once the block is downloaded and validated. The blocks it finds meanwhile
+             * are empty and held back until their parent is validated; if the tip turns out invalid
+             * they are discarded and the miner rolls back to its validated top block.
+             */
+            virtual void ReceivedHeader(const Block &header);
+
+            virtual void AfterBlockValidation(const Block &newBlock);
+
+            virtual void ReceivedInvalidBlock(const Block &newBlock);
+
+            void MineBlockOnHeader(void);
+
+            /*
+             * Stops mining on the unvalidated tip and records the risk window
+             */
+            void LeaveHeaderTip(void);
+
+            /*
+             * Adds and announces the held blocks that extend a validated block
+             */
+            void ReleaseHeldBlocks(const Block &parent);
+
+            void DiscardHeldBlocks(const Block &parent);
+
+            /*
+             * Sharding: once a block of the miner is ReceiptConfirmations deep in the main chain, its payments to the
+             * other shards are sent as receipts to their gateways and its receipts complete their cross-shard transactions
+             */
+            void ProcessConfirmedBlocks(void);
+
+            void SendReceipts(int height, int shard, const std::vector<Transaction> &transactions);
+
+            virtual void ReceivedConsensusMessage(rapidjson::Document &d);
+
+            /*
+             * Bitcoin-NG: a key block elects its miner as leader, which then streams signed microblocks
+             * every MicroblockInterval until another key block takes over the main chain
+             */
+            void StartLeading(int keyHeight);
+
+            void StopLeading(void);
+
+            /*
+             * True if the key block of the miner is still the last key block of the main chain
+             */
+            bool IsLeader(void);
+
+            void MineMicroblock(void);
+
+            friend class BlockchainMiningScheduler;
+
             int                         m_noMiners;
             uint32_t                    m_fixedBlockSize;
             double                      m_fixedBlockTimeGeneration;
             EventId                     m_nextMiningEvent;
             std::default_random_engine  m_generator;
 
-            double                      m_blockGenBinSize;
-            double                      m_blockGenParameter;
             double                      m_nextBlockTime;
             double                      m_previousBlockGenerationTime;
             double                      m_minerAverageBlockGenInterval;
             int                         m_minerGeneratedBlocks;
             double                      m_hashRate;
 
-            std::geometric_distribution<int>    m_blockGenTimeDistribution;
+            Ptr<ExponentialRandomVariable>  m_blockGenTimeDistribution;    // time until this miner finds the next block
+            Ptr<UniformRandomVariable>      m_invalidBlockDistribution;    // whether the next block of the miner is invalid
+            Ptr<BlockchainMiningScheduler>  m_miningScheduler;             // shared scheduler, 0 when mining per miner
+            int                             m_miningSchedulerIndex;        // index of the miner in m_miningScheduler
 
             int                         m_nextBlockSize;
             int                         m_maxBlockSize;
@@ -87,11 +165,103 @@ namespace ns3{
 
 
             enum Cryptocurrency  m_cryptocurrency;
+            uint32_t             m_maxUncles;            // uncles referenced per block, ETHEREUM only
+            uint32_t             m_maxUncleDepth;        // generations an uncle can be behind the new block
 
             double  m_timeStart;
             double  m_timeFinish;
             bool    m_fistToMine;
 
+            bool                        m_headerFirstMining;
+            double                      m_invalidBlockRate;     // probability that a block of the miner is invalid
+            bool                        m_miningOnHeader;       // true while mining on a tip that is not validated yet
+            Block                       m_headerTip;            // the unvalidated tip, a received header or a held block
+            double                      m_headerTipSwitchTime;  // the time the miner left its validated top block
+            std::set<std::string>       m_unvalidatedTips;      // the unvalidated blocks of the branch the miner is on
+            std::vector<Block>          m_heldBlocks;           // blocks mined on unvalidated tips, waiting for their parent
+
+            int                         m_headerTipSwitches;
+            int                         m_headerMinedBlocks;
+            int                         m_headerMiningRollbacks;
+            int                         m_headerMiningDiscardedBlocks;
+            double                      m_headerMiningInvalidTime;
+            LatencyHistogram            m_headerRiskWindows;    // switch to an unvalidated tip -> validated, rolled back or left
+
+            std::vector<int>            m_shardGateways;        // the gateway miner of each shard
+            uint32_t                    m_receiptConfirmations; // blocks on top of a block before its receipts are sent
+            const int                   m_receiptProofSizeBytes;    // merkle proof of a payment in its block, 384 Bytes
+            std::map<int, std::vector<Transaction>> m_unconfirmedBlocks;   // key = height of a block of the miner, value = its cross-shard transactions
+
+            long                        m_sentReceipts;
+            long                        m_receivedReceipts;     // receipts received as the gateway of the shard
+            long                        m_crossShardTransactions;
+            LatencyHistogram            m_crossShardLatencies;  // creation in the source shard -> receipt confirmed in the destination shard
+
+            Time                        m_microblockInterval;   // 0 mines plain blocks
+            uint32_t                    m_microblockSize;
+            const int                   m_microblockSignatureSizeBytes; // signature of the leader, 72 Bytes
+            int                         m_leaderKeyHeight;      // height of the key block the miner leads, -1 when it does not lead
+            EventId                     m_nextMicroblockEvent;
+            std::vector<int>            m_microblockHeights;    // heights of the microblocks of the miner
+            int                         m_generatedMicroblocks;
+
+    };
+
+    /*
+     * Draws the mining process of the whole network at once. Since every miner finds
+     * blocks as a Poisson process, the next block of the network comes after an exponential
+     * time with the summed rate and belongs to a miner chosen in proportion to its rate.
+     * Thanks to memorylessness the pending draw stays valid when a miner switches to a new
+     * top block, so the network costs one event per block instead of one per miner.
+     * The rates are kept in a Fenwick tree, so picking the winner takes O(log N).
+     * Only miners of the same process can share a scheduler.
+     */
+    class BlockchainMiningScheduler : public Object
+    {
+        public:
+
+            static TypeId GetTypeId(void);
+            BlockchainMiningScheduler();
+
+            virtual ~BlockchainMiningScheduler(void);
+
+            /*
+             * Registers a miner once, its index stays valid for the whole run
+             */
+            int AddMiner(BlockchainMiner *miner, double blockRate);
+
+            /*
+             * Changes the block rate of a registered miner, 0 while it is offline or stopped
+             */
+            void SetMinerRate(int index, double blockRate);
+
+            double GetTotalBlockRate(void) const;
+
+            int64_t AssignStreams(int64_t stream);
+
+        protected:
+
+            virtual void DoDispose(void);
+
+            void ScheduleNextBlock(void);
+
+            void MineNextBlock(void);
+
+            void UpdateRate(int index, double delta);
+
+            double GetPrefixRate(int count) const;
+
+            int FindMiner(double target) const;
+
+            std::vector<BlockchainMiner*>   m_miners;
+            std::vector<double>             m_rates;
+            std::vector<double>             m_tree;             // Fenwick tree over m_rates, 1-based
+            double                          m_totalRate;
+            int                             m_activeMiners;     // miners with a positive rate
+            EventId                         m_nextBlockEvent;
+
+            Ptr<ExponentialRandomVariable>  m_blockIntervalDistribution;
+            Ptr<UniformRandomVariable>      m_minerDistribution;
     };
 
 }
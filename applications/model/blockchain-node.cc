@@ -20,6 +20,7 @@ namespace ns3 {
 
     NS_LOG_COMPONENT_DEFINE("BlockchainNode");
     NS_OBJECT_ENSURE_REGISTERED(BlockchainNode);
+    NS_OBJECT_ENSURE_REGISTERED(BlockchainFlowNetwork);
 
     TypeId
     BlockchainNode::GetTypeId(void)
@@ -43,6 +44,191 @@ namespace ns3 {
                         TimeValue(Minutes(2)),
                         MakeTimeAccessor(&BlockchainNode::m_invTimeoutMinutes),
                         MakeTimeChecker())
+        .AddAttribute("TransactionSampleRate",
+                        "Track the lifecycle of one out of every n transactions",
+                        UintegerValue(1),
+                        MakeUintegerAccessor(&BlockchainNode::m_transactionSampleRate),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("ConfirmationDepth",
+                        "The number of blocks on top of which a transaction is considered confirmed",
+                        UintegerValue(12),
+                        MakeUintegerAccessor(&BlockchainNode::m_confirmationDepth),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("TransactionRetentionTime",
+                        "The time after its creation for which the lifecycle of a transaction is tracked",
+                        TimeValue(Hours(24)),
+                        MakeTimeAccessor(&BlockchainNode::m_transactionRetentionTime),
+                        MakeTimeChecker())
+        .AddAttribute("MempoolMaxSizeBytes",
+                        "The memory budget of the mempool in bytes",
+                        UintegerValue(300000000),
+                        MakeUintegerAccessor(&BlockchainNode::m_mempoolMaxSizeBytes),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("MempoolExpiry",
+                        "The time after which a transaction is dropped from the mempool (0 disables the expiry)",
+                        TimeValue(Hours(336)),
+                        MakeTimeAccessor(&BlockchainNode::m_mempoolExpiry),
+                        MakeTimeChecker())
+        .AddAttribute("KnownInventoryFilterItems",
+                        "The items per generation of the per-peer known inventory filters (0 disables the filters)",
+                        UintegerValue(5000),
+                        MakeUintegerAccessor(&BlockchainNode::m_knownInventoryFilterItems),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("KnownInventoryFilterFpRate",
+                        "The target false positive rate of the per-peer known inventory filters, in [1e-9, 0.5]",
+                        DoubleValue(0.001),
+                        MakeDoubleAccessor(&BlockchainNode::m_knownInventoryFilterFpRate),
+                        MakeDoubleChecker<double>(1e-9, 0.5))
+        .AddAttribute("KnownInventoryAudit",
+                        "Keep an exact copy of the known inventory to measure the false positives of the filters",
+                        BooleanValue(false),
+                        MakeBooleanAccessor(&BlockchainNode::m_knownInventoryAudit),
+                        MakeBooleanChecker())
+        .AddAttribute("TransactionRelayType",
+                        "PUSH_TRANSACTIONS, ANNOUNCE_TRANSACTIONS",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&BlockchainNode::m_transactionRelayType),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("TransactionInvInterval",
+                        "The interval at which the queued transaction announcements are sent",
+                        TimeValue(Seconds(1)),
+                        MakeTimeAccessor(&BlockchainNode::m_transactionInvInterval),
+                        MakeTimeChecker())
+        .AddAttribute("MaxTransactionsInFlight",
+                        "The maximum number of transactions requested from a peer at the same time",
+                        UintegerValue(100),
+                        MakeUintegerAccessor(&BlockchainNode::m_maxTransactionsInFlight),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("TransactionRequestTimeout",
+                        "The time to wait for a requested transaction before asking another announcer",
+                        TimeValue(Seconds(60)),
+                        MakeTimeAccessor(&BlockchainNode::m_transactionRequestTimeout),
+                        MakeTimeChecker())
+        .AddAttribute("TransactionValidationTime",
+                        "The time to validate a transaction that is not in the signature cache (in seconds)",
+                        DoubleValue(0.00038),
+                        MakeDoubleAccessor(&BlockchainNode::m_transactionValidationTime),
+                        MakeDoubleChecker<double>())
+        .AddAttribute("CachedTransactionValidationTime",
+                        "The time to validate a transaction already verified on mempool entry (in seconds)",
+                        DoubleValue(0.00001),
+                        MakeDoubleAccessor(&BlockchainNode::m_cachedTransactionValidationTime),
+                        MakeDoubleChecker<double>())
+        .AddAttribute("SignatureCacheSize",
+                        "The maximum number of entries of the signature cache",
+                        UintegerValue(100000),
+                        MakeUintegerAccessor(&BlockchainNode::m_signatureCacheSize),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("ForkChoiceRule",
+                        "LONGEST_CHAIN, GHOST, KEY_BLOCKS",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&BlockchainNode::m_forkChoiceRule),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("CpuCores",
+                        "The cores processing the received messages and validating blocks (0 processes them in parallel without limit)",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&BlockchainNode::m_cpuCores),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("MessageProcessingTime",
+                        "The cpu time to parse and dispatch a received message (in seconds)",
+                        DoubleValue(0.0001),
+                        MakeDoubleAccessor(&BlockchainNode::m_messageProcessingTime),
+                        MakeDoubleChecker<double>(0))
+        .AddAttribute("Shard",
+                        "The shard of the node, blocks and transactions are only relayed to the peers of the same shard",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&BlockchainNode::m_shard),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("Shards",
+                        "The number of shards, each one running its own chain on the network",
+                        UintegerValue(1),
+                        MakeUintegerAccessor(&BlockchainNode::m_noShards),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("CrossShardRatio",
+                        "The fraction of the created transactions that pay to another shard",
+                        DoubleValue(0),
+                        MakeDoubleAccessor(&BlockchainNode::m_crossShardRatio),
+                        MakeDoubleChecker<double>(0, 1))
+        .AddAttribute("UploadDiscipline",
+                        "FIFO_UPLOADS, FAIR_SHARE_UPLOADS, PEER_PRIORITY_UPLOADS",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&BlockchainNode::m_uploadDiscipline),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("ChunkSize",
+                        "The size of the chunks of a block relayed with BLOCK_TORRENT in Bytes",
+                        UintegerValue(65536),
+                        MakeUintegerAccessor(&BlockchainNode::m_chunkSizeBytes),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("MaxChunksInFlight",
+                        "The maximum number of chunks of a block requested from a peer at the same time",
+                        UintegerValue(4),
+                        MakeUintegerAccessor(&BlockchainNode::m_maxChunksInFlight),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("MeanSessionLength",
+                        "The mean time the node stays online before leaving the network, 0 disables the churn",
+                        TimeValue(Seconds(0)),
+                        MakeTimeAccessor(&BlockchainNode::m_meanSessionLength),
+                        MakeTimeChecker())
+        .AddAttribute("MeanDowntime",
+                        "The mean time the node stays offline before rejoining the network",
+                        TimeValue(Minutes(10)),
+                        MakeTimeAccessor(&BlockchainNode::m_meanDowntime),
+                        MakeTimeChecker())
+        .AddAttribute("SessionDistribution",
+                        "EXPONENTIAL_SESSIONS, WEIBULL_SESSIONS, PARETO_SESSIONS",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&BlockchainNode::m_sessionDistribution),
+                        MakeUintegerChecker<uint32_t>())
+        .AddAttribute("SessionShape",
+                        "The shape of the Weibull and Pareto session and downtime lengths",
+                        DoubleValue(0.6),
+                        MakeDoubleAccessor(&BlockchainNode::m_sessionShape),
+                        MakeDoubleChecker<double>(0.01))
+        .AddAttribute("MaxHeadersPerMessage",
+                        "The headers sent in answer to a GET_HEADERS with a locator",
+                        UintegerValue(2000),
+                        MakeUintegerAccessor(&BlockchainNode::m_maxHeadersPerMessage),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("MaxBlocksInFlight",
+                        "The blocks requested from one peer at the same time while syncing",
+                        UintegerValue(16),
+                        MakeUintegerAccessor(&BlockchainNode::m_maxBlocksInFlight),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("BlockDownloadWindow",
+                        "The blocks above the lowest missing one that may be requested while syncing",
+                        UintegerValue(1024),
+                        MakeUintegerAccessor(&BlockchainNode::m_blockDownloadWindow),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("BlockStallTimeout",
+                        "The time a peer has to deliver a block requested while syncing before it is requested from another peer",
+                        TimeValue(Seconds(10)),
+                        MakeTimeAccessor(&BlockchainNode::m_blockStallTimeout),
+                        MakeTimeChecker())
+        .AddAttribute("InitialBlockDownload",
+                        "Whether the node syncs the chain of its peers when it starts, for the nodes started late",
+                        BooleanValue(false),
+                        MakeBooleanAccessor(&BlockchainNode::m_initialBlockDownload),
+                        MakeBooleanChecker())
+        .AddAttribute("ConsensusWeight",
+                        "The share of the send queue of a peer for blocks, headers, requests and votes",
+                        UintegerValue(16),
+                        MakeUintegerAccessor(&BlockchainNode::m_consensusWeight),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("InventoryWeight",
+                        "The share of the send queue of a peer for INV and CHUNK_INV announcements",
+                        UintegerValue(4),
+                        MakeUintegerAccessor(&BlockchainNode::m_inventoryWeight),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("BulkWeight",
+                        "The share of the send queue of a peer for transactions",
+                        UintegerValue(1),
+                        MakeUintegerAccessor(&BlockchainNode::m_bulkWeight),
+                        MakeUintegerChecker<uint32_t>(1))
+        .AddAttribute("MaxUnconnectedQueueBytes",
+                        "The bytes queued for a peer that has not connected to the node yet, the messages beyond are dropped",
+                        UintegerValue(1000000),
+                        MakeUintegerAccessor(&BlockchainNode::m_maxUnconnectedQueueBytes),
+                        MakeUintegerChecker<uint32_t>())
         .AddTraceSource("Rx",
                         "A packet has been received",
                         MakeTraceSourceAccessor(&BlockchainNode::m_rxTrace),
@@ -57,6 +243,13 @@ namespace ns3 {
     {
         NS_LOG_FUNCTION(this);
         m_socket = 0;
+        m_transactionLatencies = nullptr;
+        m_feeDistribution = CreateObject<UniformRandomVariable>();
+        m_exponentialSessions = CreateObject<ExponentialRandomVariable>();
+        m_weibullSessions = CreateObject<WeibullRandomVariable>();
+        m_paretoSessions = CreateObject<ParetoRandomVariable>();
+        m_syncPeerDistribution = CreateObject<UniformRandomVariable>();
+        m_crossShardDistribution = CreateObject<UniformRandomVariable>();
         m_meanBlockReceiveTime = 0;
         m_previousBlockReceiveTime = 0;
         m_meanBlockPropagationTime = 0;
@@ -67,6 +260,34 @@ namespace ns3 {
         m_transactionId = 1;
         m_totalMining = 0;
         m_totalCreatedTransaction = 0;
+        m_suppressedBlockAdvertisements = 0;
+        m_suppressedTransactionSends = 0;
+        m_inventoryFalsePositives = 0;
+        m_inventoryNegativeQueries = 0;
+        m_startTime = 0;
+        m_committedEndorsedBlocks = 0;
+        m_committedEndorsedTransactions = 0;
+        m_cpuBusyTime = 0;
+        m_invalidBlocks = 0;
+        m_chunkedBlocksReceived = 0;
+        m_chunksReceived = 0;
+        m_duplicateChunks = 0;
+        m_unconnectedDroppedBytes = 0;
+        m_cpuQueueingTimes = LatencyHistogram(0.00001, 100000, 0.05);
+        m_uploading = false;
+        m_uploadQueueingTimes = LatencyHistogram(0.00001, 100000, 0.05);
+        m_sendQueueingTimes = std::vector<LatencyHistogram>(SendQueue::PRIORITY_CLASSES, LatencyHistogram(0.00001, 100000, 0.05));
+        m_online = true;
+        m_leaveTime = 0;
+        m_departures = 0;
+        m_offlineTime = 0;
+        m_syncing = false;
+        m_syncHeadersDone = false;
+        m_syncStartTime = 0;
+        m_syncStartBytes = 0;
+        m_catchUpTimes = LatencyHistogram(0.00001, 100000, 0.05);
+        m_catchUpBytes = 0;
+        m_syncRequestTimeouts = 0;
     }
 
     BlockchainNode::~BlockchainNode(void)
@@ -133,11 +354,63 @@ namespace ns3 {
         m_protocolType = protocolType;
     }
 
+    void
+    BlockchainNode::SetPeersNodeIds(const std::map<Ipv4Address, uint32_t> &peersNodeIds)
+    {
+        NS_LOG_FUNCTION(this);
+        m_peersNodeIds = peersNodeIds;
+    }
+
+    void
+    BlockchainNode::SetPeersShards(const std::map<Ipv4Address, uint32_t> &peersShards)
+    {
+        NS_LOG_FUNCTION(this);
+        m_peersShards = peersShards;
+    }
+
+    void
+    BlockchainNode::SetFlowNetwork(Ptr<BlockchainFlowNetwork> flowNetwork)
+    {
+        NS_LOG_FUNCTION(this);
+        m_flowNetwork = flowNetwork;
+    }
+
+    int64_t
+    BlockchainNode::AssignStreams(int64_t stream)
+    {
+        NS_LOG_FUNCTION(this << stream);
+        m_feeDistribution->SetStream(stream);
+
+        /*
+         * A run draws its sessions from one of the three distributions, so they share a stream
+         */
+        m_exponentialSessions->SetStream(stream + 1);
+        m_weibullSessions->SetStream(stream + 1);
+        m_paretoSessions->SetStream(stream + 1);
+        m_syncPeerDistribution->SetStream(stream + 2);
+        m_crossShardDistribution->SetStream(stream + 3);
+        return 4;
+    }
+
+    void
+    BlockchainNode::SetTransactionLatencies(TransactionLatencies *transactionLatencies)
+    {
+        NS_LOG_FUNCTION(this);
+        m_transactionLatencies = transactionLatencies;
+    }
+
     void
     BlockchainNode::DoDispose(void)
     {
         NS_LOG_FUNCTION(this);
         m_socket = 0;
+        m_flowNetwork = 0;
+        m_feeDistribution = 0;
+        m_exponentialSessions = 0;
+        m_weibullSessions = 0;
+        m_paretoSessions = 0;
+        m_syncPeerDistribution = 0;
+        m_crossShardDistribution = 0;
 
         Application::DoDispose();
     }
@@ -160,12 +433,15 @@ namespace ns3 {
             NS_LOG_INFO("\t" << *it);
         }
 
-        if(!m_socket)
+        if(m_flowNetwork != 0)
+        {
+            m_flowNetwork->AddNode(this);
+        }
+        else if(!m_socket)
         {
             m_socket = Socket::CreateSocket(GetNode(), m_tid);
             m_socket->Bind(m_local);
             m_socket->Listen();
-            m_socket->ShutdownSend();
             if(addressUtils::IsMulticast(m_local))
             {
                 Ptr<UdpSocket> udpSocket = DynamicCast<UdpSocket> (m_socket);
@@ -180,17 +456,28 @@ namespace ns3 {
             }
         }
 
-        m_socket->SetRecvCallback(MakeCallback(&BlockchainNode::HandleRead, this));
-        m_socket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address &>(),
-                                    MakeCallback(&BlockchainNode::HandleAccept, this));
-        m_socket->SetCloseCallbacks(MakeCallback(&BlockchainNode::HandlePeerClose, this),
-                                    MakeCallback(&BlockchainNode::HandlePeerError, this));
+        if(m_socket)
+        {
+            m_socket->SetRecvCallback(MakeCallback(&BlockchainNode::HandleRead, this));
+            m_socket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address &>(),
+                                        MakeCallback(&BlockchainNode::HandleAccept, this));
+            m_socket->SetCloseCallbacks(MakeCallback(&BlockchainNode::HandlePeerClose, this),
+                                        MakeCallback(&BlockchainNode::HandlePeerError, this));
+        }
         
         NS_LOG_DEBUG("Node" << GetNode()->GetId() << ":Before creating sockets");
         for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
         {
-            m_peersSockets[*i] = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
-            m_peersSockets[*i]->Connect(InetSocketAddress(*i, m_blockchainPort));
+            if(m_flowNetwork == 0 && ConnectsToPeer(*i))
+            {
+                ConnectToPeer(*i);
+            }
+
+            if(m_knownInventoryFilterItems > 0)
+            {
+                m_peersKnownBlocks[*i] = RollingBloomFilter(m_knownInventoryFilterItems, m_knownInventoryFilterFpRate);
+                m_peersKnownTransactions[*i] = RollingBloomFilter(m_knownInventoryFilterItems, m_knownInventoryFilterFpRate);
+            }
         }
         NS_LOG_DEBUG("Node" << GetNode()->GetId()<<": After creating sockets");
 
@@ -220,6 +507,123 @@ namespace ns3 {
         m_nodeStats->blockTimeouts = 0;
         m_nodeStats->meanMiningTime = 0;
         m_nodeStats->meanLatency = 0;
+        m_nodeStats->meanTransactionConfirmTime = 0;
+        m_nodeStats->nodeGeneratedTransaction = 0;
+        m_nodeStats->trackedTransactions = 0;
+        m_nodeStats->meanTransactionFirstSeenTime = 0;
+        m_nodeStats->meanTransactionInclusionTime = 0;
+        m_nodeStats->transactionInclusionTimeP50 = 0;
+        m_nodeStats->transactionInclusionTimeP90 = 0;
+        m_nodeStats->transactionInclusionTimeP99 = 0;
+        m_nodeStats->transactionConfirmTimeP50 = 0;
+        m_nodeStats->transactionConfirmTimeP90 = 0;
+        m_nodeStats->transactionConfirmTimeP99 = 0;
+
+        m_txTracker.SetSampleRate(m_transactionSampleRate);
+        m_txTracker.SetConfirmationDepth(m_confirmationDepth);
+        m_txTracker.SetRetentionTime(m_transactionRetentionTime.GetSeconds());
+
+        m_nodeStats->mempoolRejectedTransactions = 0;
+        m_nodeStats->mempoolEvictedTransactions = 0;
+        m_nodeStats->mempoolExpiredTransactions = 0;
+        m_nodeStats->mempoolPeakSizeBytes = 0;
+        m_nodeStats->suppressedBlockAdvertisements = 0;
+        m_nodeStats->suppressedTransactionSends = 0;
+        m_nodeStats->inventoryFilterFalsePositives = 0;
+        m_nodeStats->inventoryFilterEstimatedFpRate = 0;
+        m_nodeStats->inventoryFilterMeasuredFpRate = 0;
+        m_nodeStats->transactionReceivedBytes = 0;
+        m_nodeStats->transactionSentBytes = 0;
+        m_nodeStats->duplicateTransactionReceivedBytes = 0;
+        m_nodeStats->transactionRequestTimeouts = 0;
+        m_nodeStats->signatureCacheHits = 0;
+        m_nodeStats->signatureCacheMisses = 0;
+        m_nodeStats->minedBlocksInMainChain = 0;
+        m_nodeStats->unclesInMainChain = 0;
+        m_nodeStats->consensusReceivedBytes = 0;
+        m_nodeStats->consensusSentBytes = 0;
+        m_nodeStats->committedBlocks = 0;
+        m_nodeStats->committedTransactions = 0;
+        m_nodeStats->committedTransactionsPerSecond = 0;
+        m_nodeStats->meanFinalityTime = 0;
+        m_nodeStats->finalityTimeP50 = 0;
+        m_nodeStats->finalityTimeP90 = 0;
+        m_nodeStats->viewChanges = 0;
+        m_nodeStats->executedProposals = 0;
+        m_nodeStats->endorserUtilization = 0;
+        m_nodeStats->submittedTransactions = 0;
+        m_nodeStats->meanEndorsementTime = 0;
+        m_nodeStats->orderedBlocks = 0;
+        m_nodeStats->orderedTransactions = 0;
+        m_nodeStats->batchTimeouts = 0;
+        m_nodeStats->cpuUtilization = 0;
+        m_nodeStats->invalidBlocks = 0;
+        m_nodeStats->chunkedBlocks = 0;
+        m_nodeStats->chunksReceived = 0;
+        m_nodeStats->duplicateChunks = 0;
+        m_nodeStats->peakSendQueueBytes = 0;
+        m_nodeStats->meanConsensusSendQueueingTime = 0;
+        m_nodeStats->meanBulkSendQueueingTime = 0;
+        m_nodeStats->departures = 0;
+        m_nodeStats->catchUps = 0;
+        m_nodeStats->meanCatchUpTime = 0;
+        m_nodeStats->catchUpTimeP90 = 0;
+        m_nodeStats->catchUpReceivedBytes = 0;
+        m_nodeStats->offlineTime = 0;
+        m_nodeStats->syncRequestTimeouts = 0;
+        m_nodeStats->syncServingPeers = 0;
+        m_nodeStats->mainChainTransactions = 0;
+        m_nodeStats->headerTipSwitches = 0;
+        m_nodeStats->headerMinedBlocks = 0;
+        m_nodeStats->headerMiningRollbacks = 0;
+        m_nodeStats->headerMiningDiscardedBlocks = 0;
+        m_nodeStats->meanHeaderRiskWindow = 0;
+        m_nodeStats->headerMiningInvalidTime = 0;
+        m_nodeStats->slots = 0;
+        m_nodeStats->missedSlots = 0;
+        m_nodeStats->finalizedEpochs = 0;
+        m_nodeStats->shard = m_shard;
+        m_nodeStats->sentReceipts = 0;
+        m_nodeStats->crossShardTransactions = 0;
+        m_nodeStats->meanCrossShardLatency = 0;
+        m_nodeStats->crossShardLatencyP90 = 0;
+        m_nodeStats->microblocks = 0;
+        m_nodeStats->generatedMicroblocks = 0;
+        m_nodeStats->staleMicroblocks = 0;
+        m_nodeStats->meanCpuQueueingTime = 0;
+        m_nodeStats->cpuQueueingTimeP99 = 0;
+        m_nodeStats->meanUploadQueueingTime = 0;
+        m_nodeStats->uploadQueueingTimeP99 = 0;
+        m_nodeStats->peakPendingUploads = 0;
+        m_nodeStats->peakConcurrentDownloads = 0;
+        m_startTime = Simulator::Now().GetSeconds();
+        m_coreFreeTimes.assign(m_cpuCores, m_startTime);
+
+        m_signatureCache.SetMaxEntries(m_signatureCacheSize);
+        m_blockchain.SetForkChoiceRule(m_forkChoiceRule);
+
+        /*
+         * With PEER_PRIORITY_UPLOADS the peers with the fastest downlink are served first, they relay the blocks on sooner
+         */
+        m_uploadScheduler.SetDiscipline(m_uploadDiscipline);
+        m_downloadLink.SetCapacity(m_downloadSpeed);
+        for(auto const &peer: m_peersAddresses)
+        {
+            m_uploadScheduler.SetPeerPriority(peer, m_peersDownloadSpeeds[peer]);
+        }
+
+        m_mempool.SetMaxSizeBytes(m_mempoolMaxSizeBytes);
+        m_mempool.SetExpiryTime(m_mempoolExpiry.GetSeconds());
+
+        if(m_meanSessionLength > Seconds(0))
+        {
+            m_churnEvent = Simulator::Schedule(Seconds(GetSessionLength(m_meanSessionLength)), &BlockchainNode::LeaveNetwork, this);
+        }
+
+        if(m_initialBlockDownload)
+        {
+            StartSync();
+        }
 
         CreateTransaction();
         //ScheduleNextTransaction();
@@ -230,9 +634,18 @@ namespace ns3 {
     {
         NS_LOG_FUNCTION(this);
 
-        for(std::vector<Ipv4Address>::iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+        /*
+         * Close may call the close callbacks at once, which would erase the socket under the loop
+         */
+        for(auto &peerSocket : m_peersSockets)
+        {
+            peerSocket.second->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket>>(), MakeNullCallback<void, Ptr<Socket>>());
+            peerSocket.second->Close();
+        }
+
+        if(m_flowNetwork != 0)
         {
-            m_peersSockets[*i]->Close();
+            m_flowNetwork->RemoveNode(GetNode()->GetId());
         }
 
         if(m_socket)
@@ -242,6 +655,16 @@ namespace ns3 {
         }
 
         Simulator::Cancel(m_nextTransaction);
+        Simulator::Cancel(m_transactionInvEvent);
+        Simulator::Cancel(m_uploadEvent);
+        Simulator::Cancel(m_downloadEvent);
+        Simulator::Cancel(m_churnEvent);
+        Simulator::Cancel(m_syncStallEvent);
+
+        for(auto &request: m_transactionsInFlight)
+        {
+            Simulator::Cancel(request.second.second);
+        }
 
         NS_LOG_WARN("\n\nBLOCKCHAIN NODE " <<GetNode()->GetId() << ":");
         //NS_LOG_WARN("Current Top Block is \n"<<*(m_blockchain.GetCurrentTopBlock()));
@@ -254,15 +677,152 @@ namespace ns3 {
         NS_LOG_WARN("Mean Block Size = " << m_meanBlockSize << "Bytes");
         NS_LOG_WARN("Total Block = " << m_blockchain.GetTotalBlocks());
         NS_LOG_WARN("Received But Not Validataed size : " << m_receivedNotValidated.size());
-        NS_LOG_WARN("m_sendBlockTime size = " <<m_receiveBlockTimes.size());
+        NS_LOG_WARN("Block downloads in progress = " << m_downloadLink.GetActiveTransfers());
+        NS_LOG_WARN("Blocks received in chunks = " << m_chunkedBlocksReceived << ", chunks = " << m_chunksReceived
+                    << " (" << m_duplicateChunks << " duplicates), blocks still incomplete = " << m_chunkedBlocks.size());
 
         m_nodeStats->meanBlockReceiveTime = m_meanBlockReceiveTime;
         m_nodeStats->meanBlockPropagationTime = m_meanBlockPropagationTime;
         m_nodeStats->meanBlockSize = m_meanBlockSize;
         m_nodeStats->totalBlocks = m_blockchain.GetTotalBlocks();
+        m_nodeStats->microblocks = m_blockchain.GetTotalMicroblocks();
+        m_nodeStats->meanUploadQueueingTime = m_uploadQueueingTimes.GetMean();
+        m_nodeStats->uploadQueueingTimeP99 = m_uploadQueueingTimes.GetPercentile(99);
+        m_nodeStats->peakPendingUploads = m_uploadScheduler.GetPeakPendingUploads();
+        m_nodeStats->peakConcurrentDownloads = m_downloadLink.GetPeakActiveTransfers();
+        m_nodeStats->longestFork = m_blockchain.GetLongestForkSize();
+        m_nodeStats->blocksInForks = m_blockchain.GetBlocksInForks();
+        m_nodeStats->minedBlocksInMainChain = m_blockchain.GetMinedBlocksInMainChain(GetNode()->GetId());
+        m_nodeStats->unclesInMainChain = m_blockchain.GetUnclesInMainChain();
+        m_nodeStats->invalidBlocks = m_invalidBlocks;
+        m_nodeStats->chunkedBlocks = m_chunkedBlocksReceived;
+        m_nodeStats->chunksReceived = m_chunksReceived;
+        m_nodeStats->duplicateChunks = m_duplicateChunks;
+
+        NS_LOG_INFO("Bytes dropped for peers that had not connected = " << m_unconnectedDroppedBytes);
+
+        for(auto const &peer: m_peersPeakSendQueueBytes)
+        {
+            NS_LOG_INFO("Peak send queue to " << peer.first << " = " << peer.second << " Bytes, "
+                        << GetSendQueueBytes(peer.first) << " Bytes left at stop");
+            m_nodeStats->peakSendQueueBytes = std::max(m_nodeStats->peakSendQueueBytes, static_cast<long>(peer.second));
+        }
+
+        for(int priority = 0; priority < SendQueue::PRIORITY_CLASSES; priority++)
+        {
+            NS_LOG_WARN("Send queueing time of " << getMessagePriority(static_cast<enum MessagePriority>(priority)) << " mean/p99 = "
+                        << m_sendQueueingTimes[priority].GetMean() << "/" << m_sendQueueingTimes[priority].GetPercentile(99) << "s");
+        }
+        m_nodeStats->meanConsensusSendQueueingTime = m_sendQueueingTimes[CONSENSUS_PRIORITY].GetMean();
+        m_nodeStats->meanBulkSendQueueingTime = m_sendQueueingTimes[BULK_PRIORITY].GetMean();
+        m_nodeStats->mainChainTransactions = m_blockchain.GetTransactionsInMainChain();
         m_nodeStats->meanMiningTime = m_meanMiningTime;
         m_nodeStats->meanLatency = m_meanLatency;
-        
+
+        const LatencyHistogram &inclusionTimes = m_txTracker.GetInclusionTimes();
+        const LatencyHistogram &confirmationTimes = m_txTracker.GetConfirmationTimes();
+
+        NS_LOG_WARN("Tracked Transactions = " << m_txTracker.GetTrackedTransactions());
+        NS_LOG_WARN("Transaction Inclusion Time p50/p90/p99 = " << inclusionTimes.GetPercentile(50) << "/"
+                    << inclusionTimes.GetPercentile(90) << "/" << inclusionTimes.GetPercentile(99) << "s");
+        NS_LOG_WARN("Transaction Confirmation Time (" << m_txTracker.GetConfirmationDepth() << " blocks) p50/p90/p99 = "
+                    << confirmationTimes.GetPercentile(50) << "/" << confirmationTimes.GetPercentile(90) << "/"
+                    << confirmationTimes.GetPercentile(99) << "s");
+
+        m_nodeStats->nodeGeneratedTransaction = m_transactionId - 1;
+        m_nodeStats->trackedTransactions = m_txTracker.GetTrackedTransactions();
+        m_nodeStats->meanTransactionFirstSeenTime = m_txTracker.GetFirstSeenTimes().GetMean();
+        m_nodeStats->meanTransactionInclusionTime = inclusionTimes.GetMean();
+        m_nodeStats->meanTransactionConfirmTime = confirmationTimes.GetMean();
+
+        if(m_transactionLatencies != nullptr)
+        {
+            m_transactionLatencies->firstSeenTimes.Merge(m_txTracker.GetFirstSeenTimes());
+            m_transactionLatencies->inclusionTimes.Merge(inclusionTimes);
+            m_transactionLatencies->confirmationTimes.Merge(confirmationTimes);
+        }
+        m_nodeStats->transactionInclusionTimeP50 = inclusionTimes.GetPercentile(50);
+        m_nodeStats->transactionInclusionTimeP90 = inclusionTimes.GetPercentile(90);
+        m_nodeStats->transactionInclusionTimeP99 = inclusionTimes.GetPercentile(99);
+        m_nodeStats->transactionConfirmTimeP50 = confirmationTimes.GetPercentile(50);
+        m_nodeStats->transactionConfirmTimeP90 = confirmationTimes.GetPercentile(90);
+        m_nodeStats->transactionConfirmTimeP99 = confirmationTimes.GetPercentile(99);
+
+        NS_LOG_WARN("Mempool size = " << m_mempool.GetSize() << " transactions (" << m_mempool.GetSizeBytes() << " Bytes)"
+                    << ", rejected = " << m_mempool.GetRejectedTransactions() << ", evicted = " << m_mempool.GetEvictedTransactions()
+                    << ", expired = " << m_mempool.GetExpiredTransactions());
+
+        m_nodeStats->mempoolRejectedTransactions = m_mempool.GetRejectedTransactions();
+        m_nodeStats->mempoolEvictedTransactions = m_mempool.GetEvictedTransactions();
+        m_nodeStats->mempoolExpiredTransactions = m_mempool.GetExpiredTransactions();
+        m_nodeStats->mempoolPeakSizeBytes = m_mempool.GetPeakSizeBytes();
+
+        double estimatedFpRate = 0;
+
+        for(auto const &filter: m_peersKnownTransactions)
+        {
+            estimatedFpRate += filter.second.GetFalsePositiveRate()/m_peersKnownTransactions.size();
+        }
+
+        NS_LOG_WARN("Suppressed block advertisements = " << m_suppressedBlockAdvertisements
+                    << ", suppressed transaction sends = " << m_suppressedTransactionSends
+                    << ", known inventory false positives = " << m_inventoryFalsePositives << "/" << m_inventoryNegativeQueries);
+
+        m_nodeStats->suppressedBlockAdvertisements = m_suppressedBlockAdvertisements;
+        m_nodeStats->suppressedTransactionSends = m_suppressedTransactionSends;
+        m_nodeStats->inventoryFilterFalsePositives = m_inventoryFalsePositives;
+        m_nodeStats->inventoryFilterEstimatedFpRate = estimatedFpRate;
+        m_nodeStats->inventoryFilterMeasuredFpRate = m_inventoryNegativeQueries > 0 ? m_inventoryFalsePositives/static_cast<double>(m_inventoryNegativeQueries) : 0;
+
+        if(m_cpuCores > 0)
+        {
+            double duration = Simulator::Now().GetSeconds() - m_startTime;
+
+            NS_LOG_WARN("Cpu busy time = " << m_cpuBusyTime << "s on " << m_cpuCores << " cores, queueing time mean/p99 = "
+                        << m_cpuQueueingTimes.GetMean() << "/" << m_cpuQueueingTimes.GetPercentile(99) << "s");
+
+            m_nodeStats->cpuUtilization = duration > 0 ? std::min(m_cpuBusyTime / (m_cpuCores * duration), 1.0) : 0;
+            m_nodeStats->meanCpuQueueingTime = m_cpuQueueingTimes.GetMean();
+            m_nodeStats->cpuQueueingTimeP99 = m_cpuQueueingTimes.GetPercentile(99);
+        }
+
+        if(m_committedEndorsedBlocks > 0)
+        {
+            double duration = Simulator::Now().GetSeconds() - m_startTime;
+
+            NS_LOG_WARN("Committed " << m_committedEndorsedBlocks << " ordered blocks with " << m_committedEndorsedTransactions
+                        << " endorsed transactions. End-to-end time mean/p50/p90 = " << m_endToEndTimes.GetMean() << "/"
+                        << m_endToEndTimes.GetPercentile(50) << "/" << m_endToEndTimes.GetPercentile(90) << "s");
+
+            m_nodeStats->committedBlocks = m_committedEndorsedBlocks;
+            m_nodeStats->committedTransactions = m_committedEndorsedTransactions;
+            m_nodeStats->committedTransactionsPerSecond = duration > 0 ? m_committedEndorsedTransactions / duration : 0;
+            m_nodeStats->meanFinalityTime = m_endToEndTimes.GetMean();
+            m_nodeStats->finalityTimeP50 = m_endToEndTimes.GetPercentile(50);
+            m_nodeStats->finalityTimeP90 = m_endToEndTimes.GetPercentile(90);
+        }
+
+        if(m_meanSessionLength > Seconds(0) || m_initialBlockDownload)
+        {
+            if(!m_online)
+            {
+                m_offlineTime += Simulator::Now().GetSeconds() - m_leaveTime;
+            }
+
+            NS_LOG_WARN("Churn: left the network " << m_departures << " times, offline for " << m_offlineTime << "s, caught up "
+                        << m_catchUpTimes.GetCount() << " times in " << m_catchUpTimes.GetMean() << "s and "
+                        << (m_catchUpTimes.GetCount() > 0 ? m_catchUpBytes / m_catchUpTimes.GetCount() : 0) << " Bytes on average"
+                        << (m_syncing ? ", still syncing" : "") << ", " << m_syncRequestTimeouts << " block requests expired");
+
+            m_nodeStats->departures = m_departures;
+            m_nodeStats->catchUps = m_catchUpTimes.GetCount();
+            m_nodeStats->meanCatchUpTime = m_catchUpTimes.GetMean();
+            m_nodeStats->catchUpTimeP90 = m_catchUpTimes.GetPercentile(90);
+            m_nodeStats->catchUpReceivedBytes = m_catchUpBytes;
+            m_nodeStats->offlineTime = m_offlineTime;
+            m_nodeStats->syncRequestTimeouts = m_syncRequestTimeouts;
+            m_nodeStats->syncServingPeers = m_syncServedPeers.size();
+        }
     }
 
     void
@@ -305,576 +865,713 @@ namespace ns3 {
                 {
                     parsedPacket = totalReceivedData.substr(0,pos);
                     NS_LOG_INFO("Node " << GetNode()->GetId() << " Parsed Packet: " << parsedPacket);
-                    
-                    rapidjson::Document d;
-                    d.Parse(parsedPacket.c_str());
 
-                    if(!d.IsObject())
-                    {
-                        NS_LOG_WARN("The parsed packet is corrupted");
-                        totalReceivedData.erase(0, pos + delimiter.length());
-                        continue;
-                    }
+                    HandleMessage(parsedPacket, from);
+                    totalReceivedData.erase(0, pos + delimiter.length());
+                }
 
-                    rapidjson::StringBuffer buffer;
-                    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-                    d.Accept(writer);
+                m_bufferedData[from] = totalReceivedData;
+                delete[] packetInfo;
 
-                    NS_LOG_INFO("At time " << Simulator::Now().GetSeconds()
-                                << "s Blockchain node " << GetNode()->GetId() << " received"
-                                << InetSocketAddress::ConvertFrom(from).GetIpv4()
-                                << " port " << InetSocketAddress::ConvertFrom(from).GetPort()
-                                << " with info = " << buffer.GetString());
+            }
+            else if(InetSocketAddress::IsMatchingType(from))
+            {
+                NS_LOG_INFO("At time " << Simulator::Now().GetSeconds()
+                            << " s blockchain node " << GetNode()->GetId() << " received"
+                            << packet->GetSize() << " bytes from"
+                            << Inet6SocketAddress::ConvertFrom(from).GetIpv6()
+                            << " port" << Inet6SocketAddress::ConvertFrom(from).GetPort());
+            }
+            m_rxTrace(packet, from);
+        }
+        
+    }
 
-                    switch(d["message"].GetInt())
-                    {
-                        case INV:
-                        {
-                            NS_LOG_INFO("INV");
-                            unsigned int j;
-                            std::vector<std::string>            requestBlocks;
-                            std::vector<std::string>::iterator  block_it;
+    void
+    BlockchainNode::HandleMessage(const std::string &message, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
 
-                            m_nodeStats->invReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes; 
-                            
+        std::shared_ptr<rapidjson::Document> document = std::make_shared<rapidjson::Document>();
+        rapidjson::Document &d = *document;
 
-                            for(j = 0; j < d["inv"].Size() ; j++)
-                            {
-                                std::string invDelimiter = "/";
-                                std::string parsedInv = d["inv"][j].GetString();
-                                size_t invPos = parsedInv.find(invDelimiter);
-                                EventId timeout;
-
-                                int height = atoi(parsedInv.substr(0, invPos).c_str());
-                                int minerId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
-
-                                if(m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId) || ReceivedButNotValidated(parsedInv))
-                                {
-                                    /*std::cout<<"INV : Blockchain node " << GetNode()->GetId()
-                                                << " has already received the block with height = "
-                                                << height << " and minerId = " << minerId << "\n";*/
-                                    NS_LOG_INFO("INV : Blockchain node " << GetNode()->GetId()
-                                                << " has already received the block with height = "
-                                                << height << " and minerId = " << minerId);
-                                }
-                                else
-                                {
-                                    /*std::cout<<"INV : Blockchain node " << GetNode()->GetId()
-                                                << " does not have the block with height = "
-                                                << height << " and minerId = " << minerId << "\n";*/
-                                    NS_LOG_INFO("INV : Blockchain node " << GetNode()->GetId()
-                                                << " does not have the block with height = "
-                                                << height << " and minerId = " << minerId);
-
-                                    /*
-                                     * check if we have already requested the block
-                                     */
-                                    if(m_invTimeouts.find(parsedInv) == m_invTimeouts.end())
-                                    {
-                                        /*std::cout<<"INV: Blockchain node " << GetNode()->GetId()
-                                                    << " has not requested the block yet" << "\n";*/
-                                        NS_LOG_INFO("INV: Blockchain node " << GetNode()->GetId()
-                                                    << " has not requested the block yet");
-                                        requestBlocks.push_back(parsedInv);
-                                        timeout = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::InvTimeoutExpired, this, parsedInv);
-                                        m_invTimeouts[parsedInv] = timeout;
-                                    }
-                                    else
-                                    {
-                                        NS_LOG_INFO("INV : Blockchain node " << GetNode()->GetId()
-                                                    << " has already requested the block");
-                                    }
-
-                                    m_queueInv[parsedInv].push_back(from);
-                                }
-                            }
+        d.Parse(message.c_str());
 
-                            
-                            if(!requestBlocks.empty())
-                            {
-                                rapidjson::Value value;
-                                rapidjson::Value array(rapidjson::kArrayType);
-                                d.RemoveMember("inv");
+        if(!d.IsObject())
+        {
+            NS_LOG_WARN("The parsed packet is corrupted");
+            return;
+        }
 
-                                for(block_it = requestBlocks.begin(); block_it < requestBlocks.end(); block_it++)
-                                {
-                                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
-                                    array.PushBack(value, d.GetAllocator());
-                                }
+        if(!m_online)
+        {
+            NS_LOG_INFO("Blockchain node " << GetNode()->GetId() << " is offline and drops a "
+                        << getMessageName(static_cast<enum Messages>(d["message"].GetInt())) << " message");
+            return;
+        }
 
-                                d.AddMember("blocks", array, d.GetAllocator());
+        NS_LOG_INFO("At time " << Simulator::Now().GetSeconds()
+                    << "s Blockchain node " << GetNode()->GetId() << " received"
+                    << InetSocketAddress::ConvertFrom(from).GetIpv4()
+                    << " port " << InetSocketAddress::ConvertFrom(from).GetPort()
+                    << " with info = " << message);
 
-                                SendMessage(INV, GET_HEADERS, d, from );
-                                SendMessage(INV, GET_DATA, d, from );
-                            }
-                            
-                            break;
-                        }
-                        case TRANSACTION:
-                        {
-                            NS_LOG_INFO("TRANSACTION");
-                            //std::cout<< GetNode()->GetId() << "received transaction\n";
-                            unsigned int j;
-                            std::vector<Transaction>            requestTransactions;
-                            std::vector<Transaction>::iterator  trans_it;
+        if(m_cpuCores == 0)
+        {
+            ProcessMessage(d, from);
+        }
+        else
+        {
+            Simulator::Schedule(Seconds(ScheduleMessageProcessing(d, from)), &BlockchainNode::ProcessQueuedMessage, this, document, from);
+        }
+    }
 
-                            m_nodeStats->getDataReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["transactions"].Size()*m_inventorySizeBytes;
+    void
+    BlockchainNode::ProcessQueuedMessage(std::shared_ptr<rapidjson::Document> d, Address from)
+    {
+        NS_LOG_FUNCTION(this);
 
-                            for(j = 0; j < d["transactions"].Size(); j++)
-                            {
-                                int nodeId = d["transactions"][j]["nodeId"].GetInt();
-                                int transId = d["transactions"][j]["transId"].GetInt();
-                                int timestamp = d["transactions"][j]["timestamp"].GetDouble();
-                            
-                                if(HasTransaction(nodeId, transId))
-                                {
-                                    NS_LOG_INFO("TRANSACTION: Blockchain node " << GetNode()->GetId()
-                                                << " has the transaction nodeID: " << nodeId
-                                                << " and transId = " << transId);
-                                }
-                                else
-                                {
-                                    Transaction newTrans(nodeId, transId, timestamp);
-                                    m_transaction.push_back(newTrans);
-                                    m_notValidatedTransaction.push_back(newTrans);
-
-                                    AdvertiseNewTransaction(newTrans, InetSocketAddress::ConvertFrom(from).GetIpv4());
-                                }
-                                
-                            }
+        if(m_online)
+        {
+            ProcessMessage(*d, from);
+        }
+    }
 
-                            break;
-                        }
-                        case GET_HEADERS:
-                        {
-                            unsigned int j;
-                            std::vector<Block>              requestHeaders;
-                            std::vector<Block>::iterator    block_it;
+    void
+    BlockchainNode::ProcessMessage(rapidjson::Document &d, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        switch(d["message"].GetInt())
+        {
+            case INV:
+            {
+                NS_LOG_INFO("INV");
+                unsigned int j;
+                std::vector<std::string>            requestBlocks;
+                std::vector<std::string>::iterator  block_it;
 
-                            m_nodeStats->getHeadersReceivedBytes += m_blockchainMessageHeader + m_getHeaderSizeBytes;
+                m_nodeStats->invReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes; 
 
-                            for(j =0 ; j < d["blocks"].Size(); j++)
-                            {
-                                std::string invDelimiter = "/";
-                                std::string blockHash = d["blocks"][j].GetString();
-                                size_t      invPos = blockHash.find(invDelimiter);
-
-                                int height = atoi(blockHash.substr(0, invPos).c_str());
-                                int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
-
-                                if(m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId))
-                                {
-                                    /*std::cout<<"GET_HEADERS: Blockchain node " << GetNode()->GetId()
-                                                << " has the block with height = " << height
-                                                << " and minerId = " << minerId << "\n";*/
-                                    
-                                    NS_LOG_INFO("GET_HEADERS: Blockchain node " << GetNode()->GetId()
-                                                << " has the block with height = " << height
-                                                << " and minerId = " << minerId);
-                                    Block newBlock(m_blockchain.ReturnBlock(height, minerId));
-                                    requestHeaders.push_back(newBlock);
-
-                                } 
-                                else if (ReceivedButNotValidated(blockHash))
-                                {
-                                    /*std::cout<<"GET_HEADERS: Blockchain node " << GetNode()->GetId()
-                                                << " has received but not yet validated the block with height = "
-                                                << height << " and minerId = " << minerId << "\n";*/
-                                    
-                                    NS_LOG_INFO("GET_HEADERS: Blockchain node " << GetNode()->GetId()
-                                                << " has received but not yet validated the block with height = "
-                                                << height << " and minerId = " << minerId);
-                                    requestHeaders.push_back(m_receivedNotValidated[blockHash]);
-                                }
-                                else
-                                {
-                                    NS_LOG_INFO("GET_HEADERS: Blockchain node " << GetNode()->GetId()
-                                                << " does not have the full block with height = "
-                                                << height << " and minerId = " << minerId);
-                                }
-                            }
+                if(std::string(d["type"].GetString()) == "transaction")
+                {
+                    ReceivedTransactionInv(d, from);
+                    break;
+                }
 
-                            if(!requestHeaders.empty())
-                            {
-                                rapidjson::Value value;
-                                rapidjson::Value array(rapidjson::kArrayType);
 
-                                d.RemoveMember("blocks");
+                for(j = 0; j < d["inv"].Size() ; j++)
+                {
+                    std::string invDelimiter = "/";
+                    std::string parsedInv = d["inv"][j].GetString();
+                    size_t invPos = parsedInv.find(invDelimiter);
+                    EventId timeout;
+
+                    int height = atoi(parsedInv.substr(0, invPos).c_str());
+                    int minerId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
+
+                    MarkBlockAnnounced(InetSocketAddress::ConvertFrom(from).GetIpv4(), parsedInv);
+
+                    if(m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId) || ReceivedButNotValidated(parsedInv)
+                        || IsSyncPending(parsedInv))
+                    {
+                        /*std::cout<<"INV : Blockchain node " << GetNode()->GetId()
+                                    << " has already received the block with height = "
+                                    << height << " and minerId = " << minerId << "\n";*/
+                        NS_LOG_INFO("INV : Blockchain node " << GetNode()->GetId()
+                                    << " has already received the block with height = "
+                                    << height << " and minerId = " << minerId);
+                    }
+                    else
+                    {
+                        /*std::cout<<"INV : Blockchain node " << GetNode()->GetId()
+                                    << " does not have the block with height = "
+                                    << height << " and minerId = " << minerId << "\n";*/
+                        NS_LOG_INFO("INV : Blockchain node " << GetNode()->GetId()
+                                    << " does not have the block with height = "
+                                    << height << " and minerId = " << minerId);
+
+                        /*
+                         * check if we have already requested the block
+                         */
+                        if(m_invTimeouts.find(parsedInv) == m_invTimeouts.end())
+                        {
+                            /*std::cout<<"INV: Blockchain node " << GetNode()->GetId()
+                                        << " has not requested the block yet" << "\n";*/
+                            NS_LOG_INFO("INV: Blockchain node " << GetNode()->GetId()
+                                        << " has not requested the block yet");
+                            requestBlocks.push_back(parsedInv);
+                            timeout = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::InvTimeoutExpired, this, parsedInv);
+                            m_invTimeouts[parsedInv] = timeout;
+                        }
+                        else
+                        {
+                            NS_LOG_INFO("INV : Blockchain node " << GetNode()->GetId()
+                                        << " has already requested the block");
+                        }
+
+                        m_queueInv[parsedInv].push_back(from);
+                    }
+                }
 
-                                for(block_it = requestHeaders.begin() ; block_it < requestHeaders.end(); block_it++)
-                                {
-                                    rapidjson::Value blockInfo(rapidjson::kObjectType);
-                                    //NS_LOG_INFO("In requestHeaders " << *block_it);
 
-                                    value = block_it->GetBlockHeight();
-                                    blockInfo.AddMember("height", value, d.GetAllocator());
-                                    
-                                    value = block_it->GetMinerId();
-                                    blockInfo.AddMember("minerId", value, d.GetAllocator());
+                if(!requestBlocks.empty())
+                {
+                    rapidjson::Value value;
+                    rapidjson::Value array(rapidjson::kArrayType);
+                    d.RemoveMember("inv");
 
-                                    value = block_it->GetNonce();
-                                    blockInfo.AddMember("nonce", value, d.GetAllocator());
+                    for(block_it = requestBlocks.begin(); block_it < requestBlocks.end(); block_it++)
+                    {
+                        value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                        array.PushBack(value, d.GetAllocator());
+                    }
 
-                                    value = block_it->GetParentBlockMinerId();
-                                    blockInfo.AddMember("parentBlockMinerId", value, d.GetAllocator());
+                    d.AddMember("blocks", array, d.GetAllocator());
 
-                                    value = block_it->GetBlockSizeBytes();
-                                    blockInfo.AddMember("size", value, d.GetAllocator());
+                    SendMessage(INV, GET_HEADERS, d, from );
+                    SendMessage(INV, GET_DATA, d, from );
+                }
 
-                                    value = block_it->GetTimeStamp();
-                                    blockInfo.AddMember("timeStamp", value, d.GetAllocator());
+                break;
+            }
+            case TRANSACTION:
+            {
+                NS_LOG_INFO("TRANSACTION");
+                //std::cout<< GetNode()->GetId() << "received transaction\n";
+                unsigned int j;
+                std::vector<Transaction>            requestTransactions;
+                std::vector<Transaction>::iterator  trans_it;
 
-                                    value = block_it->GetTimeReceived();
-                                    blockInfo.AddMember("timeReceived", value, d.GetAllocator());
+                m_nodeStats->transactionReceivedBytes += m_blockchainMessageHeader + m_countBytes;
 
-                                    array.PushBack(blockInfo, d.GetAllocator());
-                                
-                                }
+                for(j = 0; j < d["transactions"].Size(); j++)
+                {
+                    int nodeId = d["transactions"][j]["nodeId"].GetInt();
+                    int transId = d["transactions"][j]["transId"].GetInt();
+                    double timestamp = d["transactions"][j]["timestamp"].GetDouble();
+                    double fee = d["transactions"][j]["fee"].GetDouble();
+                    Transaction newTrans(nodeId, transId, timestamp);
+
+                    newTrans.SetTransFee(fee);
+                    if(d["transactions"][j].HasMember("shard"))
+                    {
+                        newTrans.SetDestinationShard(d["transactions"][j]["shard"].GetInt());
+                    }
+                    m_nodeStats->transactionReceivedBytes += newTrans.GetTransSizeByte();
+                    MarkTransactionKnown(InetSocketAddress::ConvertFrom(from).GetIpv4(), nodeId, transId);
+                    TransactionRequestCompleted(getTransactionKey(nodeId, transId));
 
-                                d.AddMember("blocks", array, d.GetAllocator());
+                    if(HasTransaction(nodeId, transId))
+                    {
+                        NS_LOG_INFO("TRANSACTION: Blockchain node " << GetNode()->GetId()
+                                    << " has the transaction nodeID: " << nodeId
+                                    << " and transId = " << transId);
+                        m_nodeStats->duplicateTransactionReceivedBytes += newTrans.GetTransSizeByte();
+                    }
+                    else
+                    {
+                        m_transaction.insert(getTransactionKey(nodeId, transId));
+                        m_txTracker.TransactionSeen(newTrans, Simulator::Now().GetSeconds());
 
-                                SendMessage(GET_HEADERS, HEADERS, d, from);
+                        bool accepted = m_mempool.AddTransaction(newTrans, Simulator::Now().GetSeconds());
 
-                            }
+                        ForgetDroppedTransactions();
 
-                            break;
+                        if(accepted)
+                        {
+                            m_signatureCache.Insert(getTransactionKey(nodeId, transId));
+                            AdvertiseNewTransaction(newTrans, InetSocketAddress::ConvertFrom(from).GetIpv4());
                         }
-                        case HEADERS:
+                        else
                         {
-                            
-                            NS_LOG_INFO("HEADERS");
+                            NS_LOG_INFO("TRANSACTION: Blockchain node " << GetNode()->GetId()
+                                        << " rejected the transaction nodeID: " << nodeId
+                                        << " and transId = " << transId << " because the mempool is full");
+                        }
+                    }
 
-                            std::vector<std::string>        requestHeaders;
-                            std::vector<std::string>        requestBlocks;
-                            std::vector<std::string>::iterator  block_it;
-                            unsigned int j;
+                }
 
-                            m_nodeStats->headersReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["blocks"].Size()*m_headersSizeBytes;
+                RequestTransactions(InetSocketAddress::ConvertFrom(from).GetIpv4());
+                break;
+            }
+            case GET_HEADERS:
+            {
+                unsigned int j;
+                std::vector<Block>              requestHeaders;
+                std::vector<Block>::iterator    block_it;
 
-                            for(j = 0; j <d["blocks"].Size(); j++)
-                            {
-                                int parentHeight = d["blocks"][j]["height"].GetInt() - 1;
-                                int parentMinerId = d["blocks"][j]["parentBlockMinerId"].GetInt();
-                                int height = d["blocks"][j]["height"].GetInt();
-                                int minerId = d["blocks"][j]["minerId"].GetInt();
-
-                                EventId         timeout;
-                                std::stringstream   stringStream;
-                                std::string         blockHash;
-                                std::string         parentBlockHash;
-
-                                stringStream << height << "/" << minerId;
-                                blockHash = stringStream.str();
-                                Block newBlockHeaders(d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["nonce"].GetInt()
-                                                    , d["blocks"][j]["parentBlockMinerId"].GetInt(), d["blocks"][j]["size"].GetInt()
-                                                    , d["blocks"][j]["timeStamp"].GetDouble(), Simulator::Now().GetSeconds(), InetSocketAddress::ConvertFrom(from).GetIpv4());
-
-                                m_onlyHeadersReceived[blockHash] = Block(d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["nonce"].GetInt()
-                                                                        , d["blocks"][j]["parentBlockMinerId"].GetInt(), d["blocks"][j]["size"].GetInt()
-                                                                        , d["blocks"][j]["timeStamp"].GetDouble(), Simulator::Now().GetSeconds(), InetSocketAddress::ConvertFrom(from).GetIpv4());
-
-                                stringStream.clear();
-                                stringStream.str("");
-
-                                stringStream << parentHeight << "/" << parentMinerId;
-                                parentBlockHash = stringStream.str();
-
-                                if (!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId) && !ReceivedButNotValidated(parentBlockHash))
-                                {
-                                    /*std::cout<<"The Block with height  = " << d["blocks"][j]["height"].GetInt()
-                                                << " and minerID = " << d["blocks"][j]["minerId"].GetInt()
-                                                << " is an orphan\n" << "\n";*/
-                                    
-                                    NS_LOG_INFO("The Block with height  = " << d["blocks"][j]["height"].GetInt()
-                                                << " and minerID = " << d["blocks"][j]["minerId"].GetInt()
-                                                << " is an orphan\n");
-                                    
-                                    if(m_invTimeouts.find(parentBlockHash) == m_invTimeouts.end())
-                                    {
-                                        NS_LOG_INFO("HEADERS : Blockchain node " << GetNode()->GetId()
-                                                    << " has not requested its parent block yet");
-                                        if(!OnlyHeadersReceived(parentBlockHash))
-                                        {
-                                            requestHeaders.push_back(parentBlockHash.c_str());
-                                        }
-                                        timeout = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::InvTimeoutExpired, this, parentBlockHash);
-                                        m_invTimeouts[parentBlockHash] = timeout;
-
-                                    }
-                                    else
-                                    {
-                                        NS_LOG_INFO("HEADERS: Blockchain node " << GetNode()->GetId()
-                                                    << "has already requested the block");
-                                    }
-
-                                    m_queueInv[parentBlockHash].push_back(from);
-
-                                }
-                                else
-                                {
-                                    /*std::cout<<"The Block with height = " << d["blocks"][j]["height"].GetInt()
-                                                << " and minerId = " << d["blocks"][j]["minerId"].GetInt()
-                                                << " is NOT an orphan\n";*/
-                                    
-                                    NS_LOG_INFO("The Block with height = " << d["blocks"][j]["height"].GetInt()
-                                                << " and minerId = " << d["blocks"][j]["minerId"].GetInt()
-                                                << " is NOT an orphan\n");
-                                }
-                            }
+                m_nodeStats->getHeadersReceivedBytes += m_blockchainMessageHeader + m_getHeaderSizeBytes;
 
-                            if(!requestHeaders.empty())
-                            {
-                                rapidjson::Value        value;
-                                rapidjson::Value        array(rapidjson::kArrayType);
-                                Time                    timeout;
+                if(d.HasMember("locator"))
+                {
+                    SendSyncHeaders(d, from);
+                    break;
+                }
 
-                                d.RemoveMember("blocks");
+                for(j =0 ; j < d["blocks"].Size(); j++)
+                {
+                    std::string invDelimiter = "/";
+                    std::string blockHash = d["blocks"][j].GetString();
+                    size_t      invPos = blockHash.find(invDelimiter);
 
-                                for(block_it = requestHeaders.begin(); block_it < requestHeaders.end(); block_it++)
-                                {
-                                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
-                                    array.PushBack(value, d.GetAllocator());
-                                }
+                    int height = atoi(blockHash.substr(0, invPos).c_str());
+                    int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
 
-                                d.AddMember("blocks", array, d.GetAllocator());
+                    if(m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId))
+                    {
+                        /*std::cout<<"GET_HEADERS: Blockchain node " << GetNode()->GetId()
+                                    << " has the block with height = " << height
+                                    << " and minerId = " << minerId << "\n";*/
+
+                        NS_LOG_INFO("GET_HEADERS: Blockchain node " << GetNode()->GetId()
+                                    << " has the block with height = " << height
+                                    << " and minerId = " << minerId);
+                        Block newBlock(m_blockchain.ReturnBlock(height, minerId));
+                        requestHeaders.push_back(newBlock);
+
+                    } 
+                    else if (ReceivedButNotValidated(blockHash))
+                    {
+                        /*std::cout<<"GET_HEADERS: Blockchain node " << GetNode()->GetId()
+                                    << " has received but not yet validated the block with height = "
+                                    << height << " and minerId = " << minerId << "\n";*/
+
+                        NS_LOG_INFO("GET_HEADERS: Blockchain node " << GetNode()->GetId()
+                                    << " has received but not yet validated the block with height = "
+                                    << height << " and minerId = " << minerId);
+                        requestHeaders.push_back(m_receivedNotValidated[blockHash]);
+                    }
+                    else
+                    {
+                        NS_LOG_INFO("GET_HEADERS: Blockchain node " << GetNode()->GetId()
+                                    << " does not have the full block with height = "
+                                    << height << " and minerId = " << minerId);
+                    }
+                }
 
-                                SendMessage(HEADERS, GET_HEADERS, d, from);
-                                SendMessage(HEADERS, GET_DATA, d, from);
-                            }
+                if(!requestHeaders.empty())
+                {
+                    rapidjson::Value value;
+                    rapidjson::Value array(rapidjson::kArrayType);
 
-                            if(!requestBlocks.empty())
-                            {
-                                rapidjson::Value        value;
-                                rapidjson::Value        array(rapidjson::kArrayType);
-                                Time                    timeout;
+                    d.RemoveMember("blocks");
 
-                                d.RemoveMember("blocks");
+                    for(block_it = requestHeaders.begin() ; block_it < requestHeaders.end(); block_it++)
+                    {
+                        rapidjson::Value blockInfo(rapidjson::kObjectType);
+                        //NS_LOG_INFO("In requestHeaders " << *block_it);
 
-                                for(block_it = requestBlocks.begin(); block_it < requestBlocks.end(); block_it++)
-                                {
-                                    value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
-                                    array.PushBack(value, d.GetAllocator());
-                                }
+                        value = block_it->GetBlockHeight();
+                        blockInfo.AddMember("height", value, d.GetAllocator());
 
-                                d.AddMember("blocks", array, d.GetAllocator());
+                        value = block_it->GetMinerId();
+                        blockInfo.AddMember("minerId", value, d.GetAllocator());
 
-                                SendMessage(HEADERS, GET_DATA, d, from);
-                            }
-                            break;
-                        }
-                        case GET_DATA:
-                        {
-                            NS_LOG_INFO("GET_DATA");
-                            unsigned int j;
-                            int totalBlockMessageSize = 0;
-                            std::vector<Block>                      requestBlocks;
-                            std::vector<Block>::iterator            block_it;
-                            std::vector<Transaction>::iterator      trans_it;
+                        value = block_it->GetNonce();
+                        blockInfo.AddMember("nonce", value, d.GetAllocator());
 
-                            m_nodeStats->getDataReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["blocks"].Size()*m_inventorySizeBytes;
+                        value = block_it->GetParentBlockMinerId();
+                        blockInfo.AddMember("parentBlockMinerId", value, d.GetAllocator());
 
-                            for(j=0; j < d["blocks"].Size(); j++)
-                            {
-                                std::string     invDelimiter = "/";
-                                std::string     parsedInv = d["blocks"][j].GetString();
-                                size_t          invPos = parsedInv.find(invDelimiter);
-
-                                int height = atoi(parsedInv.substr(0, invPos).c_str());
-                                int minerId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
-
-                                if(m_blockchain.HasBlock(height, minerId))
-                                {
-                                    NS_LOG_INFO("GET_DATA : Blockchain node " << GetNode()->GetId()
-                                                << " has the block with height = " << height
-                                                << " and minerId = " << minerId);
-                                    Block newBlock(m_blockchain.ReturnBlock(height, minerId));
-                                    requestBlocks.push_back(newBlock);
-                                }
-                                else
-                                {
-                                    NS_LOG_INFO("GET_DATA : Blockchain node " << GetNode()->GetId()
-                                                << " does not have the block with height = " << height
-                                                << " and minerId = " << minerId);
-                                }
+                        value = block_it->GetBlockSizeBytes();
+                        blockInfo.AddMember("size", value, d.GetAllocator());
 
-                            }
+                        value = block_it->GetTimeStamp();
+                        blockInfo.AddMember("timeStamp", value, d.GetAllocator());
 
-                            if(!requestBlocks.empty())
-                            {
-                                rapidjson::Value value;
-                                rapidjson::Value array(rapidjson::kArrayType);
-                                rapidjson::Value tranArray(rapidjson::kArrayType);
-                                std::vector<Transaction> requestTransactions;
-
-                                d.RemoveMember("blocks");
-
-                                for(block_it = requestBlocks.begin() ; block_it < requestBlocks.end(); block_it++)
-                                {
-                                    //block_it->PrintAllTransaction();
-                                    requestTransactions = block_it->GetTransactions();
-                                    rapidjson::Value blockInfo(rapidjson::kObjectType);
-                                    
-                                    value = block_it->GetBlockHeight();
-                                    blockInfo.AddMember("height", value, d.GetAllocator());
-                                    
-                                    value = block_it->GetMinerId();
-                                    blockInfo.AddMember("minerId", value, d.GetAllocator());
-
-                                    value = block_it->GetNonce();
-                                    blockInfo.AddMember("nonce", value, d.GetAllocator());
-
-                                    value = block_it->GetParentBlockMinerId();
-                                    blockInfo.AddMember("parentBlockMinerId", value, d.GetAllocator());
-
-                                    value = block_it->GetBlockSizeBytes();
-                                    blockInfo.AddMember("size", value, d.GetAllocator());
-
-                                    value = block_it->GetTimeStamp();
-                                    blockInfo.AddMember("timeStamp", value, d.GetAllocator());
-
-                                    value = block_it->GetTimeReceived();
-                                    blockInfo.AddMember("timeReceived", value, d.GetAllocator());
-
-                                    for(trans_it = requestTransactions.begin(); trans_it < requestTransactions.end(); trans_it++)
-                                    {
-                                        //std::cout<<"node " << GetNode()->GetId()<<" add transaction\n";
-                                        rapidjson::Value transInfo(rapidjson::kObjectType);
-                                        
-                                        value = trans_it->GetTransNodeId();
-                                        transInfo.AddMember("nodeId", value, d.GetAllocator());
-
-                                        value = trans_it->GetTransId();
-                                        transInfo.AddMember("transId", value, d.GetAllocator());
-
-                                        value = trans_it->GetTransTimeStamp();
-                                        transInfo.AddMember("timestamp", value, d.GetAllocator());
-
-                                        tranArray.PushBack(transInfo, d.GetAllocator());
-
-                                    }
-                                    blockInfo.AddMember("transactions", tranArray, d.GetAllocator());
-
-                                    array.PushBack(blockInfo, d.GetAllocator());
-                                }
-
-                                d.AddMember("blocks", array, d.GetAllocator());
-
-                                double sendTime = totalBlockMessageSize/m_uploadSpeed;
-                                double eventTime;
-
-                                if(m_sendBlockTimes.size() == 0 || Simulator::Now().GetSeconds() > m_sendBlockTimes.back())
-                                {
-                                    eventTime = 0;
-                                }
-                                else
-                                {
-                                    eventTime = m_sendBlockTimes.back() - Simulator::Now().GetSeconds();
-                                }
-
-                                m_sendBlockTimes.push_back(Simulator::Now().GetSeconds()+eventTime + sendTime);
-
-                                NS_LOG_INFO("Node " << GetNode()->GetId() << " will start sending the block to "
-                                            << InetSocketAddress::ConvertFrom(from).GetIpv4()
-                                            << " at " << Simulator::Now().GetSeconds() + eventTime << "\n");
-                                
-                                rapidjson::StringBuffer packetInfo;
-                                rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-                                d.Accept(writer);
-                                std::string packet = packetInfo.GetString();
-                                NS_LOG_INFO("DEBUG: " << packetInfo.GetString());
-
-                                Simulator::Schedule (Seconds(eventTime), &BlockchainNode::SendBlock, this, packet, from);
-                                Simulator::Schedule (Seconds(eventTime + sendTime), &BlockchainNode::RemoveSendTime, this);
-                            }
+                        value = block_it->GetTimeReceived();
+                        blockInfo.AddMember("timeReceived", value, d.GetAllocator());
 
-                            break;
-                        }            
-                        case BLOCK:
+                        if(block_it->IsMicroblock())
                         {
-                            NS_LOG_INFO("BLOCK");
-                            int blockMessageSize = 0;
-                            double receiveTime;
-                            double eventTime = 0;
-                            double minSpeed = std::min(m_downloadSpeed, m_peersUploadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4()]*1000000/8);
+                            value = true;
+                            blockInfo.AddMember("microblock", value, d.GetAllocator());
+                        }
 
-                            blockMessageSize += m_blockchainMessageHeader;
-                            
+                        array.PushBack(blockInfo, d.GetAllocator());
 
-                            for(unsigned int j = 0; j < d["blocks"].Size(); j++)
-                            {
-                                blockMessageSize += d["blocks"][j]["size"].GetInt();
-                            }
+                    }
 
-                    
-                            m_nodeStats->blockReceivedBytes += blockMessageSize;
+                    d.AddMember("blocks", array, d.GetAllocator());
 
-                            rapidjson::StringBuffer blockInfo;
-                            rapidjson::Writer<rapidjson::StringBuffer> blockWriter(blockInfo);
-                            d.Accept(blockWriter);
-                            /*
-                            if(GetNode()->GetId() == 10)
-                            {
-                                std::cout<<"BLOCK: At time " << Simulator::Now().GetSeconds()
-                                        << " Node " << GetNode()->GetId()
-                                        << " received a block message " << blockInfo.GetString() << "\n";
-                            }
-                            */
-                            
-                            NS_LOG_INFO("BLOCK: At time " << Simulator::Now().GetSeconds()
-                                        << " Node " << GetNode()->GetId()
-                                        << " received a block message " << blockInfo.GetString());
-                            NS_LOG_INFO(m_downloadSpeed << " " 
-                                        << m_peersUploadSpeeds[InetSocketAddress::ConvertFrom(from). GetIpv4()] * 1000000/8 << " " << minSpeed);
+                    SendMessage(GET_HEADERS, HEADERS, d, from);
 
-                            std::string help = blockInfo.GetString();
+                }
 
-                            if(m_receiveBlockTimes.size() == 0 || Simulator::Now().GetSeconds() > m_receiveBlockTimes.back())
-                            {
-                                receiveTime = blockMessageSize / m_downloadSpeed;
-                                eventTime = blockMessageSize / minSpeed;
-                            }
-                            else
-                            {
-                                receiveTime = blockMessageSize / m_downloadSpeed + m_receiveBlockTimes.back() - Simulator::Now().GetSeconds();
-                                eventTime = blockMessageSize / minSpeed + m_receiveBlockTimes.back() - Simulator::Now().GetSeconds();
-                            }
+                break;
+            }
+            case HEADERS:
+            {
 
-                            m_receiveBlockTimes.push_back(Simulator::Now().GetSeconds()+receiveTime);
+                NS_LOG_INFO("HEADERS");
 
-                            Simulator::Schedule(Seconds(eventTime), &BlockchainNode::ReceivedBlockMessage, this, help, from);
-                            Simulator::Schedule(Seconds(receiveTime), &BlockchainNode::RemoveReceiveTime, this);
-                            NS_LOG_INFO("BLOCK: Node " << GetNode()->GetId() << " will receive the full block message at "
-                                        << Simulator::Now().GetSeconds() + eventTime);
+                std::vector<std::string>        requestHeaders;
+                std::vector<std::string>        requestBlocks;
+                std::vector<std::string>::iterator  block_it;
+                unsigned int j;
 
-                            break;
-                        }
-                        default:
-                        {
-                            NS_LOG_INFO("Default");
-                            break;
-                        }
-                        
+                m_nodeStats->headersReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["blocks"].Size()*m_headersSizeBytes;
+
+                if(d.HasMember("sync"))
+                {
+                    ReceivedSyncHeaders(d, from);
+                    break;
+                }
+
+                for(j = 0; j <d["blocks"].Size(); j++)
+                {
+                    int parentHeight = d["blocks"][j]["height"].GetInt() - 1;
+                    int parentMinerId = d["blocks"][j]["parentBlockMinerId"].GetInt();
+                    int height = d["blocks"][j]["height"].GetInt();
+                    int minerId = d["blocks"][j]["minerId"].GetInt();
+
+                    EventId         timeout;
+                    std::stringstream   stringStream;
+                    std::string         blockHash;
+                    std::string         parentBlockHash;
+
+                    stringStream << height << "/" << minerId;
+                    blockHash = stringStream.str();
+                    MarkBlockAnnounced(InetSocketAddress::ConvertFrom(from).GetIpv4(), blockHash);
+                    Block newBlockHeaders(d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["nonce"].GetInt()
+                                        , d["blocks"][j]["parentBlockMinerId"].GetInt(), d["blocks"][j]["size"].GetInt()
+                                        , d["blocks"][j]["timeStamp"].GetDouble(), Simulator::Now().GetSeconds(), InetSocketAddress::ConvertFrom(from).GetIpv4());
+
+                    m_onlyHeadersReceived[blockHash] = Block(d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["nonce"].GetInt()
+                                                            , d["blocks"][j]["parentBlockMinerId"].GetInt(), d["blocks"][j]["size"].GetInt()
+                                                            , d["blocks"][j]["timeStamp"].GetDouble(), Simulator::Now().GetSeconds(), InetSocketAddress::ConvertFrom(from).GetIpv4());
+
+                    if(d["blocks"][j].HasMember("microblock"))
+                    {
+                        newBlockHeaders.SetMicroblock(true);
+                        m_onlyHeadersReceived[blockHash].SetMicroblock(true);
                     }
 
-                    totalReceivedData.erase(0, pos + delimiter.length());
+                    stringStream.clear();
+                    stringStream.str("");
 
-                }
+                    stringStream << parentHeight << "/" << parentMinerId;
+                    parentBlockHash = stringStream.str();
 
-                m_bufferedData[from] = totalReceivedData;
-                delete[] packetInfo;
+                    if (!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId) && !ReceivedButNotValidated(parentBlockHash))
+                    {
+                        /*std::cout<<"The Block with height  = " << d["blocks"][j]["height"].GetInt()
+                                    << " and minerID = " << d["blocks"][j]["minerId"].GetInt()
+                                    << " is an orphan\n" << "\n";*/
 
+                        NS_LOG_INFO("The Block with height  = " << d["blocks"][j]["height"].GetInt()
+                                    << " and minerID = " << d["blocks"][j]["minerId"].GetInt()
+                                    << " is an orphan\n");
+
+                        if(m_invTimeouts.find(parentBlockHash) == m_invTimeouts.end())
+                        {
+                            NS_LOG_INFO("HEADERS : Blockchain node " << GetNode()->GetId()
+                                        << " has not requested its parent block yet");
+                            if(!OnlyHeadersReceived(parentBlockHash))
+                            {
+                                requestHeaders.push_back(parentBlockHash.c_str());
+                            }
+                            timeout = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::InvTimeoutExpired, this, parentBlockHash);
+                            m_invTimeouts[parentBlockHash] = timeout;
+
+                        }
+                        else
+                        {
+                            NS_LOG_INFO("HEADERS: Blockchain node " << GetNode()->GetId()
+                                        << "has already requested the block");
+                        }
+
+                        m_queueInv[parentBlockHash].push_back(from);
+
+                    }
+                    else
+                    {
+                        /*std::cout<<"The Block with height = " << d["blocks"][j]["height"].GetInt()
+                                    << " and minerId = " << d["blocks"][j]["minerId"].GetInt()
+                                    << " is NOT an orphan\n";*/
+
+                        NS_LOG_INFO("The Block with height = " << d["blocks"][j]["height"].GetInt()
+                                    << " and minerId = " << d["blocks"][j]["minerId"].GetInt()
+                                    << " is NOT an orphan\n");
+                        ReceivedHeader(newBlockHeaders);
+                    }
+                }
+
+                if(!requestHeaders.empty())
+                {
+                    rapidjson::Value        value;
+                    rapidjson::Value        array(rapidjson::kArrayType);
+                    Time                    timeout;
+
+                    d.RemoveMember("blocks");
+
+                    for(block_it = requestHeaders.begin(); block_it < requestHeaders.end(); block_it++)
+                    {
+                        value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                        array.PushBack(value, d.GetAllocator());
+                    }
+
+                    d.AddMember("blocks", array, d.GetAllocator());
+
+                    SendMessage(HEADERS, GET_HEADERS, d, from);
+                    SendMessage(HEADERS, GET_DATA, d, from);
+                }
+
+                if(!requestBlocks.empty())
+                {
+                    rapidjson::Value        value;
+                    rapidjson::Value        array(rapidjson::kArrayType);
+                    Time                    timeout;
+
+                    d.RemoveMember("blocks");
+
+                    for(block_it = requestBlocks.begin(); block_it < requestBlocks.end(); block_it++)
+                    {
+                        value.SetString(block_it->c_str(), block_it->size(), d.GetAllocator());
+                        array.PushBack(value, d.GetAllocator());
+                    }
+
+                    d.AddMember("blocks", array, d.GetAllocator());
+
+                    SendMessage(HEADERS, GET_DATA, d, from);
+                }
+                break;
             }
-            else if(InetSocketAddress::IsMatchingType(from))
-            {
-                NS_LOG_INFO("At time " << Simulator::Now().GetSeconds()
-                            << " s blockchain node " << GetNode()->GetId() << " received"
-                            << packet->GetSize() << " bytes from"
-                            << Inet6SocketAddress::ConvertFrom(from).GetIpv6()
-                            << " port" << Inet6SocketAddress::ConvertFrom(from).GetPort());
-            }
-            m_rxTrace(packet, from);
+            case GET_DATA:
+            {
+                NS_LOG_INFO("GET_DATA");
+                unsigned int j;
+                int totalBlockMessageSize = 0;
+                std::vector<Block>                      requestBlocks;
+                std::vector<Block>::iterator            block_it;
+
+                if(std::string(d["type"].GetString()) == "transaction")
+                {
+                    SendTransactions(d, from);
+                    break;
+                }
+
+                m_nodeStats->getDataReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["blocks"].Size()*m_inventorySizeBytes;
+
+                for(j=0; j < d["blocks"].Size(); j++)
+                {
+                    std::string     invDelimiter = "/";
+                    std::string     parsedInv = d["blocks"][j].GetString();
+                    size_t          invPos = parsedInv.find(invDelimiter);
+
+                    int height = atoi(parsedInv.substr(0, invPos).c_str());
+                    int minerId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
+
+                    if(m_blockchain.HasBlock(height, minerId))
+                    {
+                        NS_LOG_INFO("GET_DATA : Blockchain node " << GetNode()->GetId()
+                                    << " has the block with height = " << height
+                                    << " and minerId = " << minerId);
+                        Block newBlock(m_blockchain.ReturnBlock(height, minerId));
+                        requestBlocks.push_back(newBlock);
+                    }
+                    else
+                    {
+                        NS_LOG_INFO("GET_DATA : Blockchain node " << GetNode()->GetId()
+                                    << " does not have the block with height = " << height
+                                    << " and minerId = " << minerId);
+                    }
+
+                }
+
+                if(!requestBlocks.empty())
+                {
+                    rapidjson::Value value;
+                    rapidjson::Value array(rapidjson::kArrayType);
+
+                    d.RemoveMember("blocks");
+                    totalBlockMessageSize = m_blockchainMessageHeader;
+
+                    for(block_it = requestBlocks.begin() ; block_it < requestBlocks.end(); block_it++)
+                    {
+                        //block_it->PrintAllTransaction();
+                        rapidjson::Value blockInfo(rapidjson::kObjectType);
+
+                        totalBlockMessageSize += block_it->GetBlockSizeBytes();
+                        WriteBlockInfo(*block_it, true, blockInfo, d.GetAllocator());
+                        array.PushBack(blockInfo, d.GetAllocator());
+                    }
+
+                    d.AddMember("blocks", array, d.GetAllocator());
+
+                    rapidjson::StringBuffer packetInfo;
+                    rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
+                    d.Accept(writer);
+                    std::string packet = packetInfo.GetString();
+                    NS_LOG_INFO("DEBUG: " << packetInfo.GetString());
+
+                    ScheduleUpload(packet, totalBlockMessageSize, from);
+                }
+
+                break;
+            }            
+            case BLOCK:
+            {
+                NS_LOG_INFO("BLOCK");
+                int blockMessageSize = 0;
+                double peerUploadSpeed = m_peersUploadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4()]*1000000/8;
+
+                blockMessageSize += m_blockchainMessageHeader;
+
+
+                for(unsigned int j = 0; j < d["blocks"].Size(); j++)
+                {
+                    blockMessageSize += d["blocks"][j]["size"].GetInt();
+                }
+
+
+                m_nodeStats->blockReceivedBytes += blockMessageSize;
+
+                rapidjson::StringBuffer blockInfo;
+                rapidjson::Writer<rapidjson::StringBuffer> blockWriter(blockInfo);
+                d.Accept(blockWriter);
+                /*
+                if(GetNode()->GetId() == 10)
+                {
+                    std::cout<<"BLOCK: At time " << Simulator::Now().GetSeconds()
+                            << " Node " << GetNode()->GetId()
+                            << " received a block message " << blockInfo.GetString() << "\n";
+                }
+                */
+
+                NS_LOG_INFO("BLOCK: At time " << Simulator::Now().GetSeconds()
+                            << " Node " << GetNode()->GetId()
+                            << " received a block message " << blockInfo.GetString());
+                NS_LOG_INFO(m_downloadSpeed << " " << peerUploadSpeed);
+
+                /*
+                 * The block message shares the downlink with the other block downloads in progress
+                 */
+                int transfer = m_downloadLink.AddTransfer(blockMessageSize, peerUploadSpeed, Simulator::Now().GetSeconds());
+
+                m_pendingDownloads[transfer] = std::make_pair(std::string(blockInfo.GetString()), from);
+                ScheduleNextDownload();
+
+                NS_LOG_INFO("BLOCK: Node " << GetNode()->GetId() << " downloads the block message along with "
+                            << m_downloadLink.GetActiveTransfers() - 1 << " other transfers");
+
+                break;
+            }
+            case CHUNK_INV:
+            {
+                NS_LOG_INFO("CHUNK_INV");
+                ReceivedChunkInv(d, from);
+                break;
+            }
+            case GET_CHUNKS:
+            {
+                NS_LOG_INFO("GET_CHUNKS");
+                SendChunks(d, from);
+                break;
+            }
+            case CHUNK:
+            {
+                NS_LOG_INFO("CHUNK");
+                int chunkMessageSize = m_blockchainMessageHeader + m_blockHeadersSizeBytes + m_countBytes + d["chunkSize"].GetInt();
+                double peerUploadSpeed = m_peersUploadSpeeds[InetSocketAddress::ConvertFrom(from).GetIpv4()]*1000000/8;
+
+                m_nodeStats->blockReceivedBytes += chunkMessageSize;
+
+                rapidjson::StringBuffer chunkInfo;
+                rapidjson::Writer<rapidjson::StringBuffer> chunkWriter(chunkInfo);
+                d.Accept(chunkWriter);
+
+                /*
+                 * The chunks share the downlink with the other chunk and block downloads, like the BLOCK messages
+                 */
+                int transfer = m_downloadLink.AddTransfer(chunkMessageSize, peerUploadSpeed, Simulator::Now().GetSeconds());
+
+                m_pendingChunkDownloads[transfer] = std::make_pair(std::string(chunkInfo.GetString()), from);
+                ScheduleNextDownload();
+                break;
+            }
+            case VOTE:
+            case NEW_VIEW:
+            case ENDORSE:
+            case ENDORSEMENT:
+            case SUBMIT:
+            case APPEND:
+            case APPEND_ACK:
+            case ATTESTATION:
+            case RECEIPT:
+            {
+                NS_LOG_INFO(getMessageName(static_cast<enum Messages>(d["message"].GetInt())));
+                m_nodeStats->consensusReceivedBytes += m_blockchainMessageHeader + d["size"].GetInt();
+
+                if(d["to"].GetInt() == static_cast<int>(GetNode()->GetId()))
+                {
+                    ReceivedConsensusMessage(d);
+                }
+                else
+                {
+                    BroadcastConsensusMessage(d, InetSocketAddress::ConvertFrom(from).GetIpv4());
+                }
+                break;
+            }
+            default:
+            {
+                NS_LOG_INFO("Default");
+                break;
+            }
+
         }
-        
+    }
+
+    double
+    BlockchainNode::ScheduleCpuTask(double cost)
+    {
+        NS_LOG_FUNCTION(this << cost);
+
+        if(m_cpuCores == 0)
+        {
+            return cost;
+        }
+
+        double currentTime = Simulator::Now().GetSeconds();
+        auto core = std::min_element(m_coreFreeTimes.begin(), m_coreFreeTimes.end());
+        double start = std::max(*core, currentTime);
+
+        *core = start + cost;
+        m_cpuBusyTime += cost;
+        m_cpuQueueingTimes.AddSample(start - currentTime);
+
+        return *core - currentTime;
+    }
+
+    double
+    BlockchainNode::ScheduleMessageProcessing(rapidjson::Document &d, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        double currentTime = Simulator::Now().GetSeconds();
+        double cost = m_messageProcessingTime;
+
+        /*
+         * The signatures of the new transactions are verified on arrival, the duplicates are dropped after a lookup
+         */
+        if(d["message"].GetInt() == TRANSACTION)
+        {
+            for(rapidjson::SizeType j = 0; j < d["transactions"].Size(); j++)
+            {
+                if(!HasTransaction(d["transactions"][j]["nodeId"].GetInt(), d["transactions"][j]["transId"].GetInt()))
+                {
+                    cost += m_transactionValidationTime;
+                }
+            }
+        }
+
+        double finishTime = currentTime + ScheduleCpuTask(cost);
+        double &peerProcessedTime = m_peersProcessedTimes[from];
+
+        peerProcessedTime = std::max(peerProcessedTime, finishTime);
+        return peerProcessedTime - currentTime;
     }
 
     void
@@ -882,18 +1579,147 @@ namespace ns3 {
     {
         NS_LOG_FUNCTION(this);
         socket->SetRecvCallback (MakeCallback(&BlockchainNode::HandleRead, this));
+
+        Ipv4Address peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
+
+        socket->SetCloseCallbacks(MakeCallback(&BlockchainNode::HandlePeerClose, this),
+                                  MakeCallback(&BlockchainNode::HandlePeerError, this));
+
+        if(m_peersSockets.find(peer) == m_peersSockets.end())
+        {
+            m_peersSockets[peer] = socket;
+            socket->SetSendCallback(MakeCallback(&BlockchainNode::HandleSend, this));
+            FlushSendQueue(peer);
+        }
+    }
+
+    void
+    BlockchainNode::HandleSend(Ptr<Socket> socket, uint32_t available)
+    {
+        NS_LOG_FUNCTION(this << socket << available);
+
+        Address peerAddress;
+
+        if(socket->GetPeerName(peerAddress) == 0 && InetSocketAddress::IsMatchingType(peerAddress))
+        {
+            FlushSendQueue(InetSocketAddress::ConvertFrom(peerAddress).GetIpv4());
+        }
+    }
+
+    void
+    BlockchainNode::FlushSendQueue(Ipv4Address peer)
+    {
+        NS_LOG_FUNCTION(this << peer);
+
+        auto socket = m_peersSockets.find(peer);
+        auto queue = m_peersSendQueues.find(peer);
+
+        if(socket == m_peersSockets.end() || queue == m_peersSendQueues.end())
+        {
+            return;
+        }
+
+        /*
+         * TCP takes the bytes that fit in its send buffer, the rest waits for HandleSend
+         */
+        while(!queue->second.IsEmpty() && socket->second->GetTxAvailable() > 0)
+        {
+            uint32_t frontSize = queue->second.GetFrontSize();
+            int sent = socket->second->Send(queue->second.GetFront(), std::min(socket->second->GetTxAvailable(), frontSize), 0);
+
+            if(sent <= 0)
+            {
+                break;
+            }
+
+            if(static_cast<uint32_t>(sent) == frontSize)
+            {
+                m_sendQueueingTimes[queue->second.GetFrontPriority()].AddSample(Simulator::Now().GetSeconds() - queue->second.GetFrontTime());
+            }
+            queue->second.Pop(sent);
+        }
+
+        m_peersPeakSendQueueBytes[peer] = std::max(m_peersPeakSendQueueBytes[peer], queue->second.GetBytes());
+    }
+
+    bool
+    BlockchainNode::IsOnline(void) const
+    {
+        return m_online;
+    }
+
+    uint32_t
+    BlockchainNode::GetSendQueueBytes(Ipv4Address peer) const
+    {
+        auto queue = m_peersSendQueues.find(peer);
+
+        return queue != m_peersSendQueues.end() ? queue->second.GetBytes() : 0;
+    }
+
+    bool
+    BlockchainNode::ConnectsToPeer(Ipv4Address peer) const
+    {
+        auto peerNodeId = m_peersNodeIds.find(peer);
+
+        return m_initialBlockDownload || peerNodeId == m_peersNodeIds.end() || GetNode()->GetId() < peerNodeId->second;
+    }
+
+    void
+    BlockchainNode::ConnectToPeer(Ipv4Address peer)
+    {
+        NS_LOG_FUNCTION(this << peer);
+
+        m_peersSockets[peer] = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
+        m_peersSockets[peer]->Connect(InetSocketAddress(peer, m_blockchainPort));
+        m_peersSockets[peer]->SetRecvCallback(MakeCallback(&BlockchainNode::HandleRead, this));
+        m_peersSockets[peer]->SetSendCallback(MakeCallback(&BlockchainNode::HandleSend, this));
+        m_peersSockets[peer]->SetConnectCallback(MakeNullCallback<void, Ptr<Socket>>(),
+                                                 MakeCallback(&BlockchainNode::HandleConnectionFailed, this));
+        m_peersSockets[peer]->SetCloseCallbacks(MakeCallback(&BlockchainNode::HandlePeerClose, this),
+                                                MakeCallback(&BlockchainNode::HandlePeerError, this));
+    }
+
+    void
+    BlockchainNode::RemovePeerSocket(Ptr<Socket> socket, const std::string &reason)
+    {
+        NS_LOG_FUNCTION(this << socket);
+
+        for(auto peer = m_peersSockets.begin(); peer != m_peersSockets.end(); ++peer)
+        {
+            if(peer->second == socket)
+            {
+                NS_LOG_INFO("Blockchain node " << GetNode()->GetId() << ": " << reason << " " << peer->first
+                            << ", dropping " << GetSendQueueBytes(peer->first) << " queued Bytes");
+
+                /*
+                 * Nothing drains the queue of a peer without a connection, the next message starts a new one
+                 */
+                m_peersSendQueues.erase(peer->first);
+                m_peersSockets.erase(peer);
+                return;
+            }
+        }
+    }
+
+    void
+    BlockchainNode::HandleConnectionFailed(Ptr<Socket> socket)
+    {
+        NS_LOG_FUNCTION(this << socket);
+        RemovePeerSocket(socket, "could not connect to");
     }
 
     void
     BlockchainNode::HandlePeerClose(Ptr<Socket> socket)
     {
-        NS_LOG_FUNCTION(this);
+        NS_LOG_FUNCTION(this << socket);
+        RemovePeerSocket(socket, "connection closed by");
     }
 
     void
     BlockchainNode::HandlePeerError(Ptr<Socket> socket)
     {
-        NS_LOG_FUNCTION(this);
+        NS_LOG_FUNCTION(this << socket);
+        RemovePeerSocket(socket, "connection error with");
     }
 
     void
@@ -908,457 +1734,2221 @@ namespace ns3 {
                     << " Node " << GetNode()->GetId() << " received a block message " << blockInfo);
         for(unsigned int  j = 0 ; j < d["blocks"].Size(); j++)
         {
-            int parentHeight = d["blocks"][j]["height"].GetInt() - 1;
-            int parentMinerId = d["blocks"][j]["parentBlockMinerId"].GetInt();
-            int height = d["blocks"][j]["height"].GetInt();
-            int minerId = d["blocks"][j]["minerId"].GetInt();
+            ReceivedBlockData(ReadBlockInfo(d["blocks"][j], from), from);
+        }
+    }
 
-            EventId             timeout;
-            std::ostringstream  stringStream;
-            std::string         blockHash;
-            std::string         parentBlockHash;
+    void
+    BlockchainNode::ReceivedBlockData(const Block &newBlock, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
 
-            stringStream << height << "/" << minerId;
-            blockHash = stringStream.str();
+        int parentHeight = newBlock.GetBlockHeight() - 1;
+        int parentMinerId = newBlock.GetParentBlockMinerId();
 
-            if(m_onlyHeadersReceived.find(blockHash) != m_onlyHeadersReceived.end())
-            {
-                m_onlyHeadersReceived.erase(blockHash);
-            }
+        std::ostringstream  stringStream;
+        std::string         blockHash;
+        std::string         parentBlockHash;
 
-            stringStream.clear();
-            stringStream.str("");
+        stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
+        blockHash = stringStream.str();
+        MarkBlockAnnounced(InetSocketAddress::ConvertFrom(from).GetIpv4(), blockHash);
+
+        if(m_onlyHeadersReceived.find(blockHash) != m_onlyHeadersReceived.end())
+        {
+            m_onlyHeadersReceived.erase(blockHash);
+        }
+        m_chunkedBlocks.erase(blockHash);
 
-            stringStream << parentHeight << "/" << parentMinerId;
-            parentBlockHash = stringStream.str();
+        stringStream.clear();
+        stringStream.str("");
 
-            if(!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId)
-                && !ReceivedButNotValidated(parentBlockHash) && !OnlyHeadersReceived(parentBlockHash))
-            {
-                NS_LOG_INFO("The Block with height = " << d["blocks"][j]["height"].GetInt()
-                            << " and minerID = " << d["blocks"][j]["minerId"].GetInt()
-                            << " is an orphan, so it will be discarded\n");
-                m_queueInv.erase(blockHash);
-                Simulator::Cancel(m_invTimeouts[blockHash]);
-                m_invTimeouts.erase(blockHash);
-            }
-            else
-            {
-                std::vector<Transaction> newTransactions;
-                Block newBlock(d["blocks"][j]["height"].GetInt(), d["blocks"][j]["minerId"].GetInt(), d["blocks"][j]["nonce"].GetInt()
-                                , d["blocks"][j]["parentBlockMinerId"].GetInt(), d["blocks"][j]["size"].GetInt()
-                                , d["blocks"][j]["timeStamp"].GetDouble(), Simulator::Now().GetSeconds(), InetSocketAddress::ConvertFrom(from).GetIpv4());
-                
-                for(unsigned int i = 0 ; i < d["blocks"][j]["transactions"].Size(); i++)
-                {
-                    int transNodeId = d["blocks"][j]["transactions"][i]["nodeId"].GetInt();
-                    int transId = d["blocks"][j]["transactions"][i]["transId"].GetInt();
-                    double timeStamp = d["blocks"][j]["transactions"][i]["timestamp"].GetDouble();
-                    Transaction newTrans(transNodeId, transId, timeStamp);
-                    newTransactions.push_back(newTrans);
-                    //std::cout<<"Node " << GetNode()->GetId() << " confirmed transaction nodeid: " << transNodeId << " transId: " <<  transId << "\n";
-                }
-                newBlock.SetTransactions(newTransactions);
-                ReceiveBlock(newBlock);
-            }
+        stringStream << parentHeight << "/" << parentMinerId;
+        parentBlockHash = stringStream.str();
+
+        /*
+         * With BLOCK_TORRENT the parent may still be arriving in chunks, it is then known like a parent with only its headers
+         */
+        if(!m_blockchain.HasBlock(parentHeight, parentMinerId) && !m_blockchain.IsOrphan(parentHeight, parentMinerId)
+            && !ReceivedButNotValidated(parentBlockHash) && !OnlyHeadersReceived(parentBlockHash)
+            && m_chunkedBlocks.find(parentBlockHash) == m_chunkedBlocks.end())
+        {
+            NS_LOG_INFO("The Block with height = " << newBlock.GetBlockHeight()
+                        << " and minerID = " << newBlock.GetMinerId()
+                        << " is an orphan, so it will be discarded\n");
+            m_queueInv.erase(blockHash);
+            Simulator::Cancel(m_invTimeouts[blockHash]);
+            m_invTimeouts.erase(blockHash);
         }
+        else
+        {
+            ReceiveBlock(newBlock);
+        }
+
+        SyncBlockReceived(blockHash);
     }
 
     void
-    BlockchainNode::ReceiveBlock(const Block &newBlock)
+    BlockchainNode::WriteBlockInfo(const Block &block, bool withTransactions, rapidjson::Value &blockInfo, rapidjson::Document::AllocatorType &allocator)
     {
-        NS_LOG_FUNCTION(this);
-        NS_LOG_INFO("ReceiveBlock: At time " << Simulator::Now().GetSeconds()
-                    << "s blockchain node " << GetNode()->GetId() << " received");
-        std::ostringstream  stringStream;
-        std::string         blockHash = stringStream.str();
+        rapidjson::Value value;
+
+        value = block.GetBlockHeight();
+        blockInfo.AddMember("height", value, allocator);
+
+        value = block.GetMinerId();
+        blockInfo.AddMember("minerId", value, allocator);
+
+        value = block.GetNonce();
+        blockInfo.AddMember("nonce", value, allocator);
+
+        value = block.GetParentBlockMinerId();
+        blockInfo.AddMember("parentBlockMinerId", value, allocator);
+
+        value = block.GetBlockSizeBytes();
+        blockInfo.AddMember("size", value, allocator);
+
+        value = block.GetTimeStamp();
+        blockInfo.AddMember("timeStamp", value, allocator);
+
+        value = block.GetTimeReceived();
+        blockInfo.AddMember("timeReceived", value, allocator);
+
+        std::vector<std::pair<int, int>> uncles = block.GetUncles();
+        rapidjson::Value uncleArray(rapidjson::kArrayType);
+
+        for(auto const &uncle: uncles)
+        {
+            std::ostringstream uncleHash;
+            uncleHash << uncle.first << "/" << uncle.second;
+            value.SetString(uncleHash.str().c_str(), uncleHash.str().size(), allocator);
+            uncleArray.PushBack(value, allocator);
+        }
+        blockInfo.AddMember("uncles", uncleArray, allocator);
+
+        if(!block.IsValid())
+        {
+            value = true;
+            blockInfo.AddMember("invalid", value, allocator);
+        }
+
+        if(block.IsMicroblock())
+        {
+            value = true;
+            blockInfo.AddMember("microblock", value, allocator);
+        }
+
+        if(block.GetView() >= 0)
+        {
+            QuorumCertificate justify = block.GetJustify();
+            rapidjson::Value justifyInfo(rapidjson::kObjectType);
+
+            value = block.GetView();
+            blockInfo.AddMember("view", value, allocator);
+
+            value = justify.height;
+            justifyInfo.AddMember("height", value, allocator);
+
+            value = justify.minerId;
+            justifyInfo.AddMember("minerId", value, allocator);
+
+            value = justify.view;
+            justifyInfo.AddMember("view", value, allocator);
+
+            value = justify.votes;
+            justifyInfo.AddMember("votes", value, allocator);
+
+            blockInfo.AddMember("justify", justifyInfo, allocator);
+        }
+
+        if(withTransactions)
+        {
+            rapidjson::Value tranArray(rapidjson::kArrayType);
+
+            WriteTransactionsInfo(block.GetTransactions(), tranArray, allocator);
+            blockInfo.AddMember("transactions", tranArray, allocator);
+        }
+    }
+
+    void
+    BlockchainNode::WriteTransactionsInfo(const std::vector<Transaction> &transactions, rapidjson::Value &array, rapidjson::Document::AllocatorType &allocator)
+    {
+        rapidjson::Value value;
+
+        for(auto const &trans: transactions)
+        {
+            rapidjson::Value transInfo(rapidjson::kObjectType);
+
+            value = trans.GetTransNodeId();
+            transInfo.AddMember("nodeId", value, allocator);
+
+            value = trans.GetTransId();
+            transInfo.AddMember("transId", value, allocator);
+
+            value = trans.GetTransTimeStamp();
+            transInfo.AddMember("timestamp", value, allocator);
+
+            value = trans.GetTransFee();
+            transInfo.AddMember("fee", value, allocator);
+
+            if(trans.GetEndorsements() > 0)
+            {
+                value = trans.GetEndorsements();
+                transInfo.AddMember("endorsements", value, allocator);
+            }
+
+            array.PushBack(transInfo, allocator);
+        }
+    }
+
+    Block
+    BlockchainNode::ReadBlockInfo(const rapidjson::Value &blockInfo, Address &from)
+    {
+        Block newBlock(blockInfo["height"].GetInt(), blockInfo["minerId"].GetInt(), blockInfo["nonce"].GetInt()
+                        , blockInfo["parentBlockMinerId"].GetInt(), blockInfo["size"].GetInt()
+                        , blockInfo["timeStamp"].GetDouble(), Simulator::Now().GetSeconds(), InetSocketAddress::ConvertFrom(from).GetIpv4());
+
+        if(blockInfo.HasMember("transactions"))
+        {
+            newBlock.SetTransactions(ReadTransactionsInfo(blockInfo["transactions"]));
+        }
+
+        if(blockInfo.HasMember("uncles"))
+        {
+            std::vector<std::pair<int, int>> uncles;
+
+            for(unsigned int i = 0 ; i < blockInfo["uncles"].Size(); i++)
+            {
+                std::string uncleHash = blockInfo["uncles"][i].GetString();
+                size_t      unclePos = uncleHash.find("/");
+
+                uncles.push_back(std::make_pair(atoi(uncleHash.substr(0, unclePos).c_str()),
+                                                atoi(uncleHash.substr(unclePos+1, uncleHash.size()).c_str())));
+            }
+            newBlock.SetUncles(uncles);
+        }
+
+        if(blockInfo.HasMember("view"))
+        {
+            QuorumCertificate justify;
+
+            justify.height = blockInfo["justify"]["height"].GetInt();
+            justify.minerId = blockInfo["justify"]["minerId"].GetInt();
+            justify.view = blockInfo["justify"]["view"].GetInt();
+            justify.votes = blockInfo["justify"]["votes"].GetInt();
+
+            newBlock.SetView(blockInfo["view"].GetInt());
+            newBlock.SetJustify(justify);
+        }
+
+        if(blockInfo.HasMember("invalid"))
+        {
+            newBlock.SetValid(false);
+        }
+
+        if(blockInfo.HasMember("microblock"))
+        {
+            newBlock.SetMicroblock(true);
+        }
+
+        return newBlock;
+    }
+
+    std::vector<Transaction>
+    BlockchainNode::ReadTransactionsInfo(const rapidjson::Value &array)
+    {
+        std::vector<Transaction> transactions;
+
+        for(unsigned int i = 0 ; i < array.Size(); i++)
+        {
+            Transaction newTrans(array[i]["nodeId"].GetInt(), array[i]["transId"].GetInt(), array[i]["timestamp"].GetDouble());
+
+            newTrans.SetTransFee(array[i]["fee"].GetDouble());
+
+            if(array[i].HasMember("endorsements"))
+            {
+                newTrans.SetEndorsements(array[i]["endorsements"].GetInt());
+            }
+            transactions.push_back(newTrans);
+        }
+
+        return transactions;
+    }
+
+    void
+    BlockchainNode::ReceiveBlock(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+        NS_LOG_INFO("ReceiveBlock: At time " << Simulator::Now().GetSeconds()
+                    << "s blockchain node " << GetNode()->GetId() << " received");
+        std::ostringstream  stringStream;
+        std::string         blockHash = stringStream.str();
+
+        stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
+        blockHash = stringStream.str();
+
+        if(m_blockchain.HasBlock(newBlock) || m_blockchain.IsOrphan(newBlock) || ReceivedButNotValidated(blockHash))
+        {
+            NS_LOG_INFO("ReceiveBlock: Blockchain node " << GetNode()->GetId()
+                        << " has already added this block in the m_blockchain");
+
+            if (m_invTimeouts.find(blockHash) != m_invTimeouts.end())
+            {
+                m_queueInv.erase(blockHash);
+                Simulator::Cancel(m_invTimeouts[blockHash]);
+                m_invTimeouts.erase(blockHash);
+            }
+        }
+        else
+        {
+            NS_LOG_INFO("ReceiveBlock: Blockchain node " << GetNode()->GetId()
+                        << " has not added this block in the m_blockchain");
+            
+            m_receivedNotValidated[blockHash] = newBlock;
+
+            if (m_invTimeouts.find(blockHash) != m_invTimeouts.end())
+            {
+                m_queueInv.erase(blockHash);
+                Simulator::Cancel(m_invTimeouts[blockHash]);
+                m_invTimeouts.erase(blockHash);
+            }
+
+            ValidateBlock(newBlock);
+        }
+
+    }
+
+    void
+    BlockchainNode::SendBlock(std::string packetInfo, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        NS_LOG_INFO("SendBlock: At time "<<  Simulator::Now().GetSeconds()
+                    << "s blockchain node " << GetNode()->GetId() << " sent "
+                    << packetInfo << " to " << InetSocketAddress::ConvertFrom(from).GetIpv4());
+
+        SendMessage(GET_DATA, BLOCK,packetInfo, from);
+    }
+
+    void
+    BlockchainNode::ReceivedHigherBlock(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+        NS_LOG_INFO("ReceivedHigherBlock: blockchain node : " <<GetNode()->GetId() 
+                    << " added a new block in the m_blockchain with higher height");
+    }
+
+    void
+    BlockchainNode::ValidateBlock(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        const Block *parent = m_blockchain.GetParent(newBlock);
+
+        if(parent == nullptr)
+        {
+            NS_LOG_INFO("ValidateBlock : Block is an orphan");
+            m_blockchain.AddOrphan(newBlock);
+            
+        }
+        else
+        {
+            const int averageBlockSizeBytes = 238263;   // we should modify it
+            const double averageValidationTimeSeconds = 0.174;
+            std::vector<Transaction> transactions = newBlock.GetTransactions();
+            int transactionBytes = 0;
+            int cacheHits = 0;
+            int cacheMisses = 0;
+            int endorsementSignatures = 0;
+
+            /*
+             * Transactions verified when they entered the mempool only need a cache lookup. The
+             * endorsements of the execute-order-validate pipeline are never cached, each one is a
+             * signature check. Only the header is charged per byte.
+             */
+            for(auto const &tran: transactions)
+            {
+                uint64_t key = getTransactionKey(tran.GetTransNodeId(), tran.GetTransId());
+
+                if(m_signatureCache.Contains(key))
+                {
+                    cacheHits++;
+                    m_signatureCache.Erase(key);
+                }
+                else
+                {
+                    cacheMisses++;
+                }
+                transactionBytes += tran.GetTransSizeByte();
+                endorsementSignatures += tran.GetEndorsements();
+            }
+
+            /*
+             * The block bytes not covered by its transactions stand for transactions that are not simulated one by one.
+             * They are charged per transaction of average size, with the cache hit ratio of the simulated ones, and
+             * as cache misses when the block carries no transaction.
+             */
+            double fillerTransactions = std::max(newBlock.GetBlockSizeBytes() - m_blockHeadersSizeBytes - transactionBytes, 0)
+                                        / m_averageTransacionSize;
+            double hitRatio = transactions.empty() ? 0 : static_cast<double>(cacheHits) / transactions.size();
+            double validationTime = (cacheHits + fillerTransactions * hitRatio) * m_cachedTransactionValidationTime
+                                    + (cacheMisses + fillerTransactions * (1 - hitRatio) + endorsementSignatures) * m_transactionValidationTime
+                                    + averageValidationTimeSeconds * m_blockHeadersSizeBytes / averageBlockSizeBytes;
+
+            m_nodeStats->signatureCacheHits += cacheHits;
+            m_nodeStats->signatureCacheMisses += cacheMisses;
+            ValidateTransaction(newBlock);
+
+            //std::cout<<"validationTime : " << validationTime << "\n";
+            validationTime = ScheduleCpuTask(validationTime);
+            Simulator::Schedule (Seconds(validationTime), &BlockchainNode::AfterBlockValidation, this, newBlock);
+            NS_LOG_INFO("ValidateBlock : the block will be validated in " << validationTime << "s");
+        }
+
+    }
+
+    void
+    BlockchainNode::ValidateTransaction(const Block &newBlock)
+    {
+        std::vector<Transaction>                requestTransactions;
+        std::vector<Transaction>::iterator      trans_it;
+        requestTransactions = newBlock.GetTransactions();
+
+        for(trans_it = requestTransactions.begin(); trans_it < requestTransactions.end(); trans_it++)
+        {
+            /*
+            std::cout<<"Node "<<GetNode()->GetId() << " is validating transaction nodeId : " 
+                    << trans_it->GetTransNodeId() << " transId: " << trans_it->GetTransId() << "\n";
+            */
+
+            if(m_mempool.RemoveTransaction(trans_it->GetTransNodeId(), trans_it->GetTransId()))
+            {
+                if(trans_it->GetTransNodeId() == GetNode()->GetId())
+                {
+                    m_totalCreatedTransaction++;
+                    m_meanLatency = (m_meanLatency*static_cast<double>(m_totalCreatedTransaction-1) + (Simulator::Now().GetSeconds() - trans_it->GetTransTimeStamp()))/static_cast<double>(m_totalCreatedTransaction);
+                }
+            }
+            
+            m_transaction.insert(getTransactionKey(trans_it->GetTransNodeId(), trans_it->GetTransId()));
+        }
+    }
+
+    void
+    BlockchainNode::AfterBlockValidation(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        int height = newBlock.GetBlockHeight();
+        int minerId = newBlock.GetMinerId();
+        std::ostringstream  stringStream;
+        std::string         blockHash = stringStream.str();
+
+        stringStream << height << "/" << minerId;
+        blockHash = stringStream.str();
+
+        RemoveReceivedButNotvalidated(blockHash);
+
+        if(!newBlock.IsValid())
+        {
+            NS_LOG_WARN("AfterBlockValidation : at time " << Simulator::Now().GetSeconds()
+                        << "s blockchain node " << GetNode()->GetId() << " rejected the invalid block " << blockHash);
+
+            if(m_blockchain.IsOrphan(newBlock))
+            {
+                m_blockchain.RemoveOrphan(newBlock);
+            }
+            m_invalidBlocks++;
+            DiscardOrphanChildren(newBlock);
+            ReceivedInvalidBlock(newBlock);
+            return;
+        }
+
+        NS_LOG_INFO("AfterBlockValidation : at time " << Simulator::Now().GetSeconds()
+                    << "s blockchain node " << GetNode()->GetId()
+                    << " validated block ");
+        int topHeight = m_blockchain.GetCurrentTopBlock()->GetBlockHeight();
+        int topMinerId = m_blockchain.GetCurrentTopBlock()->GetMinerId();
+
+        if(m_blockchain.IsOrphan(newBlock))
+        {
+            NS_LOG_INFO("AfterBlockValidation: Block was orphan");
+             m_blockchain.RemoveOrphan(newBlock);
+        }
+
+        m_meanBlockReceiveTime = (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks())*m_meanBlockReceiveTime
+                                + (newBlock.GetTimeReceived() - m_previousBlockReceiveTime)/(m_blockchain.GetTotalBlocks());
+        //std::cout << "m_meanBlockReceiveTime : "<<m_meanBlockReceiveTime <<"\n";
+        m_previousBlockReceiveTime = newBlock.GetTimeReceived();
+        
+        m_meanBlockPropagationTime =  (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks())*m_meanBlockPropagationTime
+                                + (newBlock.GetTimeReceived() -newBlock.GetTimeStamp())/(m_blockchain.GetTotalBlocks());
+        //std::cout << " m_meanBlockPropagationTime : "<< m_meanBlockPropagationTime <<"\n";
+        m_meanBlockSize = (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks()) * m_meanBlockSize
+                            + (newBlock.GetBlockSizeBytes())/static_cast<double>(m_blockchain.GetTotalBlocks());
+        
+        m_blockchain.AddBlock(newBlock);
+
+        /*
+         * The fork choice rule may switch to another branch, not only to a higher block, and the new top
+         * may be a descendant of newBlock that was waiting for it
+         */
+        if(m_blockchain.GetCurrentTopBlock()->GetBlockHeight() != topHeight || m_blockchain.GetCurrentTopBlock()->GetMinerId() != topMinerId)
+        {
+            ReceivedHigherBlock(*m_blockchain.GetCurrentTopBlock());
+        }
+
+        m_txTracker.BlockAdded(newBlock, Simulator::Now().GetSeconds());
+        m_txTracker.UpdateConfirmations(m_blockchain, Simulator::Now().GetSeconds());
+
+        /*
+         * The ordering service is final, a validated block of endorsed transactions is committed
+         */
+        int endorsedTransactions = 0;
+
+        for(auto const &tran: newBlock.GetTransactions())
+        {
+            if(tran.GetEndorsements() > 0)
+            {
+                endorsedTransactions++;
+                m_endToEndTimes.AddSample(Simulator::Now().GetSeconds() - tran.GetTransTimeStamp());
+            }
+        }
+
+        if(endorsedTransactions > 0)
+        {
+            m_committedEndorsedBlocks++;
+            m_committedEndorsedTransactions += endorsedTransactions;
+        }
+
+        AdvertiseNewBlock(newBlock);
+        ValidateOrphanChildren(newBlock);
+        
+
+    }
+
+    void
+    BlockchainNode::ReceivedHeader(const Block &header)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    void
+    BlockchainNode::ReceivedInvalidBlock(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    void
+    BlockchainNode::DiscardOrphanChildren(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::vector<Block> children;
+
+        for(auto const &child: m_blockchain.GetOrpharnChildrenPointer(newBlock))
+        {
+            children.push_back(*child);
+        }
+
+        for(auto const &child: children)
+        {
+            std::ostringstream stringStream;
+
+            stringStream << child.GetBlockHeight() << "/" << child.GetMinerId();
+            NS_LOG_INFO("DiscardOrphanChildren : block " << stringStream.str() << " extends an invalid block");
+
+            m_blockchain.RemoveOrphan(child);
+            RemoveReceivedButNotvalidated(stringStream.str());
+            DiscardOrphanChildren(child);
+        }
+    }
+
+    void
+    BlockchainNode::ValidateOrphanChildren(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::vector<const Block *> children = m_blockchain.GetOrpharnChildrenPointer(newBlock);
+
+        if(children.size() == 0)
+        {
+            NS_LOG_INFO("ValidateOrphanChildren : Block has no orpharn children\n");
+        }
+        else
+        {
+            NS_LOG_INFO("ValidateOrphanChildren : Block has orpharn children:");
+            std::vector<const Block *>::iterator block_it;
+            for(block_it = children.begin(); block_it < children.end(); block_it++)
+            {
+                ValidateBlock(**block_it);
+            }
+        }
+    }
+
+    void
+    BlockchainNode::AdvertiseNewBlock(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(m_protocolType == BLOCK_TORRENT)
+        {
+            AdvertiseFullBlock(newBlock);
+            return;
+        }
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+        std::ostringstream stringStream;
+        std::string blockHash = stringStream.str();
+        d.SetObject();
+
+        stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
+        blockHash = stringStream.str();
+
+        value.SetString("blocks");
+        d.AddMember("type", value, d.GetAllocator());
+
+        if(m_protocolType == STANDARD_PROTOCOL)
+        {
+            value = INV;
+            d.AddMember("message", value, d.GetAllocator());
+
+            value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
+            array.PushBack(value, d.GetAllocator());
+            d.AddMember("inv", array, d.GetAllocator());
+        }
+
+        rapidjson::StringBuffer packetInfo;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
+        d.Accept(writer);
+
+        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin() ; i != m_peersAddresses.end(); ++i)
+        {
+            if(!IsShardPeer(*i))
+            {
+                continue;
+            }
+
+            if(*i != newBlock.GetReceivedFromIpv4() && PeerKnowsBlock(*i, blockHash))
+            {
+                NS_LOG_INFO("AdvertiseNewBlock: blockchain node " << GetNode()->GetId() << " skipped " << *i
+                            << " which already knows the block " << blockHash);
+                m_suppressedBlockAdvertisements++;
+            }
+            else if(*i != newBlock.GetReceivedFromIpv4())
+            {
+                //std::cout<<"node : " <<GetNode()->GetId()<< " Advertise new block\n";
+                MarkBlockKnown(*i, blockHash);
+                SendToPeer(*i, packetInfo.GetString(), packetInfo.GetSize(), INV);
+
+                if(m_protocolType == STANDARD_PROTOCOL)
+                {
+                    m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
+                }
+                NS_LOG_INFO("AdvertiseNewBlock: At time " << Simulator::Now().GetSeconds()
+                            << "s blockchain node " << GetNode()->GetId() << " advertised a new block to " << *i);
+
+            }
+        }
+        /*
+        if( GetNode()->GetId() == 5){
+            std::cout<< "AdvertiseNeBlock: At time " << Simulator::Now().GetSeconds()
+                            << "s blockchain node " << GetNode()->GetId() << " advertised a new block(height) :" 
+                            << newBlock.GetBlockHeight() << " minerId : " << newBlock.GetMinerId() <<"\n";
+        }
+        */
+        
+    }
+
+    void
+    BlockchainNode::AdvertiseFullBlock(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::ostringstream  stringStream;
+        std::string         blockHash;
+        std::string         bitmap(ChunkedBlock::GetChunks(newBlock.GetBlockSizeBytes(), m_chunkSizeBytes), '1');
+
+        stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
+        blockHash = stringStream.str();
+
+        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin() ; i != m_peersAddresses.end(); ++i)
+        {
+            if(!IsShardPeer(*i) || *i == newBlock.GetReceivedFromIpv4())
+            {
+                continue;
+            }
+
+            if(PeerKnowsBlock(*i, blockHash))
+            {
+                NS_LOG_INFO("AdvertiseFullBlock: blockchain node " << GetNode()->GetId() << " skipped " << *i
+                            << " which already knows the block " << blockHash);
+                m_suppressedBlockAdvertisements++;
+            }
+            else
+            {
+                MarkBlockKnown(*i, blockHash);
+                SendChunkInv(newBlock, bitmap, *i);
+                NS_LOG_INFO("AdvertiseFullBlock: At time " << Simulator::Now().GetSeconds()
+                            << "s blockchain node " << GetNode()->GetId() << " advertised the " << bitmap.size()
+                            << " chunks of a new block to " << *i);
+            }
+        }
+    }
+
+    void
+    BlockchainNode::AdvertiseChunks(const ChunkedBlock &chunkedBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        const Block         &header = chunkedBlock.GetHeader();
+        std::string         bitmap = chunkedBlock.GetBitmap();
+        std::ostringstream  stringStream;
+
+        stringStream << header.GetBlockHeight() << "/" << header.GetMinerId();
+
+        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin() ; i != m_peersAddresses.end(); ++i)
+        {
+            if(IsShardPeer(*i) && !chunkedBlock.PeerHasAllChunks(*i))
+            {
+                MarkBlockKnown(*i, stringStream.str());
+                SendChunkInv(header, bitmap, *i);
+            }
+        }
+    }
+
+    void
+    BlockchainNode::SendChunkInv(const Block &header, const std::string &bitmap, Ipv4Address peer)
+    {
+        NS_LOG_FUNCTION(this);
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        rapidjson::Value blockInfo(rapidjson::kObjectType);
+
+        d.SetObject();
+
+        value = CHUNK_INV;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString("block");
+        d.AddMember("type", value, d.GetAllocator());
+
+        WriteBlockInfo(header, false, blockInfo, d.GetAllocator());
+        d.AddMember("block", blockInfo, d.GetAllocator());
+
+        value.SetString(bitmap.c_str(), bitmap.size(), d.GetAllocator());
+        d.AddMember("chunks", value, d.GetAllocator());
+
+        rapidjson::StringBuffer packetInfo;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
+        d.Accept(writer);
+
+        SendToPeer(peer, packetInfo.GetString(), packetInfo.GetSize(), CHUNK_INV);
+        m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + (bitmap.size() + 7)/8;
+    }
+
+    void
+    BlockchainNode::ReceivedChunkInv(rapidjson::Document &d, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        Ipv4Address         peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
+        Block               header = ReadBlockInfo(d["block"], from);
+        std::string         bitmap = d["chunks"].GetString();
+        int                 height = header.GetBlockHeight();
+        int                 minerId = header.GetMinerId();
+        int                 parentHeight = height - 1;
+        int                 parentMinerId = header.GetParentBlockMinerId();
+        std::ostringstream  stringStream;
+        std::string         blockHash;
+        std::string         parentBlockHash;
+
+        stringStream << height << "/" << minerId;
+        blockHash = stringStream.str();
+
+        stringStream.clear();
+        stringStream.str("");
+
+        stringStream << parentHeight << "/" << parentMinerId;
+        parentBlockHash = stringStream.str();
+
+        m_nodeStats->invReceivedBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + (bitmap.size() + 7)/8;
+        MarkBlockAnnounced(peer, blockHash);
+
+        if(m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId) || ReceivedButNotValidated(blockHash))
+        {
+            NS_LOG_INFO("CHUNK_INV : Blockchain node " << GetNode()->GetId()
+                        << " has already received the block with height = "
+                        << height << " and minerId = " << minerId);
+            return;
+        }
+
+        auto chunkedBlock = m_chunkedBlocks.find(blockHash);
+        std::vector<Address> &announcers = m_queueInv[blockHash];
+
+        if(chunkedBlock == m_chunkedBlocks.end())
+        {
+            chunkedBlock = m_chunkedBlocks.insert(std::make_pair(blockHash, ChunkedBlock(header, m_chunkSizeBytes))).first;
+
+            if(m_blockchain.HasBlock(parentHeight, parentMinerId) || m_blockchain.IsOrphan(parentHeight, parentMinerId)
+                || ReceivedButNotValidated(parentBlockHash))
+            {
+                ReceivedHeader(header);
+            }
+        }
+
+        if(std::find(announcers.begin(), announcers.end(), from) == announcers.end())
+        {
+            announcers.push_back(from);
+        }
+
+        /*
+         * A block whose chunks stall is requested whole from its announcers, as after an INV
+         */
+        if(m_invTimeouts.find(blockHash) == m_invTimeouts.end())
+        {
+            m_invTimeouts[blockHash] = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::InvTimeoutExpired, this, blockHash);
+        }
+
+        chunkedBlock->second.SetPeerChunks(peer, bitmap);
+        RequestChunks(blockHash, from);
+    }
+
+    void
+    BlockchainNode::RequestChunks(const std::string &blockHash, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        auto chunkedBlock = m_chunkedBlocks.find(blockHash);
+
+        if(chunkedBlock == m_chunkedBlocks.end())
+        {
+            return;
+        }
+
+        std::vector<int> chunks = chunkedBlock->second.RequestChunks(InetSocketAddress::ConvertFrom(from).GetIpv4(), m_maxChunksInFlight);
+
+        if(chunks.empty())
+        {
+            return;
+        }
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+
+        d.SetObject();
+
+        value = GET_CHUNKS;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString("block");
+        d.AddMember("type", value, d.GetAllocator());
+
+        value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
+        d.AddMember("block", value, d.GetAllocator());
+
+        for(int chunk: chunks)
+        {
+            value = chunk;
+            array.PushBack(value, d.GetAllocator());
+        }
+        d.AddMember("chunks", array, d.GetAllocator());
+
+        SendMessage(CHUNK_INV, GET_CHUNKS, d, from);
+    }
+
+    void
+    BlockchainNode::SendChunks(rapidjson::Document &d, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::string     blockHash = d["block"].GetString();
+        size_t          invPos = blockHash.find("/");
+        int             height = atoi(blockHash.substr(0, invPos).c_str());
+        int             minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
+        auto            chunkedBlock = m_chunkedBlocks.find(blockHash);
+        bool            hasBlock = true;
+        Block           block;
+
+        m_nodeStats->getDataReceivedBytes += m_blockchainMessageHeader + m_inventorySizeBytes + m_countBytes + d["chunks"].Size()*m_countBytes;
+
+        if(m_blockchain.HasBlock(height, minerId))
+        {
+            block = m_blockchain.ReturnBlock(height, minerId);
+        }
+        else if(ReceivedButNotValidated(blockHash))
+        {
+            block = m_receivedNotValidated[blockHash];
+        }
+        else if(chunkedBlock != m_chunkedBlocks.end())
+        {
+            block = chunkedBlock->second.GetHeader();
+            hasBlock = false;
+        }
+        else
+        {
+            NS_LOG_INFO("GET_CHUNKS : Blockchain node " << GetNode()->GetId()
+                        << " does not have the block with height = " << height
+                        << " and minerId = " << minerId);
+            return;
+        }
+
+        std::vector<Transaction> transactions = block.GetTransactions();
+        int chunks = ChunkedBlock::GetChunks(block.GetBlockSizeBytes(), m_chunkSizeBytes);
+
+        for(unsigned int j = 0; j < d["chunks"].Size(); j++)
+        {
+            int chunk = d["chunks"][j].GetInt();
+            int chunkSize = std::min(static_cast<int>(m_chunkSizeBytes), block.GetBlockSizeBytes() - chunk * static_cast<int>(m_chunkSizeBytes));
+            rapidjson::Document chunkMessage;
+            rapidjson::Value value;
+            rapidjson::Value blockInfo(rapidjson::kObjectType);
+            rapidjson::Value tranArray(rapidjson::kArrayType);
+
+            if(chunk < 0 || chunk >= chunks || (!hasBlock && !chunkedBlock->second.HasChunk(chunk)))
+            {
+                continue;
+            }
+
+            chunkMessage.SetObject();
+
+            value = CHUNK;
+            chunkMessage.AddMember("message", value, chunkMessage.GetAllocator());
+
+            value.SetString("block");
+            chunkMessage.AddMember("type", value, chunkMessage.GetAllocator());
+
+            WriteBlockInfo(block, false, blockInfo, chunkMessage.GetAllocator());
+            chunkMessage.AddMember("block", blockInfo, chunkMessage.GetAllocator());
+
+            value = chunk;
+            chunkMessage.AddMember("chunk", value, chunkMessage.GetAllocator());
+
+            value = std::max(chunkSize, 0);
+            chunkMessage.AddMember("chunkSize", value, chunkMessage.GetAllocator());
+
+            if(hasBlock)
+            {
+                WriteTransactionsInfo(ChunkedBlock::GetChunkTransactions(transactions, chunk, chunks), tranArray, chunkMessage.GetAllocator());
+            }
+            else
+            {
+                WriteTransactionsInfo(chunkedBlock->second.GetChunkTransactions(chunk), tranArray, chunkMessage.GetAllocator());
+            }
+            chunkMessage.AddMember("transactions", tranArray, chunkMessage.GetAllocator());
+
+            rapidjson::StringBuffer packetInfo;
+            rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
+            chunkMessage.Accept(writer);
+
+            ScheduleUpload(packetInfo.GetString(), m_blockchainMessageHeader + m_blockHeadersSizeBytes + m_countBytes + std::max(chunkSize, 0),
+                           from, CHUNK);
+        }
+    }
+
+    void
+    BlockchainNode::ReceivedChunkMessage(std::string &chunkInfo, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        rapidjson::Document d;
+        d.Parse(chunkInfo.c_str());
+
+        int                 height = d["block"]["height"].GetInt();
+        int                 minerId = d["block"]["minerId"].GetInt();
+        int                 chunk = d["chunk"].GetInt();
+        std::ostringstream  stringStream;
+        std::string         blockHash;
+
+        stringStream << height << "/" << minerId;
+        blockHash = stringStream.str();
+
+        m_chunksReceived++;
+
+        auto chunkedBlock = m_chunkedBlocks.find(blockHash);
+
+        if(chunkedBlock == m_chunkedBlocks.end())
+        {
+            /*
+             * The block arrived meanwhile, whole or from the chunks of other peers, or it was dropped as an orphan
+             */
+            NS_LOG_INFO("ReceivedChunkMessage: Blockchain node " << GetNode()->GetId() << " no longer needs chunk "
+                        << chunk << " of the block " << blockHash);
+            m_duplicateChunks++;
+            return;
+        }
+
+        if(!chunkedBlock->second.AddChunk(chunk, ReadTransactionsInfo(d["transactions"])))
+        {
+            m_duplicateChunks++;
+            RequestChunks(blockHash, from);
+            return;
+        }
+
+        NS_LOG_INFO("ReceivedChunkMessage: At time " << Simulator::Now().GetSeconds() << "s blockchain node " << GetNode()->GetId()
+                    << " received chunk " << chunk << " of the block " << blockHash << " from "
+                    << InetSocketAddress::ConvertFrom(from).GetIpv4() << ", bitmap " << chunkedBlock->second.GetBitmap());
+
+        /*
+         * The new chunk is announced at once, so the peers download it from this node before the block is complete
+         */
+        AdvertiseChunks(chunkedBlock->second);
+
+        if(chunkedBlock->second.IsComplete())
+        {
+            Block newBlock = chunkedBlock->second.Assemble();
+
+            newBlock.SetTimeReceived(Simulator::Now().GetSeconds());
+            newBlock.SetReceivedFromIpv4(InetSocketAddress::ConvertFrom(from).GetIpv4());
+            m_chunkedBlocksReceived++;
+
+            ReceivedBlockData(newBlock, from);
+        }
+        else
+        {
+            RequestChunks(blockHash, from);
+        }
+    }
+
+    void
+    BlockchainNode::AdvertiseNewTransaction(const Transaction &newTrans, Ipv4Address receivedFromIpv4)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(m_transactionRelayType == ANNOUNCE_TRANSACTIONS)
+        {
+            QueueTransactionInv(newTrans, receivedFromIpv4);
+            return;
+        }
+
+        rapidjson::Document transD;
+
+        int nodeId = newTrans.GetTransNodeId();
+        int transId = newTrans.GetTransId();
+        double tranTimestamp = newTrans.GetTransTimeStamp();
+
+        transD.SetObject();
+
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+        rapidjson::Value transInfo(rapidjson::kObjectType);
+
+        value.SetString("transaction");
+        transD.AddMember("type", value, transD.GetAllocator());
+
+        value = TRANSACTION;
+        transD.AddMember("message", value, transD.GetAllocator());
+
+        value = newTrans.GetTransNodeId();
+        transInfo.AddMember("nodeId", value, transD.GetAllocator());
+
+        value = newTrans.GetTransId();
+        transInfo.AddMember("transId", value, transD.GetAllocator());
+
+        value = newTrans.GetTransTimeStamp();
+        transInfo.AddMember("timestamp", value, transD.GetAllocator());
+
+        value = newTrans.GetTransFee();
+        transInfo.AddMember("fee", value, transD.GetAllocator());
+
+        if(newTrans.GetDestinationShard() >= 0)
+        {
+            value = newTrans.GetDestinationShard();
+            transInfo.AddMember("shard", value, transD.GetAllocator());
+        }
+
+        array.PushBack(transInfo, transD.GetAllocator());
+        transD.AddMember("transactions", array, transD.GetAllocator());
+
+        rapidjson::StringBuffer transactionInfo;
+        rapidjson::Writer<rapidjson::StringBuffer> tranWriter(transactionInfo);
+        transD.Accept(tranWriter);
+
+        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+        {
+            if(!IsShardPeer(*i))
+            {
+                continue;
+            }
+
+            if(*i != receivedFromIpv4 && PeerKnowsTransaction(*i, nodeId, transId))
+            {
+                m_suppressedTransactionSends++;
+            }
+            else if(*i != receivedFromIpv4)
+            {
+                MarkTransactionKnown(*i, nodeId, transId);
+                SendToPeer(*i, transactionInfo.GetString(), transactionInfo.GetSize(), TRANSACTION);
+                m_nodeStats->transactionSentBytes += m_blockchainMessageHeader + m_countBytes + newTrans.GetTransSizeByte();
+            }
+        
+        }
+
+    }
+
+    void
+    BlockchainNode::MarkBlockAnnounced(Ipv4Address peer, const std::string &blockHash)
+    {
+        int height = atoi(blockHash.substr(0, blockHash.find("/")).c_str());
+        auto bestHeight = m_peersBestHeights.find(peer);
+
+        if(bestHeight == m_peersBestHeights.end() || bestHeight->second < height)
+        {
+            m_peersBestHeights[peer] = height;
+        }
+
+        MarkBlockKnown(peer, blockHash);
+    }
+
+    void
+    BlockchainNode::MarkBlockKnown(Ipv4Address peer, const std::string &blockHash)
+    {
+        auto filter = m_peersKnownBlocks.find(peer);
+
+        if(filter == m_peersKnownBlocks.end())
+        {
+            return;
+        }
+
+        filter->second.Insert(std::hash<std::string>()(blockHash));
+
+        if(m_knownInventoryAudit)
+        {
+            m_peersKnownBlocksAudit[peer].insert(blockHash);
+        }
+    }
+
+    void
+    BlockchainNode::MarkTransactionKnown(Ipv4Address peer, int nodeId, int transId)
+    {
+        auto filter = m_peersKnownTransactions.find(peer);
+
+        if(filter == m_peersKnownTransactions.end())
+        {
+            return;
+        }
+
+        filter->second.Insert(getTransactionKey(nodeId, transId));
+
+        if(m_knownInventoryAudit)
+        {
+            m_peersKnownTransactionsAudit[peer].insert(getTransactionKey(nodeId, transId));
+        }
+    }
+
+    bool
+    BlockchainNode::PeerKnowsBlock(Ipv4Address peer, const std::string &blockHash)
+    {
+        auto filter = m_peersKnownBlocks.find(peer);
+
+        if(filter == m_peersKnownBlocks.end())
+        {
+            return false;
+        }
+
+        bool known = filter->second.Contains(std::hash<std::string>()(blockHash));
+
+        if(m_knownInventoryAudit)
+        {
+            std::set<std::string> &exact = m_peersKnownBlocksAudit[peer];
+
+            if(exact.find(blockHash) == exact.end())
+            {
+                m_inventoryNegativeQueries++;
+                if(known)
+                {
+                    m_inventoryFalsePositives++;
+                }
+            }
+        }
+
+        return known;
+    }
+
+    bool
+    BlockchainNode::PeerKnowsTransaction(Ipv4Address peer, int nodeId, int transId)
+    {
+        auto filter = m_peersKnownTransactions.find(peer);
+
+        if(filter == m_peersKnownTransactions.end())
+        {
+            return false;
+        }
+
+        bool known = filter->second.Contains(getTransactionKey(nodeId, transId));
+
+        if(m_knownInventoryAudit)
+        {
+            std::unordered_set<uint64_t> &exact = m_peersKnownTransactionsAudit[peer];
+
+            if(exact.find(getTransactionKey(nodeId, transId)) == exact.end())
+            {
+                m_inventoryNegativeQueries++;
+                if(known)
+                {
+                    m_inventoryFalsePositives++;
+                }
+            }
+        }
+
+        return known;
+    }
+
+    bool
+    BlockchainNode::IsShardPeer(Ipv4Address peer) const
+    {
+        auto shard = m_peersShards.find(peer);
+
+        return m_noShards <= 1 || shard == m_peersShards.end() || shard->second == m_shard;
+    }
+
+    void
+    BlockchainNode::QueueTransactionInv(const Transaction &newTrans, Ipv4Address receivedFromIpv4)
+    {
+        NS_LOG_FUNCTION(this);
+
+        int nodeId = newTrans.GetTransNodeId();
+        int transId = newTrans.GetTransId();
+
+        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+        {
+            if(*i == receivedFromIpv4 || !IsShardPeer(*i))
+            {
+                continue;
+            }
+
+            if(PeerKnowsTransaction(*i, nodeId, transId))
+            {
+                m_suppressedTransactionSends++;
+                continue;
+            }
+
+            MarkTransactionKnown(*i, nodeId, transId);
+            m_peersTransactionInvQueue[*i].push_back(getTransactionKey(nodeId, transId));
+        }
+
+        if(!m_transactionInvEvent.IsRunning())
+        {
+            m_transactionInvEvent = Simulator::Schedule(m_transactionInvInterval, &BlockchainNode::SendTransactionInv, this);
+        }
+    }
+
+    void
+    BlockchainNode::SendTransactionInv(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        for(auto &queue: m_peersTransactionInvQueue)
+        {
+            if(queue.second.empty())
+            {
+                continue;
+            }
+
+            rapidjson::Document d;
+            rapidjson::Value value;
+            rapidjson::Value array(rapidjson::kArrayType);
+            std::ostringstream stringStream;
+            std::string transHash;
+
+            d.SetObject();
+
+            value.SetString("transaction");
+            d.AddMember("type", value, d.GetAllocator());
+
+            value = INV;
+            d.AddMember("message", value, d.GetAllocator());
+
+            for(auto const &key: queue.second)
+            {
+                stringStream.str("");
+                stringStream << static_cast<int>(key >> 32) << "/" << static_cast<int>(static_cast<uint32_t>(key));
+                transHash = stringStream.str();
+                value.SetString(transHash.c_str(), transHash.size(), d.GetAllocator());
+                array.PushBack(value, d.GetAllocator());
+            }
+            d.AddMember("inv", array, d.GetAllocator());
+
+            rapidjson::StringBuffer invInfo;
+            rapidjson::Writer<rapidjson::StringBuffer> invWriter(invInfo);
+            d.Accept(invWriter);
+
+            SendToPeer(queue.first, invInfo.GetString(), invInfo.GetSize(), INV);
+            m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
+
+            NS_LOG_INFO("SendTransactionInv: At time " << Simulator::Now().GetSeconds()
+                        << "s blockchain node " << GetNode()->GetId() << " announced "
+                        << queue.second.size() << " transactions to " << queue.first);
+            queue.second.clear();
+        }
+    }
+
+    void
+    BlockchainNode::ReceivedTransactionInv(rapidjson::Document &d, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        Ipv4Address peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
+
+        for(unsigned int j = 0; j < d["inv"].Size(); j++)
+        {
+            std::string invDelimiter = "/";
+            std::string parsedInv = d["inv"][j].GetString();
+            size_t invPos = parsedInv.find(invDelimiter);
+
+            int nodeId = atoi(parsedInv.substr(0, invPos).c_str());
+            int transId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
+            uint64_t key = getTransactionKey(nodeId, transId);
+
+            MarkTransactionKnown(peer, nodeId, transId);
+
+            if(HasTransaction(nodeId, transId))
+            {
+                continue;
+            }
+
+            std::deque<Ipv4Address> &announcers = m_transactionAnnouncers[key];
+
+            /*
+             * Only the first announcer is asked for the transaction. The others are kept
+             * as a fallback if the request times out.
+             */
+            if(announcers.empty() && m_transactionsInFlight.find(key) == m_transactionsInFlight.end())
+            {
+                m_peersTransactionRequestQueue[peer].push_back(key);
+            }
+            announcers.push_back(peer);
+        }
+
+        RequestTransactions(peer);
+    }
+
+    void
+    BlockchainNode::RequestTransactions(Ipv4Address peer)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::deque<uint64_t> &queue = m_peersTransactionRequestQueue[peer];
+        std::vector<uint64_t> requestTransactions;
+
+        while(!queue.empty() && m_peersTransactionsInFlight[peer] + requestTransactions.size() < m_maxTransactionsInFlight)
+        {
+            uint64_t key = queue.front();
+
+            queue.pop_front();
+            if(m_transaction.find(key) == m_transaction.end() && m_transactionsInFlight.find(key) == m_transactionsInFlight.end())
+            {
+                requestTransactions.push_back(key);
+            }
+        }
+
+        if(requestTransactions.empty())
+        {
+            return;
+        }
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+        std::ostringstream stringStream;
+        std::string transHash;
+
+        d.SetObject();
+
+        value.SetString("transaction");
+        d.AddMember("type", value, d.GetAllocator());
+
+        value = GET_DATA;
+        d.AddMember("message", value, d.GetAllocator());
+
+        for(auto const &key: requestTransactions)
+        {
+            stringStream.str("");
+            stringStream << static_cast<int>(key >> 32) << "/" << static_cast<int>(static_cast<uint32_t>(key));
+            transHash = stringStream.str();
+            value.SetString(transHash.c_str(), transHash.size(), d.GetAllocator());
+            array.PushBack(value, d.GetAllocator());
+
+            m_transactionsInFlight[key] = std::make_pair(peer, Simulator::Schedule(m_transactionRequestTimeout,
+                                                            &BlockchainNode::TransactionRequestExpired, this, key));
+            m_peersTransactionsInFlight[peer]++;
+        }
+        d.AddMember("transactions", array, d.GetAllocator());
+
+        rapidjson::StringBuffer requestInfo;
+        rapidjson::Writer<rapidjson::StringBuffer> requestWriter(requestInfo);
+        d.Accept(requestWriter);
+
+        SendToPeer(peer, requestInfo.GetString(), requestInfo.GetSize(), GET_DATA);
+        m_nodeStats->getDataSentBytes += m_blockchainMessageHeader + m_countBytes + d["transactions"].Size()*m_inventorySizeBytes;
+    }
+
+    void
+    BlockchainNode::SendTransactions(rapidjson::Document &d, Address &from)
+    {
+        NS_LOG_FUNCTION(this);
+
+        rapidjson::Document transD;
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+        Ipv4Address peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
+        int transactionBytes = 0;
+
+        m_nodeStats->getDataReceivedBytes += m_blockchainMessageHeader + m_countBytes + d["transactions"].Size()*m_inventorySizeBytes;
+
+        transD.SetObject();
+
+        value.SetString("transaction");
+        transD.AddMember("type", value, transD.GetAllocator());
+
+        value = TRANSACTION;
+        transD.AddMember("message", value, transD.GetAllocator());
+
+        for(unsigned int j = 0; j < d["transactions"].Size(); j++)
+        {
+            std::string invDelimiter = "/";
+            std::string parsedInv = d["transactions"][j].GetString();
+            size_t invPos = parsedInv.find(invDelimiter);
+
+            int nodeId = atoi(parsedInv.substr(0, invPos).c_str());
+            int transId = atoi(parsedInv.substr(invPos+1, parsedInv.size()).c_str());
+
+            // transactions that already left the mempool are not served, the requester will time out
+            if(!m_mempool.HasTransaction(nodeId, transId))
+            {
+                continue;
+            }
+
+            Transaction tran = m_mempool.ReturnTransaction(nodeId, transId);
+            rapidjson::Value transInfo(rapidjson::kObjectType);
+
+            value = tran.GetTransNodeId();
+            transInfo.AddMember("nodeId", value, transD.GetAllocator());
+
+            value = tran.GetTransId();
+            transInfo.AddMember("transId", value, transD.GetAllocator());
+
+            value = tran.GetTransTimeStamp();
+            transInfo.AddMember("timestamp", value, transD.GetAllocator());
+
+            value = tran.GetTransFee();
+            transInfo.AddMember("fee", value, transD.GetAllocator());
+
+            if(tran.GetDestinationShard() >= 0)
+            {
+                value = tran.GetDestinationShard();
+                transInfo.AddMember("shard", value, transD.GetAllocator());
+            }
+
+            array.PushBack(transInfo, transD.GetAllocator());
+            transactionBytes += tran.GetTransSizeByte();
+        }
+
+        if(array.Size() == 0)
+        {
+            return;
+        }
+
+        transD.AddMember("transactions", array, transD.GetAllocator());
+
+        rapidjson::StringBuffer transactionInfo;
+        rapidjson::Writer<rapidjson::StringBuffer> tranWriter(transactionInfo);
+        transD.Accept(tranWriter);
+
+        SendToPeer(peer, transactionInfo.GetString(), transactionInfo.GetSize(), TRANSACTION);
+        m_nodeStats->transactionSentBytes += m_blockchainMessageHeader + m_countBytes + transactionBytes;
+    }
+
+    void
+    BlockchainNode::TransactionRequestCompleted(uint64_t key)
+    {
+        auto request = m_transactionsInFlight.find(key);
+
+        if(request != m_transactionsInFlight.end())
+        {
+            Simulator::Cancel(request->second.second);
+            m_peersTransactionsInFlight[request->second.first]--;
+            m_transactionsInFlight.erase(request);
+        }
+        m_transactionAnnouncers.erase(key);
+    }
+
+    void
+    BlockchainNode::TransactionRequestExpired(uint64_t key)
+    {
+        NS_LOG_FUNCTION(this);
+
+        auto request = m_transactionsInFlight.find(key);
+
+        if(request == m_transactionsInFlight.end())
+        {
+            return;
+        }
+
+        Ipv4Address peer = request->second.first;
+
+        m_peersTransactionsInFlight[peer]--;
+        m_transactionsInFlight.erase(request);
+        m_nodeStats->transactionRequestTimeouts++;
+
+        NS_LOG_INFO("TransactionRequestExpired: At time " << Simulator::Now().GetSeconds()
+                    << "s blockchain node " << GetNode()->GetId() << " did not receive the transaction "
+                    << static_cast<int>(key >> 32) << "/" << static_cast<int>(static_cast<uint32_t>(key)) << " from " << peer);
+
+        std::deque<Ipv4Address> &announcers = m_transactionAnnouncers[key];
+
+        announcers.erase(std::remove(announcers.begin(), announcers.end(), peer), announcers.end());
+
+        if(m_transaction.find(key) != m_transaction.end() || announcers.empty())
+        {
+            m_transactionAnnouncers.erase(key);
+        }
+        else
+        {
+            // fall back to the next announcer, ahead of its other requests
+            Ipv4Address nextPeer = announcers.front();
+
+            m_peersTransactionRequestQueue[nextPeer].push_front(key);
+            RequestTransactions(nextPeer);
+        }
+
+        RequestTransactions(peer);
+    }
+
+    bool
+    BlockchainNode::HasTransaction(int nodeId, int transId)
+    {
+        return m_transaction.find(getTransactionKey(nodeId, transId)) != m_transaction.end();
+    }
+
+    void
+    BlockchainNode::ForgetDroppedTransactions(void)
+    {
+        for(auto const &key: m_mempool.TakeDroppedTransactions())
+        {
+            m_transaction.erase(key);
+        }
+    }
+
+    void
+    BlockchainNode::CreateTransaction()
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(!m_online)
+        {
+            ScheduleNextTransaction();
+            return;
+        }
+
+        rapidjson::Document transD;
+
+        int nodeId = GetNode()->GetId();
+        int transId = m_transactionId;
+        double tranTimestamp = Simulator::Now().GetSeconds();
+
+        transD.SetObject();
+
+        Transaction newTrans(nodeId, transId, tranTimestamp);
+        newTrans.SetTransFee(m_feeDistribution->GetInteger(1, 100) * newTrans.GetTransSizeByte());      // 1~100 per byte
+
+        if(m_noShards > 1 && m_crossShardDistribution->GetValue() < m_crossShardRatio)
+        {
+            newTrans.SetDestinationShard((m_shard + 1 + m_crossShardDistribution->GetInteger(0, m_noShards - 2)) % m_noShards);
+        }
+
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+        rapidjson::Value transInfo(rapidjson::kObjectType);
+
+        value.SetString("transaction");
+        transD.AddMember("type", value, transD.GetAllocator());
+
+        value = TRANSACTION;
+        transD.AddMember("message", value, transD.GetAllocator());
+
+        value = newTrans.GetTransNodeId();
+        transInfo.AddMember("nodeId", value, transD.GetAllocator());
+
+        value = newTrans.GetTransId();
+        transInfo.AddMember("transId", value, transD.GetAllocator());
+
+        value = newTrans.GetTransTimeStamp();
+        transInfo.AddMember("timestamp", value, transD.GetAllocator());
+
+        value = newTrans.GetTransFee();
+        transInfo.AddMember("fee", value, transD.GetAllocator());
+
+        if(newTrans.GetDestinationShard() >= 0)
+        {
+            value = newTrans.GetDestinationShard();
+            transInfo.AddMember("shard", value, transD.GetAllocator());
+        }
+
+        array.PushBack(transInfo, transD.GetAllocator());
+        transD.AddMember("transactions", array, transD.GetAllocator());
+
+        m_transaction.insert(getTransactionKey(nodeId, transId));
+        m_txTracker.TransactionCreated(newTrans);
+
+        rapidjson::StringBuffer transactionInfo;
+        rapidjson::Writer<rapidjson::StringBuffer> tranWriter(transactionInfo);
+        transD.Accept(tranWriter);
+
+        bool accepted = m_mempool.AddTransaction(newTrans, tranTimestamp);
+
+        ForgetDroppedTransactions();
+
+        if(!accepted)
+        {
+            NS_LOG_INFO("CreateTransaction: Blockchain node " << GetNode()->GetId()
+                        << " dropped its transaction " << transId << " because the mempool is full");
+            m_transactionId++;
+            ScheduleNextTransaction();
+            return;
+        }
+        m_signatureCache.Insert(getTransactionKey(nodeId, transId));
+
+        if(m_transactionRelayType == ANNOUNCE_TRANSACTIONS)
+        {
+            QueueTransactionInv(newTrans, Ipv4Address::GetAny());
+        }
+        else
+        {
+            for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+            {
+                if(!IsShardPeer(*i))
+                {
+                    continue;
+                }
+
+                MarkTransactionKnown(*i, nodeId, transId);
+                SendToPeer(*i, transactionInfo.GetString(), transactionInfo.GetSize(), TRANSACTION);
+                m_nodeStats->transactionSentBytes += m_blockchainMessageHeader + m_countBytes + newTrans.GetTransSizeByte();
+            }
+        }
+        //std::cout<< GetNode()->GetId() << "created and sent transaction\n";
+        m_transactionId++;
+
+        ScheduleNextTransaction();
+
+    }
+
+    void
+    BlockchainNode::ScheduleNextTransaction()
+    {
+        NS_LOG_FUNCTION(this);
+        double tTime = rand()%20+1;
+        m_nextTransaction = Simulator::Schedule(Seconds(tTime), &BlockchainNode::CreateTransaction, this);
+
+    }
+
+    void
+    BlockchainNode::BroadcastConsensusMessage(rapidjson::Document &d, Ipv4Address receivedFromIpv4)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::string id = d["id"].GetString();
+
+        if(m_consensusMessages.find(id) != m_consensusMessages.end())
+        {
+            NS_LOG_INFO("BroadcastConsensusMessage: blockchain node " << GetNode()->GetId() << " already relayed " << id);
+            return;
+        }
+        m_consensusMessages.insert(id);
+
+        for(auto const &peer: m_peersAddresses)
+        {
+            if(peer != receivedFromIpv4)
+            {
+                SendConsensusMessage(d, peer);
+            }
+        }
+    }
+
+    void
+    BlockchainNode::SendConsensusMessage(rapidjson::Document &d, Ipv4Address peer)
+    {
+        NS_LOG_FUNCTION(this);
+
+        rapidjson::StringBuffer packetInfo;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
+        d.Accept(writer);
+
+        SendToPeer(peer, packetInfo.GetString(), packetInfo.GetSize(), static_cast<enum Messages>(d["message"].GetInt()));
+        m_nodeStats->consensusSentBytes += m_blockchainMessageHeader + d["size"].GetInt();
+
+        NS_LOG_INFO("SendConsensusMessage: At time " << Simulator::Now().GetSeconds()
+                    << "s blockchain node " << GetNode()->GetId() << " sent " << packetInfo.GetString() << " to " << peer);
+    }
+
+    void
+    BlockchainNode::SendConsensusMessage(rapidjson::Document &d, int nodeId)
+    {
+        NS_LOG_FUNCTION(this << nodeId);
+
+        if(nodeId == static_cast<int>(GetNode()->GetId()))
+        {
+            ReceivedConsensusMessage(d);
+            return;
+        }
+
+        for(auto const &peer: m_peersNodeIds)
+        {
+            if(static_cast<int>(peer.second) == nodeId)
+            {
+                SendConsensusMessage(d, peer.first);
+                return;
+            }
+        }
+
+        BroadcastConsensusMessage(d, Ipv4Address("127.0.0.1"));
+    }
+
+    void
+    BlockchainNode::ReceivedConsensusMessage(rapidjson::Document &d)
+    {
+        NS_LOG_FUNCTION(this);
+        NS_LOG_INFO("ReceivedConsensusMessage: blockchain node " << GetNode()->GetId()
+                    << " has no consensus role and ignores " << d["id"].GetString());
+    }
+
+    double
+    BlockchainNode::GetSessionLength(Time mean)
+    {
+        switch(m_sessionDistribution)
+        {
+            case WEIBULL_SESSIONS:
+            {
+                return m_weibullSessions->GetValue(mean.GetSeconds() / std::tgamma(1 + 1 / m_sessionShape), m_sessionShape, 0);
+            }
+            case PARETO_SESSIONS:
+            {
+                /*
+                 * The mean of a Pareto distribution is finite for shape > 1
+                 */
+                return m_paretoSessions->GetValue(mean.GetSeconds(), std::max(m_sessionShape, 1.01), 0);
+            }
+            default:
+            {
+                return m_exponentialSessions->GetValue(mean.GetSeconds(), 0);
+            }
+        }
+    }
+
+    void
+    BlockchainNode::LeaveNetwork(void)
+    {
+        NS_LOG_FUNCTION(this);
 
-        stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
-        blockHash = stringStream.str();
+        NS_LOG_INFO("LeaveNetwork: At time " << Simulator::Now().GetSeconds() << "s blockchain node " << GetNode()->GetId()
+                    << " left the network at height " << m_blockchain.GetBlockchainHeight());
 
-        if(m_blockchain.HasBlock(newBlock) || m_blockchain.IsOrphan(newBlock) || ReceivedButNotValidated(blockHash))
+        m_online = false;
+        m_leaveTime = Simulator::Now().GetSeconds();
+        m_departures++;
+
+        /*
+         * The messages that did not reach TCP yet are lost with the node, and so is the sync in progress. A
+         * message partly written to a socket still leaves whole, otherwise the peer would parse a truncated one.
+         */
+        for(auto queue = m_peersSendQueues.begin(); queue != m_peersSendQueues.end();)
         {
-            NS_LOG_INFO("ReceiveBlock: Blockchain node " << GetNode()->GetId()
-                        << " has already added this block in the m_blockchain");
+            queue->second.Clear();
 
-            if (m_invTimeouts.find(blockHash) != m_invTimeouts.end())
+            if(queue->second.IsEmpty())
             {
-                m_queueInv.erase(blockHash);
-                Simulator::Cancel(m_invTimeouts[blockHash]);
-                m_invTimeouts.erase(blockHash);
+                queue = m_peersSendQueues.erase(queue);
             }
-        }
-        else
-        {
-            NS_LOG_INFO("ReceiveBlock: Blockchain node " << GetNode()->GetId()
-                        << " has not added this block in the m_blockchain");
-            
-            m_receivedNotValidated[blockHash] = newBlock;
-
-            if (m_invTimeouts.find(blockHash) != m_invTimeouts.end())
+            else
             {
-                m_queueInv.erase(blockHash);
-                Simulator::Cancel(m_invTimeouts[blockHash]);
-                m_invTimeouts.erase(blockHash);
+                queue++;
             }
-
-            ValidateBlock(newBlock);
         }
+        ClearSync();
 
+        m_churnEvent = Simulator::Schedule(Seconds(GetSessionLength(m_meanDowntime)), &BlockchainNode::JoinNetwork, this);
     }
 
     void
-    BlockchainNode::SendBlock(std::string packetInfo, Address &from)
+    BlockchainNode::JoinNetwork(void)
     {
         NS_LOG_FUNCTION(this);
 
-        NS_LOG_INFO("SendBlock: At time "<<  Simulator::Now().GetSeconds()
-                    << "s blockchain node " << GetNode()->GetId() << " sent "
-                    << packetInfo << " to " << InetSocketAddress::ConvertFrom(from).GetIpv4());
+        NS_LOG_INFO("JoinNetwork: At time " << Simulator::Now().GetSeconds() << "s blockchain node " << GetNode()->GetId()
+                    << " rejoined the network after " << Simulator::Now().GetSeconds() - m_leaveTime << "s");
 
-        SendMessage(GET_DATA, BLOCK,packetInfo, from);
+        m_online = true;
+        m_offlineTime += Simulator::Now().GetSeconds() - m_leaveTime;
+        m_churnEvent = Simulator::Schedule(Seconds(GetSessionLength(m_meanSessionLength)), &BlockchainNode::LeaveNetwork, this);
+
+        StartSync();
     }
 
     void
-    BlockchainNode::ReceivedHigherBlock(const Block &newBlock)
+    BlockchainNode::StartSync(void)
     {
         NS_LOG_FUNCTION(this);
-        NS_LOG_INFO("ReceivedHigherBlock: blockchain node : " <<GetNode()->GetId() 
-                    << " added a new block in the m_blockchain with higher height");
+
+        if(m_peersAddresses.empty())
+        {
+            return;
+        }
+
+        m_syncing = true;
+        m_syncHeadersDone = false;
+        m_syncServedPeers.clear();
+        m_syncPeer = m_peersAddresses[m_syncPeerDistribution->GetInteger(0, m_peersAddresses.size() - 1)];
+        m_syncLastHeader = "";
+        m_syncStartTime = Simulator::Now().GetSeconds();
+        m_syncStartBytes = m_nodeStats->headersReceivedBytes + m_nodeStats->blockReceivedBytes;
+
+        SendSyncGetHeaders();
+
+        Simulator::Cancel(m_syncStallEvent);
+        m_syncStallEvent = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::SyncStalled, this);
     }
 
     void
-    BlockchainNode::ValidateBlock(const Block &newBlock)
+    BlockchainNode::SendSyncGetHeaders(void)
     {
         NS_LOG_FUNCTION(this);
 
-        const Block *parent = m_blockchain.GetParent(newBlock);
+        rapidjson::Document d;
+        rapidjson::Value value;
+        rapidjson::Value locator(rapidjson::kArrayType);
+        Address syncPeer = InetSocketAddress(m_syncPeer, m_blockchainPort);
 
-        if(parent == nullptr)
+        d.SetObject();
+
+        value = GET_HEADERS;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString("block");
+        d.AddMember("type", value, d.GetAllocator());
+
+        if(!m_syncLastHeader.empty())
         {
-            NS_LOG_INFO("ValidateBlock : Block is an orphan");
-            m_blockchain.AddOrphan(newBlock);
-            
+            value.SetString(m_syncLastHeader.c_str(), m_syncLastHeader.size(), d.GetAllocator());
+            locator.PushBack(value, d.GetAllocator());
         }
-        else
+
+        for(auto const &block: m_blockchain.GetLocator())
         {
-            const int averageBlockSizeBytes = 238263;   // we should modify it
-            const double averageValidationTimeSeconds = 0.174;
-            double validationTime = averageValidationTimeSeconds * newBlock.GetBlockSizeBytes() / averageBlockSizeBytes;
-            ValidateTransaction(newBlock);
+            std::ostringstream blockHash;
 
-            //std::cout<<"validationTime : " << validationTime << "\n";
-            Simulator::Schedule (Seconds(validationTime), &BlockchainNode::AfterBlockValidation, this, newBlock);
-            NS_LOG_INFO("ValidateBlock : the block will be validated in " << validationTime << "s");
+            blockHash << block.first << "/" << block.second;
+            value.SetString(blockHash.str().c_str(), blockHash.str().size(), d.GetAllocator());
+            locator.PushBack(value, d.GetAllocator());
         }
+        d.AddMember("locator", locator, d.GetAllocator());
 
+        SendMessage(NO_MESSAGE, GET_HEADERS, d, syncPeer);
     }
 
     void
-    BlockchainNode::ValidateTransaction(const Block &newBlock)
+    BlockchainNode::SendSyncHeaders(rapidjson::Document &d, Address &from)
     {
-        std::vector<Transaction>                requestTransactions;
-        std::vector<Transaction>::iterator      trans_it;
-        std::vector<Transaction>::iterator      notValTrans_it;
-        requestTransactions = newBlock.GetTransactions();
+        NS_LOG_FUNCTION(this);
 
-        for(trans_it = requestTransactions.begin(); trans_it < requestTransactions.end(); trans_it++)
+        rapidjson::Value value;
+        rapidjson::Value array(rapidjson::kArrayType);
+        int forkHeight = 0;
+        int topHeight = m_blockchain.GetBlockchainHeight();
+
+        /*
+         * The fork point is the first locator entry on the main chain, the genesis if none is
+         */
+        for(unsigned int j = 0; j < d["locator"].Size(); j++)
         {
-            /*
-            std::cout<<"Node "<<GetNode()->GetId() << " is validating transaction nodeId : " 
-                    << trans_it->GetTransNodeId() << " transId: " << trans_it->GetTransId() << "\n";
-            */
-            
-            for(auto const &tran: m_transaction)
+            std::string blockHash = d["locator"][j].GetString();
+            size_t      invPos = blockHash.find("/");
+
+            int height = atoi(blockHash.substr(0, invPos).c_str());
+            int minerId = atoi(blockHash.substr(invPos+1, blockHash.size()).c_str());
+
+            if(m_blockchain.IsInMainChain(height, minerId))
             {
-                if(tran == *trans_it)
-                {
-                    break;
-                }
+                forkHeight = height;
+                break;
             }
-            
-            if(!m_notValidatedTransaction.empty())
-            {
+        }
 
-                for(notValTrans_it = m_notValidatedTransaction.begin(); notValTrans_it < m_notValidatedTransaction.end(); notValTrans_it++)
-                {
-                    if(*notValTrans_it == *trans_it)
-                    {
-                        if(trans_it->GetTransNodeId() == GetNode()->GetId())
-                        {
-                            m_totalCreatedTransaction++;
-                            m_meanLatency = (m_meanLatency*static_cast<double>(m_totalCreatedTransaction-1) + (Simulator::Now().GetSeconds() - trans_it->GetTransTimeStamp()))/static_cast<double>(m_totalCreatedTransaction);
-                        }
-                        notValTrans_it = m_notValidatedTransaction.erase(notValTrans_it);
-                        break;
-                    }
-                }
-            }
-            
-            m_transaction.push_back(*trans_it);
+        for(int height = forkHeight + 1; height <= topHeight && array.Size() < m_maxHeadersPerMessage; height++)
+        {
+            rapidjson::Value blockInfo(rapidjson::kObjectType);
+
+            WriteBlockInfo(*m_blockchain.GetMainChainBlock(height), false, blockInfo, d.GetAllocator());
+            array.PushBack(blockInfo, d.GetAllocator());
         }
+
+        NS_LOG_INFO("SendSyncHeaders: Blockchain node " << GetNode()->GetId() << " sends " << array.Size()
+                    << " headers after height " << forkHeight << " to " << InetSocketAddress::ConvertFrom(from).GetIpv4());
+
+        d.RemoveMember("locator");
+        d.AddMember("blocks", array, d.GetAllocator());
+
+        value = true;
+        d.AddMember("sync", value, d.GetAllocator());
+
+        SendMessage(GET_HEADERS, HEADERS, d, from);
     }
 
     void
-    BlockchainNode::AfterBlockValidation(const Block &newBlock)
+    BlockchainNode::ReceivedSyncHeaders(rapidjson::Document &d, Address &from)
     {
         NS_LOG_FUNCTION(this);
 
-        int height = newBlock.GetBlockHeight();
-        int minerId = newBlock.GetMinerId();
-        std::ostringstream  stringStream;
-        std::string         blockHash = stringStream.str();
-
-        stringStream << height << "/" << minerId;
-        blockHash = stringStream.str();
-
-        RemoveReceivedButNotvalidated(blockHash);
+        Ipv4Address peer = InetSocketAddress::ConvertFrom(from).GetIpv4();
 
-        NS_LOG_INFO("AfterBlockValidation : at time " << Simulator::Now().GetSeconds()
-                    << "s blockchain node " << GetNode()->GetId()
-                    << " validated block ");
-        if(newBlock.GetBlockHeight() > m_blockchain.GetBlockchainHeight())
+        if(!m_syncing || peer != m_syncPeer)
         {
-            ReceivedHigherBlock(newBlock);
+            NS_LOG_INFO("ReceivedSyncHeaders: Blockchain node " << GetNode()->GetId() << " is not syncing from " << peer);
+            return;
         }
 
-        if(m_blockchain.IsOrphan(newBlock))
+        for(unsigned int j = 0; j < d["blocks"].Size(); j++)
         {
-            NS_LOG_INFO("AfterBlockValidation: Block was orphan");
-             m_blockchain.RemoveOrphan(newBlock);
-        }
+            Block header = ReadBlockInfo(d["blocks"][j], from);
+            std::ostringstream stringStream;
 
-        m_meanBlockReceiveTime = (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks())*m_meanBlockReceiveTime
-                                + (newBlock.GetTimeReceived() - m_previousBlockReceiveTime)/(m_blockchain.GetTotalBlocks());
-        //std::cout << "m_meanBlockReceiveTime : "<<m_meanBlockReceiveTime <<"\n";
-        m_previousBlockReceiveTime = newBlock.GetTimeReceived();
-        
-        m_meanBlockPropagationTime =  (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks())*m_meanBlockPropagationTime
-                                + (newBlock.GetTimeReceived() -newBlock.GetTimeStamp())/(m_blockchain.GetTotalBlocks());
-        //std::cout << " m_meanBlockPropagationTime : "<< m_meanBlockPropagationTime <<"\n";
-        m_meanBlockSize = (m_blockchain.GetTotalBlocks() - 1)/static_cast<double>(m_blockchain.GetTotalBlocks()) * m_meanBlockSize
-                            + (newBlock.GetBlockSizeBytes())/static_cast<double>(m_blockchain.GetTotalBlocks());
-        
-        m_blockchain.AddBlock(newBlock);
-        AdvertiseNewBlock(newBlock);
-        ValidateOrphanChildren(newBlock);
-        
+            stringStream << header.GetBlockHeight() << "/" << header.GetMinerId();
+            m_syncLastHeader = stringStream.str();
+            MarkBlockAnnounced(peer, m_syncLastHeader);
 
-    }
+            if(m_blockchain.HasBlock(header) || m_blockchain.IsOrphan(header) || ReceivedButNotValidated(m_syncLastHeader)
+                || IsSyncPending(m_syncLastHeader))
+            {
+                continue;
+            }
 
-    void
-    BlockchainNode::ValidateOrphanChildren(const Block &newBlock)
-    {
-        NS_LOG_FUNCTION(this);
+            /*
+             * Known as a header, the blocks are not discarded as orphans if they arrive before their parents
+             */
+            m_onlyHeadersReceived[m_syncLastHeader] = header;
+            m_syncQueue[header.GetBlockHeight()] = m_syncLastHeader;
+            m_syncPending[header.GetBlockHeight()] = m_syncLastHeader;
+        }
 
-        std::vector<const Block *> children = m_blockchain.GetOrpharnChildrenPointer(newBlock);
+        NS_LOG_INFO("ReceivedSyncHeaders: Blockchain node " << GetNode()->GetId() << " received " << d["blocks"].Size()
+                    << " headers from " << peer << ", " << m_syncPending.size() << " blocks to download");
 
-        if(children.size() == 0)
+        if(d["blocks"].Size() >= m_maxHeadersPerMessage)
         {
-            NS_LOG_INFO("ValidateOrphanChildren : Block has no orpharn children\n");
+            SendSyncGetHeaders();
         }
         else
         {
-            NS_LOG_INFO("ValidateOrphanChildren : Block has orpharn children:");
-            std::vector<const Block *>::iterator block_it;
-            for(block_it = children.begin(); block_it < children.end(); block_it++)
-            {
-                ValidateBlock(**block_it);
-            }
+            m_syncHeadersDone = true;
         }
+
+        Simulator::Cancel(m_syncStallEvent);
+        m_syncStallEvent = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::SyncStalled, this);
+
+        RequestSyncBlocks();
+    }
+
+    bool
+    BlockchainNode::IsSyncPending(const std::string &blockHash) const
+    {
+        auto pending = m_syncPending.find(atoi(blockHash.substr(0, blockHash.find("/")).c_str()));
+
+        return pending != m_syncPending.end() && pending->second == blockHash;
     }
 
     void
-    BlockchainNode::AdvertiseNewBlock(const Block &newBlock)
+    BlockchainNode::RequestSyncBlocks(void)
     {
         NS_LOG_FUNCTION(this);
-        
-        rapidjson::Document d;
-        rapidjson::Value value;
-        rapidjson::Value array(rapidjson::kArrayType);
-        std::ostringstream stringStream;
-        std::string blockHash = stringStream.str();
-        d.SetObject();
 
-        value.SetString("blocks");
-        d.AddMember("type", value, d.GetAllocator());
+        if(!m_syncing)
+        {
+            return;
+        }
 
-        if(m_protocolType == STANDARD_PROTOCOL)
+        /*
+         * The window starts at the lowest block not received, so one slow block cannot let the
+         * downloads run arbitrarily far ahead of the validation
+         */
+        int windowEnd = m_syncPending.empty() ? 0 : m_syncPending.begin()->first + m_blockDownloadWindow;
+        auto block = m_syncQueue.begin();
+
+        while(block != m_syncQueue.end() && block->first < windowEnd)
         {
-            value = INV;
+            Ipv4Address peer;
+            rapidjson::Document d;
+            rapidjson::Value value;
+            rapidjson::Value array(rapidjson::kArrayType);
+
+            if(!SelectSyncPeer(block->first, peer))
+            {
+                break;
+            }
+
+            /*
+             * One GET_DATA per block, so that every block that arrives frees a place of its peer
+             */
+            d.SetObject();
+
+            value = GET_DATA;
             d.AddMember("message", value, d.GetAllocator());
 
-            stringStream << newBlock.GetBlockHeight() << "/" << newBlock.GetMinerId();
-            blockHash = stringStream.str();
-            value.SetString(blockHash.c_str(), blockHash.size(), d.GetAllocator());
+            value.SetString("block");
+            d.AddMember("type", value, d.GetAllocator());
+
+            value.SetString(block->second.c_str(), block->second.size(), d.GetAllocator());
             array.PushBack(value, d.GetAllocator());
-            d.AddMember("inv", array, d.GetAllocator());
+            d.AddMember("blocks", array, d.GetAllocator());
+
+            Address peerAddress = InetSocketAddress(peer, m_blockchainPort);
+            SendMessage(NO_MESSAGE, GET_DATA, d, peerAddress);
+
+            m_syncInFlight[block->second] = std::make_pair(peer, Simulator::Schedule(m_blockStallTimeout,
+                                                            &BlockchainNode::BlockRequestExpired, this, block->second));
+            m_peersBlocksInFlight[peer]++;
+            block = m_syncQueue.erase(block);
         }
 
-        rapidjson::StringBuffer packetInfo;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(packetInfo);
-        d.Accept(writer);
+        if(m_syncHeadersDone && m_syncPending.empty())
+        {
+            SyncCompleted();
+        }
+    }
 
-        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin() ; i != m_peersAddresses.end(); ++i)
+    bool
+    BlockchainNode::SelectSyncPeer(int height, Ipv4Address &peer)
+    {
+        double bestLoad = std::numeric_limits<double>::max();
+
+        for(auto const &candidate: m_peersAddresses)
         {
-            if(*i != newBlock.GetReceivedFromIpv4())
+            auto bestHeight = m_peersBestHeights.find(candidate);
+            auto uploadSpeed = m_peersUploadSpeeds.find(candidate);
+            uint32_t inFlight = m_peersBlocksInFlight[candidate];
+
+            if(inFlight >= m_maxBlocksInFlight || (bestHeight != m_peersBestHeights.end() && bestHeight->second < height))
             {
-                const uint8_t delimiter[] = "#";
-                //std::cout<<"node : " <<GetNode()->GetId()<< " Advertise new block\n";
-                m_peersSockets[*i]->Send(reinterpret_cast<const uint8_t*>(packetInfo.GetString()), packetInfo.GetSize(), 0);
-                m_peersSockets[*i]->Send(delimiter, 1, 0);
+                continue;
+            }
 
-                if(m_protocolType == STANDARD_PROTOCOL)
-                {
-                    m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_countBytes + d["inv"].Size()*m_inventorySizeBytes;
-                }
-                NS_LOG_INFO("AdvertiseNewBlock: At time " << Simulator::Now().GetSeconds()
-                            << "s blockchain node " << GetNode()->GetId() << " advertised a new block to " << *i);
+            /*
+             * The blocks already requested from the peer, in time units of its uplink
+             */
+            double load = (inFlight + 1) / (uploadSpeed != m_peersUploadSpeeds.end() && uploadSpeed->second > 0 ? uploadSpeed->second : 1);
 
+            if(load < bestLoad)
+            {
+                bestLoad = load;
+                peer = candidate;
             }
         }
+
+        return bestLoad < std::numeric_limits<double>::max();
+    }
+
+    void
+    BlockchainNode::BlockRequestExpired(std::string blockHash)
+    {
+        NS_LOG_FUNCTION(this << blockHash);
+
+        auto request = m_syncInFlight.find(blockHash);
+
+        if(request == m_syncInFlight.end())
+        {
+            return;
+        }
+
+        Ipv4Address peer = request->second.first;
+        int height = atoi(blockHash.substr(0, blockHash.find("/")).c_str());
+        auto pending = m_syncPending.find(height);
+
+        NS_LOG_INFO("BlockRequestExpired: At time " << Simulator::Now().GetSeconds() << "s blockchain node " << GetNode()->GetId()
+                    << " did not get " << blockHash << " from " << peer);
+
+        m_syncInFlight.erase(request);
+        m_peersBlocksInFlight[peer]--;
+        m_syncRequestTimeouts++;
+
         /*
-        if( GetNode()->GetId() == 5){
-            std::cout<< "AdvertiseNeBlock: At time " << Simulator::Now().GetSeconds()
-                            << "s blockchain node " << GetNode()->GetId() << " advertised a new block(height) :" 
-                            << newBlock.GetBlockHeight() << " minerId : " << newBlock.GetMinerId() <<"\n";
+         * A peer that ignores the request most likely does not have the block yet
+         */
+        if(m_peersBestHeights.find(peer) == m_peersBestHeights.end())
+        {
+            m_peersBestHeights[peer] = height - 1;
         }
-        */
-        
+
+        if(pending != m_syncPending.end() && pending->second == blockHash)
+        {
+            m_syncQueue[height] = blockHash;
+        }
+
+        RequestSyncBlocks();
     }
 
     void
-    BlockchainNode::AdvertiseNewTransaction(const Transaction &newTrans, Ipv4Address receivedFromIpv4)
+    BlockchainNode::SyncBlockReceived(const std::string &blockHash)
     {
         NS_LOG_FUNCTION(this);
 
-        rapidjson::Document transD;
-
-        int nodeId = newTrans.GetTransNodeId();
-        int transId = newTrans.GetTransId();
-        double tranTimestamp = newTrans.GetTransTimeStamp();
-
-        transD.SetObject();
+        if(!m_syncing)
+        {
+            return;
+        }
 
-        rapidjson::Value value;
-        rapidjson::Value array(rapidjson::kArrayType);
-        rapidjson::Value transInfo(rapidjson::kObjectType);
+        int height = atoi(blockHash.substr(0, blockHash.find("/")).c_str());
+        auto request = m_syncInFlight.find(blockHash);
+        auto pending = m_syncPending.find(height);
 
-        value.SetString("transaction");
-        transD.AddMember("type", value, transD.GetAllocator());
+        if(request != m_syncInFlight.end())
+        {
+            Simulator::Cancel(request->second.second);
+            m_peersBlocksInFlight[request->second.first]--;
+            m_syncServedPeers.insert(request->second.first);
+            m_syncInFlight.erase(request);
+        }
 
-        value = TRANSACTION;
-        transD.AddMember("message", value, transD.GetAllocator());
+        if(pending == m_syncPending.end() || pending->second != blockHash)
+        {
+            return;
+        }
 
-        value = newTrans.GetTransNodeId();
-        transInfo.AddMember("nodeId", value, transD.GetAllocator());
+        m_syncPending.erase(pending);
+        m_syncQueue.erase(height);
 
-        value = newTrans.GetTransId();
-        transInfo.AddMember("transId", value, transD.GetAllocator());
+        Simulator::Cancel(m_syncStallEvent);
+        m_syncStallEvent = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::SyncStalled, this);
 
-        value = newTrans.GetTransTimeStamp();
-        transInfo.AddMember("timestamp", value, transD.GetAllocator());
+        RequestSyncBlocks();
+    }
 
-        array.PushBack(transInfo, transD.GetAllocator());
-        transD.AddMember("transactions", array, transD.GetAllocator());
+    void
+    BlockchainNode::SyncStalled(void)
+    {
+        NS_LOG_FUNCTION(this);
 
-        rapidjson::StringBuffer transactionInfo;
-        rapidjson::Writer<rapidjson::StringBuffer> tranWriter(transactionInfo);
-        transD.Accept(tranWriter);
+        auto peer = std::find(m_peersAddresses.begin(), m_peersAddresses.end(), m_syncPeer);
 
-        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+        if(!m_syncing || peer == m_peersAddresses.end())
         {
-            if(*i != receivedFromIpv4)
-            {
-                const uint8_t delimiter[] = "#";
+            return;
+        }
 
-                m_peersSockets[*i]->Send(reinterpret_cast<const uint8_t*>(transactionInfo.GetString()), transactionInfo.GetSize(), 0);
-                m_peersSockets[*i]->Send(delimiter, 1, 0);
-            }
-        
+        m_syncPeer = ++peer != m_peersAddresses.end() ? *peer : m_peersAddresses.front();
+
+        NS_LOG_INFO("SyncStalled: At time " << Simulator::Now().GetSeconds() << "s blockchain node " << GetNode()->GetId()
+                    << " moves its header sync to " << m_syncPeer << " with " << m_syncInFlight.size() << " blocks in flight");
+
+        /*
+         * The heights guessed from the expired requests may be stale by now, the announcements of the peers set them again
+         */
+        m_peersBestHeights.clear();
+
+        if(!m_syncHeadersDone)
+        {
+            SendSyncGetHeaders();
         }
+        m_syncStallEvent = Simulator::Schedule(m_invTimeoutMinutes, &BlockchainNode::SyncStalled, this);
 
+        RequestSyncBlocks();
     }
 
-    bool
-    BlockchainNode::HasTransaction(int nodeId, int transId)
+    void
+    BlockchainNode::ClearSync(void)
     {
-        for(auto const &transaction: m_transaction)
+        NS_LOG_FUNCTION(this);
+
+        for(auto const &request: m_syncInFlight)
         {
-            if(transaction.GetTransNodeId() == nodeId && transaction.GetTransId() == transId)
-            {
-                return true;
-            }
+            Simulator::Cancel(request.second.second);
         }
-        return false;
+
+        m_syncing = false;
+        m_syncQueue.clear();
+        m_syncPending.clear();
+        m_syncInFlight.clear();
+        m_peersBlocksInFlight.clear();
+        Simulator::Cancel(m_syncStallEvent);
     }
 
     void
-    BlockchainNode::CreateTransaction()
+    BlockchainNode::SyncCompleted(void)
     {
         NS_LOG_FUNCTION(this);
 
-        rapidjson::Document transD;
-
-        int nodeId = GetNode()->GetId();
-        int transId = m_transactionId;
-        double tranTimestamp = Simulator::Now().GetSeconds();
-
-        transD.SetObject();
+        long receivedBytes = m_nodeStats->headersReceivedBytes + m_nodeStats->blockReceivedBytes - m_syncStartBytes;
 
-        Transaction newTrans(nodeId, transId, tranTimestamp);
+        NS_LOG_INFO("SyncCompleted: At time " << Simulator::Now().GetSeconds() << "s blockchain node " << GetNode()->GetId()
+                    << " caught up to height " << m_blockchain.GetBlockchainHeight() << " in "
+                    << Simulator::Now().GetSeconds() - m_syncStartTime << "s with " << receivedBytes << " Bytes from "
+                    << m_syncServedPeers.size() << " peers");
 
-        rapidjson::Value value;
-        rapidjson::Value array(rapidjson::kArrayType);
-        rapidjson::Value transInfo(rapidjson::kObjectType);
+        ClearSync();
 
-        value.SetString("transaction");
-        transD.AddMember("type", value, transD.GetAllocator());
+        m_catchUpTimes.AddSample(Simulator::Now().GetSeconds() - m_syncStartTime);
+        m_catchUpBytes += receivedBytes;
+    }
 
-        value = TRANSACTION;
-        transD.AddMember("message", value, transD.GetAllocator());
+    void
+    BlockchainNode::SendToPeer(Ipv4Address peer, const char *message, uint32_t size, enum Messages type)
+    {
+        NS_LOG_FUNCTION(this << peer << getMessageName(type));
 
-        value = newTrans.GetTransNodeId();
-        transInfo.AddMember("nodeId", value, transD.GetAllocator());
+        if(!m_online)
+        {
+            return;
+        }
 
-        value = newTrans.GetTransId();
-        transInfo.AddMember("transId", value, transD.GetAllocator());
+        if(m_flowNetwork != 0)
+        {
+            m_flowNetwork->Send(GetNode()->GetId(), peer, std::string(message, size));
+            return;
+        }
 
-        value = newTrans.GetTransTimeStamp();
-        transInfo.AddMember("timestamp", value, transD.GetAllocator());
+        auto queue = m_peersSendQueues.find(peer);
 
-        array.PushBack(transInfo, transD.GetAllocator());
-        transD.AddMember("transactions", array, transD.GetAllocator());
+        if(queue == m_peersSendQueues.end())
+        {
+            std::vector<uint32_t> weights(SendQueue::PRIORITY_CLASSES);
 
-        m_transaction.push_back(newTrans);
-        m_notValidatedTransaction.push_back(newTrans);
+            weights[CONSENSUS_PRIORITY] = m_consensusWeight;
+            weights[INVENTORY_PRIORITY] = m_inventoryWeight;
+            weights[BULK_PRIORITY] = m_bulkWeight;
+            queue = m_peersSendQueues.insert(std::make_pair(peer, SendQueue(weights))).first;
+        }
 
-        rapidjson::StringBuffer transactionInfo;
-        rapidjson::Writer<rapidjson::StringBuffer> tranWriter(transactionInfo);
-        transD.Accept(tranWriter);
+        bool connected = m_peersSockets.find(peer) != m_peersSockets.end();
 
-        for(std::vector<Ipv4Address>::const_iterator i = m_peersAddresses.begin(); i != m_peersAddresses.end(); ++i)
+        /*
+         * A peer that has not connected yet may be late or offline, so its queue is bounded
+         */
+        if(!connected && !ConnectsToPeer(peer) && queue->second.GetBytes() + size + 1 > m_maxUnconnectedQueueBytes)
         {
-            const uint8_t delimiter[] = "#";
-
-            m_peersSockets[*i]->Send(reinterpret_cast<const uint8_t*>(transactionInfo.GetString()), transactionInfo.GetSize(), 0);
-            m_peersSockets[*i]->Send(delimiter, 1, 0);
-        
+            NS_LOG_INFO("Node " << GetNode()->GetId() << " drops a " << getMessageName(type) << " to the unconnected " << peer);
+            m_unconnectedDroppedBytes += size + 1;
+            return;
         }
-        //std::cout<< GetNode()->GetId() << "created and sent transaction\n";
-        m_transactionId++;
 
-        ScheduleNextTransaction();
+        /*
+         * The delimiter is queued with its message, so that the messages of the other classes cannot split them
+         */
+        queue->second.Push(std::string(message, size).append("#"), getPriorityEnum(type), Simulator::Now().GetSeconds());
 
-    }
+        if(!connected)
+        {
+            if(!ConnectsToPeer(peer))
+            {
+                m_peersPeakSendQueueBytes[peer] = std::max(m_peersPeakSendQueueBytes[peer], queue->second.GetBytes());
+                return;
+            }
 
-    void
-    BlockchainNode::ScheduleNextTransaction()
-    {
-        NS_LOG_FUNCTION(this);
-        double tTime = rand()%20+1;
-        m_nextTransaction = Simulator::Schedule(Seconds(tTime), &BlockchainNode::CreateTransaction, this);
+            ConnectToPeer(peer);
+        }
 
+        FlushSendQueue(peer);
     }
 
     void
@@ -1366,8 +3956,6 @@ namespace ns3 {
     {
         NS_LOG_FUNCTION(this);
 
-        const uint8_t delimiter[] = "#";
-
         rapidjson::StringBuffer buffer;
         rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 
@@ -1378,8 +3966,16 @@ namespace ns3 {
                     << " and sent a " << getMessageName(responseMessage)
                     << " message: " << buffer.GetString() );
         
-        outgoingSocket->Send(reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-        outgoingSocket->Send(delimiter, 1, 0);
+        Address peerAddress;
+
+        if(outgoingSocket->GetPeerName(peerAddress) == 0 && InetSocketAddress::IsMatchingType(peerAddress))
+        {
+            SendToPeer(InetSocketAddress::ConvertFrom(peerAddress).GetIpv4(), buffer.GetString(), buffer.GetSize(), responseMessage);
+        }
+        else
+        {
+            NS_LOG_WARN("SendMessage: the socket is not connected, the " << getMessageName(responseMessage) << " message was not sent");
+        }
 
         switch(d["message"].GetInt())
         {
@@ -1416,6 +4012,21 @@ namespace ns3 {
                 m_nodeStats->blockSentBytes += m_blockchainMessageHeader;
                 break;
             }
+            case CHUNK_INV:
+            {
+                m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + (d["chunks"].GetStringLength() + 7)/8;
+                break;
+            }
+            case GET_CHUNKS:
+            {
+                m_nodeStats->getDataSentBytes += m_blockchainMessageHeader + m_inventorySizeBytes + m_countBytes + d["chunks"].Size() * m_countBytes;
+                break;
+            }
+            case CHUNK:
+            {
+                m_nodeStats->blockSentBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + m_countBytes + d["chunkSize"].GetInt();
+                break;
+            }
         }
 
     }
@@ -1425,8 +4036,6 @@ namespace ns3 {
     {
         NS_LOG_FUNCTION(this);
         
-        const uint8_t delimiter[] = "#";
-
         rapidjson::StringBuffer buffer;
         rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 
@@ -1438,16 +4047,7 @@ namespace ns3 {
                     << " message: " << buffer.GetString() );
         
         Ipv4Address outgoingIpv4Address = InetSocketAddress::ConvertFrom(outgoingAddress).GetIpv4();
-        std::map<Ipv4Address, Ptr<Socket>>::iterator it = m_peersSockets.find(outgoingIpv4Address);
-
-        if(it == m_peersSockets.end())
-        {
-            m_peersSockets[outgoingIpv4Address] = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
-            m_peersSockets[outgoingIpv4Address]->Connect(InetSocketAddress(outgoingIpv4Address, m_blockchainPort));
-        }
-
-        m_peersSockets[outgoingIpv4Address]->Send(reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-        m_peersSockets[outgoingIpv4Address]->Send(delimiter, 1, 0);
+        SendToPeer(outgoingIpv4Address, buffer.GetString(), buffer.GetSize(), responseMessage);
         
         switch(d["message"].GetInt())
         {
@@ -1486,6 +4086,21 @@ namespace ns3 {
                 //std::cout<<"finish add block size"<<"\n";
                 break;
             }
+            case CHUNK_INV:
+            {
+                m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + (d["chunks"].GetStringLength() + 7)/8;
+                break;
+            }
+            case GET_CHUNKS:
+            {
+                m_nodeStats->getDataSentBytes += m_blockchainMessageHeader + m_inventorySizeBytes + m_countBytes + d["chunks"].Size() * m_countBytes;
+                break;
+            }
+            case CHUNK:
+            {
+                m_nodeStats->blockSentBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + m_countBytes + d["chunkSize"].GetInt();
+                break;
+            }
         }
     }
 
@@ -1494,7 +4109,6 @@ namespace ns3 {
     {
         NS_LOG_FUNCTION(this);
         
-        const uint8_t delimiter[] = "#";
         rapidjson::Document d;
 
         rapidjson::StringBuffer buffer;
@@ -1509,16 +4123,7 @@ namespace ns3 {
                     << " message: " << buffer.GetString() );
         
         Ipv4Address outgoingIpv4Address = InetSocketAddress::ConvertFrom(outgoingAddress).GetIpv4();
-        std::map<Ipv4Address, Ptr<Socket>>::iterator it = m_peersSockets.find(outgoingIpv4Address);
-
-        if(it == m_peersSockets.end())
-        {
-            m_peersSockets[outgoingIpv4Address] = Socket::CreateSocket(GetNode(), TcpSocketFactory::GetTypeId());
-            m_peersSockets[outgoingIpv4Address]->Connect(InetSocketAddress(outgoingIpv4Address, m_blockchainPort));
-        }
-
-        m_peersSockets[outgoingIpv4Address]->Send(reinterpret_cast<const uint8_t*>(buffer.GetString()), buffer.GetSize(), 0);
-        m_peersSockets[outgoingIpv4Address]->Send(delimiter, 1, 0);
+        SendToPeer(outgoingIpv4Address, buffer.GetString(), buffer.GetSize(), responseMessage);
         
         switch(d["message"].GetInt())
         {
@@ -1555,6 +4160,21 @@ namespace ns3 {
                 m_nodeStats->blockSentBytes += m_blockchainMessageHeader;
                 break;
             }
+            case CHUNK_INV:
+            {
+                m_nodeStats->invSentBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + (d["chunks"].GetStringLength() + 7)/8;
+                break;
+            }
+            case GET_CHUNKS:
+            {
+                m_nodeStats->getDataSentBytes += m_blockchainMessageHeader + m_inventorySizeBytes + m_countBytes + d["chunks"].Size() * m_countBytes;
+                break;
+            }
+            case CHUNK:
+            {
+                m_nodeStats->blockSentBytes += m_blockchainMessageHeader + m_blockHeadersSizeBytes + m_countBytes + d["chunkSize"].GetInt();
+                break;
+            }
         }
 
     }
@@ -1658,14 +4278,61 @@ namespace ns3 {
     }
 
     void
-    BlockchainNode::RemoveSendTime()
+    BlockchainNode::ScheduleUpload(const std::string &packet, int sizeBytes, Address &to, enum Messages message)
+    {
+        NS_LOG_FUNCTION(this);
+
+        UploadScheduler::Upload upload;
+
+        upload.peer = InetSocketAddress::ConvertFrom(to).GetIpv4();
+        upload.address = to;
+        upload.packet = packet;
+        upload.message = message;
+        upload.sizeBytes = sizeBytes;
+        upload.requestTime = Simulator::Now().GetSeconds();
+
+        m_uploadScheduler.Enqueue(upload);
+
+        NS_LOG_INFO("ScheduleUpload: At time " << Simulator::Now().GetSeconds() << "s node " << GetNode()->GetId()
+                    << " queued " << sizeBytes << " Bytes for " << upload.peer << ", "
+                    << m_uploadScheduler.GetPendingUploads() << " uploads are pending");
+
+        if(!m_uploading)
+        {
+            StartNextUpload();
+        }
+    }
+
+    void
+    BlockchainNode::StartNextUpload(void)
     {
         NS_LOG_FUNCTION(this);
 
-        NS_LOG_INFO("RemoveSendTime : At time " << Simulator::Now().GetSeconds()
-                    << " " << m_sendBlockTimes.front() << " was removed");
+        if(!m_uploadScheduler.HasPendingUploads())
+        {
+            m_uploading = false;
+            return;
+        }
+
+        /*
+         * As before the message leaves when its upload starts, the receiver models the transfer time.
+         * The link is held for the upload time, so one event per upload both frees it and starts the next one.
+         */
+        UploadScheduler::Upload upload = m_uploadScheduler.Dequeue();
+
+        m_uploading = true;
+        m_uploadQueueingTimes.AddSample(Simulator::Now().GetSeconds() - upload.requestTime);
+
+        if(upload.message == BLOCK)
+        {
+            SendBlock(upload.packet, upload.address);
+        }
+        else
+        {
+            SendMessage(GET_CHUNKS, upload.message, upload.packet, upload.address);
+        }
 
-        m_sendBlockTimes.erase(m_sendBlockTimes.begin()); 
+        m_uploadEvent = Simulator::Schedule(Seconds(upload.sizeBytes / m_uploadSpeed), &BlockchainNode::StartNextUpload, this);
     }
 
     void
@@ -1680,13 +4347,49 @@ namespace ns3 {
     }
 
     void
-    BlockchainNode::RemoveReceiveTime()
+    BlockchainNode::ScheduleNextDownload(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::pair<int, double> next = m_downloadLink.GetNextCompletion();
+
+        Simulator::Cancel(m_downloadEvent);
+
+        if(next.first >= 0)
+        {
+            m_downloadEvent = Simulator::Schedule(Seconds(std::max(next.second - Simulator::Now().GetSeconds(), 0.0)),
+                                                  &BlockchainNode::DownloadCompleted, this);
+        }
+    }
+
+    void
+    BlockchainNode::DownloadCompleted(void)
     {
         NS_LOG_FUNCTION(this);
 
-        NS_LOG_INFO("RemoveReceiveTime: At time " << Simulator::Now().GetSeconds()
-                    << " " << m_receiveBlockTimes.front() << " was removed");
-        m_receiveBlockTimes.erase(m_receiveBlockTimes.begin());
+        int transfer = m_downloadLink.GetNextCompletion().first;
+        auto download = m_pendingDownloads.find(transfer);
+        auto chunkDownload = m_pendingChunkDownloads.find(transfer);
+
+        m_downloadLink.RemoveTransfer(transfer, Simulator::Now().GetSeconds());
+        ScheduleNextDownload();
+
+        if(download != m_pendingDownloads.end())
+        {
+            std::string blockInfo = download->second.first;
+            Address from = download->second.second;
+
+            m_pendingDownloads.erase(download);
+            ReceivedBlockMessage(blockInfo, from);
+        }
+        else if(chunkDownload != m_pendingChunkDownloads.end())
+        {
+            std::string chunkInfo = chunkDownload->second.first;
+            Address from = chunkDownload->second.second;
+
+            m_pendingChunkDownloads.erase(chunkDownload);
+            ReceivedChunkMessage(chunkInfo, from);
+        }
     }
 
     void 
@@ -1699,5 +4402,198 @@ namespace ns3 {
         m_receiveCompressedBlockTimes.erase(m_receiveCompressedBlockTimes.begin());
     }
 
+    TypeId
+    BlockchainFlowNetwork::GetTypeId(void)
+    {
+        static TypeId tid = TypeId("ns3::BlockchainFlowNetwork")
+            .SetParent<Object>()
+            .SetGroupName("Application")
+            .AddConstructor<BlockchainFlowNetwork>()
+            .AddAttribute("SegmentSize",
+                            "The TCP maximum segment size in Bytes, the default of ns3::TcpSocket",
+                            UintegerValue(536),
+                            MakeUintegerAccessor(&BlockchainFlowNetwork::m_segmentSize),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("HeaderBytes",
+                            "The header Bytes of every segment: TCP with timestamps, IPv4 and PPP",
+                            UintegerValue(54),
+                            MakeUintegerAccessor(&BlockchainFlowNetwork::m_headerBytes),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("InitialWindow",
+                            "The initial congestion window of a connection in segments",
+                            UintegerValue(1),
+                            MakeUintegerAccessor(&BlockchainFlowNetwork::m_initialWindow),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("ReceiveWindow",
+                            "The receive buffer of a connection in Bytes, which caps its congestion window",
+                            UintegerValue(131072),
+                            MakeUintegerAccessor(&BlockchainFlowNetwork::m_receiveWindow),
+                            MakeUintegerChecker<uint32_t>(1))
+            ;
+            return tid;
+    }
+
+    BlockchainFlowNetwork::BlockchainFlowNetwork() : m_deliveredMessages(0), m_droppedMessages(0), m_deliveredBytes(0)
+    {
+        NS_LOG_FUNCTION(this);
+        m_deliveryTimes = LatencyHistogram(0.00001, 100000, 0.05);
+        m_queueingTimes = LatencyHistogram(0.00001, 100000, 0.05);
+    }
+
+    BlockchainFlowNetwork::~BlockchainFlowNetwork(void)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    void
+    BlockchainFlowNetwork::DoDispose(void)
+    {
+        NS_LOG_FUNCTION(this);
+        m_nodes.clear();
+        m_links.clear();
+        Object::DoDispose();
+    }
+
+    void
+    BlockchainFlowNetwork::AddLink(uint32_t from, Ipv4Address to, uint32_t toNode, Ipv4Address fromAddress, double latency, double dataRate)
+    {
+        NS_LOG_FUNCTION(this << from << to << toNode);
+
+        FlowLink link;
+
+        link.toNode = toNode;
+        link.fromAddress = fromAddress;
+        link.latency = latency;
+        link.dataRate = dataRate;
+        link.busyUntil = 0;
+        link.congestionWindow = m_initialWindow;
+
+        m_links[from][to] = link;
+    }
+
+    void
+    BlockchainFlowNetwork::AddNode(BlockchainNode *node)
+    {
+        NS_LOG_FUNCTION(this);
+        m_nodes[node->GetNode()->GetId()] = node;
+    }
+
+    void
+    BlockchainFlowNetwork::RemoveNode(uint32_t nodeId)
+    {
+        NS_LOG_FUNCTION(this << nodeId);
+        m_nodes.erase(nodeId);
+    }
+
+    void
+    BlockchainFlowNetwork::Send(uint32_t from, Ipv4Address to, const std::string &message)
+    {
+        NS_LOG_FUNCTION(this << from << to);
+
+        auto node = m_links.find(from);
+
+        if(node == m_links.end() || node->second.find(to) == node->second.end())
+        {
+            NS_LOG_WARN("The flow network has no link from node " << from << " to " << to);
+            m_droppedMessages++;
+            return;
+        }
+
+        FlowLink &link = node->second[to];
+        double now = Simulator::Now().GetSeconds();
+        double start = std::max(now, link.busyUntil);
+
+        /*
+         * The message and its delimiter leave once the messages queued on the link before it are sent
+         */
+        link.busyUntil = start + GetTransferTime(link, message.size() + 1);
+
+        double delay = link.busyUntil + link.latency - now;
+
+        m_queueingTimes.AddSample(start - now);
+        m_deliveryTimes.AddSample(delay);
+
+        Simulator::Schedule(Seconds(delay), &BlockchainFlowNetwork::Deliver, this, link.toNode, link.fromAddress, message);
+    }
+
+    double
+    BlockchainFlowNetwork::GetTransferTime(FlowLink &link, uint32_t sizeBytes)
+    {
+        uint32_t segments = (sizeBytes + m_segmentSize - 1) / m_segmentSize;
+        uint32_t maxWindow = std::max(m_receiveWindow / m_segmentSize, 1u);
+        double segmentTime = (m_segmentSize + m_headerBytes) * 8 / link.dataRate;
+        double roundTripTime = 2 * link.latency + segmentTime;
+        double time = 0;
+
+        /*
+         * Every round trip the connection sends a window of segments and, while in slow start, doubles it.
+         * Once a window takes longer to send than the round trip the link is saturated and the window is irrelevant.
+         */
+        while(segments > 0)
+        {
+            uint32_t window = std::min(link.congestionWindow, maxWindow);
+            uint32_t sent = std::min(segments, window);
+
+            segments -= sent;
+            time += segments > 0 ? std::max(sent * segmentTime, roundTripTime) : sent * segmentTime;
+
+            if(link.congestionWindow < maxWindow)
+            {
+                link.congestionWindow = std::min(2 * link.congestionWindow, maxWindow);
+            }
+        }
+
+        return time;
+    }
+
+    void
+    BlockchainFlowNetwork::Deliver(uint32_t to, Ipv4Address fromAddress, std::string message)
+    {
+        NS_LOG_FUNCTION(this << to << fromAddress);
+
+        auto node = m_nodes.find(to);
+
+        if(node == m_nodes.end())
+        {
+            m_droppedMessages++;
+            return;
+        }
+
+        Address from = InetSocketAddress(fromAddress, node->second->m_blockchainPort);
+
+        m_deliveredMessages++;
+        m_deliveredBytes += message.size() + 1;
+        node->second->HandleMessage(message, from);
+    }
+
+    long
+    BlockchainFlowNetwork::GetDeliveredMessages(void) const
+    {
+        return m_deliveredMessages;
+    }
+
+    long
+    BlockchainFlowNetwork::GetDroppedMessages(void) const
+    {
+        return m_droppedMessages;
+    }
+
+    double
+    BlockchainFlowNetwork::GetDeliveredBytes(void) const
+    {
+        return m_deliveredBytes;
+    }
+
+    const LatencyHistogram&
+    BlockchainFlowNetwork::GetDeliveryTimes(void) const
+    {
+        return m_deliveryTimes;
+    }
+
+    const LatencyHistogram&
+    BlockchainFlowNetwork::GetQueueingTimes(void) const
+    {
+        return m_queueingTimes;
+    }
 
-}
\ No newline at end of file
+}
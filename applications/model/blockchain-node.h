@@ -2,11 +2,17 @@
 #define BLOCKCHAIN_NODE_H
 
 #include <algorithm>
+#include <unordered_set>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <memory>
 #include "ns3/application.h"
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/traced-callback.h"
 #include "ns3/address.h"
+#include "ns3/random-variable-stream.h"
 #include "blockchain.h"
 #include "ns3/boolean.h"
 #include "../../rapidjson/document.h"
@@ -18,11 +24,17 @@ namespace ns3 {
     class Address;
     class Socket;
     class Packet;
+    class BlockchainFlowNetwork;
 
     class BlockchainNode : public Application
     {
         public:
 
+            /*
+             * The random variable streams of a node are stream, stream + 1, ... stream + STREAMS_PER_NODE - 1
+             */
+            static const int64_t STREAMS_PER_NODE = 6;
+
             static TypeId GetTypeId(void);
             BlockchainNode(void);
 
@@ -42,8 +54,47 @@ namespace ns3 {
 
             void SetNodeStats (nodeStatistics *nodeStats);
 
+            /*
+             * Assign fixed random variable stream numbers to the random variables of the node.
+             * Returns the number of streams used, at most STREAMS_PER_NODE. BlockchainNodeHelper::AssignStreams
+             * calls it with streams derived from the node id, the nodes left out use the streams ns-3 assigns.
+             */
+            virtual int64_t AssignStreams (int64_t stream);
+
             void SetProtocolType (enum ProtocolType protocolType);
 
+            /*
+             * The node id of each peer, used to send addressed messages straight to a neighbour
+             */
+            void SetPeersNodeIds (const std::map<Ipv4Address, uint32_t> &peersNodeIds);
+
+            /*
+             * The shard of each peer, the peers missing from the map are in the shard of the node
+             */
+            void SetPeersShards (const std::map<Ipv4Address, uint32_t> &peersShards);
+
+            /*
+             * Sends the messages of the node through the flow-level model instead of its TCP sockets.
+             * All the nodes of the network must share it.
+             */
+            void SetFlowNetwork (Ptr<BlockchainFlowNetwork> flowNetwork);
+
+            /*
+             * The node adds its transaction latencies to them when it stops. All the nodes of the process may share them.
+             */
+            void SetTransactionLatencies (TransactionLatencies *transactionLatencies);
+
+            /*
+             * The bytes waiting for the TCP send buffer of the connection to a peer
+             * param peer : the address of the peer
+             */
+            uint32_t GetSendQueueBytes (Ipv4Address peer) const;
+
+            /*
+             * False while the node has left the network
+             */
+            bool IsOnline (void) const;
+
 
         protected:
 
@@ -59,12 +110,88 @@ namespace ns3 {
             void HandleRead (Ptr<Socket> socket);
 
             /*
-             * Handle an incoming connection
+             * Handles a message received from a socket or from the flow-level model
+             * param message : the serialized message, without the delimiter
+             * param from : the address the message was received from
+             */
+            void HandleMessage (const std::string &message, Address &from);
+
+            /*
+             * Handles a parsed message
+             * param d : the message
+             * param from : the address the message was received from
+             */
+            void ProcessMessage (rapidjson::Document &d, Address &from);
+
+            /*
+             * Handles a message once the cpu of the node processed it. The message is parsed once on receipt
+             * and kept for the scheduled event.
+             * param d : the parsed message
+             * param from : the address the message was received from
+             */
+            void ProcessQueuedMessage (std::shared_ptr<rapidjson::Document> d, Address from);
+
+            /*
+             * Queues a task on the earliest free core of the node
+             * param cost : the cpu time of the task in seconds
+             * return : the time until the task finishes, queueing included
+             */
+            double ScheduleCpuTask (double cost);
+
+            /*
+             * Queues the processing of a received message on the cpu of the node. The messages of a peer
+             * are processed in the order they arrived, whatever core they run on.
+             * param d : the message
+             * param from : the address the message was received from
+             * return : the time until the message is processed
+             */
+            double ScheduleMessageProcessing (rapidjson::Document &d, Address &from);
+
+            /*
+             * Handle an incoming connection. The connection becomes the socket of the peer, which the node
+             * also uses to send, unless the node connected to the peer itself.
              * param socket : the incoming connection socket
              * param from : the address the connection is from
              */
             void HandleAccept (Ptr<Socket> socket, const Address& from);
 
+            /*
+             * True if the node opens the connection to the peer: the node with the lower id connects and the other
+             * one accepts, so every pair of peers shares one connection. Without the node id of the peer both connect,
+             * and so does a node with InitialBlockDownload, whose peers failed to connect before it started.
+             * param peer : the address of the peer
+             */
+            bool ConnectsToPeer (Ipv4Address peer) const;
+
+            /*
+             * Opens the connection to a peer. A failed connection is forgotten, so that the next message
+             * connects again or the peer connects to us once it listens.
+             * param peer : the address of the peer
+             */
+            void ConnectToPeer (Ipv4Address peer);
+
+            void HandleConnectionFailed (Ptr<Socket> socket);
+
+            /*
+             * Forgets a failed or closed peer connection and the bytes queued for it
+             * param socket : the connection
+             * param reason : what happened to it, for the log
+             */
+            void RemovePeerSocket (Ptr<Socket> socket, const std::string &reason);
+
+            /*
+             * Called when the send buffer of a peer connection has room again
+             * param socket : the connection
+             * param available : the free bytes of its send buffer
+             */
+            void HandleSend (Ptr<Socket> socket, uint32_t available);
+
+            /*
+             * Moves the queued bytes of a peer into the send buffer of its connection, as far as they fit
+             * param peer : the address of the peer
+             */
+            void FlushSendQueue (Ipv4Address peer);
+
             /*
              * handle an connection close
              * param socket : the connected socket
@@ -84,6 +211,27 @@ namespace ns3 {
              */
             void ReceivedBlockMessage(std::string &blockInfo, Address &from);
 
+            /*
+             * Handles a downloaded block, whole or assembled from its chunks. The block is dropped if its parent is unknown.
+             * param newBlock : the downloaded block
+             * param from : the address the block (or its last chunk) was received from
+             */
+            void ReceivedBlockData(const Block &newBlock, Address &from);
+
+            /*
+             * Writes the fields of a block into the block object of a message
+             * param withTransactions : true to include the transactions, false for the header fields only
+             */
+            void WriteBlockInfo(const Block &block, bool withTransactions, rapidjson::Value &blockInfo, rapidjson::Document::AllocatorType &allocator);
+            void WriteTransactionsInfo(const std::vector<Transaction> &transactions, rapidjson::Value &array, rapidjson::Document::AllocatorType &allocator);
+
+            /*
+             * Reads the block object of a message, with its transactions if the message carries them
+             * param from : the address the message was received from
+             */
+            Block ReadBlockInfo(const rapidjson::Value &blockInfo, Address &from);
+            std::vector<Transaction> ReadTransactionsInfo(const rapidjson::Value &array);
+
             /*
              * Called when a new block non-orphan block is received
              * param newBlock : the newly received block
@@ -114,8 +262,26 @@ namespace ns3 {
              * Adds the new block in to the blockchain, advertises it to the peers and validates any ophan children
              * param newBlock : the new block
              */
-            void AfterBlockValidation(const Block &newBlock);
+            virtual void AfterBlockValidation(const Block &newBlock);
             
+            /*
+             * Called when the header of a block extending a known block is received, before the block is downloaded
+             * param header : the block with the header fields only
+             */
+            virtual void ReceivedHeader(const Block &header);
+
+            /*
+             * Called when a block fails the full validation, after it was rejected
+             * param newBlock : the invalid block
+             */
+            virtual void ReceivedInvalidBlock(const Block &newBlock);
+
+            /*
+             * Drops the orphans that descend from a rejected block
+             * param newBlock : the rejected block
+             */
+            void DiscardOrphanChildren(const Block &newBlock);
+
             /*
              * Validates any orphan children of the newly received block
              * param newBlock : the new block
@@ -129,19 +295,249 @@ namespace ns3 {
             void AdvertiseNewBlock (const Block &newBlock);
 
             /*
-             * Advertises the newly validated block when blockTorrent is used
+             * Advertises the newly validated block when blockTorrent is used, with a CHUNK_INV holding all its chunks
              * param newBlock : the new block
              */
-            //void AdvertiseFullBlock (const Block &newBlock);
+            void AdvertiseFullBlock (const Block &newBlock);
+
+            /*
+             * Announces the chunks received so far to the peers of the shard that miss some of them, so that
+             * the chunks are relayed before the whole block arrived
+             * param chunkedBlock : the block being received
+             */
+            void AdvertiseChunks (const ChunkedBlock &chunkedBlock);
+
+            /*
+             * Sends a CHUNK_INV message
+             * param header : the announced block
+             * param bitmap : the chunks of the block the node has, in the format of ChunkedBlock::GetBitmap()
+             * param peer : the address of the peer
+             */
+            void SendChunkInv (const Block &header, const std::string &bitmap, Ipv4Address peer);
+
+            /*
+             * Handles a CHUNK_INV message: records the chunks of the peer and requests the missing ones from it
+             * param d : the CHUNK_INV message
+             * param from : the address the CHUNK_INV was received from
+             */
+            void ReceivedChunkInv (rapidjson::Document &d, Address &from);
+
+            /*
+             * Sends a GET_CHUNKS for the missing chunks of a block the peer has, within the in-flight limit
+             * param blockHash : the block hash
+             * param from : the address of the peer
+             */
+            void RequestChunks (const std::string &blockHash, Address &from);
+
+            /*
+             * Answers a GET_CHUNKS message with a CHUNK message per chunk the node has, queued on the upload link
+             * param d : the GET_CHUNKS message
+             * param from : the address the GET_CHUNKS was received from
+             */
+            void SendChunks (rapidjson::Document &d, Address &from);
+
+            /*
+             * Handles a downloaded CHUNK message: relays the new chunk, requests more from the peer and assembles the block
+             * param chunkInfo : the CHUNK message
+             * param from : the address the CHUNK was received from
+             */
+            void ReceivedChunkMessage (std::string &chunkInfo, Address &from);
 
             void AdvertiseNewTransaction(const Transaction &newTrans, Ipv4Address receivedFromIpv4);
             
             bool HasTransaction(int nodeId, int transId);
 
+            /*
+             * Forgets the transactions that the mempool evicted or expired, so that they can be requested again
+             */
+            void ForgetDroppedTransactions(void);
+
+            /*
+             * Record that a peer knows a block or a transaction, because it announced it to us or we sent it.
+             * param peer : the address of the peer
+             */
+            void MarkBlockKnown(Ipv4Address peer, const std::string &blockHash);
+
+            /*
+             * Record a block that a peer announced or sent to us. It also raises the best height known for the peer,
+             * which the sync requests the blocks by, so the blocks we send to the peer must not go through it.
+             * param peer : the address of the peer
+             */
+            void MarkBlockAnnounced(Ipv4Address peer, const std::string &blockHash);
+            void MarkTransactionKnown(Ipv4Address peer, int nodeId, int transId);
+
+            /*
+             * Checks the known inventory filter of a peer. False positives are possible, at the configured rate.
+             * return true : if the peer is believed to know the item, false : otherwise
+             */
+            bool PeerKnowsBlock(Ipv4Address peer, const std::string &blockHash);
+            bool PeerKnowsTransaction(Ipv4Address peer, int nodeId, int transId);
+
+            /*
+             * True if the peer belongs to the shard of the node. Blocks and transactions stay in their shard,
+             * the links to the other shards only carry the addressed messages.
+             */
+            bool IsShardPeer(Ipv4Address peer) const;
+
+            /*
+             * Queues the transaction to be announced to the peers in the next batched INV message
+             * param receivedFromIpv4 : the peer the transaction was received from, which is skipped
+             */
+            void QueueTransactionInv(const Transaction &newTrans, Ipv4Address receivedFromIpv4);
+
+            /*
+             * Sends the queued transaction announcements, one INV message per peer
+             */
+            void SendTransactionInv(void);
+
+            /*
+             * Handles an INV message announcing transactions
+             * param d : the INV message
+             * param from : the address the INV was received from
+             */
+            void ReceivedTransactionInv(rapidjson::Document &d, Address &from);
+
+            /*
+             * Sends a GET_DATA for the queued transaction requests of a peer, within the in-flight limit
+             * param peer : the address of the peer
+             */
+            void RequestTransactions(Ipv4Address peer);
+
+            /*
+             * Answers a GET_DATA message for transactions with a TRANSACTION message
+             * param d : the GET_DATA message
+             * param from : the address the GET_DATA was received from
+             */
+            void SendTransactions(rapidjson::Document &d, Address &from);
+
+            /*
+             * Clears the pending request of a transaction when it is received
+             * param key : the transaction key
+             */
+            void TransactionRequestCompleted(uint64_t key);
+
+            /*
+             * Called when a requested transaction was not received in time, asks the next announcer
+             * param key : the transaction key
+             */
+            void TransactionRequestExpired(uint64_t key);
+
             void CreateTransaction();
 
             void ScheduleNextTransaction();
 
+            /*
+             * Sends an addressed message (VOTE, NEW_VIEW or a message of the execute-order-validate pipeline) to the peers.
+             * The message carries the node id it is addressed to ("to"), its modeled size ("size") and a unique "id".
+             * The peers that are not the recipient relay it once, so the message reaches nodes that are not neighbours in the overlay.
+             * param d : the consensus message
+             * param receivedFromIpv4 : the peer the message was received from, which is skipped
+             */
+            void BroadcastConsensusMessage(rapidjson::Document &d, Ipv4Address receivedFromIpv4);
+
+            /*
+             * Sends an addressed message to a single peer
+             * param d : the consensus message
+             * param peer : the address of the peer
+             */
+            void SendConsensusMessage(rapidjson::Document &d, Ipv4Address peer);
+
+            /*
+             * Sends an addressed message to a node, directly if it is a neighbour or else through the overlay
+             * param d : the consensus message
+             * param nodeId : the node id of the recipient, which may be this node
+             */
+            void SendConsensusMessage(rapidjson::Document &d, int nodeId);
+
+            /*
+             * Called when an addressed message for this node is received
+             * param d : the consensus message
+             */
+            virtual void ReceivedConsensusMessage(rapidjson::Document &d);
+
+            /*
+             * Draws a session or downtime length in seconds from m_sessionDistribution
+             * param mean : the mean length
+             */
+            double GetSessionLength(Time mean);
+
+            /*
+             * Churn: the node drops the messages it receives and sends nothing until it rejoins.
+             * The miners stop mining while they are offline.
+             */
+            virtual void LeaveNetwork(void);
+
+            /*
+             * The node rejoins and catches up with a header-first sync from one of its peers
+             */
+            virtual void JoinNetwork(void);
+
+            /*
+             * Header-first sync, on a rejoin or at the start with InitialBlockDownload: GET_HEADERS with a locator
+             * of the main chain to the sync peer, which answers with HEADERS of its main chain after the fork point,
+             * at most m_maxHeadersPerMessage per message. The blocks of the headers are fetched in parallel from all
+             * the peers that have them, m_maxBlocksInFlight per peer, within m_blockDownloadWindow blocks of the
+             * lowest block not received yet.
+             */
+            void StartSync(void);
+
+            /*
+             * Sends GET_HEADERS to the sync peer, with the last header received as the first locator entry
+             */
+            void SendSyncGetHeaders(void);
+
+            /*
+             * Answers a GET_HEADERS with a locator
+             */
+            void SendSyncHeaders(rapidjson::Document &d, Address &from);
+
+            void ReceivedSyncHeaders(rapidjson::Document &d, Address &from);
+
+            /*
+             * True if the block is one of the blocks of the sync headers not received yet
+             */
+            bool IsSyncPending(const std::string &blockHash) const;
+
+            /*
+             * Requests the queued blocks of the download window from the least loaded peers, or completes the sync
+             */
+            void RequestSyncBlocks(void);
+
+            /*
+             * Picks the peer to request a block of the height from: the peer with the fewest blocks in flight for
+             * its upload speed, among the peers below m_maxBlocksInFlight that are not known to be behind the height
+             * return : false if every peer is busy or behind
+             */
+            bool SelectSyncPeer(int height, Ipv4Address &peer);
+
+            /*
+             * The peer did not deliver the block within m_blockStallTimeout, the block goes back to the queue
+             */
+            void BlockRequestExpired(std::string blockHash);
+
+            void SyncBlockReceived(const std::string &blockHash);
+
+            /*
+             * No block for m_invTimeoutMinutes: the header sync moves to the next peer and the guessed peer heights are dropped
+             */
+            void SyncStalled(void);
+
+            /*
+             * Cancels the block requests and forgets the sync in progress
+             */
+            void ClearSync(void);
+
+            void SyncCompleted(void);
+
+            /*
+             * Writes a serialized message and its delimiter to a peer, on its socket or on m_flowNetwork.
+             * The socket is connected on the first message, or the message waits for the peer to connect.
+             * The bytes that do not fit in the send buffer wait in the send queue of the peer, nothing is dropped.
+             * param peer : the address of the peer
+             * param type : the type of the message, which sets its class in the send queue
+             */
+            void SendToPeer(Ipv4Address peer, const char *message, uint32_t size, enum Messages type);
+
             /*
              * Send a message to a peer
              * param receivedMessage : the type of the received message
@@ -196,9 +592,18 @@ namespace ns3 {
             bool OnlyHeadersReceived (std::string blockHash);
 
             /*
-             * Remove the first element from m_sendBlockTimes, when a block is sent
+             * Queues a BLOCK or a CHUNK message on the upload link of the node
+             * param packet : the message
+             * param sizeBytes : the bytes it keeps the upload link busy
+             * param to : the address the request was received from
+             * param message : the type of the message
              */
-            void RemoveSendTime();
+            void ScheduleUpload(const std::string &packet, int sizeBytes, Address &to, enum Messages message = BLOCK);
+
+            /*
+             * Sends the next upload picked by m_uploadScheduler and schedules its completion, which starts the following one
+             */
+            void StartNextUpload(void);
 
             /*
              * Remove the first element from m_sendCompressedBlockTimes, when a compressd-block is sent
@@ -206,9 +611,14 @@ namespace ns3 {
             void RemoveCompressedBlockSendTime();
 
             /*
-             * Removes the first element from m_receivedBlockTimes, when block is received
+             * Schedules the end of the block download that finishes first on m_downloadLink
+             */
+            void ScheduleNextDownload(void);
+
+            /*
+             * The first block or chunk download finished, the others share the downlink from now on
              */
-            void RemoveReceiveTime();
+            void DownloadCompleted(void);
 
             /*
              * Removes the first element from m_receiveCompressedBlockTime, when a compressed-block is received
@@ -239,22 +649,130 @@ namespace ns3 {
             int             m_totalMining;
             int             m_totalCreatedTransaction;
             EventId         m_nextTransaction;
-
-            std::vector<Transaction>                        m_transaction;
-            std::vector<Transaction>                        m_notValidatedTransaction;            
+            uint32_t        m_transactionSampleRate;        //Track one out of every n transactions
+            uint32_t        m_confirmationDepth;            //Blocks needed to consider a transaction confirmed
+            Time            m_transactionRetentionTime;     //How long after its creation a transaction is tracked
+            TransactionTracker m_txTracker;                 //Transaction lifecycle tracker
+            uint32_t        m_mempoolMaxSizeBytes;          //The memory budget of the mempool
+            Time            m_mempoolExpiry;                //The time after which a transaction leaves the mempool
+            uint32_t        m_knownInventoryFilterItems;    //Items per generation of the known inventory filters
+            double          m_knownInventoryFilterFpRate;   //Target false positive rate of the known inventory filters
+            bool            m_knownInventoryAudit;          //Keep exact known inventory sets to measure false positives
+            long            m_suppressedBlockAdvertisements;
+            long            m_suppressedTransactionSends;
+            long            m_inventoryFalsePositives;
+            long            m_inventoryNegativeQueries;
+            enum TransactionRelayType m_transactionRelayType;   //Push full transactions or announce them
+            Time            m_transactionInvInterval;       //Interval between the batched transaction INV messages
+            uint32_t        m_maxTransactionsInFlight;      //Transactions requested from a peer at the same time
+            Time            m_transactionRequestTimeout;    //Time to wait for a requested transaction
+            EventId         m_transactionInvEvent;
+            double          m_transactionValidationTime;        //Seconds to validate a transaction missing from the signature cache
+            double          m_cachedTransactionValidationTime;  //Seconds to validate a cached transaction
+            uint32_t        m_signatureCacheSize;
+            SignatureCache  m_signatureCache;                   //Transactions verified on mempool entry
+            enum ForkChoiceRule m_forkChoiceRule;               //How the top block of m_blockchain is chosen
+            double          m_startTime;
+            int             m_committedEndorsedBlocks;          //Blocks of the ordering service validated by the node
+            long            m_committedEndorsedTransactions;
+            LatencyHistogram m_endToEndTimes;                   //Proposal to the endorsers -> committed by the node
+            uint32_t        m_cpuCores;                         //Cores processing the messages and validations, 0 for unlimited
+            double          m_messageProcessingTime;            //Seconds to parse and dispatch a message
+            double          m_cpuBusyTime;
+            int             m_invalidBlocks;                    //Blocks rejected by the full validation
+            LatencyHistogram m_cpuQueueingTimes;                //Task ready -> task started on a core
+            std::vector<double> m_coreFreeTimes;                //The time each core finishes its queued tasks
+            uint32_t        m_shard;                            //The shard whose chain the node keeps
+            uint32_t        m_noShards;
+            double          m_crossShardRatio;                  //Fraction of the created transactions paying to another shard
+            enum UploadDiscipline m_uploadDiscipline;           //How the upload link picks the next requested block
+            UploadScheduler m_uploadScheduler;                  //Blocks waiting for the upload link, per peer
+            bool            m_uploading;                        //True while the upload link sends a block
+            EventId         m_uploadEvent;                      //The end of the current upload
+            LatencyHistogram m_uploadQueueingTimes;             //GET_DATA received -> upload started
+            DownloadLink    m_downloadLink;                     //Block downloads sharing the downlink
+            EventId         m_downloadEvent;                    //The end of the download that finishes first
+            Ptr<BlockchainFlowNetwork> m_flowNetwork;           //Shared flow-level transport, 0 for the TCP sockets
+            uint32_t        m_chunkSizeBytes;                   //The chunk size of BLOCK_TORRENT
+            uint32_t        m_maxChunksInFlight;                //Chunks of a block requested from a peer at the same time
+            int             m_chunkedBlocksReceived;            //Blocks assembled from their chunks
+            long            m_chunksReceived;
+            long            m_duplicateChunks;                  //Chunks received once the node had them or the whole block
+            uint32_t        m_consensusWeight;                  //The send queue weight of CONSENSUS_PRIORITY
+            uint32_t        m_inventoryWeight;                  //The send queue weight of INVENTORY_PRIORITY
+            uint32_t        m_bulkWeight;                       //The send queue weight of BULK_PRIORITY
+            uint32_t        m_maxUnconnectedQueueBytes;         //The send queue bound of a peer that has not connected yet
+            long            m_unconnectedDroppedBytes;          //Bytes dropped by that bound
+            std::vector<LatencyHistogram> m_sendQueueingTimes;  //Per MessagePriority, message queued -> handed to TCP
+            Time            m_meanSessionLength;                //Mean time online before leaving, 0 disables the churn
+            Time            m_meanDowntime;                     //Mean time offline before rejoining
+            enum SessionDistribution m_sessionDistribution;
+            double          m_sessionShape;                     //The shape of the Weibull and Pareto sessions
+            bool            m_online;
+            EventId         m_churnEvent;                       //The next departure or rejoin
+            double          m_leaveTime;
+            int             m_departures;
+            double          m_offlineTime;
+            uint32_t        m_maxHeadersPerMessage;             //Headers of a HEADERS answer to a locator
+            uint32_t        m_maxBlocksInFlight;                //Blocks requested from one peer at the same time while syncing
+            uint32_t        m_blockDownloadWindow;              //Blocks above the lowest missing one that may be requested
+            Time            m_blockStallTimeout;                //The time a peer has to deliver a requested sync block
+            bool            m_initialBlockDownload;             //True if the node syncs when it starts
+            bool            m_syncing;                          //True from the rejoin until the node has the main chain of the sync peer
+            bool            m_syncHeadersDone;                  //True once the sync peer sent its last headers
+            Ipv4Address     m_syncPeer;
+            std::string     m_syncLastHeader;                   //The last header received from the sync peer
+            std::map<int, std::string> m_syncQueue;             //Blocks of the sync headers not requested yet, by height
+            std::map<int, std::string> m_syncPending;           //Blocks of the sync headers not received yet, by height
+            std::map<std::string, std::pair<Ipv4Address, EventId>> m_syncInFlight; //Requested blocks, their peer and timeout
+            std::map<Ipv4Address, uint32_t> m_peersBlocksInFlight;
+            std::map<Ipv4Address, int> m_peersBestHeights;      //The highest block each peer is known to have
+            std::set<Ipv4Address> m_syncServedPeers;            //The peers that delivered requested sync blocks
+            long            m_syncRequestTimeouts;
+            EventId         m_syncStallEvent;
+            double          m_syncStartTime;
+            long            m_syncStartBytes;                   //The headers and block bytes received before the sync
+            LatencyHistogram m_catchUpTimes;                    //Rejoin -> synced
+            long            m_catchUpBytes;
+
+            std::unordered_set<uint64_t>                    m_transaction;                      // keys of the transactions known to the node
+            Ptr<UniformRandomVariable>                      m_feeDistribution;                  // fee per byte of the created transactions
+            Ptr<ExponentialRandomVariable>                  m_exponentialSessions;              // session and downtime lengths, per SessionDistribution
+            Ptr<WeibullRandomVariable>                      m_weibullSessions;
+            Ptr<ParetoRandomVariable>                       m_paretoSessions;
+            Ptr<UniformRandomVariable>                      m_syncPeerDistribution;             // the peer a sync starts with
+            Ptr<UniformRandomVariable>                      m_crossShardDistribution;           // whether a new transaction pays to another shard, and to which
+            std::unordered_set<std::string>                 m_consensusMessages;                // ids of the consensus messages already relayed
+            std::map<Ipv4Address, uint32_t>                 m_peersNodeIds;                     // The node id of each peer
+            std::map<Ipv4Address, uint32_t>                 m_peersShards;                      // The shard of each peer
+            Mempool                                         m_mempool;                          // transactions waiting to be included in a block
             std::vector<Ipv4Address>                        m_peersAddresses;                   // The address of peers
             std::map<Ipv4Address, double>                   m_peersDownloadSpeeds;              // The peerDownloadSpeeds of channels
             std::map<Ipv4Address, double>                   m_peersUploadSpeeds;                // The peerUploadSpeeds of channels
-            std::map<Ipv4Address, Ptr<Socket>>              m_peersSockets;                     // The sockets of peers
+            std::map<Ipv4Address, Ptr<Socket>>              m_peersSockets;                     // The connection to each peer, opened or accepted, for both directions
+            std::map<Ipv4Address, SendQueue>                m_peersSendQueues;                  // Bytes waiting for the send buffer of each peer connection, or for the peer to connect
+            std::map<Ipv4Address, uint32_t>                 m_peersPeakSendQueueBytes;          // The deepest send queue of each peer
             std::map<std::string, std::vector<Address>>     m_queueInv;
             std::map<std::string, EventId>                  m_invTimeouts;
             std::map<Address, std::string>                  m_bufferedData;                     // map holding the buffered data from previous handleRead events
+            std::map<Address, double>                       m_peersProcessedTimes;              // The time the messages received from each peer are processed
             std::map<std::string, Block>                    m_receivedNotValidated;             // Vevtor holding the received but not yet validated blocks
             std::map<std::string, Block>                    m_onlyHeadersReceived;              // Vevtor holding the blocks that we know byt not received
+            std::map<Ipv4Address, RollingBloomFilter>       m_peersKnownBlocks;                 // The blocks known to each peer
+            std::map<Ipv4Address, RollingBloomFilter>       m_peersKnownTransactions;           // The transactions known to each peer
+            std::map<Ipv4Address, std::set<std::string>>    m_peersKnownBlocksAudit;            // Exact copy of m_peersKnownBlocks, for auditing
+            std::map<Ipv4Address, std::unordered_set<uint64_t>> m_peersKnownTransactionsAudit;  // Exact copy of m_peersKnownTransactions, for auditing
+            std::map<Ipv4Address, std::vector<uint64_t>>    m_peersTransactionInvQueue;         // Transactions waiting to be announced to each peer
+            std::map<Ipv4Address, std::deque<uint64_t>>     m_peersTransactionRequestQueue;     // Transactions waiting to be requested from each peer
+            std::map<Ipv4Address, uint32_t>                 m_peersTransactionsInFlight;        // The number of transactions requested from each peer
+            std::unordered_map<uint64_t, std::pair<Ipv4Address, EventId>>  m_transactionsInFlight;   // key = transaction key, value = (peer, timeout)
+            std::unordered_map<uint64_t, std::deque<Ipv4Address>>          m_transactionAnnouncers;  // The peers that announced a missing transaction
             nodeStatistics                                  *m_nodeStats;                       // Struct holding the node stats
-            std::vector<double>                             m_sendBlockTimes;                   // contains the times of the next sendBlock events
+            TransactionLatencies                            *m_transactionLatencies;            // Network-wide transaction latencies, nullptr if not collected
             std::vector<double>                             m_sendCompressedBlockTimes;         // contains the times of the next sendBlock events
-            std::vector<double>                             m_receiveBlockTimes;                // contains the times of the next sendBlock events
+            std::map<int, std::pair<std::string, Address>>  m_pendingDownloads;                 // key = transfer on m_downloadLink, value = (BLOCK message, sender)
+            std::map<int, std::pair<std::string, Address>>  m_pendingChunkDownloads;            // key = transfer on m_downloadLink, value = (CHUNK message, sender)
+            std::map<std::string, ChunkedBlock>             m_chunkedBlocks;                    // The blocks being received in chunks
             std::vector<double>                             m_receiveCompressedBlockTimes;      // contains the times of the next sendBlock events
             enum ProtocolType                               m_protocolType;                     // protocol type
 
@@ -273,6 +791,94 @@ namespace ns3 {
 
             TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
 
+            friend class BlockchainFlowNetwork;
+    };
+
+    /*
+     * Flow-level model of the TCP connections between the nodes, a fast alternative to simulating
+     * every packet on the point-to-point links. A message is handed to the peer after the time the
+     * connection takes to push it through the link, computed analytically, plus the link latency.
+     * The messages of a direction of a link share its data rate in FIFO order, like the single TCP
+     * connection they would take. The transfer of a message follows TCP slow start: the congestion
+     * window starts at InitialWindow segments, doubles every round trip and is capped by the
+     * ReceiveWindow, so small windows on long links stay latency bound. Every segment carries
+     * HeaderBytes of TCP/IP/PPP headers. The window persists between the messages of a link.
+     * Only the nodes of the same process can share a flow network.
+     */
+    class BlockchainFlowNetwork : public Object
+    {
+        public:
+
+            static TypeId GetTypeId(void);
+            BlockchainFlowNetwork();
+
+            virtual ~BlockchainFlowNetwork(void);
+
+            /*
+             * Adds a direction of a link
+             * param from : the node id of the sender
+             * param to : the address of the receiver on the link
+             * param toNode : the node id of the receiver
+             * param fromAddress : the address of the sender on the link, which the receiver sees
+             * param latency : the one-way latency in seconds
+             * param dataRate : the data rate of the link in bits/s
+             */
+            void AddLink(uint32_t from, Ipv4Address to, uint32_t toNode, Ipv4Address fromAddress, double latency, double dataRate);
+
+            /*
+             * Starts or stops delivering the messages of a node, the messages to a stopped node are dropped
+             */
+            void AddNode(BlockchainNode *node);
+            void RemoveNode(uint32_t nodeId);
+
+            /*
+             * Sends a message on the link from the node to the peer address
+             */
+            void Send(uint32_t from, Ipv4Address to, const std::string &message);
+
+            long GetDeliveredMessages(void) const;
+            long GetDroppedMessages(void) const;
+            double GetDeliveredBytes(void) const;
+
+            /*
+             * The time from the send to the delivery of the messages, and the part spent waiting for the link
+             */
+            const LatencyHistogram& GetDeliveryTimes(void) const;
+            const LatencyHistogram& GetQueueingTimes(void) const;
+
+        protected:
+
+            typedef struct {
+                uint32_t    toNode;
+                Ipv4Address fromAddress;
+                double      latency;            // seconds
+                double      dataRate;           // bits/s
+                double      busyUntil;          // the time the link finishes its queued messages
+                uint32_t    congestionWindow;   // segments
+            } FlowLink;
+
+            virtual void DoDispose(void);
+
+            /*
+             * The time the connection takes to push the bytes through the link, growing its congestion window
+             */
+            double GetTransferTime(FlowLink &link, uint32_t sizeBytes);
+
+            void Deliver(uint32_t to, Ipv4Address fromAddress, std::string message);
+
+            std::unordered_map<uint32_t, std::map<Ipv4Address, FlowLink>>  m_links;    // key1 = node id of the sender, key2 = address of the receiver
+            std::unordered_map<uint32_t, BlockchainNode*>                   m_nodes;    // the running nodes
+
+            uint32_t                        m_segmentSize;          // Bytes
+            uint32_t                        m_headerBytes;          // per segment
+            uint32_t                        m_initialWindow;        // segments
+            uint32_t                        m_receiveWindow;        // Bytes
+
+            long                            m_deliveredMessages;
+            long                            m_droppedMessages;
+            double                          m_deliveredBytes;
+            LatencyHistogram                m_deliveryTimes;
+            LatencyHistogram                m_queueingTimes;
     };
 
 }
@@ -0,0 +1,336 @@
+#include "ns3/address.h"
+#include "ns3/log.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/node.h"
+#include "ns3/socket.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/blockchain-orderer.h"
+
+namespace ns3 {
+
+    NS_LOG_COMPONENT_DEFINE("BlockchainOrderer");
+    NS_OBJECT_ENSURE_REGISTERED(BlockchainOrderer);
+
+    TypeId
+    BlockchainOrderer::GetTypeId(void)
+    {
+        static TypeId tid = TypeId("ns3::BlockchainOrderer")
+            .SetParent<BlockchainNode>()
+            .SetGroupName("Application")
+            .AddConstructor<BlockchainOrderer>()
+            .AddAttribute("BatchSize",
+                            "The maximum number of transactions in a block",
+                            UintegerValue(500),
+                            MakeUintegerAccessor(&BlockchainOrderer::m_batchSize),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("BatchTimeout",
+                            "The time after the first transaction of a batch at which the block is cut anyway",
+                            TimeValue(Seconds(2)),
+                            MakeTimeAccessor(&BlockchainOrderer::m_batchTimeout),
+                            MakeTimeChecker())
+            .AddAttribute("BlockSize",
+                            "The preferred maximum size of a block in Bytes",
+                            UintegerValue(2097152),
+                            MakeUintegerAccessor(&BlockchainOrderer::m_maxBlockSize),
+                            MakeUintegerChecker<uint32_t>())
+            ;
+            return tid;
+    }
+
+    BlockchainOrderer::BlockchainOrderer() : BlockchainNode(), m_ordererIndex(-1), m_appendAckSizeBytes(16), m_batchSizeBytes(0), m_nextHeight(1)
+    {
+        NS_LOG_FUNCTION(this);
+
+        m_orderedBlocks = 0;
+        m_orderedTransactions = 0;
+        m_batchTimeouts = 0;
+        m_averageBlockSize = 0;
+
+        m_isMiner = true;
+    }
+
+    BlockchainOrderer::~BlockchainOrderer(void)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    void
+    BlockchainOrderer::SetOrderers(const std::vector<int> &orderers)
+    {
+        NS_LOG_FUNCTION(this);
+        m_orderers = orderers;
+    }
+
+    void
+    BlockchainOrderer::StartApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StartApplication();
+
+        m_nodeStats->miner = 1;
+
+        auto member = std::find(m_orderers.begin(), m_orderers.end(), static_cast<int>(GetNode()->GetId()));
+
+        if(member == m_orderers.end())
+        {
+            NS_LOG_WARN("Orderer " << GetNode()->GetId() << " is not in the ordering service");
+            return;
+        }
+        m_ordererIndex = member - m_orderers.begin();
+
+        NS_LOG_WARN("Orderer " << GetNode()->GetId() << (IsLeader() ? " leads" : " follows") << " the ordering service of "
+                    << m_orderers.size() << " orderers, batch size = " << m_batchSize << " transactions, batch timeout = "
+                    << m_batchTimeout.GetSeconds() << "s");
+    }
+
+    void
+    BlockchainOrderer::StopApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StopApplication();
+        Simulator::Cancel(m_batchTimer);
+
+        if(IsLeader())
+        {
+            NS_LOG_WARN("The ordering service leader " << GetNode()->GetId() << " cut " << m_orderedBlocks << " blocks with "
+                        << m_orderedTransactions << " transactions (" << m_batchTimeouts << " by the batch timeout), "
+                        << m_batch.size() << " transactions are still in the batch and " << m_replicatingBlocks.size()
+                        << " blocks are still replicating");
+        }
+
+        m_nodeStats->minerGeneratedBlocks = m_orderedBlocks;
+        m_nodeStats->minerAverageBlockSize = m_averageBlockSize;
+        m_nodeStats->orderedBlocks = m_orderedBlocks;
+        m_nodeStats->orderedTransactions = m_orderedTransactions;
+        m_nodeStats->batchTimeouts = m_batchTimeouts;
+    }
+
+    bool
+    BlockchainOrderer::IsLeader(void) const
+    {
+        return m_ordererIndex == 0;
+    }
+
+    void
+    BlockchainOrderer::AddToBatch(const Transaction &newTrans)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(!m_batch.empty() && m_batchSizeBytes + newTrans.GetTransSizeByte() > static_cast<int>(m_maxBlockSize))
+        {
+            CutBlock();
+        }
+
+        if(m_batch.empty())
+        {
+            m_batchTimer = Simulator::Schedule(m_batchTimeout, &BlockchainOrderer::BatchTimeoutExpired, this);
+        }
+
+        m_batch.push_back(newTrans);
+        m_batchSizeBytes += newTrans.GetTransSizeByte();
+
+        if(m_batch.size() >= m_batchSize || m_batchSizeBytes >= static_cast<int>(m_maxBlockSize))
+        {
+            CutBlock();
+        }
+    }
+
+    void
+    BlockchainOrderer::BatchTimeoutExpired(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        m_batchTimeouts++;
+        CutBlock();
+    }
+
+    void
+    BlockchainOrderer::CutBlock(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        Simulator::Cancel(m_batchTimer);
+
+        if(m_batch.empty())
+        {
+            return;
+        }
+
+        int minerId = GetNode()->GetId();
+        int parentMinerId = m_nextHeight > 1 ? minerId : 0;
+        int blockSize = m_blockHeadersSizeBytes + m_batchSizeBytes;
+        double currentTime = Simulator::Now().GetSeconds();
+
+        Block newBlock(m_nextHeight, minerId, 0, parentMinerId, blockSize, currentTime, currentTime, Ipv4Address("127.0.0.1"));
+        newBlock.SetTransactions(m_batch);
+
+        NS_LOG_INFO("CutBlock: At time " << currentTime << "s orderer " << minerId << " cut block " << m_nextHeight
+                    << " with " << m_batch.size() << " transactions");
+
+        m_replicatingBlocks[m_nextHeight] = std::make_pair(newBlock, std::set<int>());
+        m_batch.clear();
+        m_batchSizeBytes = 0;
+
+        for(auto const &follower: m_orderers)
+        {
+            if(follower == minerId)
+            {
+                continue;
+            }
+
+            rapidjson::Document d;
+            rapidjson::Value value;
+            std::ostringstream stringStream;
+
+            d.SetObject();
+            stringStream << "append/" << m_nextHeight << "/" << follower;
+
+            value = APPEND;
+            d.AddMember("message", value, d.GetAllocator());
+
+            value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+            d.AddMember("id", value, d.GetAllocator());
+
+            value = follower;
+            d.AddMember("to", value, d.GetAllocator());
+
+            value = m_nextHeight;
+            d.AddMember("height", value, d.GetAllocator());
+
+            value = minerId;
+            d.AddMember("leader", value, d.GetAllocator());
+
+            value = blockSize;
+            d.AddMember("size", value, d.GetAllocator());
+
+            SendConsensusMessage(d, follower);
+        }
+
+        m_nextHeight++;
+        DeliverBlocks();
+    }
+
+    void
+    BlockchainOrderer::ReceivedAppendAck(int height, int follower)
+    {
+        NS_LOG_FUNCTION(this << height << follower);
+
+        auto it = m_replicatingBlocks.find(height);
+
+        if(it != m_replicatingBlocks.end())
+        {
+            it->second.second.insert(follower);
+            DeliverBlocks();
+        }
+    }
+
+    void
+    BlockchainOrderer::DeliverBlocks(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        int majority = m_orderers.size() / 2 + 1;
+
+        while(!m_replicatingBlocks.empty() && static_cast<int>(m_replicatingBlocks.begin()->second.second.size()) + 1 >= majority)
+        {
+            Block newBlock = m_replicatingBlocks.begin()->second.first;
+            double currentTime = Simulator::Now().GetSeconds();
+
+            m_replicatingBlocks.erase(m_replicatingBlocks.begin());
+
+            NS_LOG_INFO("DeliverBlocks: At time " << currentTime << "s orderer " << GetNode()->GetId()
+                        << " delivers block " << newBlock.GetBlockHeight());
+
+            m_blockchain.AddBlock(newBlock);
+            AdvertiseNewBlock(newBlock);
+
+            m_averageBlockSize = m_orderedBlocks/static_cast<double>(m_orderedBlocks+1)*m_averageBlockSize
+                                + static_cast<double>(newBlock.GetBlockSizeBytes())/(m_orderedBlocks+1);
+            m_orderedBlocks++;
+            m_orderedTransactions += newBlock.GetTransactions().size();
+        }
+    }
+
+    void
+    BlockchainOrderer::ReceivedConsensusMessage(rapidjson::Document &d)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(m_ordererIndex < 0)
+        {
+            return;
+        }
+
+        switch(d["message"].GetInt())
+        {
+            case SUBMIT:
+            {
+                if(!IsLeader())
+                {
+                    std::ostringstream stringStream;
+
+                    stringStream << "submit/" << d["nodeId"].GetInt() << "/" << d["transId"].GetInt() << "/" << m_orderers[0];
+                    d["id"].SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+                    d["to"].SetInt(m_orderers[0]);
+
+                    SendConsensusMessage(d, m_orderers[0]);
+                    break;
+                }
+
+                Transaction newTrans(d["nodeId"].GetInt(), d["transId"].GetInt(), d["timestamp"].GetDouble());
+
+                newTrans.SetExecution();
+                newTrans.SetEndorsements(d["endorsements"].GetInt());
+                newTrans.SetTransSizeByte(d["size"].GetInt());
+                AddToBatch(newTrans);
+                break;
+            }
+            case APPEND:
+            {
+                rapidjson::Document ack;
+                rapidjson::Value value;
+                std::ostringstream stringStream;
+                int leader = d["leader"].GetInt();
+
+                ack.SetObject();
+                stringStream << "appendAck/" << d["height"].GetInt() << "/" << GetNode()->GetId();
+
+                value = APPEND_ACK;
+                ack.AddMember("message", value, ack.GetAllocator());
+
+                value.SetString(stringStream.str().c_str(), stringStream.str().size(), ack.GetAllocator());
+                ack.AddMember("id", value, ack.GetAllocator());
+
+                value = leader;
+                ack.AddMember("to", value, ack.GetAllocator());
+
+                value = d["height"].GetInt();
+                ack.AddMember("height", value, ack.GetAllocator());
+
+                value = GetNode()->GetId();
+                ack.AddMember("follower", value, ack.GetAllocator());
+
+                value = m_appendAckSizeBytes;
+                ack.AddMember("size", value, ack.GetAllocator());
+
+                SendConsensusMessage(ack, leader);
+                break;
+            }
+            case APPEND_ACK:
+            {
+                ReceivedAppendAck(d["height"].GetInt(), d["follower"].GetInt());
+                break;
+            }
+            default:
+            {
+                NS_LOG_INFO("ReceivedConsensusMessage: orderer " << GetNode()->GetId() << " ignores " << d["id"].GetString());
+                break;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,89 @@
+#ifndef BLOCKCHAIN_ORDERER_H
+#define BLOCKCHAIN_ORDERER_H
+
+#include "blockchain-node.h"
+#include "../../rapidjson/document.h"
+#include "../../rapidjson/writer.h"
+#include "../../rapidjson/stringbuffer.h"
+
+
+namespace ns3{
+
+    class Address;
+    class Socket;
+    class Packet;
+
+    /*
+     * ORDER node of the execute-order-validate pipeline (Hyperledger Fabric).
+     * The ordering service is a crash fault tolerant (Raft) cluster with a fixed leader, the first orderer.
+     * The followers forward the submitted transactions to the leader, which batches them in arrival order
+     * and cuts a block when the batch reaches BatchSize transactions or BlockSize bytes, or BatchTimeout after
+     * the first transaction of the batch arrived. The block is replicated to the followers (APPEND) and, once
+     * a majority of the cluster stored it, it is delivered to the peers through INV/GET_DATA/BLOCK.
+     */
+    class BlockchainOrderer : public BlockchainNode
+    {
+
+        public:
+
+            static TypeId GetTypeId(void);
+            BlockchainOrderer();
+
+            virtual ~BlockchainOrderer(void);
+
+            /*
+             * The node ids of the ordering service, the first one leads it
+             */
+            void SetOrderers(const std::vector<int> &orderers);
+
+        protected:
+
+            virtual void StartApplication(void);
+            virtual void StopApplication(void);
+
+            virtual void ReceivedConsensusMessage(rapidjson::Document &d);
+
+            bool IsLeader(void) const;
+
+            /*
+             * Adds an endorsed transaction to the batch of the leader and cuts the block when the batch is full
+             */
+            void AddToBatch(const Transaction &newTrans);
+
+            void BatchTimeoutExpired(void);
+
+            /*
+             * Turns the batch into the next block and replicates it to the followers
+             */
+            void CutBlock(void);
+
+            void ReceivedAppendAck(int height, int follower);
+
+            /*
+             * Delivers, in order, the blocks stored by a majority of the cluster
+             */
+            void DeliverBlocks(void);
+
+            std::vector<int>                    m_orderers;
+            int                                 m_ordererIndex;             // -1 if the node is not in m_orderers
+
+            uint32_t                            m_batchSize;                // transactions per block
+            Time                                m_batchTimeout;
+            uint32_t                            m_maxBlockSize;             // preferred maximum block size in Bytes
+            const int                           m_appendAckSizeBytes;       // term, index and result, 16 Bytes
+
+            std::vector<Transaction>            m_batch;
+            int                                 m_batchSizeBytes;
+            EventId                             m_batchTimer;
+            int                                 m_nextHeight;               // height of the next block to cut
+            std::map<int, std::pair<Block, std::set<int>>>  m_replicatingBlocks;    // key = height, value = (block, followers that stored it)
+
+            int                                 m_orderedBlocks;
+            long                                m_orderedTransactions;
+            long                                m_batchTimeouts;
+            double                              m_averageBlockSize;
+    };
+
+}
+
+#endif
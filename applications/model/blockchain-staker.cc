@@ -0,0 +1,572 @@
+#include "ns3/address.h"
+#include "ns3/log.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/node.h"
+#include "ns3/socket.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/blockchain-staker.h"
+
+namespace ns3 {
+
+    NS_LOG_COMPONENT_DEFINE("BlockchainStaker");
+    NS_OBJECT_ENSURE_REGISTERED(BlockchainStaker);
+
+    TypeId
+    BlockchainStaker::GetTypeId(void)
+    {
+        static TypeId tid = TypeId("ns3::BlockchainStaker")
+            .SetParent<BlockchainNode>()
+            .SetGroupName("Application")
+            .AddConstructor<BlockchainStaker>()
+            .AddAttribute("SlotDuration",
+                            "The duration of a slot, every slot has one proposer",
+                            TimeValue(Seconds(12)),
+                            MakeTimeAccessor(&BlockchainStaker::m_slotDuration),
+                            MakeTimeChecker())
+            .AddAttribute("SlotsPerEpoch",
+                            "The slots of an epoch, every validator attests once per epoch",
+                            UintegerValue(32),
+                            MakeUintegerAccessor(&BlockchainStaker::m_slotsPerEpoch),
+                            MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("AttestationDeadline",
+                            "The fraction of the slot after which its committee attests the top block",
+                            DoubleValue(1.0/3),
+                            MakeDoubleAccessor(&BlockchainStaker::m_attestationDeadline),
+                            MakeDoubleChecker<double>(0, 1))
+            .AddAttribute("BlockSize",
+                            "The maximum size of a proposed block in Bytes",
+                            UintegerValue(1000000),
+                            MakeUintegerAccessor(&BlockchainStaker::m_maxBlockSize),
+                            MakeUintegerChecker<uint32_t>())
+            ;
+            return tid;
+    }
+
+    BlockchainStaker::BlockchainStaker() : BlockchainNode(), m_validatorIndex(-1), m_signatureSizeBytes(96), m_attestationDataSizeBytes(128),
+                                            m_currentSlot(-1), m_lastProposedSlot(-1), m_shuffleEpoch(-1), m_finalizedEpoch(-1)
+    {
+        NS_LOG_FUNCTION(this);
+
+        /*
+         * The genesis block is finalized by definition
+         */
+        m_finalizedCheckpoint = std::make_pair(0, 0);
+
+        m_proposedBlocks = 0;
+        m_skippedProposals = 0;
+        m_averageProposalSize = 0;
+        m_sentAttestations = 0;
+        m_lateAttestations = 0;
+        m_committedBlocks = 0;
+        m_committedTransactions = 0;
+        m_finalizedEpochs = 0;
+
+        m_isMiner = true;
+    }
+
+    BlockchainStaker::~BlockchainStaker(void)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    std::vector<int>
+    BlockchainStaker::GetValidators(void) const
+    {
+        NS_LOG_FUNCTION(this);
+        return m_validators;
+    }
+
+    void
+    BlockchainStaker::SetValidators(const std::vector<int> &validators)
+    {
+        NS_LOG_FUNCTION(this);
+        m_validators = validators;
+    }
+
+    void
+    BlockchainStaker::StartApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StartApplication();
+
+        m_nodeStats->miner = 1;
+
+        auto member = std::find(m_validators.begin(), m_validators.end(), static_cast<int>(GetNode()->GetId()));
+
+        if(member == m_validators.end())
+        {
+            NS_LOG_WARN("Staker " << GetNode()->GetId() << " is not a validator");
+            return;
+        }
+        m_validatorIndex = member - m_validators.begin();
+
+        /*
+         * All the validators hold the same stake
+         */
+        m_nodeStats->hashRate = 1.0 / m_validators.size();
+
+        NS_LOG_WARN("Staker " << GetNode()->GetId() << " validators = " << m_validators.size() << ", slot = "
+                    << m_slotDuration.GetSeconds() << "s, slots per epoch = " << m_slotsPerEpoch << ", quorum = " << GetQuorum());
+
+        StartSlot(0);
+    }
+
+    void
+    BlockchainStaker::StopApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StopApplication();
+        Simulator::Cancel(m_slotEvent);
+        Simulator::Cancel(m_attestationEvent);
+
+        if(m_validatorIndex < 0)
+        {
+            return;
+        }
+
+        double duration = Simulator::Now().GetSeconds() - m_startTime;
+        int canonicalSlots = 0;
+
+        /*
+         * The slots that ended before the stop are missed if no block of theirs made it to the main chain
+         */
+        for(const Block *current = m_blockchain.GetCurrentTopBlock(); current != nullptr; current = m_blockchain.GetParent(*current))
+        {
+            if(current->GetView() >= 0 && current->GetView() < m_currentSlot)
+            {
+                canonicalSlots++;
+            }
+        }
+
+        NS_LOG_WARN("The staker " << GetNode()->GetId() << " reached slot " << m_currentSlot << ", proposed " << m_proposedBlocks
+                    << " blocks (" << m_skippedProposals << " slots skipped), sent " << m_sentAttestations << " attestations ("
+                    << m_lateAttestations << " late ones received) and finalized " << m_finalizedEpochs << " epochs with "
+                    << m_committedBlocks << " blocks and " << m_committedTransactions << " transactions. Finality time mean/p50/p90 = "
+                    << m_finalityTimes.GetMean() << "/" << m_finalityTimes.GetPercentile(50) << "/" << m_finalityTimes.GetPercentile(90) << "s");
+
+        m_nodeStats->minerGeneratedBlocks = m_proposedBlocks;
+        m_nodeStats->minerAverageBlockGenInterval = m_proposedBlocks > 0 ? duration / m_proposedBlocks : 0;
+        m_nodeStats->minerAverageBlockSize = m_averageProposalSize;
+        m_nodeStats->committedBlocks = m_committedBlocks;
+        m_nodeStats->committedTransactions = m_committedTransactions;
+        m_nodeStats->committedTransactionsPerSecond = duration > 0 ? m_committedTransactions / duration : 0;
+        m_nodeStats->meanFinalityTime = m_finalityTimes.GetMean();
+        m_nodeStats->finalityTimeP50 = m_finalityTimes.GetPercentile(50);
+        m_nodeStats->finalityTimeP90 = m_finalityTimes.GetPercentile(90);
+        m_nodeStats->slots = std::max(m_currentSlot, 0);
+        m_nodeStats->missedSlots = std::max(m_currentSlot, 0) - canonicalSlots;
+        m_nodeStats->finalizedEpochs = m_finalizedEpochs;
+    }
+
+    int
+    BlockchainStaker::GetProposer(int slot) const
+    {
+        std::mt19937 generator(slot);
+
+        return m_validators[generator() % m_validators.size()];
+    }
+
+    bool
+    BlockchainStaker::IsAttester(int slot, int validatorIndex)
+    {
+        int epoch = GetEpoch(slot);
+
+        if(epoch != m_shuffleEpoch)
+        {
+            /*
+             * Fisher-Yates shuffle seeded with the epoch, so that all the validators get the same committees
+             */
+            std::mt19937 generator(epoch + 1);
+            std::vector<int> shuffle(m_validators.size());
+
+            for(unsigned int i = 0; i < shuffle.size(); i++)
+            {
+                shuffle[i] = i;
+            }
+
+            for(int i = shuffle.size() - 1; i > 0; i--)
+            {
+                std::swap(shuffle[i], shuffle[generator() % (i + 1)]);
+            }
+
+            m_committeePositions.assign(m_validators.size(), 0);
+
+            for(unsigned int position = 0; position < shuffle.size(); position++)
+            {
+                m_committeePositions[shuffle[position]] = position;
+            }
+            m_shuffleEpoch = epoch;
+        }
+
+        return m_committeePositions[validatorIndex] % m_slotsPerEpoch == slot % m_slotsPerEpoch;
+    }
+
+    int
+    BlockchainStaker::GetEpoch(int slot) const
+    {
+        return slot / m_slotsPerEpoch;
+    }
+
+    int
+    BlockchainStaker::GetQuorum(void) const
+    {
+        return (2 * m_validators.size() + 2) / 3;
+    }
+
+    void
+    BlockchainStaker::StartSlot(int slot)
+    {
+        NS_LOG_FUNCTION(this << slot);
+
+        double nextSlotStart = m_startTime + (slot + 1) * m_slotDuration.GetSeconds();
+
+        m_currentSlot = slot;
+        m_slotEvent = Simulator::Schedule(Seconds(nextSlotStart - Simulator::Now().GetSeconds()), &BlockchainStaker::StartSlot, this, slot + 1);
+
+        NS_LOG_INFO("StartSlot: At time " << Simulator::Now().GetSeconds() << "s staker " << GetNode()->GetId()
+                    << " entered slot " << slot << " proposed by " << GetProposer(slot));
+
+        if(GetProposer(slot) == static_cast<int>(GetNode()->GetId()))
+        {
+            Propose(slot);
+        }
+
+        if(IsAttester(slot, m_validatorIndex))
+        {
+            m_attestationEvent = Simulator::Schedule(Seconds(m_attestationDeadline * m_slotDuration.GetSeconds()),
+                                                     &BlockchainStaker::Attest, this, slot);
+        }
+    }
+
+    void
+    BlockchainStaker::Propose(int slot)
+    {
+        NS_LOG_FUNCTION(this << slot);
+
+        const Block *top = m_blockchain.GetCurrentTopBlock();
+        int height = top->GetBlockHeight() + 1;
+        int parentMinerId = top->GetMinerId();
+        int minerId = GetNode()->GetId();
+        double currentTime = Simulator::Now().GetSeconds();
+
+        /*
+         * Blocks are identified by (height, minerId), so a proposer whose previous block at this height
+         * was left in a fork cannot propose on the same height again.
+         */
+        if(m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId))
+        {
+            NS_LOG_WARN("Staker " << minerId << " already proposed a block at height " << height << ", skipping slot " << slot);
+            m_skippedProposals++;
+            return;
+        }
+
+        m_lastProposedSlot = slot;
+
+        /*
+         * The aggregate of the attestations of the previous slot for the most voted block
+         */
+        QuorumCertificate justify;
+
+        justify.height = 0;
+        justify.minerId = 0;
+        justify.view = -1;
+        justify.votes = 0;
+
+        auto attestations = m_attestations.find(slot - 1);
+
+        if(attestations != m_attestations.end())
+        {
+            for(auto const &head: attestations->second)
+            {
+                if(static_cast<int>(head.second.size()) > justify.votes)
+                {
+                    justify.height = head.first.first;
+                    justify.minerId = head.first.second;
+                    justify.view = slot - 1;
+                    justify.votes = head.second.size();
+                }
+            }
+        }
+        m_attestations.erase(m_attestations.begin(), m_attestations.lower_bound(slot));
+
+        int aggregateSize = justify.view >= 0 ? m_attestationDataSizeBytes + m_signatureSizeBytes + (m_validators.size() + 7) / 8 : 0;
+        int blockSize = m_blockHeadersSizeBytes + aggregateSize;
+
+        m_mempool.ExpireTransactions(currentTime);
+        ForgetDroppedTransactions();
+        std::vector<Transaction> blockTransactions = m_mempool.GetTransactionsByFee(m_maxBlockSize - blockSize);
+
+        for(auto &tran: blockTransactions)
+        {
+            tran.SetValidation();
+            m_mempool.RemoveTransaction(tran.GetTransNodeId(), tran.GetTransId());
+            blockSize += tran.GetTransSizeByte();
+        }
+
+        Block newBlock(height, minerId, slot, parentMinerId, blockSize, currentTime, currentTime, Ipv4Address("127.0.0.1"));
+        newBlock.SetTransactions(blockTransactions);
+        newBlock.SetView(slot);
+        newBlock.SetJustify(justify);
+
+        NS_LOG_INFO("Propose: At time " << currentTime << "s staker " << minerId << " proposed block " << height << "/" << minerId
+                    << " in slot " << slot << " with " << blockTransactions.size() << " transactions and "
+                    << justify.votes << " attestations");
+
+        m_blockchain.AddBlock(newBlock);
+        m_txTracker.BlockAdded(newBlock, currentTime);
+        m_txTracker.UpdateConfirmations(m_blockchain, currentTime);
+        AdvertiseNewBlock(newBlock);
+
+        m_averageProposalSize = m_proposedBlocks/static_cast<double>(m_proposedBlocks+1)*m_averageProposalSize
+                                + static_cast<double>(blockSize)/(m_proposedBlocks+1);
+        m_proposedBlocks++;
+
+        ProcessAttestations(newBlock);
+    }
+
+    void
+    BlockchainStaker::Attest(int slot)
+    {
+        NS_LOG_FUNCTION(this << slot);
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        std::ostringstream stringStream;
+        const Block *head = m_blockchain.GetCurrentTopBlock();
+        int proposer = GetProposer(slot + 1);
+
+        d.SetObject();
+        stringStream << "attestation/" << slot << "/" << GetNode()->GetId();
+
+        value = ATTESTATION;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+        d.AddMember("id", value, d.GetAllocator());
+
+        value = proposer;
+        d.AddMember("to", value, d.GetAllocator());
+
+        value = slot;
+        d.AddMember("slot", value, d.GetAllocator());
+
+        value = head->GetBlockHeight();
+        d.AddMember("height", value, d.GetAllocator());
+
+        value = head->GetMinerId();
+        d.AddMember("minerId", value, d.GetAllocator());
+
+        value = GetNode()->GetId();
+        d.AddMember("attester", value, d.GetAllocator());
+
+        /*
+         * attestation data, attester and signature
+         */
+        value = m_attestationDataSizeBytes + 4 + m_signatureSizeBytes;
+        d.AddMember("size", value, d.GetAllocator());
+
+        m_sentAttestations++;
+        SendConsensusMessage(d, proposer);
+    }
+
+    void
+    BlockchainStaker::ReceivedAttestation(int slot, int height, int minerId, int attester)
+    {
+        NS_LOG_FUNCTION(this << slot << attester);
+
+        if(GetProposer(slot + 1) != static_cast<int>(GetNode()->GetId()))
+        {
+            return;
+        }
+
+        if(slot + 1 < m_currentSlot || m_lastProposedSlot == slot + 1)
+        {
+            NS_LOG_INFO("ReceivedAttestation: staker " << GetNode()->GetId() << " received the attestation of slot " << slot
+                        << " from " << attester << " after its proposal");
+            m_lateAttestations++;
+            return;
+        }
+
+        m_attestations[slot][std::make_pair(height, minerId)].insert(attester);
+    }
+
+    void
+    BlockchainStaker::AfterBlockValidation(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::AfterBlockValidation(newBlock);
+
+        if(m_validatorIndex >= 0 && newBlock.IsValid() && newBlock.GetView() >= 0)
+        {
+            ProcessAttestations(newBlock);
+        }
+    }
+
+    void
+    BlockchainStaker::ProcessAttestations(const Block &block)
+    {
+        NS_LOG_FUNCTION(this);
+
+        QuorumCertificate justify = block.GetJustify();
+
+        /*
+         * The aggregate of a slot is counted once, even if blocks of several forks carry it
+         */
+        if(justify.view < 0 || m_countedSlots.count(justify.view) > 0 || !m_blockchain.HasBlock(justify.height, justify.minerId))
+        {
+            return;
+        }
+        m_countedSlots.insert(justify.view);
+
+        int epoch = GetEpoch(justify.view);
+        const Block *checkpoint = GetCheckpoint(m_blockchain.ReturnBlock(justify.height, justify.minerId), epoch);
+
+        if(checkpoint == nullptr || epoch <= m_finalizedEpoch)
+        {
+            return;
+        }
+
+        std::pair<int, int> target = std::make_pair(checkpoint->GetBlockHeight(), checkpoint->GetMinerId());
+        int &votes = m_checkpointVotes[epoch][target];
+
+        votes += justify.votes;
+
+        if(votes >= GetQuorum() && m_justifiedCheckpoints.find(epoch) == m_justifiedCheckpoints.end())
+        {
+            Justify(epoch, target);
+        }
+    }
+
+    const Block*
+    BlockchainStaker::GetCheckpoint(const Block &head, int epoch)
+    {
+        const Block *current = m_blockchain.GetBlockPointer(head);
+        int epochStart = epoch * m_slotsPerEpoch;
+
+        while(current != nullptr && current->GetView() > epochStart)
+        {
+            current = m_blockchain.GetParent(*current);
+        }
+
+        return current;
+    }
+
+    bool
+    BlockchainStaker::Extends(const Block &block, int height, int minerId)
+    {
+        const Block *current = m_blockchain.GetBlockPointer(block);
+
+        while(current != nullptr && current->GetBlockHeight() > height)
+        {
+            current = m_blockchain.GetParent(*current);
+        }
+
+        return current != nullptr && current->GetBlockHeight() == height && current->GetMinerId() == minerId;
+    }
+
+    void
+    BlockchainStaker::Justify(int epoch, const std::pair<int, int> &checkpoint)
+    {
+        NS_LOG_FUNCTION(this << epoch);
+
+        m_justifiedCheckpoints[epoch] = checkpoint;
+
+        NS_LOG_INFO("Justify: At time " << Simulator::Now().GetSeconds() << "s staker " << GetNode()->GetId()
+                    << " justified the checkpoint " << checkpoint.first << "/" << checkpoint.second << " of epoch " << epoch);
+
+        /*
+         * Two consecutive justified checkpoints on the same chain finalize the first one
+         */
+        auto previous = m_justifiedCheckpoints.find(epoch - 1);
+        auto next = m_justifiedCheckpoints.find(epoch + 1);
+        Block checkpointBlock = m_blockchain.ReturnBlock(checkpoint.first, checkpoint.second);
+
+        if(previous != m_justifiedCheckpoints.end() && Extends(checkpointBlock, previous->second.first, previous->second.second))
+        {
+            Finalize(epoch - 1);
+        }
+
+        if(next != m_justifiedCheckpoints.end()
+            && Extends(m_blockchain.ReturnBlock(next->second.first, next->second.second), checkpoint.first, checkpoint.second))
+        {
+            Finalize(epoch);
+        }
+    }
+
+    void
+    BlockchainStaker::Finalize(int epoch)
+    {
+        NS_LOG_FUNCTION(this << epoch);
+
+        if(epoch <= m_finalizedEpoch)
+        {
+            return;
+        }
+
+        std::pair<int, int> checkpoint = m_justifiedCheckpoints[epoch];
+        std::vector<const Block *> newlyFinalized;
+        const Block *current = m_blockchain.GetBlockPointer(m_blockchain.ReturnBlock(checkpoint.first, checkpoint.second));
+        double currentTime = Simulator::Now().GetSeconds();
+
+        while(current != nullptr && current->GetBlockHeight() > m_finalizedCheckpoint.first)
+        {
+            newlyFinalized.push_back(current);
+            current = m_blockchain.GetParent(*current);
+        }
+
+        if(current == nullptr || current->GetMinerId() != m_finalizedCheckpoint.second)
+        {
+            NS_LOG_WARN("Staker " << GetNode()->GetId() << " finalizes the checkpoint " << checkpoint.first << "/" << checkpoint.second
+                        << " which does not extend the finalized checkpoint " << m_finalizedCheckpoint.first << "/" << m_finalizedCheckpoint.second);
+        }
+
+        for(auto it = newlyFinalized.rbegin(); it != newlyFinalized.rend(); it++)
+        {
+            m_committedBlocks++;
+            m_committedTransactions += (*it)->GetTransactions().size();
+            m_finalityTimes.AddSample(currentTime - (*it)->GetTimeStamp());
+        }
+
+        m_finalizedEpoch = epoch;
+        m_finalizedCheckpoint = checkpoint;
+        m_finalizedEpochs++;
+
+        m_checkpointVotes.erase(m_checkpointVotes.begin(), m_checkpointVotes.upper_bound(epoch));
+        m_justifiedCheckpoints.erase(m_justifiedCheckpoints.begin(), m_justifiedCheckpoints.lower_bound(epoch));
+        m_countedSlots.erase(m_countedSlots.begin(), m_countedSlots.lower_bound(epoch * m_slotsPerEpoch));
+
+        NS_LOG_INFO("Finalize: At time " << currentTime << "s staker " << GetNode()->GetId() << " finalized the checkpoint "
+                    << checkpoint.first << "/" << checkpoint.second << " of epoch " << epoch);
+    }
+
+    void
+    BlockchainStaker::ReceivedConsensusMessage(rapidjson::Document &d)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(m_validatorIndex < 0)
+        {
+            return;
+        }
+
+        switch(d["message"].GetInt())
+        {
+            case ATTESTATION:
+            {
+                ReceivedAttestation(d["slot"].GetInt(), d["height"].GetInt(), d["minerId"].GetInt(), d["attester"].GetInt());
+                break;
+            }
+            default:
+            {
+                NS_LOG_INFO("ReceivedConsensusMessage: staker " << GetNode()->GetId() << " ignores " << d["id"].GetString());
+                break;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,144 @@
+#ifndef BLOCKCHAIN_STAKER_H
+#define BLOCKCHAIN_STAKER_H
+
+#include "blockchain-node.h"
+#include <random>
+#include "../../rapidjson/document.h"
+#include "../../rapidjson/writer.h"
+#include "../../rapidjson/stringbuffer.h"
+
+
+namespace ns3{
+
+    class Address;
+    class Socket;
+    class Packet;
+
+    /*
+     * Validator of the slot-based proof-of-stake mode, the counterpart of BlockchainMiner.
+     * Time is split in slots of SlotDuration and the slots in epochs of SlotsPerEpoch. Every validator
+     * holds the same stake, the proposer of a slot is drawn from the validators with the slot as seed,
+     * and every epoch the validators are shuffled into one attestation committee per slot.
+     * At the start of its slot the proposer builds a block on its top block and relays it through
+     * INV/GET_DATA/BLOCK. The committee of the slot attests its top block AttestationDeadline into the
+     * slot (ATTESTATION) to the proposer of the next slot, which aggregates the attestations of the most
+     * voted block into the justify field of its own block.
+     * The finality gadget is a simplified Casper FFG: the attestations carried by the blocks vote for the
+     * epoch boundary block (checkpoint) below the attested block, a checkpoint voted by 2/3 of the
+     * validators is justified and a justified checkpoint is finalized once the checkpoint of the next
+     * epoch, which extends it, is justified too.
+     */
+    class BlockchainStaker : public BlockchainNode
+    {
+
+        public:
+
+            static TypeId GetTypeId(void);
+            BlockchainStaker();
+
+            virtual ~BlockchainStaker(void);
+
+            /*
+             * The node ids of the validators. All the stakers must get the same list.
+             */
+            std::vector<int> GetValidators(void) const;
+            void SetValidators(const std::vector<int> &validators);
+
+        protected:
+
+            virtual void StartApplication(void);
+            virtual void StopApplication(void);
+
+            virtual void AfterBlockValidation(const Block &newBlock);
+
+            virtual void ReceivedConsensusMessage(rapidjson::Document &d);
+
+            int GetProposer(int slot) const;
+
+            /*
+             * True if the validator at validatorIndex is in the attestation committee of the slot
+             */
+            bool IsAttester(int slot, int validatorIndex);
+
+            int GetEpoch(int slot) const;
+
+            /*
+             * The votes needed to justify a checkpoint: 2/3 of the validators
+             */
+            int GetQuorum(void) const;
+
+            /*
+             * Enters the slot, proposes if the node is its proposer and schedules the attestation and the next slot
+             */
+            void StartSlot(int slot);
+
+            void Propose(int slot);
+
+            /*
+             * Sends the attestation of the top block to the proposer of the next slot
+             */
+            void Attest(int slot);
+
+            void ReceivedAttestation(int slot, int height, int minerId, int attester);
+
+            /*
+             * Counts the aggregated attestations of a block in the finality gadget
+             */
+            void ProcessAttestations(const Block &block);
+
+            /*
+             * The checkpoint of the epoch on the chain of head: its last block of a slot up to the first slot of the epoch
+             */
+            const Block* GetCheckpoint(const Block &head, int epoch);
+
+            /*
+             * True if the block descends from the block (height, minerId)
+             */
+            bool Extends(const Block &block, int height, int minerId);
+
+            void Justify(int epoch, const std::pair<int, int> &checkpoint);
+
+            /*
+             * Finalizes the justified checkpoint of the epoch and its unfinalized ancestors
+             */
+            void Finalize(int epoch);
+
+            std::vector<int>                    m_validators;
+            int                                 m_validatorIndex;           // -1 if the node is not a validator
+
+            Time                                m_slotDuration;
+            uint32_t                            m_slotsPerEpoch;
+            double                              m_attestationDeadline;      // fraction of the slot
+            uint32_t                            m_maxBlockSize;
+            const int                           m_signatureSizeBytes;       // BLS signature, 96 Bytes
+            const int                           m_attestationDataSizeBytes; // slot, block hash, source and target checkpoints, 128 Bytes
+
+            int                                 m_currentSlot;
+            int                                 m_lastProposedSlot;
+            EventId                             m_slotEvent;
+            EventId                             m_attestationEvent;
+
+            int                                 m_shuffleEpoch;             // epoch of m_committeePositions
+            std::vector<int>                    m_committeePositions;       // position of every validator in the shuffle of the epoch
+
+            std::map<int, std::map<std::pair<int, int>, std::set<int>>> m_attestations;    // key = slot, value = attesters per block
+            std::set<int>                                               m_countedSlots;    // slots whose attestations reached the finality gadget
+            std::map<int, std::map<std::pair<int, int>, int>>           m_checkpointVotes; // key = epoch, value = votes per checkpoint
+            std::map<int, std::pair<int, int>>                          m_justifiedCheckpoints; // key = epoch
+            int                                 m_finalizedEpoch;
+            std::pair<int, int>                 m_finalizedCheckpoint;      // (height, minerId)
+
+            int                                 m_proposedBlocks;
+            int                                 m_skippedProposals;         // slots of the node without a proposal
+            double                              m_averageProposalSize;
+            long                                m_sentAttestations;
+            long                                m_lateAttestations;         // received after the next proposal
+            int                                 m_committedBlocks;
+            long                                m_committedTransactions;
+            int                                 m_finalizedEpochs;
+            LatencyHistogram                    m_finalityTimes;            // proposal -> finalization
+    };
+
+}
+
+#endif
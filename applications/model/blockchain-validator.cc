@@ -0,0 +1,610 @@
+#include "ns3/address.h"
+#include "ns3/log.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/node.h"
+#include "ns3/socket.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/blockchain-validator.h"
+
+namespace ns3 {
+
+    NS_LOG_COMPONENT_DEFINE("BlockchainValidator");
+    NS_OBJECT_ENSURE_REGISTERED(BlockchainValidator);
+
+    TypeId
+    BlockchainValidator::GetTypeId(void)
+    {
+        static TypeId tid = TypeId("ns3::BlockchainValidator")
+            .SetParent<BlockchainNode>()
+            .SetGroupName("Application")
+            .AddConstructor<BlockchainValidator>()
+            .AddAttribute("BlockSize",
+                            "The maximum size of a proposed block in Bytes",
+                            UintegerValue(1000000),
+                            MakeUintegerAccessor(&BlockchainValidator::m_maxBlockSize),
+                            MakeUintegerChecker<uint32_t>())
+            .AddAttribute("BlockInterval",
+                            "The minimum time between two consecutive proposals",
+                            TimeValue(Seconds(1)),
+                            MakeTimeAccessor(&BlockchainValidator::m_blockInterval),
+                            MakeTimeChecker())
+            .AddAttribute("ViewTimeout",
+                            "The time a validator waits for the progress of a view on top of the block interval, doubled after every consecutive timeout",
+                            TimeValue(Seconds(10)),
+                            MakeTimeAccessor(&BlockchainValidator::m_viewTimeout),
+                            MakeTimeChecker())
+            .AddAttribute("VoteAggregation",
+                            "Aggregate the votes of a quorum certificate into one signature",
+                            BooleanValue(true),
+                            MakeBooleanAccessor(&BlockchainValidator::m_voteAggregation),
+                            MakeBooleanChecker())
+            ;
+            return tid;
+    }
+
+    BlockchainValidator::BlockchainValidator() : BlockchainNode(), m_committeeIndex(-1), m_signatureSizeBytes(64), m_aggregateSignatureSizeBytes(96),
+                                                m_currentView(-1), m_lastVotedView(-1), m_lastProposedView(-1), m_consecutiveTimeouts(0),
+                                                m_proposeWhenAvailable(false), m_previousProposalTime(0)
+    {
+        NS_LOG_FUNCTION(this);
+
+        /*
+         * The genesis block is certified and committed by definition
+         */
+        m_highQC.height = 0;
+        m_highQC.minerId = 0;
+        m_highQC.view = -1;
+        m_highQC.votes = 0;
+        m_lockedQC = m_highQC;
+        m_committedBlock = std::make_pair(0, 0);
+
+        m_proposedBlocks = 0;
+        m_averageProposalSize = 0;
+        m_committedBlocks = 0;
+        m_committedTransactions = 0;
+        m_viewChanges = 0;
+
+        m_isMiner = true;
+    }
+
+    BlockchainValidator::~BlockchainValidator(void)
+    {
+        NS_LOG_FUNCTION(this);
+    }
+
+    std::vector<int>
+    BlockchainValidator::GetCommittee(void) const
+    {
+        NS_LOG_FUNCTION(this);
+        return m_committee;
+    }
+
+    void
+    BlockchainValidator::SetCommittee(const std::vector<int> &committee)
+    {
+        NS_LOG_FUNCTION(this);
+        m_committee = committee;
+    }
+
+    void
+    BlockchainValidator::StartApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StartApplication();
+
+        m_nodeStats->miner = 1;
+
+        auto member = std::find(m_committee.begin(), m_committee.end(), static_cast<int>(GetNode()->GetId()));
+
+        if(member == m_committee.end())
+        {
+            NS_LOG_WARN("Validator " << GetNode()->GetId() << " is not a member of the committee");
+            return;
+        }
+        m_committeeIndex = member - m_committee.begin();
+
+        int committeePeers = 0;
+
+        for(auto const &peer: m_peersNodeIds)
+        {
+            if(std::find(m_committee.begin(), m_committee.end(), static_cast<int>(peer.second)) != m_committee.end())
+            {
+                committeePeers++;
+            }
+        }
+
+        NS_LOG_WARN("Validator " << GetNode()->GetId() << " committee size = " << m_committee.size()
+                    << ", quorum = " << GetQuorum() << ", committee members among the peers = " << committeePeers);
+
+        StartView(0);
+    }
+
+    void
+    BlockchainValidator::StopApplication()
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::StopApplication();
+        Simulator::Cancel(m_viewTimer);
+        Simulator::Cancel(m_proposeEvent);
+
+        double duration = Simulator::Now().GetSeconds() - m_startTime;
+
+        NS_LOG_WARN("The validator " << GetNode()->GetId() << " reached view " << m_currentView
+                    << " after " << m_viewChanges << " view changes, proposed " << m_proposedBlocks
+                    << " blocks and committed " << m_committedBlocks << " blocks with " << m_committedTransactions
+                    << " transactions. Finality time mean/p50/p90 = " << m_finalityTimes.GetMean() << "/"
+                    << m_finalityTimes.GetPercentile(50) << "/" << m_finalityTimes.GetPercentile(90) << "s");
+
+        m_nodeStats->minerGeneratedBlocks = m_proposedBlocks;
+        m_nodeStats->minerAverageBlockGenInterval = m_proposedBlocks > 0 ? duration / m_proposedBlocks : 0;
+        m_nodeStats->minerAverageBlockSize = m_averageProposalSize;
+        m_nodeStats->committedBlocks = m_committedBlocks;
+        m_nodeStats->committedTransactions = m_committedTransactions;
+        m_nodeStats->committedTransactionsPerSecond = duration > 0 ? m_committedTransactions / duration : 0;
+        m_nodeStats->meanFinalityTime = m_finalityTimes.GetMean();
+        m_nodeStats->finalityTimeP50 = m_finalityTimes.GetPercentile(50);
+        m_nodeStats->finalityTimeP90 = m_finalityTimes.GetPercentile(90);
+        m_nodeStats->viewChanges = m_viewChanges;
+    }
+
+    int
+    BlockchainValidator::GetLeader(int view) const
+    {
+        return m_committee[view % m_committee.size()];
+    }
+
+    int
+    BlockchainValidator::GetQuorum(void) const
+    {
+        int n = m_committee.size();
+
+        return n - (n - 1) / 3;
+    }
+
+    int
+    BlockchainValidator::GetQuorumCertificateSizeBytes(int votes) const
+    {
+        const int voterIdSizeBytes = 4;
+
+        if(m_voteAggregation)
+        {
+            return m_aggregateSignatureSizeBytes + (m_committee.size() + 7) / 8;
+        }
+        return votes * (m_signatureSizeBytes + voterIdSizeBytes);
+    }
+
+    void
+    BlockchainValidator::StartView(int view)
+    {
+        NS_LOG_FUNCTION(this << view);
+
+        if(view <= m_currentView)
+        {
+            return;
+        }
+
+        m_currentView = view;
+        Simulator::Cancel(m_viewTimer);
+        m_viewTimer = Simulator::Schedule(m_blockInterval + Seconds(m_viewTimeout.GetSeconds() * (1 << std::min(m_consecutiveTimeouts, 6))),
+                                          &BlockchainValidator::ViewTimeoutExpired, this);
+
+        /*
+         * The leader of view aggregates the votes for the proposal of view - 1
+         */
+        m_votes.erase(m_votes.begin(), m_votes.lower_bound(view - 1));
+        m_newViews.erase(m_newViews.begin(), m_newViews.lower_bound(view));
+
+        NS_LOG_INFO("StartView: At time " << Simulator::Now().GetSeconds() << "s validator " << GetNode()->GetId()
+                    << " entered view " << view << " led by " << GetLeader(view));
+
+        if(GetLeader(view) == static_cast<int>(GetNode()->GetId()) && m_highQC.view == view - 1)
+        {
+            SchedulePropose();
+        }
+    }
+
+    void
+    BlockchainValidator::ViewTimeoutExpired(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        rapidjson::Document d;
+        rapidjson::Value value;
+        rapidjson::Value justifyInfo(rapidjson::kObjectType);
+        std::ostringstream stringStream;
+        int newView = m_currentView + 1;
+        int leader = GetLeader(newView);
+
+        NS_LOG_WARN("At time " << Simulator::Now().GetSeconds() << "s view " << m_currentView
+                    << " timed out at validator " << GetNode()->GetId());
+
+        m_viewChanges++;
+        m_consecutiveTimeouts++;
+        StartView(newView);
+
+        d.SetObject();
+        stringStream << "newView/" << newView << "/" << GetNode()->GetId();
+
+        value = NEW_VIEW;
+        d.AddMember("message", value, d.GetAllocator());
+
+        value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+        d.AddMember("id", value, d.GetAllocator());
+
+        value = leader;
+        d.AddMember("to", value, d.GetAllocator());
+
+        value = newView;
+        d.AddMember("view", value, d.GetAllocator());
+
+        value = GetNode()->GetId();
+        d.AddMember("voter", value, d.GetAllocator());
+
+        value = m_highQC.height;
+        justifyInfo.AddMember("height", value, d.GetAllocator());
+
+        value = m_highQC.minerId;
+        justifyInfo.AddMember("minerId", value, d.GetAllocator());
+
+        value = m_highQC.view;
+        justifyInfo.AddMember("view", value, d.GetAllocator());
+
+        value = m_highQC.votes;
+        justifyInfo.AddMember("votes", value, d.GetAllocator());
+
+        d.AddMember("justify", justifyInfo, d.GetAllocator());
+
+        /*
+         * view, sender, signature and the certificate
+         */
+        value = 4 + 4 + (m_voteAggregation ? m_aggregateSignatureSizeBytes : m_signatureSizeBytes)
+                + (m_highQC.view >= 0 ? GetQuorumCertificateSizeBytes(m_highQC.votes) : 0);
+        d.AddMember("size", value, d.GetAllocator());
+
+        SendConsensusMessage(d, leader);
+    }
+
+    void
+    BlockchainValidator::SchedulePropose(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(GetLeader(m_currentView) != static_cast<int>(GetNode()->GetId()) || m_lastProposedView >= m_currentView)
+        {
+            return;
+        }
+
+        double delay = std::max(0.0, m_previousProposalTime + m_blockInterval.GetSeconds() - Simulator::Now().GetSeconds());
+
+        if(m_proposedBlocks == 0)
+        {
+            delay = 0;
+        }
+
+        Simulator::Cancel(m_proposeEvent);
+        m_proposeEvent = Simulator::Schedule(Seconds(delay), &BlockchainValidator::Propose, this);
+    }
+
+    void
+    BlockchainValidator::Propose(void)
+    {
+        NS_LOG_FUNCTION(this);
+
+        int height = m_highQC.height + 1;
+        int minerId = GetNode()->GetId();
+        double currentTime = Simulator::Now().GetSeconds();
+
+        if(GetLeader(m_currentView) != minerId || m_lastProposedView >= m_currentView)
+        {
+            return;
+        }
+
+        if(!m_blockchain.HasBlock(m_highQC.height, m_highQC.minerId))
+        {
+            NS_LOG_INFO("Propose: validator " << minerId << " waits for the certified block " << m_highQC.height << "/" << m_highQC.minerId);
+            m_proposeWhenAvailable = true;
+            return;
+        }
+        m_proposeWhenAvailable = false;
+
+        /*
+         * Blocks are identified by (height, minerId), so a leader proposes at most once per height.
+         * This only happens after the views of the whole committee failed at that height.
+         */
+        if(m_blockchain.HasBlock(height, minerId) || m_blockchain.IsOrphan(height, minerId))
+        {
+            NS_LOG_WARN("Validator " << minerId << " already proposed a block at height " << height << ", skipping view " << m_currentView);
+            return;
+        }
+
+        m_lastProposedView = m_currentView;
+
+        int certificateSize = m_highQC.view >= 0 ? GetQuorumCertificateSizeBytes(m_highQC.votes) : 0;
+        int blockSize = m_blockHeadersSizeBytes + certificateSize;
+
+        m_mempool.ExpireTransactions(currentTime);
+        ForgetDroppedTransactions();
+        std::vector<Transaction> blockTransactions = m_mempool.GetTransactionsByFee(m_maxBlockSize - blockSize);
+
+        for(auto &tran: blockTransactions)
+        {
+            tran.SetValidation();
+            m_mempool.RemoveTransaction(tran.GetTransNodeId(), tran.GetTransId());
+            blockSize += tran.GetTransSizeByte();
+        }
+
+        Block newBlock(height, minerId, m_currentView, m_highQC.minerId, blockSize,
+                        currentTime, currentTime, Ipv4Address("127.0.0.1"));
+        newBlock.SetTransactions(blockTransactions);
+        newBlock.SetView(m_currentView);
+        newBlock.SetJustify(m_highQC);
+
+        NS_LOG_INFO("Propose: At time " << currentTime << "s validator " << minerId << " proposed block " << height << "/" << minerId
+                    << " in view " << m_currentView << " with " << blockTransactions.size() << " transactions");
+
+        m_blockchain.AddBlock(newBlock);
+        m_txTracker.BlockAdded(newBlock, currentTime);
+        m_txTracker.UpdateConfirmations(m_blockchain, currentTime);
+        AdvertiseNewBlock(newBlock);
+
+        m_averageProposalSize = m_proposedBlocks/static_cast<double>(m_proposedBlocks+1)*m_averageProposalSize
+                                + static_cast<double>(blockSize)/(m_proposedBlocks+1);
+        m_proposedBlocks++;
+        m_previousProposalTime = currentTime;
+
+        ProcessProposal(newBlock);
+    }
+
+    void
+    BlockchainValidator::AfterBlockValidation(const Block &newBlock)
+    {
+        NS_LOG_FUNCTION(this);
+
+        BlockchainNode::AfterBlockValidation(newBlock);
+
+        if(newBlock.GetView() >= 0)
+        {
+            ProcessProposal(newBlock);
+        }
+    }
+
+    void
+    BlockchainValidator::ProcessProposal(const Block &proposal)
+    {
+        NS_LOG_FUNCTION(this);
+
+        QuorumCertificate justify = proposal.GetJustify();
+
+        UpdateHighQC(justify);
+
+        /*
+         * Chained commit rule: the proposal certifies b2, b2 certifies b1 and b1 certifies b0.
+         * Seeing the QC of b1 locks it; if b2, b1 and b0 are linked by their parents, b0 is committed.
+         */
+        if(justify.view >= 0 && m_blockchain.HasBlock(justify.height, justify.minerId))
+        {
+            Block b2 = m_blockchain.ReturnBlock(justify.height, justify.minerId);
+            QuorumCertificate qc1 = b2.GetJustify();
+
+            if(b2.GetView() >= 0 && qc1.view > m_lockedQC.view)
+            {
+                m_lockedQC = qc1;
+            }
+
+            if(b2.GetView() >= 0 && qc1.view >= 0 && m_blockchain.HasBlock(qc1.height, qc1.minerId))
+            {
+                Block b1 = m_blockchain.ReturnBlock(qc1.height, qc1.minerId);
+                QuorumCertificate qc0 = b1.GetJustify();
+
+                if(qc0.view >= 0 && b1.IsParent(b2) && qc0.height == qc1.height - 1 && qc0.minerId == b1.GetParentBlockMinerId()
+                    && qc0.height > m_committedBlock.first && m_blockchain.HasBlock(qc0.height, qc0.minerId))
+                {
+                    Commit(m_blockchain.ReturnBlock(qc0.height, qc0.minerId));
+                }
+            }
+        }
+
+        if(m_committeeIndex >= 0)
+        {
+            bool fromLeader = proposal.GetMinerId() == GetLeader(proposal.GetView());
+            bool extendsJustify = proposal.GetBlockHeight() == justify.height + 1 && proposal.GetParentBlockMinerId() == justify.minerId;
+            bool safe = justify.view > m_lockedQC.view || Extends(proposal, m_lockedQC.height, m_lockedQC.minerId);
+
+            if(proposal.GetView() >= m_currentView && proposal.GetView() > m_lastVotedView && fromLeader && extendsJustify && safe)
+            {
+                rapidjson::Document d;
+                rapidjson::Value value;
+                std::ostringstream stringStream;
+                int leader = GetLeader(proposal.GetView() + 1);
+
+                m_lastVotedView = proposal.GetView();
+                m_consecutiveTimeouts = 0;
+
+                d.SetObject();
+                stringStream << "vote/" << proposal.GetView() << "/" << GetNode()->GetId();
+
+                value = VOTE;
+                d.AddMember("message", value, d.GetAllocator());
+
+                value.SetString(stringStream.str().c_str(), stringStream.str().size(), d.GetAllocator());
+                d.AddMember("id", value, d.GetAllocator());
+
+                value = leader;
+                d.AddMember("to", value, d.GetAllocator());
+
+                value = proposal.GetView();
+                d.AddMember("view", value, d.GetAllocator());
+
+                value = proposal.GetBlockHeight();
+                d.AddMember("height", value, d.GetAllocator());
+
+                value = proposal.GetMinerId();
+                d.AddMember("minerId", value, d.GetAllocator());
+
+                value = GetNode()->GetId();
+                d.AddMember("voter", value, d.GetAllocator());
+
+                /*
+                 * view, block hash, voter and signature
+                 */
+                value = 4 + 32 + 4 + (m_voteAggregation ? m_aggregateSignatureSizeBytes : m_signatureSizeBytes);
+                d.AddMember("size", value, d.GetAllocator());
+
+                StartView(proposal.GetView() + 1);
+                SendConsensusMessage(d, leader);
+            }
+        }
+
+        if(m_proposeWhenAvailable && m_highQC.height == proposal.GetBlockHeight() && m_highQC.minerId == proposal.GetMinerId())
+        {
+            SchedulePropose();
+        }
+    }
+
+    bool
+    BlockchainValidator::Extends(const Block &block, int height, int minerId)
+    {
+        const Block *current = m_blockchain.GetBlockPointer(block);
+
+        while(current != nullptr && current->GetBlockHeight() > height)
+        {
+            current = m_blockchain.GetParent(*current);
+        }
+
+        return current != nullptr && current->GetBlockHeight() == height && current->GetMinerId() == minerId;
+    }
+
+    void
+    BlockchainValidator::UpdateHighQC(const QuorumCertificate &qc)
+    {
+        if(qc.view > m_highQC.view)
+        {
+            m_highQC = qc;
+        }
+    }
+
+    void
+    BlockchainValidator::Commit(const Block &block)
+    {
+        NS_LOG_FUNCTION(this);
+
+        std::vector<const Block *> newlyCommitted;
+        const Block *current = m_blockchain.GetBlockPointer(block);
+        double currentTime = Simulator::Now().GetSeconds();
+
+        while(current != nullptr && current->GetBlockHeight() > m_committedBlock.first)
+        {
+            newlyCommitted.push_back(current);
+            current = m_blockchain.GetParent(*current);
+        }
+
+        if(current == nullptr || current->GetMinerId() != m_committedBlock.second)
+        {
+            NS_LOG_WARN("Validator " << GetNode()->GetId() << " commits block " << block.GetBlockHeight() << "/" << block.GetMinerId()
+                        << " which does not extend the committed block " << m_committedBlock.first << "/" << m_committedBlock.second);
+        }
+
+        for(auto it = newlyCommitted.rbegin(); it != newlyCommitted.rend(); it++)
+        {
+            m_committedBlocks++;
+            m_committedTransactions += (*it)->GetTransactions().size();
+            m_finalityTimes.AddSample(currentTime - (*it)->GetTimeStamp());
+        }
+
+        m_committedBlock = std::make_pair(block.GetBlockHeight(), block.GetMinerId());
+
+        NS_LOG_INFO("Commit: At time " << currentTime << "s validator " << GetNode()->GetId()
+                    << " committed block " << block.GetBlockHeight() << "/" << block.GetMinerId());
+    }
+
+    void
+    BlockchainValidator::ReceivedConsensusMessage(rapidjson::Document &d)
+    {
+        NS_LOG_FUNCTION(this);
+
+        if(m_committeeIndex < 0)
+        {
+            return;
+        }
+
+        switch(d["message"].GetInt())
+        {
+            case VOTE:
+            {
+                ReceivedVote(d["view"].GetInt(), d["height"].GetInt(), d["minerId"].GetInt(), d["voter"].GetInt());
+                break;
+            }
+            case NEW_VIEW:
+            {
+                QuorumCertificate qc;
+
+                qc.height = d["justify"]["height"].GetInt();
+                qc.minerId = d["justify"]["minerId"].GetInt();
+                qc.view = d["justify"]["view"].GetInt();
+                qc.votes = d["justify"]["votes"].GetInt();
+
+                ReceivedNewView(d["view"].GetInt(), d["voter"].GetInt(), qc);
+                break;
+            }
+        }
+    }
+
+    void
+    BlockchainValidator::ReceivedVote(int view, int height, int minerId, int voter)
+    {
+        NS_LOG_FUNCTION(this << view << voter);
+
+        if(GetLeader(view + 1) != static_cast<int>(GetNode()->GetId()) || view + 1 < m_currentView)
+        {
+            return;
+        }
+
+        std::set<int> &voters = m_votes[view][std::make_pair(height, minerId)];
+
+        voters.insert(voter);
+
+        if(static_cast<int>(voters.size()) == GetQuorum())
+        {
+            QuorumCertificate qc;
+
+            qc.height = height;
+            qc.minerId = minerId;
+            qc.view = view;
+            qc.votes = voters.size();
+
+            NS_LOG_INFO("ReceivedVote: At time " << Simulator::Now().GetSeconds() << "s validator " << GetNode()->GetId()
+                        << " formed the certificate of block " << height << "/" << minerId << " in view " << view);
+
+            UpdateHighQC(qc);
+            StartView(view + 1);
+            SchedulePropose();
+        }
+    }
+
+    void
+    BlockchainValidator::ReceivedNewView(int view, int voter, const QuorumCertificate &qc)
+    {
+        NS_LOG_FUNCTION(this << view << voter);
+
+        UpdateHighQC(qc);
+
+        if(GetLeader(view) != static_cast<int>(GetNode()->GetId()) || view < m_currentView)
+        {
+            return;
+        }
+
+        m_newViews[view].insert(voter);
+
+        if(static_cast<int>(m_newViews[view].size()) == GetQuorum())
+        {
+            StartView(view);
+            SchedulePropose();
+        }
+    }
+
+}
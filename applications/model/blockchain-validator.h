@@ -0,0 +1,134 @@
+#ifndef BLOCKCHAIN_VALIDATOR_H
+#define BLOCKCHAIN_VALIDATOR_H
+
+#include "blockchain-node.h"
+#include "../../rapidjson/document.h"
+#include "../../rapidjson/writer.h"
+#include "../../rapidjson/stringbuffer.h"
+
+
+namespace ns3{
+
+    class Address;
+    class Socket;
+    class Packet;
+
+    /*
+     * Committee member of the BFT ordering consensus (chained HotStuff) used by LEDGER.
+     * Views rotate the leader over the committee. The leader of a view proposes a block carrying
+     * the quorum certificate (QC) of the highest certified block; the proposals travel as ordinary
+     * blocks through INV/GET_DATA/BLOCK, so the full nodes receive them too. The validators vote
+     * for a proposal by sending a VOTE to the leader of the next view, which aggregates 2f+1 votes
+     * into the QC of its own proposal, so the phases of consecutive blocks are pipelined.
+     * A block is committed when it starts a chain of three certified blocks linked by their parents.
+     * A view that makes no progress times out and the validators send NEW_VIEW with their highest QC
+     * to the next leader.
+     */
+    class BlockchainValidator : public BlockchainNode
+    {
+
+        public:
+
+            static TypeId GetTypeId(void);
+            BlockchainValidator();
+
+            virtual ~BlockchainValidator(void);
+
+            /*
+             * The node ids of the committee in leader rotation order. All the validators must get the same list.
+             */
+            std::vector<int> GetCommittee(void) const;
+            void SetCommittee(const std::vector<int> &committee);
+
+        protected:
+
+            virtual void StartApplication(void);
+            virtual void StopApplication(void);
+
+            virtual void AfterBlockValidation(const Block &newBlock);
+
+            virtual void ReceivedConsensusMessage(rapidjson::Document &d);
+
+            int GetLeader(int view) const;
+
+            /*
+             * The votes needed for a quorum certificate: 2f+1 out of n = 3f+1 validators
+             */
+            int GetQuorum(void) const;
+
+            /*
+             * The size of a quorum certificate in bytes. Aggregated votes take one signature and a bitmap
+             * of the committee, otherwise every vote is carried with the id of the voter.
+             */
+            int GetQuorumCertificateSizeBytes(int votes) const;
+
+            /*
+             * Enters the view and restarts the view timer
+             */
+            void StartView(int view);
+
+            void ViewTimeoutExpired(void);
+
+            /*
+             * Proposes a block of the current view on top of m_highQC, at least m_blockInterval after the previous proposal
+             */
+            void SchedulePropose(void);
+            void Propose(void);
+
+            /*
+             * Updates the certificates and the commits with a new proposal and votes for it if it is safe
+             */
+            void ProcessProposal(const Block &proposal);
+
+            /*
+             * True if the block descends from the block (height, minerId)
+             */
+            bool Extends(const Block &block, int height, int minerId);
+
+            void UpdateHighQC(const QuorumCertificate &qc);
+
+            /*
+             * Commits the block and its uncommitted ancestors
+             */
+            void Commit(const Block &block);
+
+            void ReceivedVote(int view, int height, int minerId, int voter);
+
+            void ReceivedNewView(int view, int voter, const QuorumCertificate &qc);
+
+            std::vector<int>                    m_committee;
+            int                                 m_committeeIndex;           // -1 if the node is not in the committee
+
+            uint32_t                            m_maxBlockSize;
+            Time                                m_blockInterval;            // minimum time between two proposals of a leader
+            Time                                m_viewTimeout;
+            bool                                m_voteAggregation;
+            const int                           m_signatureSizeBytes;       // 64 Bytes
+            const int                           m_aggregateSignatureSizeBytes;  // 96 Bytes
+
+            int                                 m_currentView;
+            int                                 m_lastVotedView;
+            int                                 m_lastProposedView;
+            int                                 m_consecutiveTimeouts;      // doubles the view timeout
+            bool                                m_proposeWhenAvailable;     // the leader waits for the block of m_highQC
+            double                              m_previousProposalTime;
+            QuorumCertificate                   m_highQC;                   // highest known certificate
+            QuorumCertificate                   m_lockedQC;                 // votes only for blocks extending it, unless justified by a newer QC
+            std::pair<int, int>                 m_committedBlock;           // (height, minerId) of the last committed block
+            EventId                             m_viewTimer;
+            EventId                             m_proposeEvent;
+
+            std::map<int, std::map<std::pair<int, int>, std::set<int>>> m_votes;   // key = view, value = voters per block
+            std::map<int, std::set<int>>                                m_newViews; // key = view, value = senders
+
+            int                                 m_proposedBlocks;
+            double                              m_averageProposalSize;
+            int                                 m_committedBlocks;
+            long                                m_committedTransactions;
+            long                                m_viewChanges;
+            LatencyHistogram                    m_finalityTimes;            // proposal -> commit
+    };
+
+}
+
+#endif
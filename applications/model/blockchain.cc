@@ -5,6 +5,7 @@
 #include "ns3/address.h"
 #include "ns3/log.h"
 #include "blockchain.h"
+#include <cmath>
 
 namespace ns3{
 
@@ -20,13 +21,15 @@ namespace ns3{
         m_transId = transId;
         m_transSizeByte = 100;
         m_timeStamp = timeStamp;
+        m_fee = 0;
         m_validatation = false;
         m_execution = false;
+        m_endorsements = 0;
+        m_destinationShard = -1;
     }
     
-    Transaction::Transaction()
+    Transaction::Transaction() : Transaction(0, 0, 0)
     {
-        Transaction(0, 0, 0);
     }
     
     Transaction::~Transaction()
@@ -81,6 +84,24 @@ namespace ns3{
         m_timeStamp = timeStamp;
     }
 
+    double
+    Transaction::GetTransFee(void) const
+    {
+        return m_fee;
+    }
+
+    void
+    Transaction::SetTransFee(double fee)
+    {
+        m_fee = fee;
+    }
+
+    double
+    Transaction::GetTransFeeRate(void) const
+    {
+        return m_fee/m_transSizeByte;
+    }
+
     bool
     Transaction::IsValidated(void) const
     {
@@ -105,6 +126,30 @@ namespace ns3{
         m_execution = true;
     }
 
+    int
+    Transaction::GetEndorsements(void) const
+    {
+        return m_endorsements;
+    }
+
+    void
+    Transaction::SetEndorsements(int endorsements)
+    {
+        m_endorsements = endorsements;
+    }
+
+    int
+    Transaction::GetDestinationShard(void) const
+    {
+        return m_destinationShard;
+    }
+
+    void
+    Transaction::SetDestinationShard(int shard)
+    {
+        m_destinationShard = shard;
+    }
+
 
     Transaction&
     Transaction::operator= (const Transaction &tranSource)
@@ -113,8 +158,11 @@ namespace ns3{
         m_transId = tranSource.m_transId;
         m_transSizeByte = tranSource.m_transSizeByte;
         m_timeStamp = tranSource.m_timeStamp;
+        m_fee = tranSource.m_fee;
         m_validatation = tranSource.m_validatation;
-        m_validatation = tranSource.m_execution;
+        m_execution = tranSource.m_execution;
+        m_endorsements = tranSource.m_endorsements;
+        m_destinationShard = tranSource.m_destinationShard;
 
         return *this;
     }
@@ -145,12 +193,18 @@ namespace ns3{
         m_timeReceived = timeReceived;
         m_receivedFromIpv4 = receivedFromIpv4;
         m_totalTransactions = 0;
+        m_view = -1;
+        m_valid = true;
+        m_microblock = false;
+        m_justify.height = 0;
+        m_justify.minerId = 0;
+        m_justify.view = -1;
+        m_justify.votes = 0;
 
     }
 
-    Block::Block()
+    Block::Block() : Block(0,0,0,0,0,0,0, Ipv4Address("0.0.0.0"))
     {
-        Block(0,0,0,0,0,0,0, Ipv4Address("0.0.0.0"));
     }
 
     Block::Block(const Block &blockSource)
@@ -164,6 +218,11 @@ namespace ns3{
         m_timeReceived = blockSource.m_timeReceived;
         m_receivedFromIpv4 = blockSource.m_receivedFromIpv4;
         m_transactions = blockSource.m_transactions;
+        m_uncles = blockSource.m_uncles;
+        m_view = blockSource.m_view;
+        m_justify = blockSource.m_justify;
+        m_valid = blockSource.m_valid;
+        m_microblock = blockSource.m_microblock;
         m_totalTransactions = 0;
         
     }
@@ -250,6 +309,12 @@ namespace ns3{
         return m_timeReceived;
     }
 
+    void
+    Block::SetTimeReceived(double timeReceived)
+    {
+        m_timeReceived = timeReceived;
+    }
+
     Ipv4Address
     Block::GetReceivedFromIpv4(void) const
     {
@@ -274,6 +339,66 @@ namespace ns3{
         m_transactions = transactions;
     }
 
+    std::vector<std::pair<int, int>>
+    Block::GetUncles(void) const
+    {
+        return m_uncles;
+    }
+
+    void
+    Block::SetUncles(const std::vector<std::pair<int, int>> &uncles)
+    {
+        m_uncles = uncles;
+    }
+
+    int
+    Block::GetView(void) const
+    {
+        return m_view;
+    }
+
+    void
+    Block::SetView(int view)
+    {
+        m_view = view;
+    }
+
+    QuorumCertificate
+    Block::GetJustify(void) const
+    {
+        return m_justify;
+    }
+
+    void
+    Block::SetJustify(const QuorumCertificate &justify)
+    {
+        m_justify = justify;
+    }
+
+    bool
+    Block::IsValid(void) const
+    {
+        return m_valid;
+    }
+
+    void
+    Block::SetValid(bool valid)
+    {
+        m_valid = valid;
+    }
+
+    bool
+    Block::IsMicroblock(void) const
+    {
+        return m_microblock;
+    }
+
+    void
+    Block::SetMicroblock(bool microblock)
+    {
+        m_microblock = microblock;
+    }
+
     bool
     Block::IsParent(const Block &block) const
     {
@@ -376,6 +501,12 @@ namespace ns3{
         m_timeStamp = blockSource.m_timeStamp;
         m_timeReceived = blockSource.m_timeReceived;
         m_receivedFromIpv4 = blockSource.m_receivedFromIpv4;
+        m_transactions = blockSource.m_transactions;
+        m_uncles = blockSource.m_uncles;
+        m_view = blockSource.m_view;
+        m_justify = blockSource.m_justify;
+        m_valid = blockSource.m_valid;
+        m_microblock = blockSource.m_microblock;
 
         return *this;
     }
@@ -399,6 +530,8 @@ namespace ns3{
     Blockchain::Blockchain(void)
     {
         m_totalBlocks = 0;
+        m_totalMicroblocks = 0;
+        m_forkChoiceRule = LONGEST_CHAIN;
         Block genesisBlock(0,0,0,0,0,0,0, Ipv4Address("0.0.0.0"));
         AddBlock(genesisBlock);
     }
@@ -413,6 +546,12 @@ namespace ns3{
         return m_totalBlocks;
     }
 
+    int
+    Blockchain::GetTotalMicroblocks(void) const
+    {
+        return m_totalMicroblocks;
+    }
+
     int
     Blockchain::GetBlockchainHeight(void) const
     {
@@ -422,7 +561,7 @@ namespace ns3{
     bool
     Blockchain::HasBlock(const Block &newBlock) const
     {
-        if(newBlock.GetBlockHeight() > GetCurrentTopBlock()->GetBlockHeight())
+        if(newBlock.GetBlockHeight() >= static_cast<int>(m_blocks.size()))
         {
             // We didn't receive the new block which have a new block height.
             return false;
@@ -444,7 +583,7 @@ namespace ns3{
     bool
     Blockchain::HasBlock(int height, int minerId) const
     {
-        if(height > GetCurrentTopBlock()->GetBlockHeight())
+        if(height >= static_cast<int>(m_blocks.size()) || height < 0)
         {
             // We didn't receive the new block which have a new block height.
             return false;
@@ -467,7 +606,7 @@ namespace ns3{
     {
         std::vector<Block>::iterator block_it;
 
-        if(height <= GetBlockchainHeight() && height >= 0)
+        if(height < static_cast<int>(m_blocks.size()) && height >= 0)
         {
             for(block_it = m_blocks[height].begin(); block_it < m_blocks[height].end(); block_it++)
             {
@@ -518,6 +657,11 @@ namespace ns3{
     const Block*
     Blockchain::GetBlockPointer(const Block &newBlock) const
     {
+        if(newBlock.GetBlockHeight() >= static_cast<int>(m_blocks.size()))
+        {
+            return nullptr;
+        }
+
         for(auto const &block : m_blocks[newBlock.GetBlockHeight()])
         {
             if(block == newBlock)
@@ -536,7 +680,7 @@ namespace ns3{
         std::vector<Block>::iterator block_it;
         int childrenHeight = block.GetBlockHeight() + 1;
 
-        if(childrenHeight > GetBlockchainHeight())
+        if(childrenHeight >= static_cast<int>(m_blocks.size()))
         {
             return children;
         }
@@ -574,7 +718,7 @@ namespace ns3{
         std::vector<Block>::iterator block_it;
         int parentHeight = block.GetBlockHeight() - 1;
 
-        if(parentHeight > GetBlockchainHeight() || parentHeight < 0)
+        if(parentHeight >= static_cast<int>(m_blocks.size()) || parentHeight < 0)
             return nullptr;
         
         for(block_it = m_blocks[parentHeight].begin(); block_it < m_blocks[parentHeight].end(); block_it++)
@@ -590,148 +734,1998 @@ namespace ns3{
     const Block*
     Blockchain::GetCurrentTopBlock(void) const
     {
-        return &m_blocks[m_blocks.size()-1][0];
+        return &m_blocks[m_mainChain.size()-1][m_mainChain.back()];
+    }
+
+    void
+    Blockchain::SetForkChoiceRule(enum ForkChoiceRule forkChoiceRule)
+    {
+        m_forkChoiceRule = forkChoiceRule;
+    }
+
+    enum ForkChoiceRule
+    Blockchain::GetForkChoiceRule(void) const
+    {
+        return m_forkChoiceRule;
     }
 
     void
     Blockchain::AddBlock(const Block& newBlock)
     {
+        int height = newBlock.GetBlockHeight();
 
-        if(m_blocks.size() == 0)
+        while(static_cast<int>(m_blocks.size()) <= height)
         {
-           std::vector<Block> newHeight(1, newBlock);
-           m_blocks.push_back(newHeight);
+            std::vector<Block> newHeight;
+            std::vector<BlockTreeNode> newTreeHeight;
+            m_blocks.push_back(newHeight);
+            m_blockTree.push_back(newTreeHeight);
         }
-        else if(newBlock.GetBlockHeight() > GetCurrentTopBlock()->GetBlockHeight())
-        {
-           int dummyRows = newBlock.GetBlockHeight() - GetCurrentTopBlock()->GetBlockHeight()-1;
 
-           for(int i = 0 ; i < dummyRows; i++)
-           {
-               std::vector<Block> newHeight;
-               m_blocks.push_back(newHeight);
-           }
+        BlockTreeNode node;
+        node.parent = -1;
+        node.subtreeWeight = 1;
+        node.keyBlocks = newBlock.IsMicroblock() ? 0 : 1;
 
-           std::vector<Block> newHeight(1, newBlock);
-           m_blocks.push_back(newHeight);
+        if(height > 0)
+        {
+            for(unsigned int i = 0; i < m_blocks[height-1].size(); i++)
+            {
+                if(newBlock.IsChild(m_blocks[height-1][i]))
+                {
+                    node.parent = i;
+                    break;
+                }
+            }
         }
-        else
+
+        if(node.parent >= 0)
         {
-            m_blocks[newBlock.GetBlockHeight()].push_back(newBlock);
+            node.keyBlocks += m_blockTree[height-1][node.parent].keyBlocks;
         }
+
+        int index = m_blocks[height].size();
+        m_blocks[height].push_back(newBlock);
+        m_blockTree[height].push_back(node);
         m_totalBlocks++;
-    }
 
-    void
-    Blockchain::AddOrphan(const Block& newBlock)
-    {
-        m_orphans.push_back(newBlock);
-    }
+        if(newBlock.IsMicroblock())
+        {
+            m_totalMicroblocks++;
+        }
 
-    void
-    Blockchain::RemoveOrphan(const Block& newBlock)
-    {
-        std::vector<Block>::iterator block_it;
+        if(m_mainChain.empty())
+        {
+            m_mainChain.push_back(index);       // the genesis block
+            m_joinedBlocks.push_back(1);
+            return;
+        }
 
-        for(block_it = m_orphans.begin(); block_it < m_orphans.end(); block_it++)
+        /*
+         * The blocks that arrived before their parent hang from the tree without one, attach them
+         * and their descendants below the new block
+         */
+        bool relinked = false;
+
+        if(height + 1 < static_cast<int>(m_blocks.size()))
         {
-            if(newBlock==*block_it)
+            for(unsigned int i = 0; i < m_blocks[height+1].size(); i++)
             {
-                break;
+                if(m_blockTree[height+1][i].parent < 0 && newBlock.IsParent(m_blocks[height+1][i]))
+                {
+                    m_blockTree[height+1][i].parent = index;
+                    m_blockTree[height][index].children.push_back(i);
+                    m_blockTree[height][index].subtreeWeight += m_blockTree[height+1][i].subtreeWeight;
+                    UpdateKeyBlocks(height + 1, i);
+                    relinked = true;
+                }
             }
         }
-        
-        if(block_it == m_orphans.end())
+
+        if(node.parent < 0)
         {
             return;
         }
+
+        m_blockTree[height-1][node.parent].children.push_back(index);
+
+        int joinHeight = AddWeightToAncestors(height - 1, node.parent, m_blockTree[height][index].subtreeWeight);
+
+        if(relinked)
+        {
+            std::pair<int, int> best = GetBestDescendant(height, index);
+            UpdateMainChain(joinHeight, best.first, best.second);
+        }
         else
         {
-            m_orphans.erase(block_it);
+            UpdateMainChain(joinHeight, height, index);
         }
     }
 
+    bool
+    Blockchain::IsMainChainBlock(int height, int index) const
+    {
+        return height < static_cast<int>(m_mainChain.size()) && m_mainChain[height] == index;
+    }
 
+    int
+    Blockchain::AddWeightToAncestors(int height, int index, int weight)
+    {
+        /*
+         * Only the blocks out of the main chain keep their weight, so the walk stops where the branch joins
+         * the main chain and costs the depth of the fork instead of the height of the chain
+         */
+        for(int h = height, i = index; i >= 0; i = m_blockTree[h][i].parent, h--)
+        {
+            if(IsMainChainBlock(h, i))
+            {
+                m_joinedBlocks[h] += weight;
+                return h;
+            }
+            m_blockTree[h][i].subtreeWeight += weight;
+        }
+        return -1;
+    }
 
-    const char* getMessageName(enum Messages m)
+    int
+    Blockchain::GetWeight(int height, int index) const
     {
-        switch(m)
+        if(!IsMainChainBlock(height, index))
         {
-            case INV: return "INV";
-            case TRANSACTION: return "TRANSACTION";
-            case GET_HEADERS: return "GET_HEADERS";
-            case HEADERS: return "HEADERS";
-            case GET_DATA: return "GET_DATA";
-            case BLOCK: return "BLOCK";
-            case NO_MESSAGE: return "NO_MESSAGE";
+            return m_blockTree[height][index].subtreeWeight;
         }
 
-        return 0;
+        // the subtree of a main chain block holds the blocks joining the main chain at its height or above
+        int weight = 0;
+
+        for(unsigned int h = height; h < m_joinedBlocks.size(); h++)
+        {
+            weight += m_joinedBlocks[h];
+        }
+        return weight;
     }
 
-    const char* getMinerType(enum MinerType m)
+    void
+    Blockchain::TruncateMainChain(int joinHeight)
     {
-        switch(m)
+        int weight = 0;
+
+        // the blocks leaving the main chain keep their weight again, and join it at joinHeight
+        for(int h = m_mainChain.size() - 1; h > joinHeight; h--)
         {
-            case NORMAL_MINER: return "ETHEREUM";
-            case ENDORSER: return "ENDORSER";
-            case ORDER: return "ORDER";
+            weight += m_joinedBlocks[h];
+            m_blockTree[h][m_mainChain[h]].subtreeWeight = weight;
         }
 
-        return 0;
+        m_joinedBlocks[joinHeight] += weight;
+        m_mainChain.resize(joinHeight + 1);
+        m_joinedBlocks.resize(joinHeight + 1);
     }
 
-    const char* getProtocolType(enum ProtocolType m)
+    void
+    Blockchain::ExtendMainChain(int index)
     {
-         switch(m)
-         {
-             case STANDARD_PROTOCOL: return "STANDARD_PROTOCOL";
-             case SENDHEADERS: return "SENDHEADERS";
-         }
+        int height = m_mainChain.size();
+        int weight = m_blockTree[height][index].subtreeWeight;
 
-         return 0;
+        m_joinedBlocks[height - 1] -= weight;
+        m_joinedBlocks.push_back(weight);
+        m_mainChain.push_back(index);
     }
 
-    const char* getCryptocurrency(enum Cryptocurrency m)
+    void
+    Blockchain::UpdateKeyBlocks(int height, int index)
     {
-        switch(m)
+        std::vector<std::pair<int, int>> blocks(1, std::make_pair(height, index));
+
+        while(!blocks.empty())
         {
-            case ETHEREUM: return "ETHEREUM";
-            case LEDGER: return "LEDGER";
+            int h = blocks.back().first;
+            int i = blocks.back().second;
+            BlockTreeNode &node = m_blockTree[h][i];
+
+            blocks.pop_back();
+            node.keyBlocks = (m_blocks[h][i].IsMicroblock() ? 0 : 1) + (node.parent >= 0 ? m_blockTree[h-1][node.parent].keyBlocks : 0);
+
+            for(auto const &child: node.children)
+            {
+                blocks.push_back(std::make_pair(h + 1, child));
+            }
         }
-        
-        return 0;
     }
 
-    const char* getBlockchainRegion(enum BlockchainRegion m)
+    std::pair<int, int>
+    Blockchain::GetBestDescendant(int height, int index) const
     {
-        switch(m)
+        std::vector<std::pair<int, int>> blocks(1, std::make_pair(height, index));
+        std::pair<int, int> best(height, index);
+
+        // the highest descendant, or the one with the most key blocks for KEY_BLOCKS
+        while(!blocks.empty())
         {
-            case NORTH_AMERICA: return "NORTH_AMERICA";
-            case EUROPE: return "EUROPE";
-            case SOUTH_AMERICA: return "SOUTH_AMERICA";
-            case KOREA: return "KOREA";
-            case JAPAN: return "JAPAN";
-            case AUSTRALIA: return "AUSTRALIA";
-            case OTHER: return "OTHER";
+            std::pair<int, int> block = blocks.back();
+            const BlockTreeNode &node = m_blockTree[block.first][block.second];
+            const BlockTreeNode &bestNode = m_blockTree[best.first][best.second];
+
+            blocks.pop_back();
+
+            if(m_forkChoiceRule == KEY_BLOCKS ? std::make_pair(node.keyBlocks, block.first) > std::make_pair(bestNode.keyBlocks, best.first)
+                                              : block.first > best.first)
+            {
+                best = block;
+            }
+
+            for(auto const &child: node.children)
+            {
+                blocks.push_back(std::make_pair(block.first + 1, child));
+            }
         }
+        return best;
+    }
 
-        return 0;
+    void
+    Blockchain::UpdateMainChain(int joinHeight, int height, int index)
+    {
+        int topHeight = m_mainChain.size() - 1;
+
+        if(joinHeight < 0)
+        {
+            return;
+        }
+
+        if(m_forkChoiceRule == LONGEST_CHAIN || m_forkChoiceRule == KEY_BLOCKS)
+        {
+            /*
+             * KEY_BLOCKS: a block extending the top is always accepted, the microblocks included.
+             * Another branch only wins with strictly more key blocks, so a key block mined on an
+             * earlier microblock of the leader prunes the microblocks streamed after it.
+             */
+            if(m_forkChoiceRule == LONGEST_CHAIN && height <= topHeight)
+            {
+                return;
+            }
+
+            if(m_forkChoiceRule == KEY_BLOCKS && joinHeight < topHeight
+               && m_blockTree[height][index].keyBlocks <= m_blockTree[topHeight][m_mainChain[topHeight]].keyBlocks)
+            {
+                return;
+            }
+
+            std::vector<int> branch;
+
+            for(int h = height, i = index; h > joinHeight; i = m_blockTree[h][i].parent, h--)
+            {
+                branch.push_back(i);
+            }
+
+            TruncateMainChain(joinHeight);
+
+            for(auto block_it = branch.rbegin(); block_it != branch.rend(); block_it++)
+            {
+                ExtendMainChain(*block_it);
+            }
+            return;
+        }
+
+        /*
+         * GHOST: the weights above the join point grew on the main chain side as well, so only the
+         * child of the join point needs to be compared. If the new branch is now strictly heavier,
+         * the main chain is rebuilt from the join point by following the heaviest children.
+         */
+        if(joinHeight < topHeight)
+        {
+            int branch = index;
+
+            for(int h = height; h > joinHeight + 1; h--)
+            {
+                branch = m_blockTree[h][branch].parent;
+            }
+
+            if(GetWeight(joinHeight + 1, branch) <= GetWeight(joinHeight + 1, m_mainChain[joinHeight + 1]))
+            {
+                return;
+            }
+        }
+
+        TruncateMainChain(joinHeight);
+
+        for(int child = GetHeaviestChild(joinHeight, m_mainChain[joinHeight]); child >= 0;
+            child = GetHeaviestChild(m_mainChain.size() - 1, child))
+        {
+            ExtendMainChain(child);
+        }
     }
 
-    enum BlockchainRegion getBlockchainEnum(uint32_t n)
+    int
+    Blockchain::GetHeaviestChild(int height, int index) const
     {
-        switch(n)
+        int heaviest = -1;
+
+        // on equal weights the child received first wins
+        for(auto const &child: m_blockTree[height][index].children)
         {
-            case 0: return NORTH_AMERICA;
-            case 1: return EUROPE;
-            case 2: return SOUTH_AMERICA;
-            case 3: return KOREA;
-            case 4: return JAPAN;
-            case 5: return AUSTRALIA;
-            case 6: return OTHER;
+            if(heaviest < 0 || GetWeight(height + 1, child) > GetWeight(height + 1, heaviest))
+            {
+                heaviest = child;
+            }
         }
-        return OTHER;
+        return heaviest;
+    }
+
+    bool
+    Blockchain::IsInMainChain(int height, int minerId) const
+    {
+        if(height < 0 || height >= static_cast<int>(m_mainChain.size()))
+        {
+            return false;
+        }
+        return m_blocks[height][m_mainChain[height]].GetMinerId() == minerId;
+    }
+
+    const Block*
+    Blockchain::GetMainChainBlock(int height) const
+    {
+        if(height < 0 || height >= static_cast<int>(m_mainChain.size()))
+        {
+            return 0;
+        }
+        return &m_blocks[height][m_mainChain[height]];
+    }
+
+    std::vector<std::pair<int, int>>
+    Blockchain::GetLocator(void) const
+    {
+        std::vector<std::pair<int, int>> locator;
+        int step = 1;
+
+        for(int height = m_mainChain.size() - 1; height > 0; height -= step)
+        {
+            locator.push_back(std::make_pair(height, m_blocks[height][m_mainChain[height]].GetMinerId()));
+
+            if(locator.size() >= 10)
+            {
+                step *= 2;
+            }
+        }
+        locator.push_back(std::make_pair(0, m_blocks[0][m_mainChain[0]].GetMinerId()));
+
+        return locator;
+    }
+
+    std::vector<std::pair<int, int>>
+    Blockchain::GetUncleCandidates(int maxUncles, int maxDepth) const
+    {
+        std::vector<std::pair<int, int>> uncles;
+        std::set<std::pair<int, int>> referenced;
+        int newHeight = m_mainChain.size();
+        int lowestHeight = std::max(newHeight - maxDepth, 1);
+
+        for(int h = lowestHeight; h < newHeight; h++)
+        {
+            for(auto const &uncle: m_blocks[h][m_mainChain[h]].GetUncles())
+            {
+                referenced.insert(uncle);
+            }
+        }
+
+        // prefer the most recent stale blocks
+        for(int h = newHeight - 1; h >= lowestHeight && static_cast<int>(uncles.size()) < maxUncles; h--)
+        {
+            for(unsigned int i = 0; i < m_blocks[h].size() && static_cast<int>(uncles.size()) < maxUncles; i++)
+            {
+                std::pair<int, int> uncle(h, m_blocks[h][i].GetMinerId());
+
+                if(static_cast<int>(i) != m_mainChain[h] && m_blockTree[h][i].parent == m_mainChain[h-1]
+                   && referenced.find(uncle) == referenced.end())
+                {
+                    uncles.push_back(uncle);
+                }
+            }
+        }
+        return uncles;
+    }
+
+    int
+    Blockchain::GetBlocksInForks(void) const
+    {
+        return m_totalBlocks - m_mainChain.size();
+    }
+
+    int
+    Blockchain::GetLongestForkSize(void) const
+    {
+        std::vector<int> forkSizes;
+        std::vector<int> previousForkSizes;
+        int longestFork = 0;
+
+        // length of the side branch ending at each block, 0 for the main chain
+        for(unsigned int h = 0; h < m_blocks.size(); h++)
+        {
+            forkSizes.assign(m_blocks[h].size(), 0);
+
+            for(unsigned int i = 0; i < m_blocks[h].size(); i++)
+            {
+                if(h < m_mainChain.size() && m_mainChain[h] == static_cast<int>(i))
+                {
+                    continue;
+                }
+
+                int parent = m_blockTree[h][i].parent;
+                forkSizes[i] = (parent >= 0 ? previousForkSizes[parent] : 0) + 1;
+                longestFork = std::max(longestFork, forkSizes[i]);
+            }
+            previousForkSizes.swap(forkSizes);
+        }
+        return longestFork;
+    }
+
+    int
+    Blockchain::GetMinedBlocksInMainChain(int minerId) const
+    {
+        int minedBlocks = 0;
+
+        for(unsigned int h = 1; h < m_mainChain.size(); h++)
+        {
+            if(m_blocks[h][m_mainChain[h]].GetMinerId() == minerId)
+            {
+                minedBlocks++;
+            }
+        }
+        return minedBlocks;
+    }
+
+    int
+    Blockchain::GetUnclesInMainChain(void) const
+    {
+        int uncles = 0;
+
+        for(unsigned int h = 1; h < m_mainChain.size(); h++)
+        {
+            uncles += m_blocks[h][m_mainChain[h]].GetUncles().size();
+        }
+        return uncles;
+    }
+
+    long
+    Blockchain::GetTransactionsInMainChain(void) const
+    {
+        long transactions = 0;
+
+        for(unsigned int h = 1; h < m_mainChain.size(); h++)
+        {
+            transactions += m_blocks[h][m_mainChain[h]].GetTransactions().size();
+        }
+        return transactions;
+    }
+
+    void
+    Blockchain::AddOrphan(const Block& newBlock)
+    {
+        m_orphans.push_back(newBlock);
+    }
+
+    void
+    Blockchain::RemoveOrphan(const Block& newBlock)
+    {
+        std::vector<Block>::iterator block_it;
+
+        for(block_it = m_orphans.begin(); block_it < m_orphans.end(); block_it++)
+        {
+            if(newBlock==*block_it)
+            {
+                break;
+            }
+        }
+        
+        if(block_it == m_orphans.end())
+        {
+            return;
+        }
+        else
+        {
+            m_orphans.erase(block_it);
+        }
+    }
+
+
+
+    /*
+     *
+     * Class Mempool Function
+     * 
+     */
+
+    Mempool::Mempool(void)
+    {
+        m_maxSizeBytes = 300000000;
+        m_expiryTime = 0;
+        m_sizeBytes = 0;
+        m_peakSizeBytes = 0;
+        m_rejected = 0;
+        m_evicted = 0;
+        m_expired = 0;
+    }
+
+    Mempool::~Mempool(void)
+    {
+    }
+
+    void
+    Mempool::SetMaxSizeBytes(uint64_t maxSizeBytes)
+    {
+        m_maxSizeBytes = maxSizeBytes;
+    }
+
+    void
+    Mempool::SetExpiryTime(double expiryTime)
+    {
+        m_expiryTime = expiryTime;
+    }
+
+    void
+    Mempool::Remove(std::unordered_map<uint64_t, std::pair<Transaction, double>>::iterator entry)
+    {
+        m_byFeeRate.erase(std::make_pair(entry->second.first.GetTransFeeRate(), entry->first));
+        m_sizeBytes -= entry->second.first.GetTransSizeByte();
+        m_transactions.erase(entry);
+    }
+
+    bool
+    Mempool::AddTransaction(const Transaction &newTrans, double time)
+    {
+        uint64_t key = getTransactionKey(newTrans.GetTransNodeId(), newTrans.GetTransId());
+        uint64_t size = newTrans.GetTransSizeByte();
+        uint64_t freedBytes = 0;
+        std::vector<uint64_t> victims;
+
+        if(m_transactions.find(key) != m_transactions.end())
+        {
+            return true;
+        }
+
+        ExpireTransactions(time);
+
+        if(size > m_maxSizeBytes)
+        {
+            m_rejected++;
+            return false;
+        }
+
+        /*
+         * Find the lowest fee rate transactions that have to leave. If one of them pays at least as much
+         * as the new transaction, the new transaction is rejected and the pool stays as it is.
+         */
+        for(auto fee_it = m_byFeeRate.begin(); m_sizeBytes - freedBytes + size > m_maxSizeBytes; fee_it++)
+        {
+            if(fee_it->first >= newTrans.GetTransFeeRate())
+            {
+                m_rejected++;
+                return false;
+            }
+            freedBytes += m_transactions[fee_it->second].first.GetTransSizeByte();
+            victims.push_back(fee_it->second);
+        }
+
+        for(auto const &victim: victims)
+        {
+            Remove(m_transactions.find(victim));
+            m_dropped.push_back(victim);
+            m_evicted++;
+        }
+
+        m_transactions[key] = std::make_pair(newTrans, time);
+        m_byFeeRate.insert(std::make_pair(newTrans.GetTransFeeRate(), key));
+        m_sizeBytes += size;
+        m_peakSizeBytes = std::max(m_peakSizeBytes, m_sizeBytes);
+
+        if(m_expiryTime > 0)
+        {
+            m_entryTimes.push_back(std::make_pair(time, key));
+        }
+
+        return true;
+    }
+
+    bool
+    Mempool::RemoveTransaction(int nodeId, int transId)
+    {
+        auto entry = m_transactions.find(getTransactionKey(nodeId, transId));
+
+        if(entry == m_transactions.end())
+        {
+            return false;
+        }
+
+        Remove(entry);
+        return true;
+    }
+
+    bool
+    Mempool::HasTransaction(int nodeId, int transId) const
+    {
+        return m_transactions.find(getTransactionKey(nodeId, transId)) != m_transactions.end();
+    }
+
+    Transaction
+    Mempool::ReturnTransaction(int nodeId, int transId) const
+    {
+        auto entry = m_transactions.find(getTransactionKey(nodeId, transId));
+
+        if(entry == m_transactions.end())
+        {
+            return Transaction();
+        }
+
+        return entry->second.first;
+    }
+
+    void
+    Mempool::ExpireTransactions(double time)
+    {
+        while(!m_entryTimes.empty() && m_entryTimes.front().first < time - m_expiryTime)
+        {
+            auto entry = m_transactions.find(m_entryTimes.front().second);
+
+            // the transaction may have been removed already, or removed and added again later
+            if(entry != m_transactions.end() && entry->second.second == m_entryTimes.front().first)
+            {
+                Remove(entry);
+                m_dropped.push_back(m_entryTimes.front().second);
+                m_expired++;
+            }
+            m_entryTimes.pop_front();
+        }
+    }
+
+    std::vector<uint64_t>
+    Mempool::TakeDroppedTransactions(void)
+    {
+        std::vector<uint64_t> dropped;
+
+        dropped.swap(m_dropped);
+        return dropped;
+    }
+
+    std::vector<Transaction>
+    Mempool::GetTransactionsByFee(int maxSizeBytes) const
+    {
+        std::vector<Transaction> transactions;
+        int sizeBytes = 0;
+
+        for(auto fee_it = m_byFeeRate.rbegin(); fee_it != m_byFeeRate.rend(); fee_it++)
+        {
+            const Transaction &tran = m_transactions.at(fee_it->second).first;
+
+            if(sizeBytes + tran.GetTransSizeByte() > maxSizeBytes)
+            {
+                break;
+            }
+            sizeBytes += tran.GetTransSizeByte();
+            transactions.push_back(tran);
+        }
+
+        return transactions;
+    }
+
+    int
+    Mempool::GetSize(void) const
+    {
+        return m_transactions.size();
+    }
+
+    uint64_t
+    Mempool::GetSizeBytes(void) const
+    {
+        return m_sizeBytes;
+    }
+
+    uint64_t
+    Mempool::GetPeakSizeBytes(void) const
+    {
+        return m_peakSizeBytes;
+    }
+
+    long
+    Mempool::GetRejectedTransactions(void) const
+    {
+        return m_rejected;
+    }
+
+    long
+    Mempool::GetEvictedTransactions(void) const
+    {
+        return m_evicted;
+    }
+
+    long
+    Mempool::GetExpiredTransactions(void) const
+    {
+        return m_expired;
+    }
+
+    /*
+     *
+     * Class SignatureCache Function
+     * 
+     */
+
+    SignatureCache::SignatureCache(void)
+    {
+        m_maxEntries = 100000;
+        m_insertions = 0;
+    }
+
+    SignatureCache::~SignatureCache(void)
+    {
+    }
+
+    void
+    SignatureCache::SetMaxEntries(uint32_t maxEntries)
+    {
+        m_maxEntries = maxEntries;
+    }
+
+    bool
+    SignatureCache::IsCurrent(const std::pair<uint64_t, uint64_t> &insertion) const
+    {
+        auto entry = m_entries.find(insertion.second);
+
+        return entry != m_entries.end() && entry->second == insertion.first;
+    }
+
+    void
+    SignatureCache::Insert(uint64_t key)
+    {
+        if(m_maxEntries == 0 || !m_entries.insert(std::make_pair(key, m_insertions)).second)
+        {
+            return;
+        }
+
+        m_insertionOrder.push_back(std::make_pair(m_insertions++, key));
+
+        // the stale elements of erased or reinserted keys are skipped, they must not evict the current entries
+        while(m_entries.size() > m_maxEntries)
+        {
+            if(IsCurrent(m_insertionOrder.front()))
+            {
+                m_entries.erase(m_insertionOrder.front().second);
+            }
+            m_insertionOrder.pop_front();
+        }
+
+        // drop the stale elements, so that the queue does not grow with them
+        if(m_insertionOrder.size() > 2*m_entries.size() + 1)
+        {
+            std::deque<std::pair<uint64_t, uint64_t>> insertionOrder;
+
+            for(auto const &insertion: m_insertionOrder)
+            {
+                if(IsCurrent(insertion))
+                {
+                    insertionOrder.push_back(insertion);
+                }
+            }
+            m_insertionOrder.swap(insertionOrder);
+        }
+    }
+
+    bool
+    SignatureCache::Contains(uint64_t key) const
+    {
+        return m_entries.find(key) != m_entries.end();
+    }
+
+    void
+    SignatureCache::Erase(uint64_t key)
+    {
+        m_entries.erase(key);
+    }
+
+    /*
+     *
+     * Class RollingBloomFilter Function
+     * 
+     */
+
+    RollingBloomFilter::RollingBloomFilter(int items, double fpRate)
+    {
+        // the two generations are checked, so each one gets half of the false positive budget. A rate of 0
+        // would need infinitely many bits.
+        double generationFpRate = std::min(std::max(fpRate, 1e-9), 0.5)/2;
+
+        m_items = std::max(items, 1);
+        m_noBits = static_cast<uint32_t>(std::ceil(-m_items*std::log(generationFpRate)/(std::log(2)*std::log(2))));
+        m_noHashes = std::max(1, static_cast<int>(std::round(static_cast<double>(m_noBits)/m_items*std::log(2))));
+        m_currentItems = 0;
+        m_previousItems = 0;
+        m_current.assign(m_noBits, false);
+        m_previous.assign(m_noBits, false);
+    }
+
+    RollingBloomFilter::RollingBloomFilter(void) : RollingBloomFilter(5000, 0.001)
+    {
+    }
+
+    RollingBloomFilter::~RollingBloomFilter(void)
+    {
+    }
+
+    uint32_t
+    RollingBloomFilter::GetBit(uint64_t key, int i) const
+    {
+        // double hashing on top of the splitmix64 finalizer
+        uint64_t h1 = key + 0x9E3779B97F4A7C15ULL;
+        h1 = (h1 ^ (h1 >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h1 = (h1 ^ (h1 >> 27)) * 0x94D049BB133111EBULL;
+        h1 = h1 ^ (h1 >> 31);
+
+        uint64_t h2 = (h1 >> 32) | 1;
+
+        return (h1 + i*h2) % m_noBits;
+    }
+
+    void
+    RollingBloomFilter::Insert(uint64_t key)
+    {
+        if(m_currentItems == m_items)
+        {
+            m_previous.swap(m_current);
+            m_current.assign(m_noBits, false);
+            m_previousItems = m_currentItems;
+            m_currentItems = 0;
+        }
+
+        for(int i = 0; i < m_noHashes; i++)
+        {
+            m_current[GetBit(key, i)] = true;
+        }
+        m_currentItems++;
+    }
+
+    bool
+    RollingBloomFilter::Contains(uint64_t key) const
+    {
+        bool inCurrent = true;
+        bool inPrevious = true;
+
+        for(int i = 0; i < m_noHashes && (inCurrent || inPrevious); i++)
+        {
+            uint32_t bit = GetBit(key, i);
+
+            inCurrent = inCurrent && m_current[bit];
+            inPrevious = inPrevious && m_previous[bit];
+        }
+
+        return inCurrent || inPrevious;
+    }
+
+    double
+    RollingBloomFilter::GetGenerationFalsePositiveRate(int insertedItems) const
+    {
+        return std::pow(1 - std::exp(-static_cast<double>(m_noHashes)*insertedItems/m_noBits), m_noHashes);
+    }
+
+    double
+    RollingBloomFilter::GetFalsePositiveRate(void) const
+    {
+        return 1 - (1 - GetGenerationFalsePositiveRate(m_currentItems))*(1 - GetGenerationFalsePositiveRate(m_previousItems));
+    }
+
+    /*
+     *
+     * Class LatencyHistogram Function
+     * 
+     */
+
+    LatencyHistogram::LatencyHistogram(double minValue, double maxValue, double resolution)
+    {
+        m_minValue = minValue;
+        m_logResolution = std::log1p(resolution);
+        m_count = 0;
+        m_sum = 0;
+
+        // bucket 0 holds the values below minValue and the last bucket the values above maxValue
+        int noBuckets = static_cast<int>(std::ceil(std::log(maxValue/minValue)/m_logResolution)) + 2;
+        m_buckets.assign(noBuckets, 0);
+    }
+
+    LatencyHistogram::LatencyHistogram(void) : LatencyHistogram(0.001, 100000, 0.05)
+    {
+    }
+
+    LatencyHistogram::~LatencyHistogram(void)
+    {
+    }
+
+    int
+    LatencyHistogram::GetBucket(double value) const
+    {
+        if(value < m_minValue)
+        {
+            return 0;
+        }
+
+        int bucket = 1 + static_cast<int>(std::log(value/m_minValue)/m_logResolution);
+
+        return std::min(bucket, static_cast<int>(m_buckets.size()) - 1);
+    }
+
+    void
+    LatencyHistogram::AddSample(double value)
+    {
+        m_buckets[GetBucket(value)]++;
+        m_count++;
+        m_sum += value;
+    }
+
+    double
+    LatencyHistogram::GetPercentile(double percentile) const
+    {
+        if(m_count == 0)
+        {
+            return 0;
+        }
+
+        uint64_t target = static_cast<uint64_t>(std::ceil(percentile/100*m_count));
+        uint64_t cumulative = 0;
+
+        if(target < 1)
+        {
+            target = 1;
+        }
+
+        for(unsigned int i = 0; i < m_buckets.size(); i++)
+        {
+            cumulative += m_buckets[i];
+
+            if(cumulative >= target)
+            {
+                if(i == 0)
+                {
+                    return m_minValue;
+                }
+
+                // geometric middle of the bucket
+                return m_minValue * std::exp((i - 0.5)*m_logResolution);
+            }
+        }
+
+        return m_minValue * std::exp((m_buckets.size() - 1.5)*m_logResolution);
+    }
+
+    double
+    LatencyHistogram::GetMean(void) const
+    {
+        if(m_count == 0)
+        {
+            return 0;
+        }
+        return m_sum/m_count;
+    }
+
+    uint64_t
+    LatencyHistogram::GetCount(void) const
+    {
+        return m_count;
+    }
+
+    void
+    LatencyHistogram::Merge(const LatencyHistogram &histogram)
+    {
+        Merge(histogram.m_buckets, histogram.m_sum);
+    }
+
+    void
+    LatencyHistogram::Merge(const std::vector<uint32_t> &buckets, double sum)
+    {
+        NS_ASSERT_MSG(buckets.size() == m_buckets.size(), "Merging latency histograms with different buckets");
+
+        for(unsigned int i = 0; i < m_buckets.size(); i++)
+        {
+            m_buckets[i] += buckets[i];
+            m_count += buckets[i];
+        }
+        m_sum += sum;
+    }
+
+    const std::vector<uint32_t>&
+    LatencyHistogram::GetBuckets(void) const
+    {
+        return m_buckets;
+    }
+
+    double
+    LatencyHistogram::GetSum(void) const
+    {
+        return m_sum;
+    }
+
+    /*
+     *
+     * Class TransactionTracker Function
+     * 
+     */
+
+    TransactionTracker::TransactionTracker(void)
+    {
+        m_sampleRate = 1;
+        m_confirmationDepth = 12;
+        m_retentionTime = 86400;
+        m_trackedTransactions = 0;
+    }
+
+    TransactionTracker::~TransactionTracker(void)
+    {
+    }
+
+    void
+    TransactionTracker::SetSampleRate(uint32_t sampleRate)
+    {
+        m_sampleRate = std::max(sampleRate, 1u);
+    }
+
+    void
+    TransactionTracker::SetConfirmationDepth(int confirmationDepth)
+    {
+        m_confirmationDepth = std::max(confirmationDepth, 1);
+    }
+
+    int
+    TransactionTracker::GetConfirmationDepth(void) const
+    {
+        return m_confirmationDepth;
+    }
+
+    void
+    TransactionTracker::SetRetentionTime(double retentionTime)
+    {
+        m_retentionTime = retentionTime;
+    }
+
+    bool
+    TransactionTracker::IsSampled(int nodeId, int transId) const
+    {
+        if(m_sampleRate <= 1)
+        {
+            return true;
+        }
+
+        uint64_t hash = getTransactionKey(nodeId, transId) * 0x9E3779B97F4A7C15ULL;
+
+        return (hash >> 32) % m_sampleRate == 0;
+    }
+
+    bool
+    TransactionTracker::IsFollowed(const Transaction &tran, double time) const
+    {
+        return IsSampled(tran.GetTransNodeId(), tran.GetTransId()) && time - tran.GetTransTimeStamp() <= m_retentionTime;
+    }
+
+    void
+    TransactionTracker::ForgetExpired(double time)
+    {
+        /*
+         * An entry is added at least when the transaction is created, so a transaction seen again after its entry
+         * was freed is older than the retention time and IsFollowed ignores it
+         */
+        while(!m_followedSince.empty() && m_followedSince.front().first + m_retentionTime < time)
+        {
+            m_stages.erase(m_followedSince.front().second);
+            m_followedSince.pop_front();
+        }
+    }
+
+    void
+    TransactionTracker::TransactionCreated(const Transaction &newTrans)
+    {
+        double time = newTrans.GetTransTimeStamp();
+
+        if(!IsFollowed(newTrans, time))
+        {
+            return;
+        }
+
+        uint64_t key = getTransactionKey(newTrans.GetTransNodeId(), newTrans.GetTransId());
+
+        ForgetExpired(time);
+        m_stages[key] = SEEN;
+        m_followedSince.push_back(std::make_pair(time, key));
+        m_trackedTransactions++;
+    }
+
+    void
+    TransactionTracker::TransactionSeen(const Transaction &newTrans, double time)
+    {
+        if(!IsFollowed(newTrans, time))
+        {
+            return;
+        }
+
+        uint64_t key = getTransactionKey(newTrans.GetTransNodeId(), newTrans.GetTransId());
+
+        ForgetExpired(time);
+
+        if(m_stages.find(key) == m_stages.end())
+        {
+            m_stages[key] = SEEN;
+            m_followedSince.push_back(std::make_pair(time, key));
+            m_trackedTransactions++;
+            m_firstSeenTimes.AddSample(time - newTrans.GetTransTimeStamp());
+        }
+    }
+
+    void
+    TransactionTracker::BlockAdded(const Block &newBlock, double time)
+    {
+        std::vector<Transaction> transactions = newBlock.GetTransactions();
+        std::pair<int, int> blockId(newBlock.GetBlockHeight(), newBlock.GetMinerId());
+
+        ForgetExpired(time);
+
+        for(auto const &tran: transactions)
+        {
+            if(!IsFollowed(tran, time))
+            {
+                continue;
+            }
+
+            uint64_t key = getTransactionKey(tran.GetTransNodeId(), tran.GetTransId());
+            double latency = time - tran.GetTransTimeStamp();
+            auto stage = m_stages.find(key);
+
+            if(stage == m_stages.end())
+            {
+                // the node sees the transaction for the first time inside the block
+                m_stages[key] = INCLUDED;
+                m_followedSince.push_back(std::make_pair(time, key));
+                m_trackedTransactions++;
+                m_firstSeenTimes.AddSample(latency);
+                m_inclusionTimes.AddSample(latency);
+            }
+            else if(stage->second == SEEN)
+            {
+                stage->second = INCLUDED;
+                m_inclusionTimes.AddSample(latency);
+            }
+            else if(stage->second == CONFIRMED)
+            {
+                continue;
+            }
+
+            // a transaction may be included in competing blocks, the first one to be confirmed counts
+            m_pendingConfirmations[blockId].push_back(std::make_pair(key, tran.GetTransTimeStamp()));
+        }
+    }
+
+    void
+    TransactionTracker::UpdateConfirmations(Blockchain &blockchain, double time)
+    {
+        if(m_pendingConfirmations.empty())
+        {
+            return;
+        }
+
+        const Block *block = blockchain.GetCurrentTopBlock();
+        int confirmedHeight = block->GetBlockHeight() - m_confirmationDepth + 1;
+        int lowestHeight = m_pendingConfirmations.begin()->first.first;
+        std::map<int, int> mainChain;               // key = height, value = minerId
+
+        if(lowestHeight > confirmedHeight)
+        {
+            return;
+        }
+
+        while(block != nullptr && block->GetBlockHeight() >= lowestHeight)
+        {
+            if(block->GetBlockHeight() <= confirmedHeight)
+            {
+                mainChain[block->GetBlockHeight()] = block->GetMinerId();
+            }
+            block = blockchain.GetParent(*block);
+        }
+
+        auto pending_it = m_pendingConfirmations.begin();
+
+        while(pending_it != m_pendingConfirmations.end() && pending_it->first.first <= confirmedHeight)
+        {
+            int height = pending_it->first.first;
+            auto mainBlock = mainChain.find(height);
+
+            if(mainBlock != mainChain.end() && mainBlock->second == pending_it->first.second)
+            {
+                for(auto const &tran: pending_it->second)
+                {
+                    auto stage = m_stages.find(tran.first);
+
+                    if(stage != m_stages.end() && stage->second != CONFIRMED)
+                    {
+                        m_confirmationTimes.AddSample(time - tran.second);
+                        stage->second = CONFIRMED;
+                    }
+                }
+                pending_it = m_pendingConfirmations.erase(pending_it);
+            }
+            else if(height + m_confirmationDepth <= confirmedHeight)
+            {
+                // the block stayed out of the main chain for another k blocks, so it is considered stale
+                pending_it = m_pendingConfirmations.erase(pending_it);
+            }
+            else
+            {
+                pending_it++;
+            }
+        }
+    }
+
+    uint64_t
+    TransactionTracker::GetTrackedTransactions(void) const
+    {
+        return m_trackedTransactions;
+    }
+
+    const LatencyHistogram&
+    TransactionTracker::GetFirstSeenTimes(void) const
+    {
+        return m_firstSeenTimes;
+    }
+
+    const LatencyHistogram&
+    TransactionTracker::GetInclusionTimes(void) const
+    {
+        return m_inclusionTimes;
+    }
+
+    const LatencyHistogram&
+    TransactionTracker::GetConfirmationTimes(void) const
+    {
+        return m_confirmationTimes;
+    }
+
+    UploadScheduler::UploadScheduler(void) : m_discipline(FIFO_UPLOADS), m_quantumBytes(100000), m_pendingUploads(0), m_peakPendingUploads(0)
+    {
+    }
+
+    UploadScheduler::~UploadScheduler(void)
+    {
+    }
+
+    void
+    UploadScheduler::SetDiscipline(enum UploadDiscipline discipline)
+    {
+        m_discipline = discipline;
+    }
+
+    void
+    UploadScheduler::SetQuantum(int quantumBytes)
+    {
+        m_quantumBytes = std::max(quantumBytes, 1);
+    }
+
+    void
+    UploadScheduler::SetPeerPriority(Ipv4Address peer, double priority)
+    {
+        m_priorities[peer] = priority;
+    }
+
+    void
+    UploadScheduler::Enqueue(const Upload &upload)
+    {
+        std::deque<Upload> &queue = m_queues[upload.peer];
+
+        if(queue.empty())
+        {
+            if(m_discipline == FAIR_SHARE_UPLOADS)
+            {
+                m_activePeers.push_back(upload.peer);
+                m_deficits[upload.peer] = 0;
+            }
+            else if(m_discipline == PEER_PRIORITY_UPLOADS)
+            {
+                m_priorityPeers.insert(std::make_pair(m_priorities[upload.peer], upload.peer));
+            }
+        }
+
+        if(m_discipline == FIFO_UPLOADS)
+        {
+            m_requestOrder.push_back(upload.peer);
+        }
+
+        queue.push_back(upload);
+        m_pendingUploads++;
+        m_peakPendingUploads = std::max(m_peakPendingUploads, m_pendingUploads);
+    }
+
+    UploadScheduler::Upload
+    UploadScheduler::Dequeue(void)
+    {
+        Ipv4Address peer;
+
+        switch(m_discipline)
+        {
+            case FIFO_UPLOADS:
+            {
+                peer = m_requestOrder.front();
+                m_requestOrder.pop_front();
+                break;
+            }
+            case FAIR_SHARE_UPLOADS:
+            {
+                /*
+                 * The peer at the front of the round uploads while its deficit covers its next upload,
+                 * otherwise it earns a quantum and waits for its next turn at the back of the round
+                 */
+                while(m_deficits[m_activePeers.front()] < m_queues[m_activePeers.front()].front().sizeBytes)
+                {
+                    m_deficits[m_activePeers.front()] += m_quantumBytes;
+                    m_activePeers.push_back(m_activePeers.front());
+                    m_activePeers.pop_front();
+                }
+
+                peer = m_activePeers.front();
+                m_deficits[peer] -= m_queues[peer].front().sizeBytes;
+
+                if(m_queues[peer].size() == 1)
+                {
+                    m_activePeers.pop_front();
+                    m_deficits.erase(peer);
+                }
+                break;
+            }
+            case PEER_PRIORITY_UPLOADS:
+            {
+                auto highest = std::prev(m_priorityPeers.end());
+
+                peer = highest->second;
+
+                if(m_queues[peer].size() == 1)
+                {
+                    m_priorityPeers.erase(highest);
+                }
+                break;
+            }
+        }
+
+        std::deque<Upload> &queue = m_queues[peer];
+        Upload upload = queue.front();
+
+        queue.pop_front();
+        m_pendingUploads--;
+
+        return upload;
+    }
+
+    bool
+    UploadScheduler::HasPendingUploads(void) const
+    {
+        return m_pendingUploads > 0;
+    }
+
+    int
+    UploadScheduler::GetPendingUploads(void) const
+    {
+        return m_pendingUploads;
+    }
+
+    int
+    UploadScheduler::GetPeakPendingUploads(void) const
+    {
+        return m_peakPendingUploads;
+    }
+
+    DownloadLink::DownloadLink(void) : m_capacity(0), m_lastUpdate(0), m_nextId(0), m_peakActiveTransfers(0)
+    {
+    }
+
+    DownloadLink::~DownloadLink(void)
+    {
+    }
+
+    void
+    DownloadLink::SetCapacity(double bytesPerSecond)
+    {
+        m_capacity = bytesPerSecond;
+        UpdateRates();
+    }
+
+    int
+    DownloadLink::AddTransfer(double sizeBytes, double maxRate, double time)
+    {
+        Transfer transfer;
+
+        Advance(time);
+
+        transfer.remainingBytes = sizeBytes;
+        transfer.maxRate = maxRate;
+        transfer.rate = 0;
+        m_transfers[m_nextId] = transfer;
+        m_peakActiveTransfers = std::max(m_peakActiveTransfers, static_cast<int>(m_transfers.size()));
+
+        UpdateRates();
+        return m_nextId++;
+    }
+
+    void
+    DownloadLink::RemoveTransfer(int id, double time)
+    {
+        Advance(time);
+        m_transfers.erase(id);
+        UpdateRates();
+    }
+
+    std::pair<int, double>
+    DownloadLink::GetNextCompletion(void) const
+    {
+        std::pair<int, double> next(-1, 0);
+
+        for(auto const &transfer: m_transfers)
+        {
+            double finish = m_lastUpdate + (transfer.second.rate > 0 ? transfer.second.remainingBytes / transfer.second.rate : 0);
+
+            if(next.first < 0 || finish < next.second)
+            {
+                next = std::make_pair(transfer.first, finish);
+            }
+        }
+
+        return next;
+    }
+
+    int
+    DownloadLink::GetActiveTransfers(void) const
+    {
+        return m_transfers.size();
+    }
+
+    int
+    DownloadLink::GetPeakActiveTransfers(void) const
+    {
+        return m_peakActiveTransfers;
+    }
+
+    void
+    DownloadLink::Advance(double time)
+    {
+        for(auto &transfer: m_transfers)
+        {
+            transfer.second.remainingBytes = std::max(transfer.second.remainingBytes - transfer.second.rate * (time - m_lastUpdate), 0.0);
+        }
+        m_lastUpdate = time;
+    }
+
+    void
+    DownloadLink::UpdateRates(void)
+    {
+        std::vector<std::pair<double, int>> caps;       // (maxRate, id), lowest cap first
+        double available = m_capacity;
+        int remaining = m_transfers.size();
+
+        for(auto const &transfer: m_transfers)
+        {
+            caps.push_back(std::make_pair(transfer.second.maxRate, transfer.first));
+        }
+        std::sort(caps.begin(), caps.end());
+
+        /*
+         * Water-filling: a transfer capped below the equal share of what is left keeps its cap,
+         * the others get the equal share
+         */
+        for(auto const &cap: caps)
+        {
+            double rate = std::min(cap.first, available / remaining);
+
+            m_transfers[cap.second].rate = rate;
+            available -= rate;
+            remaining--;
+        }
+    }
+
+    ChunkedBlock::ChunkedBlock(const Block &header, int chunkSizeBytes) : m_header(header), m_chunkSizeBytes(chunkSizeBytes), m_receivedChunks(0)
+    {
+        int chunks = GetChunks(header.GetBlockSizeBytes(), chunkSizeBytes);
+
+        m_header.SetTransactions(std::vector<Transaction>());
+        m_received.assign(chunks, false);
+        m_transactions.resize(chunks);
+    }
+
+    ChunkedBlock::ChunkedBlock(void) : ChunkedBlock(Block(), 1)
+    {
+    }
+
+    ChunkedBlock::~ChunkedBlock(void)
+    {
+    }
+
+    int
+    ChunkedBlock::GetChunks(int blockSizeBytes, int chunkSizeBytes)
+    {
+        return std::max((blockSizeBytes + chunkSizeBytes - 1) / std::max(chunkSizeBytes, 1), 1);
+    }
+
+    std::vector<Transaction>
+    ChunkedBlock::GetChunkTransactions(const std::vector<Transaction> &transactions, int chunk, int chunks)
+    {
+        size_t first = transactions.size() * chunk / chunks;
+        size_t last = transactions.size() * (chunk + 1) / chunks;
+
+        return std::vector<Transaction>(transactions.begin() + first, transactions.begin() + last);
+    }
+
+    const Block&
+    ChunkedBlock::GetHeader(void) const
+    {
+        return m_header;
+    }
+
+    int
+    ChunkedBlock::GetChunks(void) const
+    {
+        return m_received.size();
+    }
+
+    int
+    ChunkedBlock::GetChunkSizeBytes(int chunk) const
+    {
+        return std::min(m_chunkSizeBytes, m_header.GetBlockSizeBytes() - chunk * m_chunkSizeBytes);
+    }
+
+    bool
+    ChunkedBlock::HasChunk(int chunk) const
+    {
+        return chunk >= 0 && chunk < GetChunks() && m_received[chunk];
+    }
+
+    const std::vector<Transaction>&
+    ChunkedBlock::GetChunkTransactions(int chunk) const
+    {
+        return m_transactions[chunk];
+    }
+
+    bool
+    ChunkedBlock::AddChunk(int chunk, const std::vector<Transaction> &transactions)
+    {
+        if(chunk < 0 || chunk >= GetChunks() || m_received[chunk])
+        {
+            return false;
+        }
+
+        m_received[chunk] = true;
+        m_transactions[chunk] = transactions;
+        m_requests.erase(chunk);
+        m_receivedChunks++;
+        return true;
+    }
+
+    bool
+    ChunkedBlock::IsComplete(void) const
+    {
+        return m_receivedChunks == GetChunks();
+    }
+
+    Block
+    ChunkedBlock::Assemble(void) const
+    {
+        Block block(m_header);
+        std::vector<Transaction> transactions;
+
+        for(auto const &chunk: m_transactions)
+        {
+            transactions.insert(transactions.end(), chunk.begin(), chunk.end());
+        }
+        block.SetTransactions(transactions);
+
+        return block;
+    }
+
+    std::string
+    ChunkedBlock::GetBitmap(void) const
+    {
+        std::string bitmap;
+
+        for(bool received: m_received)
+        {
+            bitmap += received ? '1' : '0';
+        }
+
+        return bitmap;
+    }
+
+    void
+    ChunkedBlock::SetPeerChunks(Ipv4Address peer, const std::string &bitmap)
+    {
+        std::vector<bool> &chunks = m_peersChunks[peer];
+
+        chunks.assign(GetChunks(), false);
+
+        for(size_t i = 0; i < bitmap.size() && i < chunks.size(); i++)
+        {
+            chunks[i] = bitmap[i] == '1';
+        }
+    }
+
+    bool
+    ChunkedBlock::PeerHasAllChunks(Ipv4Address peer) const
+    {
+        auto chunks = m_peersChunks.find(peer);
+
+        return chunks != m_peersChunks.end() && std::find(chunks->second.begin(), chunks->second.end(), false) == chunks->second.end();
+    }
+
+    std::vector<int>
+    ChunkedBlock::RequestChunks(Ipv4Address peer, int maxInFlight)
+    {
+        std::vector<int> requested;
+        std::vector<std::pair<int, int>> candidates;        // (peers that have the chunk, chunk)
+        auto peerChunks = m_peersChunks.find(peer);
+        int inFlight = 0;
+
+        if(peerChunks == m_peersChunks.end())
+        {
+            return requested;
+        }
+
+        for(auto const &request: m_requests)
+        {
+            if(request.second == peer)
+            {
+                inFlight++;
+            }
+        }
+
+        for(int chunk = 0; chunk < GetChunks(); chunk++)
+        {
+            if(!m_received[chunk] && peerChunks->second[chunk] && m_requests.find(chunk) == m_requests.end())
+            {
+                int owners = 0;
+
+                for(auto const &chunks: m_peersChunks)
+                {
+                    owners += chunks.second[chunk];
+                }
+                candidates.push_back(std::make_pair(owners, chunk));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for(auto const &candidate: candidates)
+        {
+            if(inFlight >= maxInFlight)
+            {
+                break;
+            }
+
+            m_requests[candidate.second] = peer;
+            requested.push_back(candidate.second);
+            inFlight++;
+        }
+
+        return requested;
+    }
+
+    SendQueue::SendQueue(void) : SendQueue(std::vector<uint32_t>(PRIORITY_CLASSES, 1))
+    {
+    }
+
+    SendQueue::SendQueue(const std::vector<uint32_t> &weights) : m_messages(PRIORITY_CLASSES), m_weights(weights),
+                                                                  m_finishTimes(PRIORITY_CLASSES, 0), m_classBytes(PRIORITY_CLASSES, 0),
+                                                                  m_virtualTime(0), m_current(-1), m_offset(0), m_bytes(0)
+    {
+        m_weights.resize(PRIORITY_CLASSES, 1);
+
+        for(auto &weight: m_weights)
+        {
+            weight = std::max(weight, 1u);
+        }
+    }
+
+    SendQueue::~SendQueue(void)
+    {
+    }
+
+    void
+    SendQueue::Push(const std::string &message, enum MessagePriority priority, double time)
+    {
+        m_messages[priority].push_back(std::make_pair(message, time));
+        m_classBytes[priority] += message.size();
+        m_bytes += message.size();
+
+        if(m_current < 0)
+        {
+            SelectNext();
+        }
+    }
+
+    bool
+    SendQueue::IsEmpty(void) const
+    {
+        return m_current < 0;
+    }
+
+    uint32_t
+    SendQueue::GetBytes(void) const
+    {
+        return m_bytes;
+    }
+
+    uint32_t
+    SendQueue::GetBytes(enum MessagePriority priority) const
+    {
+        return m_classBytes[priority];
+    }
+
+    const uint8_t*
+    SendQueue::GetFront(void) const
+    {
+        return reinterpret_cast<const uint8_t*>(m_messages[m_current].front().first.data()) + m_offset;
+    }
+
+    uint32_t
+    SendQueue::GetFrontSize(void) const
+    {
+        return m_messages[m_current].front().first.size() - m_offset;
+    }
+
+    enum MessagePriority
+    SendQueue::GetFrontPriority(void) const
+    {
+        return static_cast<enum MessagePriority>(m_current);
+    }
+
+    double
+    SendQueue::GetFrontTime(void) const
+    {
+        return m_messages[m_current].front().second;
+    }
+
+    void
+    SendQueue::Pop(uint32_t bytes)
+    {
+        m_offset += bytes;
+        m_bytes -= bytes;
+        m_classBytes[m_current] -= bytes;
+
+        if(m_offset >= m_messages[m_current].front().first.size())
+        {
+            m_messages[m_current].pop_front();
+            m_offset = 0;
+            SelectNext();
+        }
+    }
+
+    void
+    SendQueue::Clear(void)
+    {
+        for(int priority = 0; priority < PRIORITY_CLASSES; priority++)
+        {
+            if(priority == m_current && m_offset > 0)
+            {
+                m_messages[priority].resize(1);
+                m_classBytes[priority] = m_messages[priority].front().first.size() - m_offset;
+            }
+            else
+            {
+                m_messages[priority].clear();
+                m_classBytes[priority] = 0;
+            }
+        }
+
+        m_bytes = m_current >= 0 ? m_classBytes[m_current] : 0;
+
+        if(m_bytes == 0)
+        {
+            m_current = -1;
+        }
+    }
+
+    void
+    SendQueue::SelectNext(void)
+    {
+        int next = -1;
+        double nextFinishTime = 0;
+
+        /*
+         * A message finishes one size/weight after the later of the last message of its class and the
+         * current virtual time, the ties go to the most urgent class
+         */
+        for(int priority = 0; priority < PRIORITY_CLASSES; priority++)
+        {
+            if(m_messages[priority].empty())
+            {
+                continue;
+            }
+
+            double finishTime = std::max(m_finishTimes[priority], m_virtualTime)
+                                + m_messages[priority].front().first.size() / static_cast<double>(m_weights[priority]);
+
+            if(next < 0 || finishTime < nextFinishTime)
+            {
+                next = priority;
+                nextFinishTime = finishTime;
+            }
+        }
+
+        if(next >= 0)
+        {
+            m_virtualTime = std::max(m_finishTimes[next], m_virtualTime);
+            m_finishTimes[next] = nextFinishTime;
+        }
+        m_current = next;
+    }
+
+    const char* getMessageName(enum Messages m)
+    {
+        switch(m)
+        {
+            case INV: return "INV";
+            case TRANSACTION: return "TRANSACTION";
+            case GET_HEADERS: return "GET_HEADERS";
+            case HEADERS: return "HEADERS";
+            case GET_DATA: return "GET_DATA";
+            case BLOCK: return "BLOCK";
+            case NO_MESSAGE: return "NO_MESSAGE";
+            case VOTE: return "VOTE";
+            case NEW_VIEW: return "NEW_VIEW";
+            case ENDORSE: return "ENDORSE";
+            case ENDORSEMENT: return "ENDORSEMENT";
+            case SUBMIT: return "SUBMIT";
+            case APPEND: return "APPEND";
+            case APPEND_ACK: return "APPEND_ACK";
+            case ATTESTATION: return "ATTESTATION";
+            case RECEIPT: return "RECEIPT";
+            case CHUNK_INV: return "CHUNK_INV";
+            case GET_CHUNKS: return "GET_CHUNKS";
+            case CHUNK: return "CHUNK";
+        }
+
+        return 0;
+    }
+
+    const char* getMinerType(enum MinerType m)
+    {
+        switch(m)
+        {
+            case NORMAL_MINER: return "ETHEREUM";
+            case ENDORSER: return "ENDORSER";
+            case ORDER: return "ORDER";
+        }
+
+        return 0;
+    }
+
+    const char* getProtocolType(enum ProtocolType m)
+    {
+         switch(m)
+         {
+             case STANDARD_PROTOCOL: return "STANDARD_PROTOCOL";
+             case SENDHEADERS: return "SENDHEADERS";
+             case BLOCK_TORRENT: return "BLOCK_TORRENT";
+         }
+
+         return 0;
+    }
+
+    const char* getCryptocurrency(enum Cryptocurrency m)
+    {
+        switch(m)
+        {
+            case ETHEREUM: return "ETHEREUM";
+            case LEDGER: return "LEDGER";
+        }
+        
+        return 0;
+    }
+
+    const char* getTransactionRelayType(enum TransactionRelayType m)
+    {
+        switch(m)
+        {
+            case PUSH_TRANSACTIONS: return "PUSH_TRANSACTIONS";
+            case ANNOUNCE_TRANSACTIONS: return "ANNOUNCE_TRANSACTIONS";
+        }
+
+        return 0;
+    }
+
+    const char* getForkChoiceRule(enum ForkChoiceRule m)
+    {
+        switch(m)
+        {
+            case LONGEST_CHAIN: return "LONGEST_CHAIN";
+            case GHOST: return "GHOST";
+            case KEY_BLOCKS: return "KEY_BLOCKS";
+        }
+
+        return 0;
+    }
+
+    const char* getUploadDiscipline(enum UploadDiscipline m)
+    {
+        switch(m)
+        {
+            case FIFO_UPLOADS: return "FIFO_UPLOADS";
+            case FAIR_SHARE_UPLOADS: return "FAIR_SHARE_UPLOADS";
+            case PEER_PRIORITY_UPLOADS: return "PEER_PRIORITY_UPLOADS";
+        }
+
+        return 0;
+    }
+
+    const char* getMessagePriority(enum MessagePriority m)
+    {
+        switch(m)
+        {
+            case CONSENSUS_PRIORITY: return "CONSENSUS_PRIORITY";
+            case INVENTORY_PRIORITY: return "INVENTORY_PRIORITY";
+            case BULK_PRIORITY: return "BULK_PRIORITY";
+        }
+
+        return 0;
+    }
+
+    const char* getSessionDistribution(enum SessionDistribution m)
+    {
+        switch(m)
+        {
+            case EXPONENTIAL_SESSIONS: return "EXPONENTIAL_SESSIONS";
+            case WEIBULL_SESSIONS: return "WEIBULL_SESSIONS";
+            case PARETO_SESSIONS: return "PARETO_SESSIONS";
+        }
+
+        return 0;
+    }
+
+    enum MessagePriority getPriorityEnum(enum Messages m)
+    {
+        switch(m)
+        {
+            case INV:
+            case CHUNK_INV:
+                return INVENTORY_PRIORITY;
+            case TRANSACTION:
+            case ENDORSE:
+            case ENDORSEMENT:
+            case SUBMIT:
+            case RECEIPT:
+                return BULK_PRIORITY;
+            default:
+                return CONSENSUS_PRIORITY;
+        }
+    }
+
+    const char* getBlockchainRegion(enum BlockchainRegion m)
+    {
+        switch(m)
+        {
+            case NORTH_AMERICA: return "NORTH_AMERICA";
+            case EUROPE: return "EUROPE";
+            case SOUTH_AMERICA: return "SOUTH_AMERICA";
+            case KOREA: return "KOREA";
+            case JAPAN: return "JAPAN";
+            case AUSTRALIA: return "AUSTRALIA";
+            case OTHER: return "OTHER";
+        }
+
+        return 0;
+    }
+
+    enum BlockchainRegion getBlockchainEnum(uint32_t n)
+    {
+        switch(n)
+        {
+            case 0: return NORTH_AMERICA;
+            case 1: return EUROPE;
+            case 2: return SOUTH_AMERICA;
+            case 3: return KOREA;
+            case 4: return JAPAN;
+            case 5: return AUSTRALIA;
+            case 6: return OTHER;
+        }
+        return OTHER;
+    }
+
+    uint64_t getTransactionKey(int nodeId, int transId)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(nodeId)) << 32) | static_cast<uint32_t>(transId);
     }
 
 }
\ No newline at end of file
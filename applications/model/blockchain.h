@@ -4,6 +4,10 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <deque>
 #include "ns3/address.h"
 
 namespace ns3 {
@@ -17,6 +21,18 @@ namespace ns3 {
         GET_DATA,       //4
         BLOCK,          //5    
         NO_MESSAGE,     //6
+        VOTE,           //7
+        NEW_VIEW,       //8
+        ENDORSE,        //9
+        ENDORSEMENT,    //10
+        SUBMIT,         //11
+        APPEND,         //12
+        APPEND_ACK,     //13
+        ATTESTATION,    //14
+        RECEIPT,        //15
+        CHUNK_INV,      //16
+        GET_CHUNKS,     //17
+        CHUNK,          //18
     };
 
     enum MinerType
@@ -29,7 +45,35 @@ namespace ns3 {
     enum ProtocolType
     {
         STANDARD_PROTOCOL,      //default
-        SENDHEADERS
+        SENDHEADERS,
+        BLOCK_TORRENT           //blocks are relayed in chunks
+    };
+
+    enum TransactionRelayType
+    {
+        PUSH_TRANSACTIONS,          //default, full transactions are pushed to the peers
+        ANNOUNCE_TRANSACTIONS       //transactions are announced in INV messages and fetched with GET_DATA
+    };
+
+    enum UploadDiscipline
+    {
+        FIFO_UPLOADS,               //default, the blocks are uploaded in the order they were requested
+        FAIR_SHARE_UPLOADS,         //deficit round robin over the peers, every peer gets the same share of the upload bytes
+        PEER_PRIORITY_UPLOADS       //the blocks requested by the peer with the highest priority are uploaded first
+    };
+
+    enum SessionDistribution
+    {
+        EXPONENTIAL_SESSIONS,       //default, memoryless sessions and downtimes
+        WEIBULL_SESSIONS,           //heavy tailed with shape < 1, as measured on peer-to-peer networks
+        PARETO_SESSIONS             //heavy tailed with shape > 1
+    };
+
+    enum MessagePriority
+    {
+        CONSENSUS_PRIORITY,         //blocks, headers, block and chunk requests and the consensus votes
+        INVENTORY_PRIORITY,         //INV and CHUNK_INV announcements
+        BULK_PRIORITY               //transactions and the transaction flow of fabric
     };
 
     enum Cryptocurrency
@@ -38,6 +82,13 @@ namespace ns3 {
         LEDGER
     };
 
+    enum ForkChoiceRule
+    {
+        LONGEST_CHAIN,          //default, the highest block received first is the top block
+        GHOST,                  //the top block is found by following the heaviest subtree from the genesis
+        KEY_BLOCKS              //Bitcoin-NG, the branch with the most key blocks wins, microblocks only extend the branch of their leader
+    };
+
     enum BlockchainRegion
     {
         NORTH_AMERICA,
@@ -80,6 +131,87 @@ namespace ns3 {
         int     nodeGeneratedTransaction;
         double  meanMiningTime;
         double  meanLatency;
+        long    trackedTransactions;            // sampled transactions followed by the lifecycle tracker
+        double  meanTransactionFirstSeenTime;   // creation -> first seen by this node
+        double  meanTransactionInclusionTime;   // creation -> first block including it
+        double  transactionInclusionTimeP50;
+        double  transactionInclusionTimeP90;
+        double  transactionInclusionTimeP99;
+        double  transactionConfirmTimeP50;      // creation -> k confirmations
+        double  transactionConfirmTimeP90;
+        double  transactionConfirmTimeP99;
+        long    mempoolRejectedTransactions;    // transactions refused by a full mempool
+        long    mempoolEvictedTransactions;     // transactions evicted by higher fee ones
+        long    mempoolExpiredTransactions;     // transactions that stayed in the mempool longer than the expiry time
+        long    mempoolPeakSizeBytes;
+        long    suppressedBlockAdvertisements;  // INV sends skipped because the peer already knew the block
+        long    suppressedTransactionSends;     // TRANSACTION sends skipped because the peer already knew the transaction
+        long    inventoryFilterFalsePositives;  // only counted when the inventory audit is enabled
+        double  inventoryFilterEstimatedFpRate;
+        double  inventoryFilterMeasuredFpRate;
+        long    transactionReceivedBytes;
+        long    transactionSentBytes;
+        long    duplicateTransactionReceivedBytes;  // bytes of transactions the node already had
+        long    transactionRequestTimeouts;
+        long    signatureCacheHits;             // block transactions already verified on mempool entry
+        long    signatureCacheMisses;           // block transactions verified for the first time
+        int     unclesInMainChain;              // uncle references included by the main chain blocks
+        long    consensusReceivedBytes;         // VOTE, NEW_VIEW, ATTESTATION and RECEIPT messages, and the messages of the execute-order-validate pipeline
+        long    consensusSentBytes;
+        int     committedBlocks;                // blocks finalized by the BFT consensus or the finality gadget, or ordered blocks committed by a peer of the pipeline
+        long    committedTransactions;
+        double  committedTransactionsPerSecond;
+        double  meanFinalityTime;               // proposal -> commit
+        double  finalityTimeP50;
+        double  finalityTimeP90;
+        long    viewChanges;                    // views left because their timeout expired
+        long    executedProposals;              // transaction proposals simulated by an endorser
+        double  endorserUtilization;            // fraction of the time the endorser was executing
+        long    submittedTransactions;          // endorsed transactions sent to the ordering service
+        double  meanEndorsementTime;            // proposal -> endorsement policy satisfied
+        int     orderedBlocks;                  // blocks cut by the ordering service leader
+        long    orderedTransactions;
+        long    batchTimeouts;                  // blocks cut by the batch timeout before the batch was full
+        double  cpuUtilization;                 // busy time of the cores over their available time
+        double  meanCpuQueueingTime;            // time the cpu tasks waited for a free core
+        double  cpuQueueingTimeP99;
+        int     invalidBlocks;                  // received blocks rejected by the full validation
+        long    mainChainTransactions;
+        int     headerTipSwitches;              // switches of the miner to a tip known only by its header
+        int     headerMinedBlocks;              // empty blocks mined on tips not validated yet
+        int     headerMiningRollbacks;          // unvalidated tips that turned out invalid
+        int     headerMiningDiscardedBlocks;    // blocks mined on top of invalid tips
+        double  meanHeaderRiskWindow;           // time from the switch to an unvalidated tip until it is validated or left
+        double  headerMiningInvalidTime;        // total time spent mining on invalid tips
+        int     slots;                          // slots elapsed in the proof-of-stake mode
+        int     missedSlots;                    // slots without a block in the main chain
+        int     finalizedEpochs;                // epochs whose checkpoint was finalized
+        int     shard;                          // the shard of the node, 0 without sharding
+        long    sentReceipts;                   // cross-shard transactions of the miner's confirmed blocks sent to their destination shard
+        long    crossShardTransactions;         // receipts confirmed in the miner's blocks of the destination shard
+        double  meanCrossShardLatency;          // creation in the source shard -> receipt confirmed in the destination shard
+        double  crossShardLatencyP90;
+        int     microblocks;                    // Bitcoin-NG microblocks received by the node
+        int     generatedMicroblocks;           // microblocks streamed by the miner as leader
+        int     staleMicroblocks;               // microblocks of the miner left out of the main chain
+        double  meanUploadQueueingTime;         // GET_DATA received -> upload of the blocks started
+        double  uploadQueueingTimeP99;
+        int     peakPendingUploads;             // most block uploads waiting for the upload link at once
+        int     peakConcurrentDownloads;        // most block downloads sharing the downlink at once
+        int     chunkedBlocks;                  // blocks assembled from their BLOCK_TORRENT chunks
+        long    chunksReceived;
+        long    duplicateChunks;                // chunks received once the node had them or the whole block
+        long    peakSendQueueBytes;             // most bytes waiting for the TCP send buffer of a peer connection
+        double  meanConsensusSendQueueingTime;  // CONSENSUS_PRIORITY message queued -> handed to TCP
+        double  meanBulkSendQueueingTime;       // BULK_PRIORITY message queued -> handed to TCP
+        int     departures;                     // times the node left the network
+        int     catchUps;                       // rejoins or late starts after which the node synced the chain of its sync peer
+        double  meanCatchUpTime;                // rejoin -> synced
+        double  catchUpTimeP90;
+        long    catchUpReceivedBytes;           // headers and blocks received while catching up
+        double  offlineTime;                    // seconds spent offline
+        long    syncRequestTimeouts;            // sync block requests that a peer did not deliver in time
+        int     syncServingPeers;               // peers that delivered sync blocks
         
     } nodeStatistics;
 
@@ -88,12 +220,29 @@ namespace ns3 {
         double uploadSpeed;
     } nodeInternetSpeed;
 
+    /*
+     * Quorum certificate of the BFT consensus: a quorum of the committee voted for the block (height, minerId) proposed in view
+     */
+    typedef struct{
+        int     height;
+        int     minerId;
+        int     view;           // -1 for the genesis certificate
+        int     votes;
+    } QuorumCertificate;
+
     const char* getMessageName(enum Messages m);
     const char* getMinerType(enum MinerType m);
     const char* getProtocolType(enum ProtocolType m);
     const char* getCryptocurrency(enum Cryptocurrency m);
+    const char* getTransactionRelayType(enum TransactionRelayType m);
+    const char* getForkChoiceRule(enum ForkChoiceRule m);
+    const char* getUploadDiscipline(enum UploadDiscipline m);
+    const char* getMessagePriority(enum MessagePriority m);
+    const char* getSessionDistribution(enum SessionDistribution m);
+    enum MessagePriority getPriorityEnum(enum Messages m);
     const char* getBlockchainRegion(enum BlockchainRegion m);
     enum BlockchainRegion getBlockchainEnum(uint32_t n);
+    uint64_t getTransactionKey(int nodeId, int transId);
 
     class Transaction
     {
@@ -115,12 +264,33 @@ namespace ns3 {
             double GetTransTimeStamp(void) const;
             void SetTransTimeStamp(double timeStamp);
 
+            double GetTransFee(void) const;
+            void SetTransFee(double fee);
+
+            /*
+             * Returns the fee paid per byte, used to order the transactions in the mempool
+             */
+            double GetTransFeeRate(void) const;
+
             bool IsValidated(void) const;
             void SetValidation(void);
 
             bool IsExecuted(void) const;
             void SetExecution(void);
 
+            /*
+             * The endorsements collected in the execute-order-validate pipeline, 0 for other transactions
+             */
+            int GetEndorsements(void) const;
+            void SetEndorsements(int endorsements);
+
+            /*
+             * The shard the transaction pays to, -1 if it stays in the shard of its creator.
+             * In the destination shard the same transaction is the receipt of the payment.
+             */
+            int GetDestinationShard(void) const;
+            void SetDestinationShard(int shard);
+
             Transaction& operator = (const Transaction &tranSource);     //Assignment Constructor
 
             friend bool operator == (const Transaction &tran1, const Transaction &tran2);
@@ -131,8 +301,11 @@ namespace ns3 {
             int m_transId;
             int m_transSizeByte;
             double m_timeStamp;
+            double m_fee;
             bool m_validatation; 
             bool m_execution;
+            int m_endorsements;
+            int m_destinationShard;
 
     };
 
@@ -165,12 +338,43 @@ namespace ns3 {
             void SetTimeStamp(double timeStamp);
 
             double GetTimeReceived(void) const;
+            void SetTimeReceived(double timeReceived);
             
             Ipv4Address GetReceivedFromIpv4(void) const;
             void SetReceivedFromIpv4(Ipv4Address receivedFromIpv4);
 
             std::vector<Transaction> GetTransactions(void) const;
             void SetTransactions(const std::vector<Transaction> &transactions);
+
+            /*
+             * The (height, minerId) of the stale blocks referenced by this block as uncles
+             */
+            std::vector<std::pair<int, int>> GetUncles(void) const;
+            void SetUncles(const std::vector<std::pair<int, int>> &uncles);
+
+            /*
+             * The BFT view in which the block was proposed, -1 for mined blocks
+             */
+            int GetView(void) const;
+            void SetView(int view);
+
+            /*
+             * The quorum certificate carried by a proposed block
+             */
+            QuorumCertificate GetJustify(void) const;
+            void SetJustify(const QuorumCertificate &justify);
+
+            /*
+             * Whether the body of the block passes the full validation, the header always does
+             */
+            bool IsValid(void) const;
+            void SetValid(bool valid);
+
+            /*
+             * Whether the block is a microblock streamed by the leader of the last key block (Bitcoin-NG)
+             */
+            bool IsMicroblock(void) const;
+            void SetMicroblock(bool microblock);
             /*
             * Checks if the block provided as the argument is the parent of this block object
             */
@@ -209,6 +413,11 @@ namespace ns3 {
             double      m_timeReceived;              //the time that the block was received from the node
             Ipv4Address m_receivedFromIpv4;       //the ipv4 of the node which sent the block to the receiving node
             std::vector<Transaction> m_transactions;
+            std::vector<std::pair<int, int>> m_uncles;  //the (height, minerId) of the referenced uncles
+            int         m_view;                         //the BFT view of the block, -1 for mined blocks
+            QuorumCertificate m_justify;                //the quorum certificate carried by a proposed block
+            bool        m_valid;                        //false if the full validation of the block fails
+            bool        m_microblock;                   //true for the microblocks of a Bitcoin-NG leader
     };
 
     class Blockchain : public Block
@@ -219,6 +428,11 @@ namespace ns3 {
 
             int GetTotalBlocks(void) const;
 
+            /*
+             * The microblocks among the total blocks
+             */
+            int GetTotalMicroblocks(void) const;
+
             int GetNoOrphans(void) const;
 
             int GetBlockchainHeight(void) const;
@@ -250,25 +464,634 @@ namespace ns3 {
 
             const Block* GetCurrentTopBlock(void) const;
 
+            /*
+             * Sets the rule used to pick the top block. Should be called before adding blocks.
+             */
+            void SetForkChoiceRule(enum ForkChoiceRule forkChoiceRule);
+
+            enum ForkChoiceRule GetForkChoiceRule(void) const;
+
             void AddBlock(const Block& newBlock);
 
             void AddOrphan(const Block& newBlock);
 
             void RemoveOrphan (const Block& newBlock);
 
+            bool IsInMainChain(int height, int minerId) const;
+
+            /*
+             * The block of the main chain at the height, 0 above the top block
+             */
+            const Block* GetMainChainBlock(int height) const;
+
+            /*
+             * The (height, minerId) of the main chain blocks that describe it to a peer: the last 10 blocks,
+             * then exponentially sparser blocks down to the genesis.
+             */
+            std::vector<std::pair<int, int>> GetLocator(void) const;
+
+            /*
+             * Returns the (height, minerId) of at most maxUncles blocks that a block mined on top of the
+             * current top block may reference as uncles: stale blocks at most maxDepth generations older
+             * whose parent is in the main chain and which have not been referenced yet.
+             */
+            std::vector<std::pair<int, int>> GetUncleCandidates(int maxUncles, int maxDepth) const;
+
             //void PrintOrphans(void);
 
-            //void GetBlocksInForks(void);
+            int GetBlocksInForks(void) const;
+
+            int GetLongestForkSize(void) const;
+
+            int GetMinedBlocksInMainChain(int minerId) const;
 
-            //int GetLongestForkSize(void);
+            int GetUnclesInMainChain(void) const;
+
+            long GetTransactionsInMainChain(void) const;
 
             //friend std:: ostream& operator << (std:ostream &out, Blockchain &blockchain);
 
         protected:
-        
+
+            /*
+             * Tree information of m_blocks[height][i], kept in m_blockTree[height][i]
+             */
+            struct BlockTreeNode
+            {
+                int                 parent;             // index of the parent in the previous height, -1 for the genesis and the blocks whose parent is missing
+                int                 subtreeWeight;      // number of blocks in the subtree rooted at this block, only kept while the block is out of the main chain
+                int                 keyBlocks;          // number of key blocks from the genesis to this block
+                std::vector<int>    children;           // indices of the children in the next height
+            };
+
+            bool IsMainChainBlock(int height, int index) const;
+
+            /*
+             * Adds weight to the block and its ancestors up to the main chain
+             * Returns the height where the branch joins the main chain, -1 if it has no main chain ancestor
+             */
+            int AddWeightToAncestors(int height, int index, int weight);
+
+            /*
+             * The number of blocks in the subtree rooted at the block
+             */
+            int GetWeight(int height, int index) const;
+
+            /*
+             * Removes the main chain blocks above joinHeight, or appends a child of the top block
+             */
+            void TruncateMainChain(int joinHeight);
+            void ExtendMainChain(int index);
+
+            /*
+             * Recomputes the key blocks of a subtree that was attached to its parent
+             */
+            void UpdateKeyBlocks(int height, int index);
+
+            /*
+             * The (height, index) of the descendant that the fork choice rule would pick as the top block
+             */
+            std::pair<int, int> GetBestDescendant(int height, int index) const;
+
+            void UpdateMainChain(int joinHeight, int height, int index);
+
+            int GetHeaviestChild(int height, int index) const;
+
             int                             m_totalBlocks;
+            int                             m_totalMicroblocks;
             std::vector<std::vector<Block>> m_blocks;
             std::vector<Block>              m_orphans;                 
+            std::vector<std::vector<BlockTreeNode>> m_blockTree;
+            std::vector<int>                m_mainChain;        // index in m_blocks[height] of the main chain block
+            std::vector<int>                m_joinedBlocks;     // per main chain height, the blocks whose highest main chain ancestor is at that height
+            enum ForkChoiceRule             m_forkChoiceRule;
+    };
+
+    /*
+     * Pool of the transactions waiting to be included in a block. The pool has a byte budget; when it is full
+     * the transactions with the lowest fee rate are evicted, or the new transaction is rejected if it pays less
+     * than them. Transactions older than the expiry time are dropped.
+     */
+    class Mempool
+    {
+        public:
+            Mempool(void);
+            virtual ~Mempool(void);
+
+            void SetMaxSizeBytes(uint64_t maxSizeBytes);
+            void SetExpiryTime(double expiryTime);      // 0 means that the transactions never expire
+
+            /*
+             * Adds a transaction to the pool, making space if needed.
+             * return false : if the transaction was rejected
+             */
+            bool AddTransaction(const Transaction &newTrans, double time);
+
+            /*
+             * Removes the transaction from the pool.
+             * return false : if the transaction was not in the pool
+             */
+            bool RemoveTransaction(int nodeId, int transId);
+
+            bool HasTransaction(int nodeId, int transId) const;
+
+            /*
+             * Returns the transaction. Should be called after HasTransaction() to make sure that it exists.
+             */
+            Transaction ReturnTransaction(int nodeId, int transId) const;
+
+            /*
+             * Drops the transactions that entered the pool before (time - expiryTime)
+             */
+            void ExpireTransactions(double time);
+
+            /*
+             * Returns the transactions with the highest fee rate that fit in maxSizeBytes, highest first.
+             */
+            std::vector<Transaction> GetTransactionsByFee(int maxSizeBytes) const;
+
+            int GetSize(void) const;
+            uint64_t GetSizeBytes(void) const;
+            uint64_t GetPeakSizeBytes(void) const;
+            long GetRejectedTransactions(void) const;
+            long GetEvictedTransactions(void) const;
+            long GetExpiredTransactions(void) const;
+
+            /*
+             * Returns the keys of the transactions evicted or expired since the last call
+             */
+            std::vector<uint64_t> TakeDroppedTransactions(void);
+
+        protected:
+            void Remove(std::unordered_map<uint64_t, std::pair<Transaction, double>>::iterator entry);
+
+            uint64_t    m_maxSizeBytes;
+            double      m_expiryTime;
+            uint64_t    m_sizeBytes;
+            uint64_t    m_peakSizeBytes;
+            long        m_rejected;
+            long        m_evicted;
+            long        m_expired;
+
+            std::unordered_map<uint64_t, std::pair<Transaction, double>>    m_transactions;     // key = transaction key, value = (transaction, entry time)
+            std::set<std::pair<double, uint64_t>>                           m_byFeeRate;        // (fee rate, transaction key), lowest first
+            std::deque<std::pair<double, uint64_t>>                         m_entryTimes;       // (entry time, transaction key) in arrival order
+            std::vector<uint64_t>                                           m_dropped;          // keys evicted or expired since TakeDroppedTransactions()
+    };
+
+    /*
+     * Bounded cache of the transactions whose signatures were already verified.
+     * When it is full, the oldest entry is evicted. An erased key that is inserted again
+     * counts from its new insertion.
+     */
+    class SignatureCache
+    {
+        public:
+            SignatureCache(void);
+            virtual ~SignatureCache(void);
+
+            void SetMaxEntries(uint32_t maxEntries);
+
+            void Insert(uint64_t key);
+
+            bool Contains(uint64_t key) const;
+
+            /*
+             * Removes the entry, once the transaction is in a block it will not be verified again
+             */
+            void Erase(uint64_t key);
+
+        protected:
+            uint32_t                                        m_maxEntries;
+            uint64_t                                        m_insertions;
+            std::unordered_map<uint64_t, uint64_t>          m_entries;              // key = transaction key, value = insertion number
+            std::deque<std::pair<uint64_t, uint64_t>>       m_insertionOrder;       // (insertion number, key), may still hold erased or reinserted keys
+
+            /*
+             * Whether the element of m_insertionOrder is the current insertion of its key
+             */
+            bool IsCurrent(const std::pair<uint64_t, uint64_t> &insertion) const;
+    };
+
+    /*
+     * Rolling Bloom filter keeping roughly the last 2*items insertions. Two generations of bits are kept;
+     * when the current one is full, it becomes the previous one and a new empty generation starts.
+     */
+    class RollingBloomFilter
+    {
+        public:
+            RollingBloomFilter(int items, double fpRate);     // fpRate is clamped to [1e-9, 0.5]
+            RollingBloomFilter(void);
+            virtual ~RollingBloomFilter(void);
+
+            void Insert(uint64_t key);
+
+            bool Contains(uint64_t key) const;
+
+            /*
+             * Returns the false positive rate estimated from the number of items in each generation
+             */
+            double GetFalsePositiveRate(void) const;
+
+        protected:
+            uint32_t GetBit(uint64_t key, int i) const;
+            double GetGenerationFalsePositiveRate(int insertedItems) const;
+
+            int                 m_items;                //items per generation
+            int                 m_noHashes;
+            uint32_t            m_noBits;               //bits per generation
+            int                 m_currentItems;
+            int                 m_previousItems;
+            std::vector<bool>   m_current;
+            std::vector<bool>   m_previous;
+    };
+
+    /*
+     * Latency histogram with logarithmic buckets. The memory is fixed regardless of the number of samples
+     * and the percentiles are accurate to the bucket resolution.
+     */
+    class LatencyHistogram
+    {
+        public:
+            LatencyHistogram(double minValue, double maxValue, double resolution);
+            LatencyHistogram(void);
+            virtual ~LatencyHistogram(void);
+
+            void AddSample(double value);
+
+            /*
+             * Returns the value below which the given percentage (0-100) of the samples fall.
+             */
+            double GetPercentile(double percentile) const;
+
+            double GetMean(void) const;
+
+            uint64_t GetCount(void) const;
+
+            /*
+             * Adds the samples of another histogram, so that the percentiles are those of all the samples.
+             * Both histograms must have the same buckets.
+             */
+            void Merge(const LatencyHistogram &histogram);
+            void Merge(const std::vector<uint32_t> &buckets, double sum);
+
+            const std::vector<uint32_t>& GetBuckets(void) const;
+            double GetSum(void) const;
+
+        protected:
+            int GetBucket(double value) const;
+
+            double                  m_minValue;
+            double                  m_logResolution;        // log(1 + resolution)
+            std::vector<uint32_t>   m_buckets;
+            uint64_t                m_count;
+            double                  m_sum;
+    };
+
+    /*
+     * Follows the lifecycle of transactions at one node: creation, first-seen, first inclusion
+     * and k-confirmation depth. Only the transactions selected by the sample rate are followed,
+     * so that the state stays small in very large runs. The selection only depends on the transaction id,
+     * so all the nodes follow the same transactions.
+     */
+    class TransactionTracker
+    {
+        public:
+            TransactionTracker(void);
+            virtual ~TransactionTracker(void);
+
+            void SetSampleRate(uint32_t sampleRate);
+
+            void SetConfirmationDepth(int confirmationDepth);
+
+            int GetConfirmationDepth(void) const;
+
+            /*
+             * The transactions are followed for at most retentionTime seconds after their creation, after which
+             * their state is freed and they are ignored
+             */
+            void SetRetentionTime(double retentionTime);
+
+            bool IsSampled(int nodeId, int transId) const;
+
+            /*
+             * Called when the node creates a transaction
+             */
+            void TransactionCreated(const Transaction &newTrans);
+
+            /*
+             * Called when the node receives a transaction for the first time
+             */
+            void TransactionSeen(const Transaction &newTrans, double time);
+
+            /*
+             * Called when a block is added in the blockchain of the node
+             */
+            void BlockAdded(const Block &newBlock, double time);
+
+            /*
+             * Checks which included transactions reached the confirmation depth in the main chain
+             */
+            void UpdateConfirmations(Blockchain &blockchain, double time);
+
+            uint64_t GetTrackedTransactions(void) const;
+
+            const LatencyHistogram& GetFirstSeenTimes(void) const;
+            const LatencyHistogram& GetInclusionTimes(void) const;
+            const LatencyHistogram& GetConfirmationTimes(void) const;
+
+        protected:
+            enum TransactionStage
+            {
+                SEEN,
+                INCLUDED,
+                CONFIRMED                   // kept so that the transaction is not counted again when it is seen again
+            };
+
+            /*
+             * Whether the transaction is sampled and still within the retention time
+             */
+            bool IsFollowed(const Transaction &tran, double time) const;
+
+            /*
+             * Frees the state of the transactions followed for longer than the retention time
+             */
+            void ForgetExpired(double time);
+
+            uint32_t                                                        m_sampleRate;           // 1 out of m_sampleRate transactions is followed
+            int                                                             m_confirmationDepth;    // k
+            double                                                          m_retentionTime;
+            uint64_t                                                        m_trackedTransactions;
+            std::unordered_map<uint64_t, enum TransactionStage>             m_stages;               // key = transaction key
+            std::deque<std::pair<double, uint64_t>>                         m_followedSince;        // (time, transaction key) in the order the entries of m_stages were added
+            std::map<std::pair<int, int>, std::vector<std::pair<uint64_t, double>>>  m_pendingConfirmations;  // key = (height, minerId), value = (transaction key, creation time)
+            LatencyHistogram                                                m_firstSeenTimes;
+            LatencyHistogram                                                m_inclusionTimes;
+            LatencyHistogram                                                m_confirmationTimes;
+    };
+
+    /*
+     * The transaction latencies of all the nodes, merged bucket by bucket so that the network-wide percentiles
+     * are those of all the samples instead of an average of the per-node percentiles
+     */
+    struct TransactionLatencies
+    {
+        LatencyHistogram    firstSeenTimes;
+        LatencyHistogram    inclusionTimes;
+        LatencyHistogram    confirmationTimes;
+    };
+
+    /*
+     * Upload link of a node. The uploads are sent one at a time at the full upload speed of the node and the
+     * pending ones wait in per-peer queues, from which the discipline picks the next upload: FIFO_UPLOADS in
+     * request order, FAIR_SHARE_UPLOADS by deficit round robin over the peers with pending uploads and
+     * PEER_PRIORITY_UPLOADS from the peer with the highest priority (the highest address on equal priorities).
+     * Every queue only pops at its front, so picking the next upload takes O(1), O(log peers) with priorities.
+     */
+    class UploadScheduler
+    {
+        public:
+            struct Upload
+            {
+                Ipv4Address         peer;
+                Address             address;            // where the message is sent
+                std::string         packet;
+                enum Messages       message;            // BLOCK or CHUNK
+                int                 sizeBytes;
+                double              requestTime;
+            };
+
+            UploadScheduler(void);
+            virtual ~UploadScheduler(void);
+
+            /*
+             * Should be called before the first upload is queued
+             */
+            void SetDiscipline(enum UploadDiscipline discipline);
+
+            /*
+             * The bytes a peer may upload per round of FAIR_SHARE_UPLOADS
+             */
+            void SetQuantum(int quantumBytes);
+
+            void SetPeerPriority(Ipv4Address peer, double priority);
+
+            void Enqueue(const Upload &upload);
+
+            /*
+             * Removes and returns the next upload. Should be called after HasPendingUploads() to make sure that it exists.
+             */
+            Upload Dequeue(void);
+
+            bool HasPendingUploads(void) const;
+            int GetPendingUploads(void) const;
+            int GetPeakPendingUploads(void) const;
+
+        protected:
+            enum UploadDiscipline                           m_discipline;
+            int                                             m_quantumBytes;
+            int                                             m_pendingUploads;
+            int                                             m_peakPendingUploads;
+            std::map<Ipv4Address, std::deque<Upload>>       m_queues;           // pending uploads of every peer, in request order
+            std::deque<Ipv4Address>                         m_requestOrder;     // FIFO_UPLOADS: the peer of every pending upload, in request order
+            std::deque<Ipv4Address>                         m_activePeers;      // FAIR_SHARE_UPLOADS: round of the peers with pending uploads
+            std::map<Ipv4Address, int>                      m_deficits;         // FAIR_SHARE_UPLOADS: bytes every active peer may still upload
+            std::map<Ipv4Address, double>                   m_priorities;
+            std::set<std::pair<double, Ipv4Address>>        m_priorityPeers;    // PEER_PRIORITY_UPLOADS: the peers with pending uploads
+    };
+
+    /*
+     * Downlink of a node shared max-min fairly by the transfers in progress. Every transfer is capped by the
+     * upload speed of its sender: water-filling gives the transfers below the fair share their cap and splits
+     * the rest of the downlink equally among the others. The rates only change when a transfer starts or ends,
+     * so the remaining bytes are only advanced at those instants and no packet is simulated.
+     */
+    class DownloadLink
+    {
+        public:
+            DownloadLink(void);
+            virtual ~DownloadLink(void);
+
+            void SetCapacity(double bytesPerSecond);
+
+            /*
+             * Starts a transfer at the given time
+             * return : the id of the transfer
+             */
+            int AddTransfer(double sizeBytes, double maxRate, double time);
+
+            /*
+             * Ends a transfer at the given time, the others share its bandwidth from then on
+             */
+            void RemoveTransfer(int id, double time);
+
+            /*
+             * The transfer that finishes first and its finish time, (-1, 0) if there are no transfers
+             */
+            std::pair<int, double> GetNextCompletion(void) const;
+
+            int GetActiveTransfers(void) const;
+            int GetPeakActiveTransfers(void) const;
+
+        protected:
+            struct Transfer
+            {
+                double              remainingBytes;
+                double              maxRate;            // upload speed of the sender
+                double              rate;               // current max-min fair share
+            };
+
+            /*
+             * Drains the transfers at their current rates up to the given time
+             */
+            void Advance(double time);
+
+            void UpdateRates(void);
+
+            double                                          m_capacity;         // Bytes/s
+            double                                          m_lastUpdate;
+            int                                             m_nextId;
+            int                                             m_peakActiveTransfers;
+            std::map<int, Transfer>                         m_transfers;
+    };
+
+    /*
+     * A block relayed in fixed-size chunks (BlockTorrent). The transactions of the block are dealt to the chunks
+     * in order, so every chunk can be relayed on its own and the block is assembled once all of them arrived.
+     * It also keeps the chunks every peer announced and the chunks requested from it, so that the requests
+     * are spread over all the peers that have a chunk, the rarest chunks first.
+     */
+    class ChunkedBlock
+    {
+        public:
+            ChunkedBlock(const Block &header, int chunkSizeBytes);
+            ChunkedBlock(void);
+            virtual ~ChunkedBlock(void);
+
+            /*
+             * The number of chunks of a block of blockSizeBytes, at least one
+             */
+            static int GetChunks(int blockSizeBytes, int chunkSizeBytes);
+
+            /*
+             * The transactions of a chunk, out of the transactions of the whole block
+             */
+            static std::vector<Transaction> GetChunkTransactions(const std::vector<Transaction> &transactions, int chunk, int chunks);
+
+            const Block& GetHeader(void) const;
+            int GetChunks(void) const;
+
+            /*
+             * The bytes of a chunk, the last one may be shorter
+             */
+            int GetChunkSizeBytes(int chunk) const;
+
+            bool HasChunk(int chunk) const;
+
+            /*
+             * Should be called after HasChunk() to make sure that the chunk was received
+             */
+            const std::vector<Transaction>& GetChunkTransactions(int chunk) const;
+
+            /*
+             * return true : if the chunk was missing, false : if it is a duplicate
+             */
+            bool AddChunk(int chunk, const std::vector<Transaction> &transactions);
+
+            bool IsComplete(void) const;
+
+            /*
+             * The block with the transactions of all the chunks. Should be called once IsComplete().
+             */
+            Block Assemble(void) const;
+
+            /*
+             * The received chunks as a string of '0' and '1', one character per chunk
+             */
+            std::string GetBitmap(void) const;
+
+            /*
+             * Records the chunks announced by a peer, in the format of GetBitmap()
+             */
+            void SetPeerChunks(Ipv4Address peer, const std::string &bitmap);
+            bool PeerHasAllChunks(Ipv4Address peer) const;
+
+            /*
+             * Picks the missing chunks the peer has and nobody was asked for, the chunks announced by the fewest
+             * peers first, and marks them requested from the peer. The chunks requested from the peer and not
+             * received yet count towards maxInFlight.
+             */
+            std::vector<int> RequestChunks(Ipv4Address peer, int maxInFlight);
+
+        protected:
+            Block                                           m_header;           // the block without its transactions
+            int                                             m_chunkSizeBytes;
+            int                                             m_receivedChunks;
+            std::vector<bool>                               m_received;
+            std::vector<std::vector<Transaction>>           m_transactions;     // the transactions of every received chunk
+            std::map<int, Ipv4Address>                      m_requests;         // key = chunk, value = the peer it was requested from
+            std::map<Ipv4Address, std::vector<bool>>        m_peersChunks;      // the chunks announced by every peer
+    };
+
+    /*
+     * Outbound messages of a connection that did not fit in its TCP send buffer yet. The messages wait in one
+     * queue per MessagePriority and always leave whole, the next one is picked by weighted fair queueing: while
+     * several classes are backlogged every class gets a share of the bytes proportional to its weight, and a
+     * class that was idle cannot claim the bytes it did not use. The first message is sent from an offset, so
+     * draining a large queue in small pieces stays cheap.
+     */
+    class SendQueue
+    {
+        public:
+            static const int PRIORITY_CLASSES = 3;
+
+            SendQueue(void);
+            SendQueue(const std::vector<uint32_t> &weights);        // one weight per MessagePriority, 0 counts as 1
+            virtual ~SendQueue(void);
+
+            /*
+             * param message : the serialized message with its delimiter
+             * param time : when the message was queued, in seconds
+             */
+            void Push(const std::string &message, enum MessagePriority priority, double time);
+
+            bool IsEmpty(void) const;
+            uint32_t GetBytes(void) const;
+            uint32_t GetBytes(enum MessagePriority priority) const;
+
+            /*
+             * The unsent bytes of the message being sent. Should be called after IsEmpty() to make sure that it exists.
+             */
+            const uint8_t* GetFront(void) const;
+            uint32_t GetFrontSize(void) const;
+            enum MessagePriority GetFrontPriority(void) const;
+            double GetFrontTime(void) const;
+
+            /*
+             * Removes bytes that were sent, at most GetFrontSize()
+             */
+            void Pop(uint32_t bytes);
+
+            /*
+             * Drops the queued messages. A message partly sent is kept until it leaves whole, so that the peer
+             * never receives it truncated.
+             */
+            void Clear(void);
+
+        protected:
+            /*
+             * Picks the class with the smallest virtual finish time for the next message
+             */
+            void SelectNext(void);
+
+            std::vector<std::deque<std::pair<std::string, double>>> m_messages;     // per class, the messages and when they were queued
+            std::vector<uint32_t>                           m_weights;
+            std::vector<double>                             m_finishTimes;      // virtual finish time of the last message of every class
+            std::vector<uint32_t>                           m_classBytes;
+            double                                          m_virtualTime;      // virtual start time of the message being sent
+            int                                             m_current;          // class of the message being sent, -1 if the queue is empty
+            uint32_t                                        m_offset;           // bytes of the message being sent already sent
+            uint32_t                                        m_bytes;
     };
 
 }
@@ -0,0 +1,51 @@
+# Compares the flow-level model of the links (--flowLevel) with the packet-level TCP simulation,
+# and times the flow-level model on large networks. Run copy-to-ns3.sh first.
+# The results are appended to $RESULTS, one line per run.
+
+# Configure the following values
+NS3_FOLDER=~/workspace/ns-allinone-3.25/ns-3.25
+RESULTS=$(pwd)/flow-level-comparison.txt
+SMALL_NODES=200
+SMALL_BLOCKS=50
+RUNS="1 2 3 4 5"
+LARGE_NODES="50000 100000"
+LARGE_BLOCKS=10
+
+# Do not change
+run()
+{
+  local label=$1
+  shift
+  local start=$(date +%s.%N)
+  local output=$(cd $NS3_FOLDER && ./waf --run "blockchain_test1 $*" 2>&1)
+  local end=$(date +%s.%N)
+
+  if [ "$label" = flow ] && ! echo "$output" | grep -q "^Flow-level links:"
+  then
+    echo "The flow-level run $* fell back to the TCP packets or failed:" >&2
+    echo "$output" | grep "flow-level model needs" >&2
+    exit 1
+  fi
+
+  local mean=$(echo "$output" | grep -m1 "^Mean Block Propagation Time" | sed 's/.*= \(.*\)s/\1/')
+  local median=$(echo "$output" | grep -m1 "^Median Block Propagation Time" | sed 's/.*= \(.*\)s/\1/')
+  local p90=$(echo "$output" | grep -m1 "^90% percentile of Block Propagation Time" | sed 's/.*= \(.*\)s/\1/')
+  local stale=$(echo "$output" | grep -m1 "^Stale block rate" | sed 's/Stale block rate = \([^%]*\)%.*/\1/')
+
+  echo "$label $* : propagation mean/median/p90 = $mean/$median/${p90}s, stale rate = $stale%, wall time = $(echo "$end - $start" | bc)s" | tee -a $RESULTS
+}
+
+echo "# $(date)" >> $RESULTS
+
+# Accuracy: the same seeds with and without the flow-level model
+for r in $RUNS
+do
+  run tcp --nodes=$SMALL_NODES --noBlocks=$SMALL_BLOCKS --RngRun=$r
+  run flow --nodes=$SMALL_NODES --noBlocks=$SMALL_BLOCKS --RngRun=$r --flowLevel=true
+done
+
+# Scale: the flow-level model only, the packet-level simulation does not fit in memory there
+for n in $LARGE_NODES
+do
+  run flow --nodes=$n --noBlocks=$LARGE_BLOCKS --RngRun=1 --flowLevel=true
+done
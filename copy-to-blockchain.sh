@@ -7,15 +7,30 @@ cp $NS3_FOLDER/src/applications/model/blockchain.h $PROJECT_FOLDER/applications/
 cp $NS3_FOLDER/src/applications/model/blockchain.cc $PROJECT_FOLDER/applications/model/
 cp $NS3_FOLDER/src/applications/model/blockchain-miner.h $PROJECT_FOLDER/applications/model/
 cp $NS3_FOLDER/src/applications/model/blockchain-miner.cc $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-validator.h $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-validator.cc $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-staker.h $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-staker.cc $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-endorser.h $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-endorser.cc $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-orderer.h $PROJECT_FOLDER/applications/model/
+cp $NS3_FOLDER/src/applications/model/blockchain-orderer.cc $PROJECT_FOLDER/applications/model/
 cp $NS3_FOLDER/src/applications/model/blockchain-node.h $PROJECT_FOLDER/applications/model/
 cp $NS3_FOLDER/src/applications/model/blockchain-node.cc $PROJECT_FOLDER/applications/model/
 cp $NS3_FOLDER/src/applications/helper/blockchain-miner-helper.h $PROJECT_FOLDER/applications/helper/
 cp $NS3_FOLDER/src/applications/helper/blockchain-miner-helper.cc $PROJECT_FOLDER/applications/helper/
+cp $NS3_FOLDER/src/applications/helper/blockchain-validator-helper.h $PROJECT_FOLDER/applications/helper/
+cp $NS3_FOLDER/src/applications/helper/blockchain-validator-helper.cc $PROJECT_FOLDER/applications/helper/
+cp $NS3_FOLDER/src/applications/helper/blockchain-staker-helper.h $PROJECT_FOLDER/applications/helper/
+cp $NS3_FOLDER/src/applications/helper/blockchain-staker-helper.cc $PROJECT_FOLDER/applications/helper/
 cp $NS3_FOLDER/src/applications/helper/blockchain-node-helper.h $PROJECT_FOLDER/applications/helper/
 cp $NS3_FOLDER/src/applications/helper/blockchain-node-helper.cc $PROJECT_FOLDER/applications/helper/
 cp $NS3_FOLDER/src/applications/helper/blockchain-topology-helper.h $PROJECT_FOLDER/applications/helper/
 cp $NS3_FOLDER/src/applications/helper/blockchain-topology-helper.cc $PROJECT_FOLDER/applications/helper/
+cp $NS3_FOLDER/src/applications/helper/blockchain-region-model.h $PROJECT_FOLDER/applications/helper/
+cp $NS3_FOLDER/src/applications/helper/blockchain-region-model.cc $PROJECT_FOLDER/applications/helper/
 cp $NS3_FOLDER/src/internet/helper/ipv4-address-helper-custom.h $PROJECT_FOLDER/internet/helper/
 cp $NS3_FOLDER/src/internet/helper/ipv4-address-helper-custom.cc $PROJECT_FOLDER/internet/helper/
 cp $NS3_FOLDER/scratch/blockchain_test1.cc $PROJECT_FOLDER/scratch
+cp $NS3_FOLDER/blockchain-regions.txt $PROJECT_FOLDER/data/
 
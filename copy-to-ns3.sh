@@ -7,14 +7,29 @@ cp $PROJECT_FOLDER/applications/model/blockchain.h $NS3_FOLDER/src/applications/
 cp $PROJECT_FOLDER/applications/model/blockchain.cc $NS3_FOLDER/src/applications/model/
 cp $PROJECT_FOLDER/applications/model/blockchain-miner.h $NS3_FOLDER/src/applications/model/
 cp $PROJECT_FOLDER/applications/model/blockchain-miner.cc $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-validator.h $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-validator.cc $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-staker.h $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-staker.cc $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-endorser.h $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-endorser.cc $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-orderer.h $NS3_FOLDER/src/applications/model/
+cp $PROJECT_FOLDER/applications/model/blockchain-orderer.cc $NS3_FOLDER/src/applications/model/
 cp $PROJECT_FOLDER/applications/model/blockchain-node.h $NS3_FOLDER/src/applications/model/
 cp $PROJECT_FOLDER/applications/model/blockchain-node.cc $NS3_FOLDER/src/applications/model/
 cp $PROJECT_FOLDER/applications/helper/blockchain-miner-helper.h $NS3_FOLDER/src/applications/helper/
 cp $PROJECT_FOLDER/applications/helper/blockchain-miner-helper.cc $NS3_FOLDER/src/applications/helper/
+cp $PROJECT_FOLDER/applications/helper/blockchain-validator-helper.h $NS3_FOLDER/src/applications/helper/
+cp $PROJECT_FOLDER/applications/helper/blockchain-validator-helper.cc $NS3_FOLDER/src/applications/helper/
+cp $PROJECT_FOLDER/applications/helper/blockchain-staker-helper.h $NS3_FOLDER/src/applications/helper/
+cp $PROJECT_FOLDER/applications/helper/blockchain-staker-helper.cc $NS3_FOLDER/src/applications/helper/
 cp $PROJECT_FOLDER/applications/helper/blockchain-node-helper.h $NS3_FOLDER/src/applications/helper/
 cp $PROJECT_FOLDER/applications/helper/blockchain-node-helper.cc $NS3_FOLDER/src/applications/helper/
 cp $PROJECT_FOLDER/applications/helper/blockchain-topology-helper.h $NS3_FOLDER/src/applications/helper/
 cp $PROJECT_FOLDER/applications/helper/blockchain-topology-helper.cc $NS3_FOLDER/src/applications/helper/
+cp $PROJECT_FOLDER/applications/helper/blockchain-region-model.h $NS3_FOLDER/src/applications/helper/
+cp $PROJECT_FOLDER/applications/helper/blockchain-region-model.cc $NS3_FOLDER/src/applications/helper/
 cp $PROJECT_FOLDER/internet/helper/ipv4-address-helper-custom.h $NS3_FOLDER/src/internet/helper/
 cp $PROJECT_FOLDER/internet/helper/ipv4-address-helper-custom.cc $NS3_FOLDER/src/internet/helper/
+cp $PROJECT_FOLDER/data/blockchain-regions.txt $NS3_FOLDER/
 
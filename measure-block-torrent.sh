@@ -0,0 +1,37 @@
+# Measures the block propagation gain of the chunked relay (--blockTorrent) over the whole-block relay
+# for growing block sizes, over the same seeds. Run copy-to-ns3.sh first.
+# The results are appended to $RESULTS, one line per run, and the mean gain per block size at the end.
+
+# Configure the following values
+NS3_FOLDER=~/workspace/ns-allinone-3.25/ns-3.25
+RESULTS=$(pwd)/block-torrent-gain.txt
+NODES=200
+BLOCKS=50
+BLOCK_SIZES="1000000 2000000 4000000 8000000"
+RUNS="1 2 3"
+
+# Do not change
+propagation()
+{
+  local output=$(cd $NS3_FOLDER && ./waf --run "blockchain_test1 $*" 2>&1)
+  local mean=$(echo "$output" | grep -m1 "^Mean Block Propagation Time" | sed 's/.*= \(.*\)s/\1/')
+  local p90=$(echo "$output" | grep -m1 "^90% percentile of Block Propagation Time" | sed 's/.*= \(.*\)s/\1/')
+  local stale=$(echo "$output" | grep -m1 "^Stale block rate" | sed 's/Stale block rate = \([^%]*\)%.*/\1/')
+
+  echo "$* : propagation mean/p90 = $mean/${p90}s, stale rate = $stale%" >> $RESULTS
+  echo $mean
+}
+
+echo "# $(date)" >> $RESULTS
+
+for size in $BLOCK_SIZES
+do
+  relay=0
+  torrent=0
+  for r in $RUNS
+  do
+    relay=$(echo "$relay + $(propagation --nodes=$NODES --noBlocks=$BLOCKS --blockSize=$size --RngRun=$r)" | bc -l)
+    torrent=$(echo "$torrent + $(propagation --nodes=$NODES --noBlocks=$BLOCKS --blockSize=$size --RngRun=$r --blockTorrent=true)" | bc -l)
+  done
+  echo "blockSize = $size: mean propagation relay/blockTorrent = $relay/$torrent (summed over the runs), gain = $(echo "100 * (1 - $torrent / $relay)" | bc -l | cut -c1-5)%" | tee -a $RESULTS
+done